@@ -0,0 +1,278 @@
+#include "animation.h"
+#include "profiler.h"
+#include "projection.h"
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+
+//Implementation details of animation clips and keyframe sampling
+
+namespace {
+
+inline void normalizeQuaternion(float q[4]){
+    float len = sqrtf(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+    float scale = len > 0? 1.0f/len: 0.0f;
+    for(int c = 0; c < 4; c++) q[c] *= scale;
+    if(len == 0) q[3] = 1;
+}
+
+/**
+ * Spherical interpolation of unit quaternions, falling back to a normalized
+ * lerp when they are almost parallel
+ */
+inline void slerp(const float a[4], const float b[4], float u, float out[4]){
+    float d = a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3];
+    float sign = d < 0? -1.0f: 1.0f;
+    d *= sign;
+    float wa = 1 - u, wb = u;
+    if(d < 0.9995f){
+        float theta = acosf(d);
+        float inv_sin = 1.0f/sinf(theta);
+        wa = sinf((1 - u)*theta)*inv_sin;
+        wb = sinf(u*theta)*inv_sin;
+    }
+    wb *= sign;
+    for(int c = 0; c < 4; c++) out[c] = wa*a[c] + wb*b[c];
+    normalizeQuaternion(out);
+}
+
+}
+
+// ====== AnimationClip ======
+
+AnimationClip::AnimationClip(){
+    duration = 0;
+    joint_count = 0;
+}
+
+/**
+ * Add a track to the clip. Rotation keys are normalized and flipped to the
+ * hemisphere of the previous key, so interpolation takes the short way around.
+ * @param joint index of the animated joint
+ * @param target animated channel
+ * @param interpolation how to interpolate between keys, must suit the channel
+ * @param key_times key_count strictly increasing times in seconds
+ * @param key_values 3 floats per key, 4 for rotations
+ * @param key_count number of keys, at least 1
+ * @return the track index, -1 when the keys or the interpolation are invalid
+ */
+int AnimationClip::addTrack(int joint, TrackTarget target, Interpolation interpolation,
+                            const float* key_times, const float* key_values, size_t key_count){
+    bool rotation = target == TRACK_ROTATION;
+    bool suits = interpolation == INTERP_STEP
+                 || (rotation? interpolation == INTERP_NLERP || interpolation == INTERP_SLERP
+                             : interpolation == INTERP_LINEAR || interpolation == INTERP_CUBIC);
+    if(!suits || key_count == 0 || joint < 0){
+        std::cout << "Warning: invalid animation track for joint " << joint << "\n";
+        return -1;
+    }
+    for(size_t k = 1; k < key_count; k++){
+        if(!(key_times[k] > key_times[k - 1])){
+            std::cout << "Warning: animation track keys of joint " << joint << " are not in increasing time\n";
+            return -1;
+        }
+    }
+    AnimationTrack track;
+    track.joint = joint;
+    track.target = target;
+    track.interpolation = interpolation;
+    track.first_key = (uint32_t)times.size();
+    track.key_count = (uint32_t)key_count;
+    track.first_value = (uint32_t)values.size();
+    track.components = rotation? 4: 3;
+    int n = track.components;
+
+    times.insert(times.end(), key_times, key_times + key_count);
+    values.insert(values.end(), key_values, key_values + n*key_count);
+    tangents.resize(values.size(), 0.0f);
+    float* v = &values[track.first_value];
+    if(rotation){
+        for(size_t k = 0; k < key_count; k++){
+            normalizeQuaternion(v + 4*k);
+            if(k > 0 && v[4*k]*v[4*k - 4] + v[4*k + 1]*v[4*k - 3] + v[4*k + 2]*v[4*k - 2] + v[4*k + 3]*v[4*k - 1] < 0){
+                for(int c = 0; c < 4; c++) v[4*k + c] = -v[4*k + c];
+            }
+        }
+    }
+    if(interpolation == INTERP_CUBIC && key_count > 1){
+        //finite difference slopes, one sided at the ends
+        float* m = &tangents[track.first_value];
+        for(size_t k = 0; k < key_count; k++){
+            size_t prev = k > 0? k - 1: k, next = k + 1 < key_count? k + 1: k;
+            float dt = key_times[next] - key_times[prev];
+            for(int c = 0; c < n; c++) m[n*k + c] = (v[n*next + c] - v[n*prev + c])/dt;
+        }
+    }
+    tracks.push_back(track);
+    duration = std::max(duration, key_times[key_count - 1]);
+    joint_count = std::max(joint_count, joint + 1);
+    return (int)tracks.size() - 1;
+}
+
+/**
+ * @return time of the last key of the clip, in seconds
+ */
+float AnimationClip::getDuration() const{
+    return duration;
+}
+
+int AnimationClip::getJointCount() const{
+    return joint_count;
+}
+
+size_t AnimationClip::trackCount() const{
+    return tracks.size();
+}
+
+const AnimationTrack& AnimationClip::getTrack(int track) const{
+    return tracks[track];
+}
+
+// ====== Pose ======
+
+/**
+ * Reset every joint to the identity transform
+ */
+void Pose::setIdentity(int joint_count){
+    translation.assign(3*joint_count, 0.0f);
+    scale.assign(3*joint_count, 1.0f);
+    rotation.assign(4*joint_count, 0.0f);
+    for(int j = 0; j < joint_count; j++) rotation[4*j + 3] = 1.0f;
+}
+
+int Pose::jointCount() const{
+    return (int)translation.size()/3;
+}
+
+// ====== ClipSampler ======
+
+ClipSampler::ClipSampler(const AnimationClip& animation){
+    clip = &animation;
+    resetCursors();
+}
+
+/**
+ * Forget the sampled keys, e.g. after tracks were added to the clip
+ */
+void ClipSampler::resetCursors(){
+    cursors.assign(clip->trackCount(), 0);
+}
+
+/**
+ * Key at or before time: the cursor is tried first, then the key after it, then a binary search
+ * @return index of the key relative to the track's first key, clamped to the track
+ */
+uint32_t ClipSampler::findKey(const AnimationTrack& track, uint32_t& cursor, float time) const{
+    const float* keys = &clip->times[track.first_key];
+    uint32_t n = track.key_count;
+    if(n == 1 || time <= keys[0]) return cursor = 0;
+    if(time >= keys[n - 1]) return cursor = n - 1;
+    uint32_t k = cursor;
+    if(keys[k] <= time){ //k < n - 1 here, since time < keys[n - 1]
+        if(time < keys[k + 1]) return k;
+        if(time < keys[k + 2]) return cursor = k + 1;
+    }
+    return cursor = (uint32_t)(std::upper_bound(keys, keys + n, time) - keys - 1);
+}
+
+/**
+ * Evaluate every track of the clip and write the animated channels of the pose.
+ * Channels without a track are left untouched, so the pose can start as a rest pose.
+ * @param time clip time in seconds, clamped to the keys of every track
+ * @param pose receives the local transforms, grown with identity joints if needed
+ * @param loop wrap time to the clip duration
+ */
+void ClipSampler::sample(float time, Pose& pose, bool loop){
+    PROFILE_ZONE("ClipSampler::sample");
+    if(cursors.size() != clip->trackCount()) resetCursors();
+    float duration = clip->getDuration();
+    if(loop && duration > 0){
+        time = fmodf(time, duration);
+        if(time < 0) time += duration;
+    }
+    int joints = pose.jointCount();
+    if(joints < clip->getJointCount()){
+        Pose grown;
+        grown.setIdentity(clip->getJointCount());
+        std::copy(pose.translation.begin(), pose.translation.end(), grown.translation.begin());
+        std::copy(pose.rotation.begin(), pose.rotation.end(), grown.rotation.begin());
+        std::copy(pose.scale.begin(), pose.scale.end(), grown.scale.begin());
+        pose = grown;
+    }
+    const float* times = clip->times.data();
+    const float* values = clip->values.data();
+    const float* tangents = clip->tangents.data();
+
+    for(size_t t = 0; t < clip->trackCount(); t++){
+        const AnimationTrack& track = clip->getTrack((int)t);
+        int n = track.components;
+        float* out = track.target == TRACK_TRANSLATION? &pose.translation[3*track.joint]
+                   : track.target == TRACK_ROTATION? &pose.rotation[4*track.joint]: &pose.scale[3*track.joint];
+        uint32_t k = findKey(track, cursors[t], time);
+        const float* v0 = values + track.first_value + n*k;
+        if(k + 1 >= track.key_count || track.interpolation == INTERP_STEP){
+            for(int c = 0; c < n; c++) out[c] = v0[c];
+            continue;
+        }
+        const float* v1 = v0 + n;
+        float t0 = times[track.first_key + k], t1 = times[track.first_key + k + 1];
+        float u = std::min(1.0f, std::max(0.0f, (time - t0)/(t1 - t0)));
+        switch(track.interpolation){
+            case INTERP_LINEAR:
+                for(int c = 0; c < n; c++) out[c] = v0[c] + u*(v1[c] - v0[c]);
+                break;
+            case INTERP_CUBIC:{
+                const float* m0 = tangents + track.first_value + n*k;
+                const float* m1 = m0 + n;
+                float h = t1 - t0, u2 = u*u, u3 = u2*u;
+                float h00 = 2*u3 - 3*u2 + 1, h10 = (u3 - 2*u2 + u)*h, h01 = 3*u2 - 2*u3, h11 = (u3 - u2)*h;
+                for(int c = 0; c < n; c++) out[c] = h00*v0[c] + h10*m0[c] + h01*v1[c] + h11*m1[c];
+                break;
+            }
+            case INTERP_NLERP:
+                for(int c = 0; c < n; c++) out[c] = v0[c] + u*(v1[c] - v0[c]);
+                normalizeQuaternion(out);
+                break;
+            case INTERP_SLERP:
+                slerp(v0, v1, u, out);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// ====== Hierarchy ======
+
+/**
+ * Local matrix of every joint: translation * rotation * scale
+ * @param pose the local transforms
+ * @param matrices filled with 16 floats per joint, column-major (see projection.h)
+ */
+void composeLocalMatrices(const Pose& pose, float* matrices){
+    for(int j = 0; j < pose.jointCount(); j++){
+        const float* q = &pose.rotation[4*j];
+        const float* s = &pose.scale[3*j];
+        const float* t = &pose.translation[3*j];
+        float x = q[0], y = q[1], z = q[2], w = q[3];
+        float* m = matrices + 16*j;
+        m[0] = (1 - 2*(y*y + z*z))*s[0]; m[1] = 2*(x*y + w*z)*s[0]; m[2] = 2*(x*z - w*y)*s[0]; m[3] = 0;
+        m[4] = 2*(x*y - w*z)*s[1]; m[5] = (1 - 2*(x*x + z*z))*s[1]; m[6] = 2*(y*z + w*x)*s[1]; m[7] = 0;
+        m[8] = 2*(x*z + w*y)*s[2]; m[9] = 2*(y*z - w*x)*s[2]; m[10] = (1 - 2*(x*x + y*y))*s[2]; m[11] = 0;
+        m[12] = t[0]; m[13] = t[1]; m[14] = t[2]; m[15] = 1;
+    }
+}
+
+/**
+ * Model space matrix of every joint from the local ones
+ * @param local 16 floats per joint, see composeLocalMatrices()
+ * @param parents parent of every joint, -1 for roots; parents come before their children
+ * @param joint_count number of joints
+ * @param model filled with 16 floats per joint, ready for buildSkinPalette()
+ */
+void composeModelMatrices(const float* local, const int* parents, int joint_count, float* model){
+    for(int j = 0; j < joint_count; j++){
+        if(parents[j] < 0) std::copy(local + 16*j, local + 16*j + 16, model + 16*j);
+        else multiplyMatrix(model + 16*parents[j], local + 16*j, model + 16*j);
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef GRAPHICSENGINE3D_ANIMATION_H
+#define GRAPHICSENGINE3D_ANIMATION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Joint channel animated by a track
+ */
+enum TrackTarget{
+    TRACK_TRANSLATION, //3 floats per key
+    TRACK_ROTATION, //unit quaternion (x, y, z, w), 4 floats per key
+    TRACK_SCALE //3 floats per key
+};
+
+/**
+ * Interpolation between two keys. Rotations use INTERP_NLERP or INTERP_SLERP,
+ * translations and scales INTERP_LINEAR or INTERP_CUBIC; INTERP_STEP holds
+ * the previous key for any channel.
+ */
+enum Interpolation{
+    INTERP_STEP,
+    INTERP_LINEAR,
+    INTERP_CUBIC, //Catmull-Rom style Hermite spline through the keys
+    INTERP_NLERP,
+    INTERP_SLERP
+};
+
+/**
+ * Keyframes of one channel of one joint, stored in the clip's shared arrays
+ */
+struct AnimationTrack{
+    int joint;
+    TrackTarget target;
+    Interpolation interpolation;
+    uint32_t first_key; //into AnimationClip::times
+    uint32_t key_count;
+    uint32_t first_value; //into AnimationClip::values and tangents, components floats per key
+    int components;
+};
+
+/**
+ * Animation clip: the keys of every track stored back to back in a few
+ * contiguous arrays, so sampling every track walks memory in order.
+ */
+class AnimationClip{
+public:
+    AnimationClip();
+    int addTrack(int joint, TrackTarget target, Interpolation interpolation,
+                 const float* key_times, const float* key_values, size_t key_count);
+    float getDuration() const;
+    int getJointCount() const; //largest animated joint + 1
+    size_t trackCount() const;
+    const AnimationTrack& getTrack(int track) const;
+
+    std::vector<float> times;
+    std::vector<float> values;
+    std::vector<float> tangents; //per key slopes of cubic tracks, in value units per second
+private:
+    std::vector<AnimationTrack> tracks;
+    float duration;
+    int joint_count;
+};
+
+/**
+ * Local transforms of a skeleton's joints, structure of arrays:
+ * 3 floats of translation, 4 of rotation and 3 of scale per joint
+ */
+struct Pose{
+    std::vector<float> translation;
+    std::vector<float> rotation;
+    std::vector<float> scale;
+
+    void setIdentity(int joint_count);
+    int jointCount() const;
+};
+
+/**
+ * Evaluates every track of a clip at a time, in one pass over the clip.
+ * Every track keeps a cursor on the key it last sampled, so playback going
+ * forward finds its keys in O(1) per track; seeking backwards or far ahead
+ * falls back to a binary search.
+ */
+class ClipSampler{
+public:
+    explicit ClipSampler(const AnimationClip& clip);
+    void sample(float time, Pose& pose, bool loop = false);
+    void resetCursors();
+private:
+    const AnimationClip* clip;
+    std::vector<uint32_t> cursors; //key index of every track, relative to its first key
+
+    uint32_t findKey(const AnimationTrack& track, uint32_t& cursor, float time) const;
+};
+
+void composeLocalMatrices(const Pose& pose, float* matrices);
+void composeModelMatrices(const float* local, const int* parents, int joint_count, float* model);
+
+#endif //GRAPHICSENGINE3D_ANIMATION_H
@@ -0,0 +1,120 @@
+#include "arena.h"
+#include <stdint.h>
+#include <algorithm>
+#include <mutex>
+
+//Implementation details of the FrameArena
+
+namespace {
+
+std::mutex registry_lock;
+std::vector<FrameArena*> registry; //arenas of the live threads
+
+/**
+ * Thread local arena that registers itself for resetAll()
+ */
+struct ThreadArena{
+    FrameArena arena;
+    ThreadArena(){
+        std::lock_guard<std::mutex> guard(registry_lock);
+        registry.push_back(&arena);
+    }
+    ~ThreadArena(){
+        std::lock_guard<std::mutex> guard(registry_lock);
+        registry.erase(std::remove(registry.begin(), registry.end(), &arena), registry.end());
+    }
+};
+
+}
+
+/**
+ * Create an empty arena; the first block is allocated on first use
+ * @param size size of the blocks requested from the heap
+ */
+FrameArena::FrameArena(size_t size){
+    block_size = size > 0? size: DEFAULT_BLOCK_SIZE;
+    offset = 0;
+    used_before = 0;
+    peak = 0;
+}
+
+FrameArena::~FrameArena(){
+    for(auto& block: blocks) delete[] block.data;
+}
+
+/**
+ * Bump allocate from the current block, starting a new block when it is full
+ * @param bytes size of the allocation
+ * @param alignment power of two alignment of the allocation
+ * @return uninitialized storage, valid until the next reset()
+ */
+void* FrameArena::allocate(size_t bytes, size_t alignment){
+    if(!blocks.empty()){
+        Block& block = blocks.back();
+        uintptr_t base = (uintptr_t)block.data;
+        size_t start = ((base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+        if(start + bytes <= block.size){
+            offset = start + bytes;
+            return block.data + start;
+        }
+    }
+    addBlock(bytes + alignment);
+    Block& block = blocks.back();
+    uintptr_t base = (uintptr_t)block.data;
+    size_t start = ((base + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+    offset = start + bytes;
+    return block.data + start;
+}
+
+void FrameArena::addBlock(size_t min_size){
+    if(!blocks.empty()) used_before += offset;
+    size_t size = std::max(block_size, min_size);
+    blocks.push_back(Block{new char[size], size});
+    offset = 0;
+}
+
+/**
+ * Release every allocation. Blocks are kept; several blocks are merged into
+ * one large enough for the whole frame.
+ */
+void FrameArena::reset(){
+    peak = std::max(peak, bytesUsed());
+    if(blocks.size() > 1){
+        size_t total = capacity();
+        for(auto& block: blocks) delete[] block.data;
+        blocks.clear();
+        blocks.push_back(Block{new char[total], total});
+    }
+    offset = 0;
+    used_before = 0;
+}
+
+size_t FrameArena::bytesUsed() const{
+    return used_before + offset;
+}
+
+size_t FrameArena::peakBytes() const{
+    return std::max(peak, bytesUsed());
+}
+
+size_t FrameArena::capacity() const{
+    size_t total = 0;
+    for(auto& block: blocks) total += block.size;
+    return total;
+}
+
+/**
+ * Arena of the calling thread, created on first use and freed when the thread exits
+ */
+FrameArena& FrameArena::forThread(){
+    static thread_local ThreadArena local;
+    return local.arena;
+}
+
+/**
+ * Reset the arena of every thread that has one
+ */
+void FrameArena::resetAll(){
+    std::lock_guard<std::mutex> guard(registry_lock);
+    for(FrameArena* arena: registry) arena->reset();
+}
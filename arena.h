@@ -0,0 +1,92 @@
+#ifndef GRAPHICSENGINE3D_ARENA_H
+#define GRAPHICSENGINE3D_ARENA_H
+
+#include <stddef.h>
+#include <new>
+#include <vector>
+
+/**
+ * Linear allocator for per-frame temporaries. Allocations bump a pointer
+ * inside large blocks and are never freed one by one; reset() releases
+ * everything at once. When a frame needed more than one block, reset()
+ * replaces them by a single block of the combined size, so a steady state
+ * frame allocates nothing from the heap.
+ * An arena is used by one thread at a time: forThread() gives every thread
+ * its own, and resetAll() resets them together at the end of a frame.
+ */
+class FrameArena{
+public:
+    static const size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+
+    explicit FrameArena(size_t block_size = DEFAULT_BLOCK_SIZE);
+    ~FrameArena();
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment = alignof(max_align_t));
+    template<typename T>
+    T* allocateArray(size_t count);
+    void reset();
+
+    size_t bytesUsed() const; //since the last reset
+    size_t peakBytes() const; //largest bytesUsed() seen at a reset
+    size_t capacity() const;
+
+    static FrameArena& forThread();
+    static void resetAll(); //only while no thread allocates, e.g. between frames
+private:
+    struct Block{
+        char* data;
+        size_t size;
+    };
+    std::vector<Block> blocks;
+    size_t block_size;
+    size_t offset; //in the last block
+    size_t used_before; //bytes of the blocks before the last one
+    size_t peak;
+
+    void addBlock(size_t min_size);
+};
+
+/**
+ * Allocate uninitialized storage for count objects of type T
+ */
+template<typename T>
+T* FrameArena::allocateArray(size_t count){
+    return (T*)allocate(count*sizeof(T), alignof(T));
+}
+
+/**
+ * Standard allocator drawing from a FrameArena, e.g.
+ * std::vector<float, ArenaAllocator<float>> v(ArenaAllocator<float>(FrameArena::forThread()));
+ * deallocate() is a no-op: memory comes back when the arena is reset, and a
+ * container must not be used after that.
+ * @tparam T type of the allocated objects
+ */
+template<typename T>
+class ArenaAllocator{
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(FrameArena& frame_arena): arena(&frame_arena){}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other): arena(other.getArena()){}
+
+    T* allocate(size_t count){ return arena->allocateArray<T>(count);}
+    void deallocate(T*, size_t){}
+    FrameArena* getArena() const{ return arena;}
+private:
+    FrameArena* arena;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b){
+    return a.getArena() == b.getArena();
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b){
+    return a.getArena() != b.getArena();
+}
+
+#endif //GRAPHICSENGINE3D_ARENA_H
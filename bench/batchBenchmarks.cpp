@@ -0,0 +1,338 @@
+#include "../animation.h"
+#include "../broadphase.h"
+#include "../fixedpoint.h"
+#include "../narrowphase.h"
+#include "../particles.h"
+#include "../physics.h"
+#include "../projection.h"
+#include "../skinning.h"
+#include "../texture.h"
+#include <math.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "benchmark.h"
+
+/**
+ * Vertex streams shared by the batch benchmarks
+ */
+struct BatchData{
+    std::vector<float> x, y, z;
+    std::vector<float> sx, sy, sz, rhw;
+    std::vector<uint8_t> clip;
+
+    explicit BatchData(size_t count): x(count), y(count), z(count), sx(count), sy(count), sz(count),
+                                      rhw(count), clip(count){
+        uint32_t seed = 12345;
+        for(size_t i = 0; i < count; i++){
+            seed = seed*1664525u + 1013904223u;
+            x[i] = (seed >> 8)*(1.0f/16777216.0f)*4.0f - 2.0f;
+            seed = seed*1664525u + 1013904223u;
+            y[i] = (seed >> 8)*(1.0f/16777216.0f)*4.0f - 2.0f;
+            seed = seed*1664525u + 1013904223u;
+            z[i] = -1.0f - (seed >> 8)*(1.0f/16777216.0f)*10.0f;
+        }
+    }
+};
+
+/**
+ * Register the batch kernels for one batch size
+ * @param count vertices per call
+ */
+static void addBatchBenchmarks(BenchmarkRunner& runner, size_t count){
+    std::string suffix = "/" + std::to_string(count);
+    std::shared_ptr<BatchData> data = std::make_shared<BatchData>(count);
+    float projection[16];
+    perspectiveMatrix(1.0f, 1.5f, 0.5f, 50.0f, projection);
+    std::vector<float> perspective(projection, projection + 16);
+    orthographicMatrix(-2.0f, 2.0f, -2.0f, 2.0f, 0.5f, 20.0f, projection);
+    std::vector<float> ortho(projection, projection + 16);
+
+    runner.add("projectVertices" + suffix, [data, perspective, count](){
+        BatchData& d = *data;
+        size_t r = projectVertices(perspective.data(), d.x.data(), d.y.data(), d.z.data(), count, 1920, 1080,
+                                   d.sx.data(), d.sy.data(), d.sz.data(), d.rhw.data(), d.clip.data());
+        doNotOptimize(r);
+    }, count);
+    runner.add("projectOrthographic" + suffix, [data, ortho, count](){
+        BatchData& d = *data;
+        size_t r = projectOrthographic(ortho.data(), d.x.data(), d.y.data(), d.z.data(), count, 2048, 2048,
+                                       d.sx.data(), d.sy.data(), d.sz.data(), d.clip.data());
+        doNotOptimize(r);
+    }, count);
+    runner.add("orthoProject" + suffix, [data, count](){
+        BatchData& d = *data;
+        orthoProject(PLANE_XZ, d.x.data(), d.y.data(), d.z.data(), count, d.sx.data(), d.sy.data());
+        clobberMemory();
+    }, count);
+    runner.add("obliqueProject" + suffix, [data, count](){
+        BatchData& d = *data;
+        float dir[3] = {0.3f, 0.2f, -1.0f};
+        bool r = obliqueProject(PLANE_XY, dir, d.x.data(), d.y.data(), d.z.data(), count, d.sx.data(), d.sy.data());
+        doNotOptimize(r);
+    }, count);
+}
+
+/**
+ * Register the skinning kernel for one vertex count, 4 influences per vertex over 64 joints
+ */
+static void addSkinningBenchmark(BenchmarkRunner& runner, size_t count){
+    const size_t joint_count = 64;
+    std::shared_ptr<Mesh> bind = std::make_shared<Mesh>(), out = std::make_shared<Mesh>();
+    std::shared_ptr<SkinWeights> skin = std::make_shared<SkinWeights>();
+    std::shared_ptr<std::vector<float>> palette = std::make_shared<std::vector<float>>(SKIN_PALETTE_STRIDE*joint_count);
+    std::vector<float> transforms(16*joint_count), weights(4*count);
+    std::vector<uint32_t> joints(4*count);
+    for(size_t j = 0; j < joint_count; j++){
+        identityMatrix(&transforms[16*j]);
+        transforms[16*j + 12] = 0.1f*j;
+    }
+    buildSkinPalette(transforms.data(), nullptr, joint_count, palette->data());
+    BatchData data(count);
+    bind->px = data.x; bind->py = data.y; bind->pz = data.z;
+    bind->nx = data.y; bind->ny = data.z; bind->nz = data.x;
+    for(size_t i = 0; i < 4*count; i++){
+        joints[i] = (uint32_t)((i*2654435761u) >> 7)%joint_count;
+        weights[i] = 1.0f + i%3;
+    }
+    packSkinWeights(joints.data(), weights.data(), 4, count, *skin);
+    out->resizeVertices(count, true);
+
+    runner.add("skinVertices/" + std::to_string(count), [bind, out, skin, palette, count](){
+        skinVertices(palette->data(), *skin, *bind, *out, 0, count);
+        clobberMemory();
+    }, count);
+}
+
+/**
+ * Register sequential playback of a clip with a translation, rotation and scale track per joint
+ */
+static void addSamplingBenchmark(BenchmarkRunner& runner, int joint_count){
+    const size_t key_count = 64;
+    std::shared_ptr<AnimationClip> clip = std::make_shared<AnimationClip>();
+    std::vector<float> times(key_count), values(4*key_count);
+    for(size_t k = 0; k < key_count; k++){
+        times[k] = k/30.0f;
+        for(int c = 0; c < 4; c++) values[4*k + c] = 0.5f + 0.01f*((k*7 + c*3)%11);
+    }
+    for(int j = 0; j < joint_count; j++){
+        clip->addTrack(j, TRACK_TRANSLATION, INTERP_CUBIC, times.data(), values.data(), key_count);
+        clip->addTrack(j, TRACK_ROTATION, INTERP_SLERP, times.data(), values.data(), key_count);
+        clip->addTrack(j, TRACK_SCALE, INTERP_LINEAR, times.data(), values.data(), key_count);
+    }
+    std::shared_ptr<ClipSampler> sampler = std::make_shared<ClipSampler>(*clip);
+    std::shared_ptr<Pose> pose = std::make_shared<Pose>();
+    std::shared_ptr<float> time = std::make_shared<float>(0.0f);
+    runner.add("ClipSampler::sample/" + std::to_string(joint_count), [clip, sampler, pose, time](){
+        *time += 1/60.0f;
+        sampler->sample(*time, *pose, true);
+        clobberMemory();
+    }, 3*(size_t)joint_count);
+}
+
+/**
+ * Register one integration step of a world of free bodies, on every hardware thread
+ */
+static void addPhysicsBenchmark(BenchmarkRunner& runner, size_t count){
+    std::shared_ptr<JobSystem> jobs = std::make_shared<JobSystem>();
+    std::shared_ptr<PhysicsWorld> world = std::make_shared<PhysicsWorld>(*jobs);
+    BatchData data(count);
+    float inertia[3] = {0.4f, 0.6f, 0.8f};
+    for(size_t i = 0; i < count; i++){
+        float position[3] = {data.x[i], data.y[i], data.z[i]};
+        float spin[3] = {data.z[i], data.x[i], data.y[i]};
+        int body = world->addBody(position, 1.0f, inertia);
+        world->setVelocity(body, position, spin);
+    }
+    world->step(1/60.0f);
+    runner.add("PhysicsWorld::step/" + std::to_string(count), [jobs, world](){
+        world->step(1/60.0f);
+        clobberMemory();
+    }, count);
+}
+
+/**
+ * Register both broadphases on count boxes spread over a terrain like slab, at constant density
+ */
+static void addBroadphaseBenchmarks(BenchmarkRunner& runner, size_t count){
+    std::shared_ptr<ColliderBounds> bounds = std::make_shared<ColliderBounds>();
+    BatchData data(count);
+    float side = sqrtf((float)count);
+    bounds->resize(count);
+    for(size_t i = 0; i < count; i++){
+        float u = 0.25f*data.x[i] + 0.5f, v = 0.25f*data.y[i] + 0.5f, w = -0.1f*(data.z[i] + 1);
+        float bmin[3] = {side*u, 2*v, side*w};
+        float size = 0.2f + 0.8f*v*v;
+        float bmax[3] = {bmin[0] + size, bmin[1] + size, bmin[2] + size};
+        bounds->set(i, bmin, bmax);
+    }
+    std::shared_ptr<std::vector<ColliderPair>> pairs = std::make_shared<std::vector<ColliderPair>>();
+    std::shared_ptr<SweepAndPrune> sap = std::make_shared<SweepAndPrune>();
+    std::shared_ptr<SpatialHashGrid> grid = std::make_shared<SpatialHashGrid>();
+    runner.add("SweepAndPrune::findPairs/" + std::to_string(count), [bounds, pairs, sap](){
+        sap->findPairs(*bounds, *pairs);
+        clobberMemory();
+    }, count);
+    runner.add("SpatialHashGrid::findPairs/" + std::to_string(count), [bounds, pairs, grid](){
+        grid->findPairs(*bounds, *pairs);
+        clobberMemory();
+    }, count);
+}
+
+/**
+ * Register the narrowphase on the pairs of a dense pile of boxes, spheres and capsules
+ */
+static void addNarrowphaseBenchmark(BenchmarkRunner& runner, size_t count){
+    float half[3] = {0.5f, 0.3f, 0.4f};
+    std::shared_ptr<std::vector<ConvexShape>> kinds = std::make_shared<std::vector<ConvexShape>>();
+    kinds->push_back(makeBox(half));
+    kinds->push_back(makeSphere(0.5f));
+    kinds->push_back(makeCapsule(0.25f, 0.4f));
+    std::shared_ptr<std::vector<ShapeInstance>> shapes = std::make_shared<std::vector<ShapeInstance>>(count);
+    BatchData data(count);
+    float side = cbrtf((float)count)*0.9f;
+    ColliderBounds bounds;
+    bounds.resize(count);
+    for(size_t i = 0; i < count; i++){
+        ShapeInstance& s = (*shapes)[i];
+        s.shape = &(*kinds)[i%3];
+        s.position[0] = side*(0.25f*data.x[i] + 0.5f);
+        s.position[1] = side*(0.25f*data.y[i] + 0.5f);
+        s.position[2] = -0.1f*side*(data.z[i] + 1);
+        float angle = 3*data.x[i];
+        s.rotation[0] = sinf(angle); s.rotation[1] = 0; s.rotation[2] = 0; s.rotation[3] = cosf(angle);
+        float bmin[3], bmax[3];
+        shapeBounds(s, bmin, bmax);
+        bounds.set(i, bmin, bmax);
+    }
+    std::shared_ptr<std::vector<ColliderPair>> pairs = std::make_shared<std::vector<ColliderPair>>();
+    SpatialHashGrid grid;
+    grid.findPairs(bounds, *pairs);
+    std::shared_ptr<JobSystem> jobs = std::make_shared<JobSystem>();
+    std::shared_ptr<Narrowphase> narrowphase = std::make_shared<Narrowphase>();
+    std::shared_ptr<std::vector<Contact>> contacts = std::make_shared<std::vector<Contact>>();
+    runner.add("Narrowphase::findContacts/" + std::to_string(pairs->size()),
+               [kinds, shapes, pairs, jobs, narrowphase, contacts](){
+        narrowphase->findContacts(*jobs, *shapes, *pairs, *contacts);
+        clobberMemory();
+    }, pairs->size());
+}
+
+/**
+ * Register one update of count particles under gravity, drag and curl noise, on every hardware thread.
+ * Lives are long enough that the count stays constant while the benchmark runs.
+ */
+static void addParticleBenchmark(BenchmarkRunner& runner, size_t count){
+    std::shared_ptr<JobSystem> jobs = std::make_shared<JobSystem>();
+    std::shared_ptr<ParticleSystem> particles = std::make_shared<ParticleSystem>(*jobs, count);
+    ParticleEmitter emitter = {{0, 0, 0}, {0, 5, 0}, 3, {1e6f, 2e6f}, 0.05f};
+    particles->emit(emitter, count);
+    particles->setDrag(0.2f);
+    particles->setCurlNoise(2, 0.5f);
+    runner.add("ParticleSystem::update/" + std::to_string(count), [jobs, particles](){
+        particles->update(1/60.0f);
+        clobberMemory();
+    }, count);
+}
+
+/**
+ * Register trilinear sampling of a mipmapped size^2 texture along a span rotated by 30 degrees,
+ * one sample at a time and 4 at a time
+ */
+static void addTextureBenchmarks(BenchmarkRunner& runner, int size){
+    std::shared_ptr<Texture> texture = std::make_shared<Texture>(size, size);
+    BatchData data((size_t)size*size);
+    for(int y = 0; y < size; y++){
+        for(int x = 0; x < size; x++){
+            size_t i = (size_t)y*size + x;
+            float rgba[4] = {data.x[i], data.y[i], data.z[i], 1};
+            texture->setTexel(x, y, rgba);
+        }
+    }
+    JobSystem jobs;
+    texture->buildMipmaps(jobs);
+    texture->setFilter(TEXTURE_TRILINEAR);
+    const size_t count = 4096;
+    std::shared_ptr<std::vector<float>> u = std::make_shared<std::vector<float>>(count);
+    std::shared_ptr<std::vector<float>> v = std::make_shared<std::vector<float>>(count);
+    std::shared_ptr<std::vector<float>> lod = std::make_shared<std::vector<float>>(count, 0.3f);
+    std::shared_ptr<std::vector<float>> out = std::make_shared<std::vector<float>>(4*count);
+    for(size_t i = 0; i < count; i++){
+        (*u)[i] = 0.1f + 0.866f*i/size;
+        (*v)[i] = 0.2f + 0.5f*i/size;
+    }
+    runner.add("Texture::sample/" + std::to_string(size), [texture, u, v, lod, out](){
+        for(size_t i = 0; i < count; i++) texture->sample((*u)[i], (*v)[i], (*lod)[i], &(*out)[4*i]);
+        clobberMemory();
+    }, count);
+    runner.add("Texture::sample4/" + std::to_string(size), [texture, u, v, lod, out](){
+        float* o = out->data();
+        for(size_t i = 0; i < count; i += 4){
+            texture->sample4(&(*u)[i], &(*v)[i], &(*lod)[i], o + i, o + count + i, o + 2*count + i, o + 3*count + i);
+        }
+        clobberMemory();
+    }, count);
+}
+
+/**
+ * Register the Q16.16 batch kernels, with the scalar Matrixx path they replace for reference
+ * @param count vectors per call
+ */
+static void addFixedPointBenchmarks(BenchmarkRunner& runner, size_t count){
+    std::shared_ptr<std::vector<int32_t>> streams = std::make_shared<std::vector<int32_t>>(9*count);
+    uint32_t seed = 4242;
+    for(size_t i = 0; i < 6*count; i++){
+        seed = seed*1664525u + 1013904223u;
+        (*streams)[i] = (int32_t)(seed >> 8) - (1 << 23); //+-128
+    }
+    Matrixx<3> M{{Fixed16::fromFloat(0.8), Fixed16::fromFloat(0.6), Fixed16()},
+                 {Fixed16::fromFloat(-0.6), Fixed16::fromFloat(0.8), Fixed16()},
+                 {Fixed16(), Fixed16(), Fixed16::fromInt(1)}};
+    std::string suffix = "/" + std::to_string(count);
+    runner.add("fixedCross3" + suffix, [streams, count](){
+        int32_t* s = streams->data();
+        fixedCross3(s, s + count, s + 2*count, s + 3*count, s + 4*count, s + 5*count, count,
+                    s + 6*count, s + 7*count, s + 8*count);
+        clobberMemory();
+    }, count);
+    runner.add("fixedTransform3" + suffix, [streams, M, count](){
+        int32_t* s = streams->data();
+        fixedTransform3(M, s, s + count, s + 2*count, count, s + 6*count, s + 7*count, s + 8*count);
+        clobberMemory();
+    }, count);
+    runner.add("Matrixx*Vectorx" + suffix, [streams, M, count](){
+        int32_t* s = streams->data();
+        for(size_t i = 0; i < count; i++){
+            Vectorx<3> p = M*Vectorx<3>{Fixed16::fromRaw(s[i]), Fixed16::fromRaw(s[count + i]),
+                                        Fixed16::fromRaw(s[2*count + i])};
+            for(int k = 0; k < 3; k++) s[(6 + k)*count + i] = p[k].getRaw();
+        }
+        clobberMemory();
+    }, count);
+    runner.add("fixedNormalize3" + suffix, [streams, count](){
+        int32_t* s = streams->data();
+        fixedNormalize3(s + 3*count, s + 4*count, s + 5*count, count);
+        clobberMemory();
+    }, count);
+}
+
+void batchBenchmarks(BenchmarkRunner& runner){
+    std::vector<float> a(16), b(16);
+    perspectiveMatrix(1.0f, 1.5f, 0.5f, 50.0f, a.data());
+    orthographicMatrix(-2.0f, 2.0f, -2.0f, 2.0f, 0.5f, 20.0f, b.data());
+    runner.add("multiplyMatrix", [a, b](){
+        float out[16];
+        multiplyMatrix(a.data(), b.data(), out);
+        doNotOptimize(out);
+    });
+    addBatchBenchmarks(runner, 1024);
+    addBatchBenchmarks(runner, 1 << 20);
+    addSkinningBenchmark(runner, 1 << 16);
+    addSamplingBenchmark(runner, 1000);
+    addPhysicsBenchmark(runner, 50000);
+    addBroadphaseBenchmarks(runner, 1 << 17);
+    addNarrowphaseBenchmark(runner, 20000);
+    addParticleBenchmark(runner, 1 << 20);
+    addTextureBenchmarks(runner, 1024);
+    addFixedPointBenchmarks(runner, 1 << 16);
+}
@@ -0,0 +1,149 @@
+#include "benchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Implementation details of the BenchmarkRunner and the benchmark executable
+
+BenchmarkRunner::BenchmarkRunner(){
+    warmup_samples = 3;
+    sample_count = 30;
+    min_sample_time = 0.002;
+}
+
+/**
+ * Register a benchmark
+ * @param name unique name, used by the filter and the JSON output
+ * @param body one call of the code to time
+ * @param items work items processed by one call, reported for throughput
+ */
+void BenchmarkRunner::add(const std::string& name, std::function<void()> body, size_t items){
+    entries.push_back(Entry{name, std::move(body), items});
+}
+
+/**
+ * Only run benchmarks whose name contains substring, all of them when empty
+ */
+void BenchmarkRunner::setFilter(const std::string& substring){
+    filter = substring;
+}
+
+void BenchmarkRunner::setSamples(size_t warmup, size_t samples){
+    warmup_samples = warmup;
+    sample_count = std::max<size_t>(1, samples);
+}
+
+void BenchmarkRunner::setMinSampleTime(double seconds){
+    min_sample_time = seconds;
+}
+
+/**
+ * Measure every registered benchmark matching the filter, printing one line each
+ */
+void BenchmarkRunner::run(){
+    results.clear();
+    for(const Entry& entry: entries){
+        if(!filter.empty() && entry.name.find(filter) == std::string::npos) continue;
+        BenchmarkResult r = measure(entry);
+        results.push_back(r);
+        printf("%-40s median %12.2f ns  p99 %12.2f ns  (%zu x %zu)\n",
+               r.name.c_str(), r.median, r.p99, r.samples, r.batch);
+    }
+}
+
+BenchmarkResult BenchmarkRunner::measure(const Entry& entry) const{
+    typedef std::chrono::steady_clock Clock;
+    //calibrate: double the batch until one sample is long enough to time reliably
+    size_t batch = 1;
+    while(true){
+        Clock::time_point start = Clock::now();
+        for(size_t i = 0; i < batch; i++) entry.body();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if(seconds >= min_sample_time || batch >= ((size_t)1 << 30)) break;
+        batch *= 2;
+    }
+    for(size_t s = 0; s < warmup_samples; s++){
+        for(size_t i = 0; i < batch; i++) entry.body();
+    }
+    std::vector<double> times(sample_count);
+    for(size_t s = 0; s < sample_count; s++){
+        Clock::time_point start = Clock::now();
+        for(size_t i = 0; i < batch; i++) entry.body();
+        clobberMemory();
+        times[s] = std::chrono::duration<double, std::nano>(Clock::now() - start).count()/batch;
+    }
+    std::sort(times.begin(), times.end());
+    BenchmarkResult r;
+    r.name = entry.name;
+    r.items = entry.items;
+    r.batch = batch;
+    r.samples = sample_count;
+    r.median = sample_count%2? times[sample_count/2]: 0.5*(times[sample_count/2 - 1] + times[sample_count/2]);
+    r.p99 = times[std::min(sample_count - 1, (size_t)(0.99*(sample_count - 1) + 0.5))];
+    r.min = times[0];
+    r.mean = 0;
+    for(double t: times) r.mean += t/sample_count;
+    return r;
+}
+
+/**
+ * Write the results as JSON: {"benchmarks": [{"name", "median_ns", ...}, ...]}
+ * @param path the file to write
+ * @return whether the file was written
+ */
+bool BenchmarkRunner::writeJSON(const std::string& path) const{
+    std::ofstream out(path, std::ios::trunc);
+    if(!out){
+        std::cout << "Warning: could not write benchmark results " << path << "\n";
+        return false;
+    }
+    char line[512];
+    out << "{\n  \"benchmarks\": [\n";
+    for(size_t i = 0; i < results.size(); i++){
+        const BenchmarkResult& r = results[i];
+        snprintf(line, sizeof(line),
+                 "    {\"name\": \"%s\", \"items\": %zu, \"batch\": %zu, \"samples\": %zu, "
+                 "\"median_ns\": %.3f, \"p99_ns\": %.3f, \"mean_ns\": %.3f, \"min_ns\": %.3f}%s\n",
+                 r.name.c_str(), r.items, r.batch, r.samples, r.median, r.p99, r.mean, r.min,
+                 i + 1 < results.size()? ",": "");
+        out << line;
+    }
+    out << "  ]\n}\n";
+    return (bool)out;
+}
+
+const std::vector<BenchmarkResult>& BenchmarkRunner::getResults() const{
+    return results;
+}
+
+/**
+ * Benchmark executable
+ * usage: benchmark [--filter substring] [--json results.json] [--samples n] [--warmup n]
+ */
+int main(int argc, char** argv){
+    BenchmarkRunner runner;
+    std::string json_path;
+    size_t samples = 30, warmup = 3;
+    for(int i = 1; i < argc; i += 2){
+        if(i + 1 >= argc){
+            std::cout << "Error: missing value for option " << argv[i] << "\n";
+            return 1;
+        }
+        if(strcmp(argv[i], "--filter") == 0) runner.setFilter(argv[i + 1]);
+        else if(strcmp(argv[i], "--json") == 0) json_path = argv[i + 1];
+        else if(strcmp(argv[i], "--samples") == 0) samples = (size_t)atoi(argv[i + 1]);
+        else if(strcmp(argv[i], "--warmup") == 0) warmup = (size_t)atoi(argv[i + 1]);
+        else std::cout << "Warning: unknown option " << argv[i] << "\n";
+    }
+    runner.setSamples(warmup, samples);
+    vectorBenchmarks(runner);
+    matrixBenchmarks(runner);
+    batchBenchmarks(runner);
+    runner.run();
+    if(!json_path.empty() && !runner.writeJSON(json_path)) return 1;
+    return 0;
+}
@@ -0,0 +1,81 @@
+#ifndef GRAPHICSENGINE3D_BENCHMARK_H
+#define GRAPHICSENGINE3D_BENCHMARK_H
+
+#include <stddef.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Keep a value alive so the compiler cannot drop the computation producing it
+ * @tparam T type of the value
+ */
+template<typename T>
+inline void doNotOptimize(T& value){
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : "+m"(value) : : "memory");
+#else
+    volatile char sink = *(volatile char*)&value;
+    (void)sink;
+#endif
+}
+
+/**
+ * Stop the compiler from caching memory across this point
+ */
+inline void clobberMemory(){
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : : "memory");
+#endif
+}
+
+/**
+ * Timing statistics of one benchmark, in nanoseconds per call of its body
+ */
+struct BenchmarkResult{
+    std::string name;
+    size_t items; //work items per call, e.g. vertices of a batch
+    size_t batch; //calls per sample
+    size_t samples;
+    double median;
+    double p99;
+    double mean;
+    double min;
+};
+
+/**
+ * Microbenchmark runner. Every benchmark is calibrated so one sample takes
+ * about min_sample_time seconds, warmed up, then timed for a number of samples;
+ * the median and 99th percentile of the samples are reported.
+ */
+class BenchmarkRunner{
+public:
+    BenchmarkRunner();
+    void add(const std::string& name, std::function<void()> body, size_t items = 1);
+    void setFilter(const std::string& substring);
+    void setSamples(size_t warmup, size_t samples);
+    void setMinSampleTime(double seconds);
+    void run();
+    bool writeJSON(const std::string& path) const;
+    const std::vector<BenchmarkResult>& getResults() const;
+private:
+    struct Entry{
+        std::string name;
+        std::function<void()> body;
+        size_t items;
+    };
+    std::vector<Entry> entries;
+    std::vector<BenchmarkResult> results;
+    std::string filter;
+    size_t warmup_samples;
+    size_t sample_count;
+    double min_sample_time;
+
+    BenchmarkResult measure(const Entry& entry) const;
+};
+
+void vectorBenchmarks(BenchmarkRunner& runner);
+void matrixBenchmarks(BenchmarkRunner& runner);
+void batchBenchmarks(BenchmarkRunner& runner);
+
+#endif //GRAPHICSENGINE3D_BENCHMARK_H
@@ -0,0 +1,93 @@
+#include "../matrix.h"
+#include <string>
+#include <vector>
+#include "benchmark.h"
+
+/**
+ * Register every Matrixf operation for one dimension
+ * @tparam N dimension of the square matrices
+ */
+template<size_t N>
+static void addMatrixBenchmarks(BenchmarkRunner& runner){
+    std::string prefix = "Matrixf<" + std::to_string(N) + ">::";
+    Matrixf<N> m{{2.0f, 1.0f, 0.0f, 0.5f}, {1.0f, 3.0f, 1.0f, 0.0f},
+                 {0.0f, 1.0f, 4.0f, 1.0f}, {0.5f, 0.0f, 1.0f, 5.0f}};
+    Matrixf<N> k = Matrixf<N>();
+    Vectorf<N> v{1.0f, 2.0f, 3.0f, 4.0f};
+
+    runner.add(prefix + "constructIdentity", [](){
+        Matrixf<N> r = Matrixf<N>();
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "constructList", [](){
+        Matrixf<N> r{1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f,
+                     9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f, 16.0f}; //truncated to N*N
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "constructNestedList", [](){
+        Matrixf<N> r{{1.0f, 2.0f}, {3.0f, 4.0f}};
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "row", [m]() mutable{
+        std::vector<float> r = m.row(1);
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "col", [m]() mutable{
+        std::vector<float> r = m.col(1);
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "index", [m]() mutable{
+        std::vector<float> r = m[1];
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "add", [m, k](){
+        Matrixf<N> r = m + k;
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "subtract", [m, k](){
+        Matrixf<N> r = m - k;
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "scalarMultiply", [m](){
+        Matrixf<N> r = 2.5f*m;
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "multiply", [m, k](){
+        Matrixf<N> r = m*k;
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "multiplyVector", [m, v](){
+        Vectorf<N> r = m*v;
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "vectorMultiply", [m, v](){
+        Vectorf<N> r = v*m;
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "power", [m]() mutable{
+        Matrixf<N> r = m^3;
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "dotProduct", [m]() mutable{
+        float r = Matrixf<N>::dotProduct(m.row(0), m.col(1));
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "invert", [m]() mutable{
+        Matrixf<N> r = m.invert();
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "det", [m](){
+        float r = det(m);
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "mProduct", [v](){
+        Matrixf<N> r = Matrixf<N>::mProduct(v, v);
+        doNotOptimize(r);
+    });
+}
+
+void matrixBenchmarks(BenchmarkRunner& runner){
+    addMatrixBenchmarks<2>(runner);
+    addMatrixBenchmarks<3>(runner);
+    addMatrixBenchmarks<4>(runner);
+}
@@ -0,0 +1,425 @@
+#include "../arena.h"
+#include "../imagewriter.h"
+#include "../projection.h"
+#include "../rasterizer.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Reference scene benchmark: renders deterministic scenes headless, reports the
+//time of every pipeline stage, and checks the images against golden renders
+//and the frame times against a baseline run
+
+/**
+ * One reference scene, meshes are owned by the scene
+ */
+struct Scene{
+    std::string name;
+    std::vector<Mesh> meshes;
+    std::vector<RenderObject> objects;
+    std::vector<PointLight> lights;
+    std::vector<SpotLight> spot_lights;
+    std::vector<DirectionalLight> directional_lights;
+    int shadow_cascades = 0; //of the first directional light
+    Camera camera;
+};
+
+/**
+ * Median wall times of one scene in milliseconds, and the image check
+ */
+struct SceneResult{
+    std::string name;
+    double clear, transform, shadows, bin, raster, resolve, frame;
+    size_t triangles, fragments;
+    int max_diff; //largest channel difference to the golden image, in 8 bit levels
+    double bad_fraction; //pixels differing by more than the tolerance
+    double baseline_frame; //0 without baseline
+    bool image_ok, time_ok;
+};
+
+/**
+ * UV sphere with normals, counter clockwise seen from outside
+ */
+static Mesh buildSphere(int rings, int segments){
+    Mesh sphere;
+    sphere.resizeVertices((size_t)(rings + 1)*(segments + 1), true);
+    size_t v = 0;
+    for(int r = 0; r <= rings; r++){
+        float theta = 3.14159265f*r/rings;
+        for(int s = 0; s <= segments; s++, v++){
+            float phi = 6.28318531f*s/segments;
+            sphere.nx[v] = sinf(theta)*cosf(phi);
+            sphere.ny[v] = cosf(theta);
+            sphere.nz[v] = -sinf(theta)*sinf(phi);
+            sphere.px[v] = sphere.nx[v]; sphere.py[v] = sphere.ny[v]; sphere.pz[v] = sphere.nz[v];
+        }
+    }
+    for(int r = 0; r < rings; r++){
+        for(int s = 0; s < segments; s++){
+            uint32_t a = r*(segments + 1) + s, b = a + segments + 1;
+            sphere.indices.insert(sphere.indices.end(), {a, b, a + 1, a + 1, b, b + 1});
+        }
+    }
+    return sphere;
+}
+
+/**
+ * Grid of n x n quads covering [-1,1]^2 in the y = 0 plane, facing up
+ */
+static Mesh buildFloor(int n){
+    Mesh floor;
+    floor.resizeVertices((size_t)(n + 1)*(n + 1), true);
+    size_t v = 0;
+    for(int j = 0; j <= n; j++){
+        for(int i = 0; i <= n; i++, v++){
+            floor.px[v] = -1 + 2.0f*i/n; floor.py[v] = 0; floor.pz[v] = -1 + 2.0f*j/n;
+            floor.nx[v] = 0; floor.ny[v] = 1; floor.nz[v] = 0;
+        }
+    }
+    for(int j = 0; j < n; j++){
+        for(int i = 0; i < n; i++){
+            uint32_t a = j*(n + 1) + i, b = a + n + 1;
+            floor.indices.insert(floor.indices.end(), {a, b, a + 1, a + 1, b, b + 1});
+        }
+    }
+    return floor;
+}
+
+/**
+ * Object with a translate-scale model matrix
+ */
+static RenderObject place(const Mesh& mesh, float x, float y, float z, float sx, float sy, float sz,
+                          float r, float g, float b){
+    RenderObject object;
+    object.mesh = &mesh;
+    identityMatrix(object.transform);
+    object.transform[0] = sx; object.transform[5] = sy; object.transform[10] = sz;
+    object.transform[12] = x; object.transform[13] = y; object.transform[14] = z;
+    object.albedo[0] = r; object.albedo[1] = g; object.albedo[2] = b;
+    return object;
+}
+
+/**
+ * Camera with a 1 radian vertical field of view and a y up axis
+ */
+static Camera makeCamera(std::initializer_list<float> eye, std::initializer_list<float> target, float aspect){
+    float up[3] = {0, 1, 0};
+    Camera camera;
+    camera.lookAt(eye.begin(), target.begin(), up);
+    camera.setPerspective(1.0f, aspect, 0.1f, 200.0f);
+    return camera;
+}
+
+/**
+ * xorshift32 step, returns a float uniformly distributed in [0,1)
+ */
+static float random(uint32_t& state){
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state >> 8)*(1.0f/16777216.0f);
+}
+
+/**
+ * Build the reference scenes. Meshes are added before objects point into them.
+ */
+static std::vector<Scene> buildScenes(float aspect){
+    std::vector<Scene> scenes(6);
+    uint32_t rng = 2463534242u;
+
+    //many objects: a thousand small spheres on a floor
+    Scene& many = scenes[0];
+    many.name = "many_objects";
+    many.meshes = {buildSphere(12, 16), buildFloor(1)};
+    many.objects.push_back(place(many.meshes[1], 0, 0, -20, 30, 1, 30, 0.6f, 0.6f, 0.6f));
+    for(int j = 0; j < 25; j++){
+        for(int i = 0; i < 40; i++){
+            many.objects.push_back(place(many.meshes[0], -20 + i, 0.4f, -5 - 1.2f*j, 0.4f, 0.4f, 0.4f,
+                                         random(rng), random(rng), random(rng)));
+        }
+    }
+    many.lights = {PointLight{{-8, 6, -10}, {1.2f, 1.1f, 0.9f}, 30}, PointLight{{8, 6, -25}, {0.8f, 0.9f, 1.2f}, 30}};
+    many.camera = makeCamera({0, 6, 4}, {0, 0, -15}, aspect);
+
+    //overdraw: screen filling quads drawn back to front, every layer passes the depth test
+    Scene& overdraw = scenes[1];
+    overdraw.name = "overdraw";
+    overdraw.meshes = {buildFloor(2)};
+    for(int layer = 0; layer < 48; layer++){
+        RenderObject quad = place(overdraw.meshes[0], 0, 0, -50 + layer, 60, 1, 60,
+                                  random(rng), random(rng), random(rng));
+        //rotate the floor to face the camera: y -> z, z -> -y
+        quad.transform[5] = 0; quad.transform[6] = 1;
+        quad.transform[9] = -60; quad.transform[10] = 0;
+        overdraw.objects.push_back(quad);
+    }
+    overdraw.lights = {PointLight{{0, 0, 2}, {1, 1, 1}, 80}};
+    overdraw.camera = makeCamera({0, 0, 5}, {0, 0, 0}, aspect);
+
+    //huge mesh: one sphere of about a million triangles
+    Scene& huge = scenes[2];
+    huge.name = "huge_mesh";
+    huge.meshes = {buildSphere(512, 1024)};
+    huge.objects.push_back(place(huge.meshes[0], 0, 0, -4, 1.8f, 1.8f, 1.8f, 0.8f, 0.7f, 0.5f));
+    huge.lights = {PointLight{{3, 3, 0}, {1, 0.95f, 0.9f}, 12}, PointLight{{-4, -1, -1}, {0.2f, 0.3f, 0.6f}, 10}};
+    huge.camera = makeCamera({0, 0, 0}, {0, 0, -4}, aspect);
+
+    //many lights: a tessellated floor and a few spheres under 256 colored lights
+    Scene& lit = scenes[3];
+    lit.name = "many_lights";
+    lit.meshes = {buildFloor(64), buildSphere(24, 32)};
+    lit.objects.push_back(place(lit.meshes[0], 0, 0, -12, 16, 1, 16, 0.8f, 0.8f, 0.8f));
+    for(int j = 0; j < 5; j++){
+        for(int i = 0; i < 5; i++){
+            lit.objects.push_back(place(lit.meshes[1], -8 + 4*i, 1, -20 + 4*j, 1, 1, 1, 0.9f, 0.9f, 0.9f));
+        }
+    }
+    for(int l = 0; l < 256; l++){
+        float x = -16 + 32*random(rng), z = -28 + 32*random(rng), y = 0.3f + 2*random(rng);
+        lit.lights.push_back(PointLight{{x, y, z}, {random(rng), random(rng), random(rng)}, 3});
+    }
+    lit.camera = makeCamera({0, 8, 6}, {0, 0, -10}, aspect);
+
+    //architectural: a hall of pillars under thousands of small point lights and ceiling spots
+    Scene& hall = scenes[4];
+    hall.name = "architectural";
+    hall.meshes = {buildFloor(64), buildSphere(12, 16)};
+    hall.objects.push_back(place(hall.meshes[0], 0, 0, -30, 40, 1, 40, 0.7f, 0.7f, 0.65f));
+    for(int j = 0; j < 12; j++){
+        for(int i = 0; i < 8; i++){
+            hall.objects.push_back(place(hall.meshes[1], -14 + 4*i, 3, -4 - 5*j, 0.5f, 3, 0.5f, 0.8f, 0.8f, 0.8f));
+        }
+    }
+    for(int l = 0; l < 4096; l++){
+        float x = -20 + 40*random(rng), z = -66 + 64*random(rng), y = 0.2f + 4*random(rng);
+        hall.lights.push_back(PointLight{{x, y, z}, {random(rng), random(rng), random(rng)}, 1.5f});
+    }
+    for(int l = 0; l < 512; l++){
+        float x = -20 + 40*random(rng), z = -66 + 64*random(rng);
+        hall.spot_lights.push_back(SpotLight{{x, 6, z}, {0, -1, 0}, {1.2f, 1.1f, 0.9f}, 8, 0.9f, 0.8f});
+    }
+    hall.camera = makeCamera({0, 4, 4}, {0, 2, -20}, aspect);
+
+    //sun shadows: the spheres on a floor again, under a low sun casting cascaded shadows
+    Scene& sun = scenes[5];
+    sun.name = "sun_shadows";
+    sun.meshes = {buildSphere(12, 16), buildFloor(1)};
+    sun.objects.push_back(place(sun.meshes[1], 0, 0, -20, 30, 1, 30, 0.6f, 0.6f, 0.6f));
+    for(int j = 0; j < 25; j++){
+        for(int i = 0; i < 40; i++){
+            sun.objects.push_back(place(sun.meshes[0], -20 + i, 0.4f + 0.8f*random(rng), -5 - 1.2f*j, 0.4f, 0.4f, 0.4f,
+                                        random(rng), random(rng), random(rng)));
+        }
+    }
+    sun.directional_lights = {DirectionalLight{{0.6f, -0.5f, -0.62f}, {1.1f, 1.0f, 0.85f}}};
+    sun.shadow_cascades = 4;
+    sun.camera = makeCamera({0, 6, 4}, {0, 0, -15}, aspect);
+    return scenes;
+}
+
+/**
+ * Read a binary PPM (P6, 8 bit)
+ * @return whether the file could be read
+ */
+static bool readPPM(const std::string& path, int& width, int& height, std::vector<unsigned char>& rgb){
+    std::ifstream in(path, std::ios::binary);
+    std::string magic;
+    int max_value = 0;
+    if(!(in >> magic >> width >> height >> max_value) || magic != "P6" || max_value != 255) return false;
+    in.get(); //single whitespace before the pixels
+    rgb.resize(3*(size_t)width*height);
+    in.read((char*)rgb.data(), rgb.size());
+    return (size_t)in.gcount() == rgb.size();
+}
+
+/**
+ * Compare a render with its golden image
+ * @return whether the golden image could be read and has the same size
+ */
+static bool compareGolden(const std::string& render, const std::string& golden, int tolerance, SceneResult& r){
+    int w0, h0, w1, h1;
+    std::vector<unsigned char> a, b;
+    if(!readPPM(render, w0, h0, a) || !readPPM(golden, w1, h1, b) || w0 != w1 || h0 != h1){
+        std::cout << "Warning: could not compare " << render << " with golden image " << golden << "\n";
+        return false;
+    }
+    size_t bad = 0;
+    r.max_diff = 0;
+    for(size_t p = 0; p < a.size(); p += 3){
+        int diff = 0;
+        for(int c = 0; c < 3; c++) diff = std::max(diff, abs((int)a[p + c] - (int)b[p + c]));
+        r.max_diff = std::max(r.max_diff, diff);
+        bad += diff > tolerance;
+    }
+    r.bad_fraction = (double)bad/(a.size()/3);
+    return true;
+}
+
+/**
+ * Frame time of a scene in a results file written by --json, 0 when missing
+ */
+static double baselineFrame(const std::string& json, const std::string& name){
+    size_t at = json.find("\"name\": \"" + name + "\"");
+    if(at == std::string::npos) return 0;
+    at = json.find("\"frame_ms\": ", at);
+    if(at == std::string::npos) return 0;
+    return atof(json.c_str() + at + strlen("\"frame_ms\": "));
+}
+
+static double median(std::vector<double> values){
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n%2? values[n/2]: 0.5*(values[n/2 - 1] + values[n/2]);
+}
+
+static bool writeJSON(const std::string& path, const std::vector<SceneResult>& results){
+    std::ofstream out(path, std::ios::trunc);
+    if(!out){
+        std::cout << "Warning: could not write scene results " << path << "\n";
+        return false;
+    }
+    char line[512];
+    out << "{\n  \"scenes\": [\n";
+    for(size_t i = 0; i < results.size(); i++){
+        const SceneResult& r = results[i];
+        snprintf(line, sizeof(line),
+                 "    {\"name\": \"%s\", \"frame_ms\": %.3f, \"clear_ms\": %.3f, \"transform_ms\": %.3f, "
+                 "\"shadows_ms\": %.3f, \"bin_ms\": %.3f, \"raster_ms\": %.3f, \"resolve_ms\": %.3f, \"triangles\": %zu, "
+                 "\"fragments\": %zu, \"max_diff\": %d, \"bad_fraction\": %.6f, \"passed\": %s}%s\n",
+                 r.name.c_str(), r.frame, r.clear, r.transform, r.shadows, r.bin, r.raster, r.resolve, r.triangles,
+                 r.fragments, r.max_diff, r.bad_fraction, r.image_ok && r.time_ok? "true": "false",
+                 i + 1 < results.size()? ",": "");
+        out << line;
+    }
+    out << "  ]\n}\n";
+    return (bool)out;
+}
+
+/**
+ * Scene benchmark executable
+ * usage: scenes [--width n] [--height n] [--frames n] [--threads n] [--filter substring]
+ *               [--out dir] [--golden dir] [--update-golden] [--tolerance levels] [--max-bad fraction]
+ *               [--baseline results.json] [--threshold fraction] [--json results.json]
+ * Renders go to --out; with --golden they are compared to the images of the same name there,
+ * with --update-golden (which requires --golden) they replace them. With --baseline, a scene whose median frame time
+ * exceeds the baseline's by more than --threshold fails. Returns 1 when any check fails.
+ */
+int main(int argc, char** argv){
+    int width = 640, height = 360, frames = 5, tolerance = 2;
+    unsigned threads = 0;
+    double max_bad = 0.001, threshold = 0.1;
+    bool update_golden = false;
+    std::string filter, out_dir = ".", golden_dir, baseline_path, json_path;
+    for(int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc? argv[i + 1]: "";
+        if(arg == "--update-golden"){ update_golden = true; continue;}
+        if(arg == "--width") width = atoi(value);
+        else if(arg == "--height") height = atoi(value);
+        else if(arg == "--frames") frames = std::max(1, atoi(value));
+        else if(arg == "--threads") threads = (unsigned)atoi(value);
+        else if(arg == "--filter") filter = value;
+        else if(arg == "--out") out_dir = value;
+        else if(arg == "--golden") golden_dir = value;
+        else if(arg == "--tolerance") tolerance = atoi(value);
+        else if(arg == "--max-bad") max_bad = atof(value);
+        else if(arg == "--baseline") baseline_path = value;
+        else if(arg == "--threshold") threshold = atof(value);
+        else if(arg == "--json") json_path = value;
+        else{
+            std::cout << "Warning: unknown option " << arg << "\n";
+            continue;
+        }
+        i++;
+    }
+    if(update_golden && golden_dir.empty()){
+        std::cout << "Error: --update-golden needs --golden dir\n";
+        return 1;
+    }
+    std::string baseline;
+    if(!baseline_path.empty()){
+        std::ifstream in(baseline_path);
+        std::stringstream text;
+        text << in.rdbuf();
+        baseline = text.str();
+        if(baseline.empty()) std::cout << "Warning: could not read baseline " << baseline_path << "\n";
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    JobSystem jobs(threads);
+    Rasterizer raster(jobs);
+    Framebuffer target(width, height);
+    std::vector<float> rgb(3*(size_t)width*height);
+    float sky[3] = {0.05f, 0.06f, 0.08f};
+    float ambient[3] = {0.08f, 0.08f, 0.1f};
+    raster.setAmbient(ambient);
+    std::vector<SceneResult> results;
+    bool passed = true;
+
+    for(Scene& scene: buildScenes((float)width/height)){
+        if(!filter.empty() && scene.name.find(filter) == std::string::npos) continue;
+        raster.setLights(scene.lights);
+        raster.setSpotLights(scene.spot_lights);
+        raster.setDirectionalLights(scene.directional_lights);
+        raster.setShadows(scene.shadow_cascades, 1024, 60);
+        std::vector<double> clear, transform, shadows, bin, rasterize, resolve, frame;
+        for(int f = -1; f < frames; f++){ //one warm up frame
+            Clock::time_point start = Clock::now();
+            target.clear(sky);
+            Clock::time_point cleared = Clock::now();
+            raster.render(scene.camera, scene.objects, target);
+            FrameArena::resetAll(); //end of frame, no job is running
+            Clock::time_point rendered = Clock::now();
+            target.resolve(rgb.data());
+            Clock::time_point resolved = Clock::now();
+            if(f < 0) continue;
+            const RasterStats& stats = raster.getStats();
+            clear.push_back(std::chrono::duration<double, std::milli>(cleared - start).count());
+            transform.push_back(stats.transform*1e3);
+            shadows.push_back(stats.shadows*1e3);
+            bin.push_back(stats.bin*1e3);
+            rasterize.push_back(stats.raster*1e3);
+            resolve.push_back(std::chrono::duration<double, std::milli>(resolved - rendered).count());
+            frame.push_back(std::chrono::duration<double, std::milli>(resolved - start).count());
+        }
+        SceneResult r{};
+        r.name = scene.name;
+        r.clear = median(clear); r.transform = median(transform); r.shadows = median(shadows); r.bin = median(bin);
+        r.raster = median(rasterize); r.resolve = median(resolve); r.frame = median(frame);
+        r.triangles = raster.getStats().triangles;
+        r.fragments = raster.getStats().fragments;
+        r.image_ok = true;
+        r.time_ok = true;
+
+        std::string render_path = out_dir + "/" + scene.name + ".ppm";
+        std::string golden_path = golden_dir + "/" + scene.name + ".ppm";
+        if(!ImageWriter::writeImage(update_golden? golden_path: render_path, target, IMAGE_PPM)) r.image_ok = false;
+        else if(!golden_dir.empty() && !update_golden){
+            r.image_ok = compareGolden(render_path, golden_path, tolerance, r) && r.bad_fraction <= max_bad;
+        }
+        r.baseline_frame = baselineFrame(baseline, scene.name);
+        if(r.baseline_frame > 0) r.time_ok = r.frame <= r.baseline_frame*(1 + threshold);
+
+        printf("%-14s frame %9.3f ms  clear %7.3f  transform %8.3f  shadows %8.3f  bin %8.3f  raster %9.3f"
+               "  resolve %7.3f  (%zu triangles, %zu fragments)\n", r.name.c_str(), r.frame, r.clear, r.transform,
+               r.shadows, r.bin, r.raster, r.resolve, r.triangles, r.fragments);
+        if(!r.image_ok){
+            printf("%-14s FAILED image check: max diff %d, %.4f%% of pixels over tolerance\n", r.name.c_str(),
+                   r.max_diff, 100*r.bad_fraction);
+        }
+        if(!r.time_ok){
+            printf("%-14s FAILED timing check: %.3f ms against a baseline of %.3f ms\n", r.name.c_str(),
+                   r.frame, r.baseline_frame);
+        }
+        passed = passed && r.image_ok && r.time_ok;
+        results.push_back(r);
+    }
+    if(!json_path.empty() && !writeJSON(json_path, results)) passed = false;
+    return passed? 0: 1;
+}
@@ -0,0 +1,114 @@
+#include "../vector.h"
+#include <string>
+#include "benchmark.h"
+
+/**
+ * Register the Vectorf operations available for every dimension
+ * @tparam N dimension of the vectors
+ */
+template<size_t N>
+static void addVectorBenchmarks(BenchmarkRunner& runner){
+    std::string prefix = "Vectorf<" + std::to_string(N) + ">::";
+    Vectorf<N> a{1.0f, 2.0f, 3.0f, 4.0f};
+    Vectorf<N> b{0.5f, -1.0f, 2.5f, -3.0f};
+
+    runner.add(prefix + "construct", [](){
+        Vectorf<N> v{1.0f, 2.0f, 3.0f};
+        doNotOptimize(v);
+    });
+    runner.add(prefix + "add", [a, b]() mutable{
+        Vectorf<N> r = a + b;
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "subtract", [a, b]() mutable{
+        Vectorf<N> r = a - b;
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "dot", [a, b]() mutable{
+        float r = a*b;
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "scalarMultiply", [a]() mutable{
+        Vectorf<N> r = 2.5f*a;
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "norm", [a]() mutable{
+        float r = a.norm();
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "norm2", [a]() mutable{
+        float r = a.norm2();
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "compareVector", [a, b]() mutable{
+        bool r = a < b;
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "compareNorm", [a]() mutable{
+        bool r = a < 3.0f;
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "normalize", [a]() mutable{
+        Vectorf<N> r = a.normalize();
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "scale", [a, b]() mutable{
+        Vectorf<N> r = a.scale(a, b);
+        doNotOptimize(r);
+    });
+}
+
+/**
+ * Register the Vectorf operations that are only defined in 3D
+ */
+static void addVector3Benchmarks(BenchmarkRunner& runner){
+    std::string prefix = "Vectorf<3>::";
+    Vectorf<3> a{1.0f, 2.0f, 3.0f};
+    Vectorf<3> d{0.3f, 0.2f, -1.0f};
+    std::string plane = "xy";
+
+    runner.add(prefix + "cross", [a, d]() mutable{
+        Vectorf<3> r = a ^ d;
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "rotate3", [a, plane]() mutable{
+        Vectorf<3> r = a.rotate3(plane, 0.7f);
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "gRotate3", [a]() mutable{
+        float axis[3] = {0.0f, 0.6f, 0.8f};
+        Vectorf<3> r = a.gRotate3(axis, 0.7f);
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "reflect3", [a, plane]() mutable{
+        Vectorf<3> r = a.reflect3(plane);
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "gReflect3", [a]() mutable{
+        float normal[3] = {0.0f, 0.6f, 0.8f};
+        Vectorf<3> r = a.gReflect3(normal);
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "orthoProject3", [a, plane]() mutable{
+        Vectorf<3> r = a.orthoProject3(plane);
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "oblProject3", [a, d, plane]() mutable{
+        Vectorf<3> r = a.oblProject3(plane, d);
+        doNotOptimize(r);
+    });
+    runner.add(prefix + "pProject", [a]() mutable{
+        Vectorf<3> eye{0.0f, 0.0f, 5.0f};
+        Vectorf<3> point{0.0f, 0.0f, 0.0f};
+        Vectorf<3> normal{0.0f, 0.0f, 1.0f};
+        Vectorf<3> r = a.pProject(eye, point, normal);
+        doNotOptimize(r);
+    });
+}
+
+void vectorBenchmarks(BenchmarkRunner& runner){
+    addVectorBenchmarks<2>(runner);
+    addVectorBenchmarks<3>(runner);
+    addVectorBenchmarks<4>(runner);
+    addVector3Benchmarks(runner);
+}
@@ -0,0 +1,236 @@
+#include "broadphase.h"
+#include "profiler.h"
+#include "simd.h"
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+
+//Implementation details of the sweep and prune and spatial hash broadphases
+
+namespace {
+
+struct BoundStreams{
+    const float* lo[3];
+    const float* hi[3];
+
+    explicit BoundStreams(const ColliderBounds& bounds){
+        lo[0] = bounds.minx.data(); lo[1] = bounds.miny.data(); lo[2] = bounds.minz.data();
+        hi[0] = bounds.maxx.data(); hi[1] = bounds.maxy.data(); hi[2] = bounds.maxz.data();
+    }
+
+    bool overlap(uint32_t a, uint32_t b, int axis) const{
+        return lo[axis][a] <= hi[axis][b] && lo[axis][b] <= hi[axis][a];
+    }
+};
+
+inline ColliderPair makePair(uint32_t a, uint32_t b){
+    return a < b? ColliderPair{a, b}: ColliderPair{b, a};
+}
+
+inline uint32_t hashCell(const int32_t cell[3]){
+    return (uint32_t)cell[0]*73856093u ^ (uint32_t)cell[1]*19349663u ^ (uint32_t)cell[2]*83492791u;
+}
+
+}
+
+// ====== ColliderBounds ======
+
+size_t ColliderBounds::count() const{
+    return minx.size();
+}
+
+void ColliderBounds::resize(size_t count){
+    minx.resize(count); miny.resize(count); minz.resize(count);
+    maxx.resize(count); maxy.resize(count); maxz.resize(count);
+}
+
+void ColliderBounds::set(size_t collider, const float bmin[3], const float bmax[3]){
+    minx[collider] = bmin[0]; miny[collider] = bmin[1]; minz[collider] = bmin[2];
+    maxx[collider] = bmax[0]; maxy[collider] = bmax[1]; maxz[collider] = bmax[2];
+}
+
+// ====== SweepAndPrune ======
+
+SweepAndPrune::SweepAndPrune(){
+    axis = 0;
+    swaps = 0;
+}
+
+void SweepAndPrune::setAxis(int a){
+    if(a < 0 || a > 2){
+        std::cout << "Warning: sweep and prune axis " << a << " is not 0, 1 or 2\n";
+        return;
+    }
+    if(a != axis) order.clear();
+    axis = a;
+}
+
+/**
+ * Every pair of colliders with overlapping bounds, each pair once
+ * @param bounds the colliders of this frame; colliders keep their index from frame to frame
+ * @param pairs replaced by the overlapping pairs, in sweep order
+ */
+void SweepAndPrune::findPairs(const ColliderBounds& bounds, std::vector<ColliderPair>& pairs){
+    PROFILE_ZONE("SweepAndPrune::findPairs");
+    pairs.clear();
+    size_t n = bounds.count();
+    BoundStreams s(bounds);
+    const float* mins = s.lo[axis];
+
+    //colliders added since the last frame go at the end, removed ones are dropped
+    if(order.size() != n){
+        order.erase(std::remove_if(order.begin(), order.end(), [n](uint32_t c){ return c >= n;}), order.end());
+        for(size_t c = order.size(); c < n; c++) order.push_back((uint32_t)c);
+    }
+    swaps = 0;
+    for(size_t i = 1; i < n; i++){
+        uint32_t key = order[i];
+        float value = mins[key];
+        size_t j = i;
+        while(j > 0 && mins[order[j - 1]] > value){
+            order[j] = order[j - 1];
+            j--;
+        }
+        swaps += i - j;
+        order[j] = key;
+    }
+
+    //gather in sweep order, padded with 4 colliders that start past everything
+    int axes[3] = {axis, (axis + 1)%3, (axis + 2)%3};
+    for(int k = 0; k < 3; k++){
+        sorted[k].resize(n + 4);
+        sorted[3 + k].resize(n + 4);
+        for(size_t i = 0; i < n; i++){
+            sorted[k][i] = s.lo[axes[k]][order[i]];
+            sorted[3 + k][i] = s.hi[axes[k]][order[i]];
+        }
+        std::fill(sorted[k].begin() + n, sorted[k].end(), INFINITY);
+        std::fill(sorted[3 + k].begin() + n, sorted[3 + k].end(), -INFINITY);
+    }
+    const float* lo0 = sorted[0].data(); const float* lo1 = sorted[1].data(); const float* lo2 = sorted[2].data();
+    const float* hi0 = sorted[3].data(); const float* hi1 = sorted[4].data(); const float* hi2 = sorted[5].data();
+    for(size_t i = 0; i < n; i++){
+        Float4 end(hi0[i]), min1(lo1[i]), max1(hi1[i]), min2(lo2[i]), max2(hi2[i]);
+        for(size_t j = i + 1; j < n && lo0[j] <= hi0[i]; j += 4){ //the padding alone stops nothing if hi0[i] is infinite
+            Float4 hit = (Float4::load(lo0 + j) <= end) & (Float4::load(lo1 + j) <= max1)
+                         & (Float4::load(hi1 + j) >= min1) & (Float4::load(lo2 + j) <= max2)
+                         & (Float4::load(hi2 + j) >= min2);
+            for(int bits = mask(hit); bits != 0; bits &= bits - 1){
+                int lane = 0;
+                while(!(bits >> lane & 1)) lane++;
+                if(j + lane >= n) break; //padding lanes can pass every test against infinite bounds
+                pairs.push_back(makePair(order[i], order[j + lane]));
+            }
+        }
+    }
+}
+
+size_t SweepAndPrune::lastSwaps() const{
+    return swaps;
+}
+
+// ====== SpatialHashGrid ======
+
+SpatialHashGrid::SpatialHashGrid(){
+    cell_size = 0;
+    used_cell_size = 0;
+}
+
+void SpatialHashGrid::setCellSize(float size){
+    cell_size = std::max(0.0f, size);
+}
+
+/**
+ * @return cell size used by the last findPairs call
+ */
+float SpatialHashGrid::getCellSize() const{
+    return used_cell_size;
+}
+
+/**
+ * Every pair of colliders with overlapping bounds, each pair once
+ * @param bounds the colliders of this frame
+ * @param pairs replaced by the overlapping pairs, grouped by cell
+ */
+void SpatialHashGrid::findPairs(const ColliderBounds& bounds, std::vector<ColliderPair>& pairs){
+    PROFILE_ZONE("SpatialHashGrid::findPairs");
+    pairs.clear();
+    size_t n = bounds.count();
+    BoundStreams s(bounds);
+    used_cell_size = cell_size;
+    if(used_cell_size == 0){
+        double extent = 0;
+        for(size_t c = 0; c < n; c++){
+            extent += std::max(s.hi[0][c] - s.lo[0][c], std::max(s.hi[1][c] - s.lo[1][c], s.hi[2][c] - s.lo[2][c]));
+        }
+        used_cell_size = n > 0 && extent > 0? (float)(2*extent/n): 1.0f;
+    }
+    float inv = 1/used_cell_size;
+
+    entries.clear();
+    oversized.clear();
+    for(uint32_t c = 0; c < n; c++){
+        float flo[3], fhi[3], cells = 1;
+        for(int k = 0; k < 3; k++){
+            flo[k] = floorf(s.lo[k][c]*inv);
+            fhi[k] = floorf(s.hi[k][c]*inv);
+            cells *= fhi[k] - flo[k] + 1;
+        }
+        //also catches non finite bounds and cells out of the int range
+        if(!(cells <= SPATIAL_HASH_MAX_CELLS) || !(fabsf(flo[0]) < 1e9f && fabsf(flo[1]) < 1e9f && fabsf(flo[2]) < 1e9f)){
+            oversized.push_back(c);
+            continue;
+        }
+        int32_t lo[3] = {(int32_t)flo[0], (int32_t)flo[1], (int32_t)flo[2]};
+        int32_t hi[3] = {(int32_t)fhi[0], (int32_t)fhi[1], (int32_t)fhi[2]};
+        Entry e;
+        e.collider = c;
+        for(e.cell[2] = lo[2]; e.cell[2] <= hi[2]; e.cell[2]++){
+            for(e.cell[1] = lo[1]; e.cell[1] <= hi[1]; e.cell[1]++){
+                for(e.cell[0] = lo[0]; e.cell[0] <= hi[0]; e.cell[0]++) entries.push_back(e);
+            }
+        }
+    }
+
+    //counting sort of the entries by bucket; entries stay in collider order within a bucket
+    size_t table = 16;
+    while(table < 2*entries.size()) table *= 2;
+    uint32_t mask = (uint32_t)table - 1;
+    bucket_start.assign(table + 1, 0);
+    for(const Entry& e: entries) bucket_start[(hashCell(e.cell) & mask) + 1]++;
+    for(size_t b = 0; b < table; b++) bucket_start[b + 1] += bucket_start[b];
+    buckets.resize(entries.size());
+    {
+        std::vector<uint32_t> cursor(bucket_start.begin(), bucket_start.end() - 1);
+        for(const Entry& e: entries) buckets[cursor[hashCell(e.cell) & mask]++] = e;
+    }
+
+    for(size_t b = 0; b < table; b++){
+        for(uint32_t i = bucket_start[b]; i < bucket_start[b + 1]; i++){
+            const Entry& ei = buckets[i];
+            uint32_t a = ei.collider;
+            for(uint32_t j = i + 1; j < bucket_start[b + 1]; j++){
+                const Entry& ej = buckets[j];
+                if(ei.cell[0] != ej.cell[0] || ei.cell[1] != ej.cell[1] || ei.cell[2] != ej.cell[2]) continue;
+                uint32_t c = ej.collider;
+                if(!s.overlap(a, c, 0) || !s.overlap(a, c, 1) || !s.overlap(a, c, 2)) continue;
+                //the owner is the cell holding the max corner of the two mins, both boxes touch it
+                bool owner = true;
+                for(int k = 0; k < 3; k++){
+                    owner = owner && (int32_t)floorf(std::max(s.lo[k][a], s.lo[k][c])*inv) == ei.cell[k];
+                }
+                if(owner) pairs.push_back(makePair(a, c));
+            }
+        }
+    }
+
+    if(oversized.empty()) return;
+    std::vector<char> is_oversized(n, 0);
+    for(uint32_t o: oversized) is_oversized[o] = 1;
+    for(uint32_t o: oversized){
+        for(uint32_t c = 0; c < n; c++){
+            if(c == o || (is_oversized[c] && c < o)) continue;
+            if(s.overlap(o, c, 0) && s.overlap(o, c, 1) && s.overlap(o, c, 2)) pairs.push_back(makePair(o, c));
+        }
+    }
+}
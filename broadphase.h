@@ -0,0 +1,82 @@
+#ifndef GRAPHICSENGINE3D_BROADPHASE_H
+#define GRAPHICSENGINE3D_BROADPHASE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+const int SPATIAL_HASH_MAX_CELLS = 64; //colliders touching more cells skip the grid
+
+/**
+ * Axis aligned bounding boxes of the colliders, structure of arrays:
+ * one stream per bound, indexed by collider
+ */
+struct ColliderBounds{
+    std::vector<float> minx;
+    std::vector<float> miny;
+    std::vector<float> minz;
+    std::vector<float> maxx;
+    std::vector<float> maxy;
+    std::vector<float> maxz;
+
+    size_t count() const;
+    void resize(size_t count);
+    void set(size_t collider, const float bmin[3], const float bmax[3]);
+};
+
+/**
+ * Two colliders whose bounds overlap, a < b
+ */
+struct ColliderPair{
+    uint32_t a;
+    uint32_t b;
+};
+
+/**
+ * Sweep and prune along one axis. The order of the colliders along the axis
+ * is kept from one frame to the next and repaired with an insertion sort,
+ * which is close to linear when few colliders move, as in mostly static scenes.
+ * The sweep tests 4 candidates at a time; its cost grows with the number of
+ * colliders overlapping along the axis, so dense scenes are better served by
+ * SpatialHashGrid.
+ */
+class SweepAndPrune{
+public:
+    SweepAndPrune();
+    void setAxis(int axis); //0, 1 or 2, the axis the colliders spread the most along works best
+    void findPairs(const ColliderBounds& bounds, std::vector<ColliderPair>& pairs);
+    size_t lastSwaps() const; //insertion sort moves of the last findPairs call
+private:
+    int axis;
+    std::vector<uint32_t> order; //colliders sorted by their min along the axis
+    std::vector<float> sorted[6]; //bounds gathered in sweep order: min then max, sweep axis first
+    size_t swaps;
+};
+
+/**
+ * Uniform grid hashed into a table rebuilt every frame, for dense scenes
+ * where everything moves. Every collider goes into the cells it touches and
+ * a pair is only reported by the first cell both colliders share, so no pair
+ * comes out twice. Colliders touching more than SPATIAL_HASH_MAX_CELLS cells
+ * are tested against every other collider instead.
+ */
+class SpatialHashGrid{
+public:
+    SpatialHashGrid();
+    void setCellSize(float size); //0 picks twice the mean collider extent every frame
+    float getCellSize() const;
+    void findPairs(const ColliderBounds& bounds, std::vector<ColliderPair>& pairs);
+private:
+    struct Entry{
+        int32_t cell[3];
+        uint32_t collider;
+    };
+    float cell_size;
+    float used_cell_size;
+    std::vector<Entry> entries;
+    std::vector<Entry> buckets; //entries sorted by hash bucket
+    std::vector<uint32_t> bucket_start;
+    std::vector<uint32_t> oversized;
+};
+
+#endif //GRAPHICSENGINE3D_BROADPHASE_H
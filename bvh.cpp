@@ -0,0 +1,643 @@
+#include "bvh.h"
+#include "profiler.h"
+#include "simd.h"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <functional>
+#include <future>
+#include <thread>
+#include <math.h>
+
+//Implementation details of the triangle bounding volume hierarchy
+
+namespace {
+
+const int BIN_COUNT = 16;
+const uint32_t MAX_LEAF_SIZE = 4;
+const uint32_t PARALLEL_THRESHOLD = 8192; // smaller subtrees are built on the current thread
+const int STACK_SIZE = 128;
+
+/**
+ * Traversal stack of nodes still to visit. The first STACK_SIZE entries live
+ * on the call stack; degenerate trees deeper than that (e.g. an attached
+ * hierarchy, or many coincident triangles) spill to the heap instead of
+ * dropping subtrees.
+ */
+class NodeStack{
+public:
+    NodeStack(): sp(0){}
+    bool empty() const{ return sp == 0 && spill.empty();}
+    void push(const BVHNode* node){
+        if(sp < STACK_SIZE) nodes[sp++] = node;
+        else spill.push_back(node);
+    }
+    const BVHNode* pop(){
+        if(spill.empty()) return nodes[--sp];
+        const BVHNode* node = spill.back();
+        spill.pop_back();
+        return node;
+    }
+private:
+    const BVHNode* nodes[STACK_SIZE];
+    int sp;
+    std::vector<const BVHNode*> spill;
+};
+
+/**
+ * Axis aligned bounding box used while building, kept out of BVHNode
+ * so the node layout stays compact.
+ */
+struct Bounds{
+    float bmin[3];
+    float bmax[3];
+
+    void reset(){
+        for(int i = 0; i < 3; i++){ bmin[i] = FLT_MAX; bmax[i] = -FLT_MAX;}
+    }
+    void grow(const Bounds& b){
+        for(int i = 0; i < 3; i++){
+            bmin[i] = std::min(bmin[i], b.bmin[i]);
+            bmax[i] = std::max(bmax[i], b.bmax[i]);
+        }
+    }
+    float area() const{
+        float dx = bmax[0] - bmin[0]; float dy = bmax[1] - bmin[1]; float dz = bmax[2] - bmin[2];
+        if(dx < 0) return 0.0;
+        return dx*dy + dy*dz + dz*dx;
+    }
+};
+
+/**
+ * Shared state of one build. Nodes are preallocated so worker threads
+ * only need an atomic counter to claim child pairs.
+ */
+struct BuildContext{
+    std::vector<Bounds> tri_bounds;
+    std::vector<float> centroids; // 3 floats per triangle
+    std::atomic<uint32_t> next_node;
+    BVHNode* nodes;
+    uint32_t* order;
+    int parallel_depth;
+};
+
+/**
+ * Bounds of a single triangle read from the structure of arrays positions
+ */
+Bounds triangleBounds(const float* px, const float* py, const float* pz, const uint32_t* idx){
+    Bounds b;
+    b.reset();
+    for(int k = 0; k < 3; k++){
+        uint32_t v = idx[k];
+        b.bmin[0] = std::min(b.bmin[0], px[v]); b.bmax[0] = std::max(b.bmax[0], px[v]);
+        b.bmin[1] = std::min(b.bmin[1], py[v]); b.bmax[1] = std::max(b.bmax[1], py[v]);
+        b.bmin[2] = std::min(b.bmin[2], pz[v]); b.bmax[2] = std::max(b.bmax[2], pz[v]);
+    }
+    return b;
+}
+
+/**
+ * Recursively split a node with the binned surface area heuristic.
+ * The node's leftFirst/count must already describe its triangle range.
+ * Subtrees near the root are handed to other threads until parallel_depth is reached.
+ * @param ctx build state shared by all threads
+ * @param node_index index of the node to split
+ * @param depth depth of the node in the tree
+ */
+void subdivide(BuildContext& ctx, uint32_t node_index, int depth){
+    BVHNode& node = ctx.nodes[node_index];
+    uint32_t first = node.leftFirst;
+    uint32_t count = node.count;
+
+    Bounds nb; nb.reset();
+    Bounds cb; cb.reset(); // centroid bounds
+    for(uint32_t i = first; i < first+count; i++){
+        uint32_t t = ctx.order[i];
+        nb.grow(ctx.tri_bounds[t]);
+        for(int a = 0; a < 3; a++){
+            cb.bmin[a] = std::min(cb.bmin[a], ctx.centroids[3*t+a]);
+            cb.bmax[a] = std::max(cb.bmax[a], ctx.centroids[3*t+a]);
+        }
+    }
+    for(int a = 0; a < 3; a++){ node.bmin[a] = nb.bmin[a]; node.bmax[a] = nb.bmax[a];}
+    if(count <= MAX_LEAF_SIZE) return;
+
+    //evaluate the SAH at the bin boundaries of every axis
+    float best_cost = FLT_MAX;
+    int best_axis = -1;
+    int best_split = 0;
+    for(int a = 0; a < 3; a++){
+        float extent = cb.bmax[a] - cb.bmin[a];
+        if(extent <= 0) continue;
+        Bounds bins[BIN_COUNT];
+        uint32_t bin_count[BIN_COUNT];
+        for(int b = 0; b < BIN_COUNT; b++){ bins[b].reset(); bin_count[b] = 0;}
+        float scale = BIN_COUNT/extent;
+        for(uint32_t i = first; i < first+count; i++){
+            uint32_t t = ctx.order[i];
+            int b = std::min(BIN_COUNT-1, (int)((ctx.centroids[3*t+a] - cb.bmin[a])*scale));
+            bin_count[b]++;
+            bins[b].grow(ctx.tri_bounds[t]);
+        }
+        float left_area[BIN_COUNT-1];
+        uint32_t left_count[BIN_COUNT-1];
+        Bounds acc; acc.reset();
+        uint32_t sum = 0;
+        for(int b = 0; b < BIN_COUNT-1; b++){
+            sum += bin_count[b];
+            acc.grow(bins[b]);
+            left_count[b] = sum;
+            left_area[b] = acc.area();
+        }
+        acc.reset();
+        sum = 0;
+        for(int b = BIN_COUNT-1; b > 0; b--){
+            sum += bin_count[b];
+            acc.grow(bins[b]);
+            float cost = left_count[b-1]*left_area[b-1] + sum*acc.area();
+            if(left_count[b-1] > 0 && sum > 0 && cost < best_cost){
+                best_cost = cost;
+                best_axis = a;
+                best_split = b;
+            }
+        }
+    }
+    if(best_axis < 0 || best_cost >= count*nb.area()) return; //splitting does not pay off
+
+    //partition the triangle range in place around the chosen bin boundary
+    float cmin = cb.bmin[best_axis];
+    float scale = BIN_COUNT/(cb.bmax[best_axis] - cmin);
+    uint32_t i = first;
+    uint32_t j = first + count;
+    while(i < j){
+        uint32_t t = ctx.order[i];
+        int b = std::min(BIN_COUNT-1, (int)((ctx.centroids[3*t+best_axis] - cmin)*scale));
+        if(b < best_split) i++;
+        else std::swap(ctx.order[i], ctx.order[--j]);
+    }
+    uint32_t left_tris = i - first;
+    if(left_tris == 0 || left_tris == count) return;
+
+    uint32_t child = ctx.next_node.fetch_add(2);
+    node.leftFirst = child;
+    node.count = 0;
+    ctx.nodes[child].leftFirst = first;
+    ctx.nodes[child].count = left_tris;
+    ctx.nodes[child+1].leftFirst = i;
+    ctx.nodes[child+1].count = count - left_tris;
+
+    if(depth < ctx.parallel_depth && count > PARALLEL_THRESHOLD){
+        std::future<void> left = std::async(std::launch::async, subdivide, std::ref(ctx), child, depth+1);
+        subdivide(ctx, child+1, depth+1);
+        left.get();
+    }
+    else{
+        subdivide(ctx, child, depth+1);
+        subdivide(ctx, child+1, depth+1);
+    }
+}
+
+/**
+ * Slab test of a ray against a node's box.
+ * @return entry distance along the ray, FLT_MAX when the box is missed or farther than t_max
+ */
+inline float slab(const Ray& ray, const BVHNode& node, float t_max){
+    float tx1 = (node.bmin[0] - ray.origin[0])*ray.invDir[0];
+    float tx2 = (node.bmax[0] - ray.origin[0])*ray.invDir[0];
+    float tmin = std::min(tx1, tx2); float tmax = std::max(tx1, tx2);
+    float ty1 = (node.bmin[1] - ray.origin[1])*ray.invDir[1];
+    float ty2 = (node.bmax[1] - ray.origin[1])*ray.invDir[1];
+    tmin = std::max(tmin, std::min(ty1, ty2)); tmax = std::min(tmax, std::max(ty1, ty2));
+    float tz1 = (node.bmin[2] - ray.origin[2])*ray.invDir[2];
+    float tz2 = (node.bmax[2] - ray.origin[2])*ray.invDir[2];
+    tmin = std::max(tmin, std::min(tz1, tz2)); tmax = std::min(tmax, std::max(tz1, tz2));
+    if(tmax >= tmin && tmin < t_max && tmax > 0) return tmin;
+    return FLT_MAX;
+}
+
+/**
+ * Slab test of four rays against a node's box.
+ * @return per lane entry distance, FLT_MAX in lanes that miss or hit farther than t_max
+ */
+inline Float4 slab4(const Float4 o[3], const Float4 inv[3], const BVHNode& node, Float4 t_max){
+    Float4 t1 = (Float4(node.bmin[0]) - o[0])*inv[0];
+    Float4 t2 = (Float4(node.bmax[0]) - o[0])*inv[0];
+    Float4 tmin = min(t1, t2); Float4 tmax = max(t1, t2);
+    t1 = (Float4(node.bmin[1]) - o[1])*inv[1];
+    t2 = (Float4(node.bmax[1]) - o[1])*inv[1];
+    tmin = max(tmin, min(t1, t2)); tmax = min(tmax, max(t1, t2));
+    t1 = (Float4(node.bmin[2]) - o[2])*inv[2];
+    t2 = (Float4(node.bmax[2]) - o[2])*inv[2];
+    tmin = max(tmin, min(t1, t2)); tmax = min(tmax, max(t1, t2));
+    Float4 hit = (tmax >= tmin) & (tmin < t_max) & (tmax > Float4(0.0f));
+    return select(hit, tmin, Float4(FLT_MAX));
+}
+
+/**
+ * Smallest lane of a packet distance, used to order children front to back
+ */
+inline float hmin(Float4 d){
+    float l[4];
+    d.store(l);
+    return std::min(std::min(l[0], l[1]), std::min(l[2], l[3]));
+}
+
+}
+
+// ==================== Ray ====================
+
+/**
+ * Default ray along +z from the origin with unbounded extent
+ */
+Ray::Ray(){
+    for(int i = 0; i < 3; i++){ origin[i] = 0.0; dir[i] = 0.0;}
+    dir[2] = 1.0;
+    invDir[0] = FLT_MAX; invDir[1] = FLT_MAX; invDir[2] = 1.0;
+    tMax = FLT_MAX;
+}
+
+/**
+ * Ray from an origin in a direction, the direction need not be normalized
+ * but hit distances are then expressed in multiples of its length.
+ * @param o ray origin
+ * @param d ray direction
+ * @param t_max farthest distance along the ray that counts as a hit
+ */
+Ray::Ray(const float o[3], const float d[3], float t_max){
+    for(int i = 0; i < 3; i++){
+        origin[i] = o[i];
+        dir[i] = d[i];
+        invDir[i] = 1.0f/d[i];
+    }
+    tMax = t_max;
+}
+
+// ==================== BVH ====================
+
+/**
+ * Empty hierarchy, every query misses until build() is called
+ */
+BVH::BVH(){
+    node_data = nullptr;
+    order_data = nullptr;
+    used_nodes = 0;
+    px = nullptr; py = nullptr; pz = nullptr;
+    indices = nullptr;
+    tri_count = 0;
+}
+
+/**
+ * Build the hierarchy over an indexed triangle list.
+ * Node 1 is left unused so sibling pairs share a cache line.
+ * @param x x coordinates of the vertices
+ * @param y y coordinates of the vertices
+ * @param z z coordinates of the vertices
+ * @param idx 3 vertex indices per triangle
+ * @param count number of triangles
+ */
+void BVH::build(const float* x, const float* y, const float* z, const uint32_t* idx, size_t count){
+    PROFILE_ZONE("BVH::build");
+    px = x; py = y; pz = z;
+    indices = idx;
+    tri_count = count;
+    nodes.clear();
+    tri_order.resize(count);
+    node_data = nullptr;
+    order_data = nullptr;
+    used_nodes = 0;
+    if(count == 0) return;
+
+    BuildContext ctx;
+    ctx.tri_bounds.resize(count);
+    ctx.centroids.resize(3*count);
+    for(size_t t = 0; t < count; t++){
+        ctx.tri_bounds[t] = triangleBounds(px, py, pz, idx+3*t);
+        for(int a = 0; a < 3; a++){
+            ctx.centroids[3*t+a] = 0.5f*(ctx.tri_bounds[t].bmin[a] + ctx.tri_bounds[t].bmax[a]);
+        }
+        tri_order[t] = (uint32_t)t;
+    }
+    nodes.resize(2*count + 1);
+    ctx.nodes = nodes.data();
+    ctx.order = tri_order.data();
+    ctx.next_node = 2;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    ctx.parallel_depth = 0;
+    while((1u << ctx.parallel_depth) < threads) ctx.parallel_depth++;
+
+    nodes[0].leftFirst = 0;
+    nodes[0].count = (uint32_t)count;
+    nodes[1].leftFirst = 0;
+    nodes[1].count = 0;
+    subdivide(ctx, 0, 0);
+    used_nodes = ctx.next_node;
+    nodes.resize(used_nodes);
+    node_data = nodes.data();
+    order_data = tri_order.data();
+}
+
+/**
+ * Use a hierarchy stored elsewhere, typically a memory mapped mesh cache,
+ * without copying it. Every array is referenced and must outlive the BVH.
+ * @param node_array the nodes, as laid out by build()
+ * @param node_count number of nodes
+ * @param order triangle ids in leaf order
+ * @param x x coordinates of the vertices
+ * @param y y coordinates of the vertices
+ * @param z z coordinates of the vertices
+ * @param idx 3 vertex indices per triangle
+ * @param count number of triangles
+ */
+void BVH::attach(const BVHNode* node_array, size_t node_count, const uint32_t* order,
+                 const float* x, const float* y, const float* z, const uint32_t* idx, size_t count){
+    nodes.clear();
+    tri_order.clear();
+    node_data = node_array;
+    order_data = order;
+    used_nodes = node_count;
+    px = x; py = y; pz = z;
+    indices = idx;
+    tri_count = count;
+}
+
+/**
+ * Recompute node bounds bottom-up after the vertices moved.
+ * Children are always stored after their parent, so a reverse sweep
+ * visits every child before its parent. Tree quality degrades as the
+ * mesh deforms far from its build pose, rebuild when that becomes visible.
+ * @param x new x coordinates of the vertices
+ * @param y new y coordinates of the vertices
+ * @param z new z coordinates of the vertices
+ */
+void BVH::refit(const float* x, const float* y, const float* z){
+    PROFILE_ZONE("BVH::refit");
+    px = x; py = y; pz = z;
+    if(node_data != nodes.data()){
+        //attached storage is read-only, take a private copy before updating it
+        nodes.assign(node_data, node_data + used_nodes);
+        tri_order.assign(order_data, order_data + tri_count);
+        node_data = nodes.data();
+        order_data = tri_order.data();
+    }
+    for(size_t i = used_nodes; i-- > 0;){
+        if(i == 1) continue; //padding node
+        BVHNode& node = nodes[i];
+        Bounds b; b.reset();
+        if(node.count > 0){
+            for(uint32_t k = node.leftFirst; k < node.leftFirst+node.count; k++){
+                b.grow(triangleBounds(px, py, pz, indices+3*tri_order[k]));
+            }
+        }
+        else{
+            for(int c = 0; c < 2; c++){
+                const BVHNode& child = nodes[node.leftFirst+c];
+                for(int a = 0; a < 3; a++){
+                    b.bmin[a] = std::min(b.bmin[a], child.bmin[a]);
+                    b.bmax[a] = std::max(b.bmax[a], child.bmax[a]);
+                }
+            }
+        }
+        for(int a = 0; a < 3; a++){ node.bmin[a] = b.bmin[a]; node.bmax[a] = b.bmax[a];}
+    }
+}
+
+/**
+ * Moller-Trumbore ray/triangle test, updates hit when the triangle is closer
+ * @param ray the ray to test
+ * @param tri triangle id
+ * @param hit current closest hit
+ * @return whether hit was updated
+ */
+bool BVH::intersectTriangle(const Ray& ray, uint32_t tri, Hit& hit) const{
+    uint32_t i0 = indices[3*tri]; uint32_t i1 = indices[3*tri+1]; uint32_t i2 = indices[3*tri+2];
+    float e1[3] = {px[i1]-px[i0], py[i1]-py[i0], pz[i1]-pz[i0]};
+    float e2[3] = {px[i2]-px[i0], py[i2]-py[i0], pz[i2]-pz[i0]};
+    float p[3] = {ray.dir[1]*e2[2] - ray.dir[2]*e2[1],
+                  ray.dir[2]*e2[0] - ray.dir[0]*e2[2],
+                  ray.dir[0]*e2[1] - ray.dir[1]*e2[0]};
+    float det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+    if(fabs(det) < 1e-12f) return false; //ray parallel to triangle
+    float inv_det = 1.0f/det;
+    float s[3] = {ray.origin[0]-px[i0], ray.origin[1]-py[i0], ray.origin[2]-pz[i0]};
+    float u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2])*inv_det;
+    if(u < 0 || u > 1) return false;
+    float q[3] = {s[1]*e1[2] - s[2]*e1[1],
+                  s[2]*e1[0] - s[0]*e1[2],
+                  s[0]*e1[1] - s[1]*e1[0]};
+    float v = (ray.dir[0]*q[0] + ray.dir[1]*q[1] + ray.dir[2]*q[2])*inv_det;
+    if(v < 0 || u+v > 1) return false;
+    float t = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2])*inv_det;
+    if(t <= 0 || t >= hit.t) return false;
+    hit.t = t;
+    hit.u = u;
+    hit.v = v;
+    hit.triangle = tri;
+    return true;
+}
+
+/**
+ * Closest hit query. Children are visited front to back so
+ * farther subtrees are culled by the closest hit found so far.
+ * @param ray the ray to trace
+ * @param hit filled with the closest hit, hit.triangle is NO_HIT on a miss
+ * @return whether any triangle was hit within ray.tMax
+ */
+bool BVH::intersect(const Ray& ray, Hit& hit) const{
+    hit.t = ray.tMax;
+    hit.u = 0.0; hit.v = 0.0;
+    hit.triangle = NO_HIT;
+    if(used_nodes == 0 || slab(ray, node_data[0], hit.t) == FLT_MAX) return false;
+
+    NodeStack stack;
+    const BVHNode* node = &node_data[0];
+    while(true){
+        if(node->count > 0){
+            for(uint32_t k = node->leftFirst; k < node->leftFirst+node->count; k++){
+                intersectTriangle(ray, order_data[k], hit);
+            }
+            if(stack.empty()) break;
+            node = stack.pop();
+            continue;
+        }
+        const BVHNode* near_child = &node_data[node->leftFirst];
+        const BVHNode* far_child = near_child+1;
+        float d_near = slab(ray, *near_child, hit.t);
+        float d_far = slab(ray, *far_child, hit.t);
+        if(d_near > d_far){ std::swap(d_near, d_far); std::swap(near_child, far_child);}
+        if(d_near == FLT_MAX){
+            if(stack.empty()) break;
+            node = stack.pop();
+        }
+        else{
+            node = near_child;
+            if(d_far != FLT_MAX) stack.push(far_child);
+        }
+    }
+    return hit.triangle != NO_HIT;
+}
+
+/**
+ * Any hit query, returns as soon as one triangle blocks the ray.
+ * Much cheaper than intersect() for shadow and line of sight tests.
+ * @param ray the ray to trace
+ * @return whether some triangle is hit within ray.tMax
+ */
+bool BVH::occluded(const Ray& ray) const{
+    if(used_nodes == 0 || slab(ray, node_data[0], ray.tMax) == FLT_MAX) return false;
+    Hit hit;
+    hit.t = ray.tMax;
+    hit.triangle = NO_HIT;
+
+    NodeStack stack;
+    const BVHNode* node = &node_data[0];
+    while(true){
+        if(node->count > 0){
+            for(uint32_t k = node->leftFirst; k < node->leftFirst+node->count; k++){
+                if(intersectTriangle(ray, order_data[k], hit)) return true;
+            }
+            if(stack.empty()) break;
+            node = stack.pop();
+            continue;
+        }
+        const BVHNode* left = &node_data[node->leftFirst];
+        bool hit_left = slab(ray, *left, ray.tMax) != FLT_MAX;
+        bool hit_right = slab(ray, *(left+1), ray.tMax) != FLT_MAX;
+        if(hit_left){
+            node = left;
+            if(hit_right) stack.push(left+1);
+        }
+        else if(hit_right) node = left+1;
+        else{
+            if(stack.empty()) break;
+            node = stack.pop();
+        }
+    }
+    return false;
+}
+
+/**
+ * Closest hit query for a packet of 4 rays. The packet descends into a node
+ * as soon as one of its rays hits the node's box, and triangles are tested
+ * against all 4 rays at once.
+ * @param packet the rays to trace, results are written to its t/u/v/triangle lanes
+ * @return bit mask of the lanes that hit a triangle
+ */
+int BVH::intersect4(RayPacket4& packet) const{
+    for(int l = 0; l < 4; l++){
+        packet.t[l] = packet.tMax[l];
+        packet.u[l] = 0.0; packet.v[l] = 0.0;
+        packet.triangle[l] = NO_HIT;
+    }
+    if(used_nodes == 0) return 0;
+
+    Float4 o[3], d[3], inv[3];
+    for(int a = 0; a < 3; a++){
+        o[a] = Float4::load(packet.origin[a]);
+        d[a] = Float4::load(packet.dir[a]);
+        inv[a] = Float4(1.0f)/d[a];
+    }
+    Float4 t = Float4::load(packet.tMax);
+    Float4 u(0.0f), v(0.0f);
+    Float4 zero(0.0f), one(1.0f);
+    if(!any(slab4(o, inv, node_data[0], t) < Float4(FLT_MAX))) return 0;
+
+    NodeStack stack;
+    const BVHNode* node = &node_data[0];
+    while(true){
+        if(node->count > 0){
+            for(uint32_t k = node->leftFirst; k < node->leftFirst+node->count; k++){
+                uint32_t tri = order_data[k];
+                uint32_t i0 = indices[3*tri]; uint32_t i1 = indices[3*tri+1]; uint32_t i2 = indices[3*tri+2];
+                float e1[3] = {px[i1]-px[i0], py[i1]-py[i0], pz[i1]-pz[i0]};
+                float e2[3] = {px[i2]-px[i0], py[i2]-py[i0], pz[i2]-pz[i0]};
+                Float4 p0 = d[1]*Float4(e2[2]) - d[2]*Float4(e2[1]);
+                Float4 p1 = d[2]*Float4(e2[0]) - d[0]*Float4(e2[2]);
+                Float4 p2 = d[0]*Float4(e2[1]) - d[1]*Float4(e2[0]);
+                Float4 det = Float4(e1[0])*p0 + Float4(e1[1])*p1 + Float4(e1[2])*p2;
+                Float4 inv_det = one/det;
+                Float4 s0 = o[0] - Float4(px[i0]); Float4 s1 = o[1] - Float4(py[i0]); Float4 s2 = o[2] - Float4(pz[i0]);
+                Float4 bu = (s0*p0 + s1*p1 + s2*p2)*inv_det;
+                Float4 q0 = s1*Float4(e1[2]) - s2*Float4(e1[1]);
+                Float4 q1 = s2*Float4(e1[0]) - s0*Float4(e1[2]);
+                Float4 q2 = s0*Float4(e1[1]) - s1*Float4(e1[0]);
+                Float4 bv = (d[0]*q0 + d[1]*q1 + d[2]*q2)*inv_det;
+                Float4 bt = (Float4(e2[0])*q0 + Float4(e2[1])*q1 + Float4(e2[2])*q2)*inv_det;
+                Float4 hit = (abs(det) > Float4(1e-12f)) & (bu >= zero) & (bv >= zero) & (bu+bv <= one)
+                             & (bt > zero) & (bt < t);
+                int hit_mask = mask(hit);
+                if(hit_mask == 0) continue;
+                t = select(hit, bt, t);
+                u = select(hit, bu, u);
+                v = select(hit, bv, v);
+                for(int l = 0; l < 4; l++){
+                    if(hit_mask & (1 << l)) packet.triangle[l] = tri;
+                }
+            }
+            if(stack.empty()) break;
+            node = stack.pop();
+            continue;
+        }
+        const BVHNode* near_child = &node_data[node->leftFirst];
+        const BVHNode* far_child = near_child+1;
+        float d_near = hmin(slab4(o, inv, *near_child, t));
+        float d_far = hmin(slab4(o, inv, *far_child, t));
+        if(d_near > d_far){ std::swap(d_near, d_far); std::swap(near_child, far_child);}
+        if(d_near == FLT_MAX){
+            if(stack.empty()) break;
+            node = stack.pop();
+        }
+        else{
+            node = near_child;
+            if(d_far != FLT_MAX) stack.push(far_child);
+        }
+    }
+    t.store(packet.t);
+    u.store(packet.u);
+    v.store(packet.v);
+    int result = 0;
+    for(int l = 0; l < 4; l++){
+        if(packet.triangle[l] != NO_HIT) result |= 1 << l;
+    }
+    return result;
+}
+
+/**
+ * Closest hit query for picking, with the ray given as engine vectors
+ * @param origin ray origin
+ * @param direction ray direction
+ * @param hit filled with the closest hit
+ * @param t_max farthest distance along the ray that counts as a hit
+ * @return whether any triangle was hit
+ */
+bool BVH::intersect(Vectorf<3> origin, Vectorf<3> direction, Hit& hit, float t_max){
+    Ray ray{origin.get(), direction.get(), t_max};
+    return intersect(ray, hit);
+}
+
+/**
+ * Line of sight query with the segment given as engine vectors
+ * @param origin ray origin
+ * @param direction ray direction
+ * @param t_max farthest distance along the ray that counts as blocking
+ * @return whether the ray is blocked before t_max
+ */
+bool BVH::occluded(Vectorf<3> origin, Vectorf<3> direction, float t_max){
+    Ray ray{origin.get(), direction.get(), t_max};
+    return occluded(ray);
+}
+
+const BVHNode* BVH::getNodes() const{
+    return node_data;
+}
+
+size_t BVH::nodeCount() const{
+    return used_nodes;
+}
+
+const uint32_t* BVH::getTriangleOrder() const{
+    return order_data;
+}
+
+size_t BVH::triangleCount() const{
+    return tri_count;
+}
@@ -0,0 +1,115 @@
+#ifndef GRAPHICSENGINE3D_BVH_H
+#define GRAPHICSENGINE3D_BVH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "vector.h"
+
+/**
+ * Compact 32-byte bounding volume hierarchy node, two nodes per cache line.
+ * Interior nodes have count == 0 and leftFirst is the index of the left child;
+ * the right child is always stored at leftFirst+1.
+ * Leaves have count > 0 and leftFirst is the first entry of the
+ * triangle index list covered by the leaf.
+ */
+struct BVHNode{
+    float bmin[3];
+    uint32_t leftFirst;
+    float bmax[3];
+    uint32_t count;
+};
+
+static_assert(sizeof(BVHNode) == 32, "BVHNode must stay 32 bytes");
+
+/**
+ * Ray used for BVH queries. The reciprocal direction is cached since every
+ * slab test uses it.
+ */
+struct Ray{
+    Ray();
+    Ray(const float o[3], const float d[3], float t_max);
+    float origin[3];
+    float dir[3];
+    float invDir[3];
+    float tMax;
+};
+
+/**
+ * Result of a closest-hit query. triangle is BVH::NO_HIT when nothing was hit,
+ * u and v are the barycentric coordinates of the hit on the triangle.
+ */
+struct Hit{
+    float t;
+    float u;
+    float v;
+    uint32_t triangle;
+};
+
+/**
+ * Four rays traced together through the hierarchy, one SIMD lane per ray.
+ * Meant for coherent rays (neighbouring primary rays), which visit mostly the
+ * same nodes so one box test serves the whole packet.
+ * Results are written per lane; triangle is BVH::NO_HIT for lanes that missed.
+ * A lane with tMax == 0 never hits, which is how partial packets are padded.
+ */
+struct RayPacket4{
+    float origin[3][4];
+    float dir[3][4];
+    float tMax[4];
+    float t[4];
+    float u[4];
+    float v[4];
+    uint32_t triangle[4];
+};
+
+/**
+ * Bounding volume hierarchy over an indexed triangle mesh.
+ * Positions are given as structure of arrays (x, y and z streams) and
+ * are referenced, not copied: the arrays must outlive the BVH.
+ * Built with the binned surface area heuristic, subtrees are built in parallel.
+ * Animated meshes should be refit() rather than rebuilt every frame.
+ * A prebuilt hierarchy (e.g. from a mesh cache) can be attach()ed in place.
+ */
+class BVH{
+public:
+    static const uint32_t NO_HIT = 0xffffffffu;
+
+    BVH();
+    BVH(const BVH&) = delete; //node_data may point into this object's own storage
+    BVH& operator=(const BVH&) = delete;
+    BVH(BVH&&) = default;
+    BVH& operator=(BVH&&) = default;
+    void build(const float* px, const float* py, const float* pz,
+               const uint32_t* indices, size_t tri_count);
+    void refit(const float* px, const float* py, const float* pz); //positions moved, topology kept
+    void attach(const BVHNode* nodes, size_t node_count, const uint32_t* tri_order,
+                const float* px, const float* py, const float* pz, const uint32_t* indices, size_t tri_count);
+
+    bool intersect(const Ray& ray, Hit& hit) const; //closest hit
+    bool occluded(const Ray& ray) const; //any hit, for line of sight and shadows
+    int intersect4(RayPacket4& packet) const; //closest hit for 4 coherent rays
+    bool intersect(Vectorf<3> origin, Vectorf<3> direction, Hit& hit, float t_max);
+    bool occluded(Vectorf<3> origin, Vectorf<3> direction, float t_max);
+
+    const BVHNode* getNodes() const;
+    size_t nodeCount() const;
+    const uint32_t* getTriangleOrder() const; //triangle ids in leaf order
+    size_t triangleCount() const;
+
+private:
+    std::vector<BVHNode> nodes;
+    std::vector<uint32_t> tri_order;
+    const BVHNode* node_data; //nodes, or attached storage
+    const uint32_t* order_data; //tri_order, or attached storage
+    size_t used_nodes;
+    const float* px;
+    const float* py;
+    const float* pz;
+    const uint32_t* indices;
+    size_t tri_count;
+
+    bool intersectTriangle(const Ray& ray, uint32_t tri, Hit& hit) const;
+};
+
+#endif //GRAPHICSENGINE3D_BVH_H
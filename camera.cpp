@@ -1,4 +1,173 @@
 #include "camera.h"
+#include "projection.h"
+#include <math.h>
 
 //Implementations details of Camera class
 
+static const float DEFAULT_FOV = 1.04719755f; // 60 degrees
+
+/**
+ * Normalize a 3 float array in place, leaves the zero vector untouched
+ */
+static void normalize3(float v[3]){
+    float n = sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+    if(n == 0) return;
+    for(int i = 0; i < 3; i++) v[i] /= n;
+}
+
+/**
+ * Default camera at the origin looking down -z with y up,
+ * 60 degree vertical field of view and square aspect ratio.
+ */
+Camera::Camera(){
+    float eye[3]{0.0, 0.0, 0.0};
+    float target[3]{0.0, 0.0, -1.0};
+    float world_up[3]{0.0, 1.0, 0.0};
+    lookAt(eye, target, world_up);
+    setPerspective(DEFAULT_FOV, 1.0, 0.1, 1000.0);
+}
+
+/**
+ * Camera placed at eye looking at target
+ * @param eye position of the camera
+ * @param target point the camera looks at
+ * @param up approximate up direction, need not be orthogonal to the view direction
+ * @param fov vertical field of view in radians
+ * @param aspect width over height of the image
+ */
+Camera::Camera(Vectorf<3> eye, Vectorf<3> target, Vectorf<3> up, float fov, float aspect){
+    lookAt(eye, target, up);
+    setPerspective(fov, aspect, 0.1, 1000.0);
+}
+
+/**
+ * Place the camera and rebuild its orthonormal basis
+ * @param eye position of the camera
+ * @param target point the camera looks at
+ * @param world_up approximate up direction
+ */
+void Camera::lookAt(const float eye[3], const float target[3], const float world_up[3]){
+    for(int i = 0; i < 3; i++){
+        position[i] = eye[i];
+        forward[i] = target[i] - eye[i];
+    }
+    normalize3(forward);
+    right[0] = forward[1]*world_up[2] - forward[2]*world_up[1];
+    right[1] = forward[2]*world_up[0] - forward[0]*world_up[2];
+    right[2] = forward[0]*world_up[1] - forward[1]*world_up[0];
+    normalize3(right);
+    up[0] = right[1]*forward[2] - right[2]*forward[1];
+    up[1] = right[2]*forward[0] - right[0]*forward[2];
+    up[2] = right[0]*forward[1] - right[1]*forward[0];
+}
+
+/**
+ * Place the camera from engine vectors
+ * @param eye position of the camera
+ * @param target point the camera looks at
+ * @param world_up approximate up direction
+ */
+void Camera::lookAt(Vectorf<3> eye, Vectorf<3> target, Vectorf<3> world_up){
+    lookAt(eye.get(), target.get(), world_up.get());
+}
+
+/**
+ * Set the perspective parameters of the camera
+ * @param fov_y vertical field of view in radians
+ * @param aspect_ratio width over height of the image
+ * @param near_p distance to the near clipping plane
+ * @param far_p distance to the far clipping plane
+ */
+void Camera::setPerspective(float fov_y, float aspect_ratio, float near_p, float far_p){
+    fov = fov_y;
+    aspect = aspect_ratio;
+    near_plane = near_p;
+    far_plane = far_p;
+}
+
+/**
+ * Primary ray through a point of the image plane.
+ * (0,0) is the top left corner of the image and (1,1) the bottom right.
+ * @param sx horizontal image coordinate in [0,1]
+ * @param sy vertical image coordinate in [0,1]
+ * @param origin filled with the ray origin
+ * @param dir filled with the normalized ray direction
+ */
+void Camera::generateRay(float sx, float sy, float origin[3], float dir[3]) const{
+    float h = tan(0.5f*fov);
+    float px = (2*sx - 1)*h*aspect;
+    float py = (1 - 2*sy)*h;
+    for(int i = 0; i < 3; i++){
+        origin[i] = position[i];
+        dir[i] = forward[i] + px*right[i] + py*up[i];
+    }
+    normalize3(dir);
+}
+
+/**
+ * World to view space transform: the camera sits at the origin looking down -z
+ * @param m filled with the column-major matrix
+ */
+void Camera::getViewMatrix(float m[16]) const{
+    for(int i = 0; i < 3; i++){
+        m[4*i] = right[i];
+        m[4*i + 1] = up[i];
+        m[4*i + 2] = -forward[i];
+        m[4*i + 3] = 0.0f;
+    }
+    m[12] = -(right[0]*position[0] + right[1]*position[1] + right[2]*position[2]);
+    m[13] = -(up[0]*position[0] + up[1]*position[1] + up[2]*position[2]);
+    m[14] = forward[0]*position[0] + forward[1]*position[1] + forward[2]*position[2];
+    m[15] = 1.0f;
+}
+
+/**
+ * View to clip space transform built from the perspective parameters
+ * @param m filled with the column-major matrix
+ */
+void Camera::getProjectionMatrix(float m[16]) const{
+    perspectiveMatrix(fov, aspect, near_plane, far_plane, m);
+}
+
+/**
+ * World to clip space transform, projection * view
+ * @param m filled with the column-major matrix
+ */
+void Camera::getViewProjectionMatrix(float m[16]) const{
+    float view[16];
+    getViewMatrix(view);
+    getProjectionMatrix(m);
+    multiplyMatrix(m, view, m);
+}
+
+const float* Camera::getPosition() const{
+    return position;
+}
+
+const float* Camera::getForward() const{
+    return forward;
+}
+
+const float* Camera::getRight() const{
+    return right;
+}
+
+const float* Camera::getUp() const{
+    return up;
+}
+
+float Camera::getFov() const{
+    return fov;
+}
+
+float Camera::getAspect() const{
+    return aspect;
+}
+
+float Camera::getNear() const{
+    return near_plane;
+}
+
+float Camera::getFar() const{
+    return far_plane;
+}
@@ -1,12 +1,42 @@
 #ifndef GRAPHICSENGINE3D_CAMERA_H
 #define GRAPHICSENGINE3D_CAMERA_H
 
-#endif //GRAPHICSENGINE3D_CAMERA_H
+#include "vector.h"
 
 /**
- * Camera class to represent the camera during 3D graphics rendering
+ * Camera class to represent the camera during 3D graphics rendering.
+ * Right handed: the camera looks down its forward axis, with right and up
+ * completing an orthonormal basis. The field of view is vertical, in radians.
  */
 class Camera{
 public:
+    Camera();
+    Camera(Vectorf<3> eye, Vectorf<3> target, Vectorf<3> up, float fov, float aspect);
+    void lookAt(const float eye[3], const float target[3], const float up[3]);
+    void lookAt(Vectorf<3> eye, Vectorf<3> target, Vectorf<3> up);
+    void setPerspective(float fov, float aspect, float near_plane, float far_plane);
+    void generateRay(float sx, float sy, float origin[3], float dir[3]) const; //sx, sy in [0,1]
+    void getViewMatrix(float m[16]) const; //column-major, see projection.h
+    void getProjectionMatrix(float m[16]) const;
+    void getViewProjectionMatrix(float m[16]) const;
+
+    const float* getPosition() const;
+    const float* getForward() const;
+    const float* getRight() const;
+    const float* getUp() const;
+    float getFov() const;
+    float getAspect() const;
+    float getNear() const;
+    float getFar() const;
 private:
-};
\ No newline at end of file
+    float position[3];
+    float forward[3];
+    float right[3];
+    float up[3];
+    float fov;
+    float aspect;
+    float near_plane;
+    float far_plane;
+};
+
+#endif //GRAPHICSENGINE3D_CAMERA_H
@@ -0,0 +1,202 @@
+#include "fixedpoint.h"
+#include "simd.h"
+#include <string.h>
+
+//Implementation details of the fixed point sine and batch kernels
+
+namespace {
+
+const int SIN_SEGMENT_BITS = 8; //the quarter wave is split into 256 segments
+const int SIN_FRACTION_BITS = 30 - SIN_SEGMENT_BITS;
+
+/**
+ * sin(i pi/512) with 30 fraction bits, rounded to nearest.
+ * Written out rather than computed at startup so no machine's libm is involved.
+ */
+const int32_t SIN_TABLE[(1 << SIN_SEGMENT_BITS) + 1] = {
+    0, 6588356, 13176464, 19764076, 26350943, 32936819, 39521455, 46104602,
+    52686014, 59265442, 65842639, 72417357, 78989349, 85558366, 92124163, 98686491,
+    105245103, 111799753, 118350194, 124896179, 131437462, 137973796, 144504935, 151030634,
+    157550647, 164064728, 170572633, 177074115, 183568930, 190056834, 196537583, 203010932,
+    209476638, 215934457, 222384147, 228825464, 235258165, 241682010, 248096755, 254502159,
+    260897982, 267283981, 273659918, 280025552, 286380643, 292724951, 299058239, 305380268,
+    311690799, 317989595, 324276419, 330551034, 336813204, 343062693, 349299266, 355522689,
+    361732726, 367929144, 374111709, 380280190, 386434353, 392573967, 398698801, 404808624,
+    410903207, 416982319, 423045732, 429093217, 435124548, 441139496, 447137835, 453119340,
+    459083786, 465030947, 470960600, 476872522, 482766489, 488642281, 494499676, 500338453,
+    506158392, 511959275, 517740883, 523502998, 529245404, 534967884, 540670223, 546352205,
+    552013618, 557654248, 563273883, 568872310, 574449320, 580004702, 585538248, 591049748,
+    596538995, 602005783, 607449906, 612871159, 618269338, 623644239, 628995660, 634323400,
+    639627258, 644907034, 650162530, 655393548, 660599890, 665781362, 670937767, 676068911,
+    681174602, 686254647, 691308855, 696337036, 701339000, 706314559, 711263525, 716185713,
+    721080937, 725949013, 730789757, 735602987, 740388522, 745146182, 749875788, 754577161,
+    759250125, 763894504, 768510122, 773096806, 777654384, 782182683, 786681534, 791150767,
+    795590213, 799999706, 804379079, 808728167, 813046808, 817334838, 821592095, 825818421,
+    830013654, 834177638, 838310216, 842411232, 846480531, 850517961, 854523370, 858496606,
+    862437520, 866345964, 870221790, 874064853, 877875009, 881652112, 885396022, 889106597,
+    892783698, 896427186, 900036924, 903612776, 907154608, 910662286, 914135678, 917574653,
+    920979082, 924348837, 927683790, 930983817, 934248793, 937478595, 940673101, 943832191,
+    946955747, 950043650, 953095785, 956112036, 959092290, 962036435, 964944360, 967815955,
+    970651112, 973449725, 976211688, 978936898, 981625251, 984276646, 986890984, 989468165,
+    992008094, 994510675, 996975812, 999403415, 1001793390, 1004145648, 1006460100, 1008736660,
+    1010975242, 1013175761, 1015338134, 1017462281, 1019548121, 1021595575, 1023604567, 1025575020,
+    1027506862, 1029400018, 1031254418, 1033069992, 1034846671, 1036584389, 1038283080, 1039942680,
+    1041563127, 1043144360, 1044686319, 1046188946, 1047652185, 1049075980, 1050460278, 1051805027,
+    1053110176, 1054375676, 1055601479, 1056787540, 1057933813, 1059040255, 1060106826, 1061133483,
+    1062120190, 1063066909, 1063973603, 1064840240, 1065666786, 1066453210, 1067199483, 1067905576,
+    1068571464, 1069197120, 1069782521, 1070327646, 1070832474, 1071296985, 1071721163, 1072104991,
+    1072448455, 1072751542, 1073014240, 1073236540, 1073418433, 1073559913, 1073660973, 1073721611,
+    1073741824
+};
+
+/**
+ * Sums of two products of 4 lanes, rounded once like Vectorx: a*b + c*d, or a*b - c*d when subtract is set
+ */
+inline Int4 mulAdd2(Int4 a, Int4 b, Int4 c, Int4 d, bool subtract){
+    Int4 even0, odd0, even1, odd1;
+    mulWide(a, b, even0, odd0);
+    mulWide(c, d, even1, odd1);
+    if(subtract) return narrow64(sub64(even0, even1), sub64(odd0, odd1), 16);
+    return narrow64(add64(even0, even1), add64(odd0, odd1), 16);
+}
+
+/**
+ * a0*b0 + a1*b1 + a2*b2 over 4 lanes, rounded once
+ */
+inline Int4 dot3Lanes(Int4 a0, Int4 a1, Int4 a2, Int4 b0, Int4 b1, Int4 b2){
+    Int4 even0, odd0, even1, odd1, even2, odd2;
+    mulWide(a0, b0, even0, odd0);
+    mulWide(a1, b1, even1, odd1);
+    mulWide(a2, b2, even2, odd2);
+    return narrow64(add64(add64(even0, even1), even2), add64(add64(odd0, odd1), odd2), 16);
+}
+
+/**
+ * One vector of fixedNormalize3, the same steps as Vectorx::normalize()
+ */
+inline void normalizeOne(int32_t& x, int32_t& y, int32_t& z, uint64_t sum_squares){
+    int32_t length = (int32_t)fixedIsqrt(sum_squares);
+    if(length == 0) return;
+    Fixed16 l = Fixed16::fromRaw(length);
+    x = (Fixed16::fromRaw(x)/l).getRaw();
+    y = (Fixed16::fromRaw(y)/l).getRaw();
+    z = (Fixed16::fromRaw(z)/l).getRaw();
+}
+
+}
+
+/**
+ * Sine of a fraction of a turn: the quarter wave table is mirrored into the
+ * other quadrants and interpolated linearly between its entries
+ * @param turns angle in 2^-32 turns, so every angle has one representation
+ * @return the sine with 30 fraction bits
+ */
+int32_t fixedSinTurns(uint32_t turns){
+    uint32_t quadrant = turns >> 30;
+    uint32_t p = turns & ((1u << 30) - 1);
+    if(quadrant & 1) p = (1u << 30) - p; //sin(pi - x) = sin(x)
+    uint32_t segment = p >> SIN_FRACTION_BITS;
+    int32_t value = SIN_TABLE[segment];
+    uint32_t fraction = p & ((1u << SIN_FRACTION_BITS) - 1);
+    if(fraction != 0){
+        int64_t step = (int64_t)(SIN_TABLE[segment + 1] - value)*fraction;
+        value += (int32_t)((step + (1 << (SIN_FRACTION_BITS - 1))) >> SIN_FRACTION_BITS);
+    }
+    return quadrant & 2? -value: value;
+}
+
+// ====== Batch kernels ======
+
+/**
+ * Dot products of count pairs of 3d vectors
+ * @param out count results, may alias an input
+ */
+void fixedDot3(const int32_t* ax, const int32_t* ay, const int32_t* az,
+               const int32_t* bx, const int32_t* by, const int32_t* bz, size_t count, int32_t* out){
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4){
+        dot3Lanes(Int4::load(ax + i), Int4::load(ay + i), Int4::load(az + i),
+                  Int4::load(bx + i), Int4::load(by + i), Int4::load(bz + i)).store(out + i);
+    }
+    for(; i < count; i++){
+        Vectorx<3> a{Fixed16::fromRaw(ax[i]), Fixed16::fromRaw(ay[i]), Fixed16::fromRaw(az[i])};
+        Vectorx<3> b{Fixed16::fromRaw(bx[i]), Fixed16::fromRaw(by[i]), Fixed16::fromRaw(bz[i])};
+        out[i] = (a*b).getRaw();
+    }
+}
+
+/**
+ * Cross products a^b of count pairs of 3d vectors, the outputs must not alias the inputs
+ */
+void fixedCross3(const int32_t* ax, const int32_t* ay, const int32_t* az,
+                 const int32_t* bx, const int32_t* by, const int32_t* bz, size_t count,
+                 int32_t* cx, int32_t* cy, int32_t* cz){
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4){
+        Int4 x0 = Int4::load(ax + i), y0 = Int4::load(ay + i), z0 = Int4::load(az + i);
+        Int4 x1 = Int4::load(bx + i), y1 = Int4::load(by + i), z1 = Int4::load(bz + i);
+        mulAdd2(y0, z1, z0, y1, true).store(cx + i);
+        mulAdd2(z0, x1, x0, z1, true).store(cy + i);
+        mulAdd2(x0, y1, y0, x1, true).store(cz + i);
+    }
+    for(; i < count; i++){
+        Vectorx<3> a{Fixed16::fromRaw(ax[i]), Fixed16::fromRaw(ay[i]), Fixed16::fromRaw(az[i])};
+        Vectorx<3> b{Fixed16::fromRaw(bx[i]), Fixed16::fromRaw(by[i]), Fixed16::fromRaw(bz[i])};
+        Vectorx<3> c = a^b;
+        cx[i] = c[0].getRaw(); cy[i] = c[1].getRaw(); cz[i] = c[2].getRaw();
+    }
+}
+
+/**
+ * M*p for count points, the outputs must not alias the inputs
+ */
+void fixedTransform3(const Matrixx<3, Fixed16>& M, const int32_t* x, const int32_t* y, const int32_t* z,
+                     size_t count, int32_t* out_x, int32_t* out_y, int32_t* out_z){
+    int32_t* outputs[3] = {out_x, out_y, out_z};
+    Int4 rows[3][3];
+    for(int r = 0; r < 3; r++){
+        for(int c = 0; c < 3; c++) rows[r][c] = Int4(M.at(r, c).getRaw());
+    }
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4){
+        Int4 px = Int4::load(x + i), py = Int4::load(y + i), pz = Int4::load(z + i);
+        for(int r = 0; r < 3; r++){
+            dot3Lanes(rows[r][0], rows[r][1], rows[r][2], px, py, pz).store(outputs[r] + i);
+        }
+    }
+    for(; i < count; i++){
+        Vectorx<3> p = M*Vectorx<3>{Fixed16::fromRaw(x[i]), Fixed16::fromRaw(y[i]), Fixed16::fromRaw(z[i])};
+        for(int r = 0; r < 3; r++) outputs[r][i] = p[r].getRaw();
+    }
+}
+
+/**
+ * Normalize count 3d vectors in place, zero vectors are left as they are.
+ * The sums of squares are vectorized, the integer square roots and divisions
+ * are done lane by lane.
+ */
+void fixedNormalize3(int32_t* x, int32_t* y, int32_t* z, size_t count){
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4){
+        Int4 px = Int4::load(x + i), py = Int4::load(y + i), pz = Int4::load(z + i);
+        Int4 even0, odd0, even1, odd1, even2, odd2;
+        mulWide(px, px, even0, odd0);
+        mulWide(py, py, even1, odd1);
+        mulWide(pz, pz, even2, odd2);
+        int32_t even[4], odd[4];
+        add64(add64(even0, even1), even2).store(even);
+        add64(add64(odd0, odd1), odd2).store(odd);
+        uint64_t sums[4];
+        memcpy(sums, even, sizeof(even)); //lanes 0 and 2
+        memcpy(sums + 2, odd, sizeof(odd)); //lanes 1 and 3
+        normalizeOne(x[i], y[i], z[i], sums[0]);
+        normalizeOne(x[i + 1], y[i + 1], z[i + 1], sums[2]);
+        normalizeOne(x[i + 2], y[i + 2], z[i + 2], sums[1]);
+        normalizeOne(x[i + 3], y[i + 3], z[i + 3], sums[3]);
+    }
+    for(; i < count; i++){
+        Vectorx<3> v{Fixed16::fromRaw(x[i]), Fixed16::fromRaw(y[i]), Fixed16::fromRaw(z[i])};
+        v = v.normalize();
+        x[i] = v[0].getRaw(); y[i] = v[1].getRaw(); z[i] = v[2].getRaw();
+    }
+}
@@ -0,0 +1,672 @@
+#ifndef GRAPHICSENGINE3D_FIXEDPOINT_H
+#define GRAPHICSENGINE3D_FIXEDPOINT_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+
+/**
+ * Integer types a fixed point raw type is multiplied in: products keep every bit
+ * @tparam T signed raw type
+ */
+template<typename T> struct FixedWide;
+template<> struct FixedWide<int32_t>{
+    typedef int64_t type;
+    typedef uint64_t unsigned_type;
+    typedef uint32_t unsigned_raw;
+};
+#ifdef __SIZEOF_INT128__
+template<> struct FixedWide<int64_t>{
+    typedef __int128 type;
+    typedef unsigned __int128 unsigned_type;
+    typedef uint64_t unsigned_raw;
+};
+#endif
+
+const int64_t FIXED_TURNS_PER_RADIAN = 683565276; //2^32/(2 pi), radians to 32 bit fractions of a turn
+
+int32_t fixedSinTurns(uint32_t turns); //sine of turns/2^32 of a full turn, 30 fraction bits
+
+/**
+ * Floor of the square root of an unsigned integer, bit by bit
+ * @tparam U unsigned integer type
+ */
+template<typename U>
+U fixedIsqrt(U n){
+    U result = 0;
+    U bit = (U)1 << (sizeof(U)*8 - 2);
+    while(bit > n) bit >>= 2;
+    while(bit != 0){
+        if(n >= result + bit){
+            n -= result + bit;
+            result = (result >> 1) + bit;
+        }
+        else result >>= 1;
+        bit >>= 2;
+    }
+    return result;
+}
+
+/**
+ * 64 bit square roots start from the double precision root, within one of the
+ * exact one, and correct it with integer compares: the result is the exact
+ * floor whatever the rounding of the estimate, so it stays deterministic
+ */
+template<>
+inline uint64_t fixedIsqrt<uint64_t>(uint64_t n){
+    uint64_t result = (uint64_t)::sqrt((double)n);
+    if(result > 0xffffffffu) result = 0xffffffffu;
+    while(result*result > n) result--;
+    while(result < 0xffffffffu && (result + 1)*(result + 1) <= n) result++;
+    return result;
+}
+
+/**
+ * Signed fixed point number with F fraction bits, for simulations that must give
+ * bit-exact results on every machine (lockstep networking, replays).
+ * Every operation is integer arithmetic with a fixed rounding: + and - wrap
+ * around, * keeps the full product and shifts it down (rounding towards
+ * negative infinity), / truncates towards zero and saturates on division by zero.
+ * Right shifts of negative numbers are taken to be arithmetic, as they are on
+ * every compiler the engine builds with.
+ * fromFloat() is only meant for constants and inputs, results should never
+ * depend on float arithmetic.
+ * @tparam T signed raw integer type
+ * @tparam F fraction bits
+ */
+template<typename T, int F>
+class Fixed{
+public:
+    typedef T Raw;
+    typedef typename FixedWide<T>::type Wide;
+    typedef typename FixedWide<T>::unsigned_type UnsignedWide;
+    static const int FRACTION_BITS = F;
+
+    Fixed(): raw(0){}
+    static Fixed fromRaw(T r){ Fixed f; f.raw = r; return f;}
+    static Fixed fromInt(int i){ return fromRaw((T)((typename FixedWide<T>::unsigned_raw)(T)i << F));}
+    static Fixed fromFloat(double d);
+    static Fixed fromWide(Wide product){ return fromRaw((T)(product >> F));} //from 2F fraction bits
+    T getRaw() const{ return raw;}
+    double toDouble() const{ return (double)raw/((Wide)1 << F);}
+    float toFloat() const{ return (float)toDouble();}
+    Wide wideProduct(Fixed b) const{ return (Wide)raw*b.raw;} //2F fraction bits, never overflows
+
+    Fixed operator+(Fixed b) const;
+    Fixed operator-(Fixed b) const;
+    Fixed operator-() const;
+    Fixed operator*(Fixed b) const{ return fromWide(wideProduct(b));}
+    Fixed operator/(Fixed b) const;
+    Fixed& operator+=(Fixed b){ return *this = *this + b;}
+    Fixed& operator-=(Fixed b){ return *this = *this - b;}
+    bool operator==(Fixed b) const{ return raw == b.raw;}
+    bool operator!=(Fixed b) const{ return raw != b.raw;}
+    bool operator<(Fixed b) const{ return raw < b.raw;}
+    bool operator<=(Fixed b) const{ return raw <= b.raw;}
+    bool operator>(Fixed b) const{ return raw > b.raw;}
+    bool operator>=(Fixed b) const{ return raw >= b.raw;}
+    template<typename U, int G>
+    friend std::ostream& operator<<(std::ostream& os, Fixed<U, G> x);
+private:
+    T raw;
+};
+
+typedef Fixed<int32_t, 16> Fixed16; //Q16.16, the lockstep format with vectorized batch kernels
+#ifdef __SIZEOF_INT128__
+typedef Fixed<int64_t, 32> Fixed32; //Q32.32, products need 128 bit integers
+#endif
+
+/**
+ * Nearest fixed point number to a double, halves rounded up
+ */
+template<typename T, int F>
+Fixed<T, F> Fixed<T, F>::fromFloat(double d){
+    double scaled = d*(double)((Wide)1 << F) + 0.5;
+    T r = (T)scaled;
+    if((double)r > scaled) r--; //floor for negative numbers
+    return fromRaw(r);
+}
+
+template<typename T, int F>
+Fixed<T, F> Fixed<T, F>::operator+(Fixed b) const{
+    typedef typename FixedWide<T>::unsigned_raw U;
+    return fromRaw((T)((U)raw + (U)b.raw));
+}
+
+template<typename T, int F>
+Fixed<T, F> Fixed<T, F>::operator-(Fixed b) const{
+    typedef typename FixedWide<T>::unsigned_raw U;
+    return fromRaw((T)((U)raw - (U)b.raw));
+}
+
+template<typename T, int F>
+Fixed<T, F> Fixed<T, F>::operator-() const{
+    return Fixed() - *this;
+}
+
+template<typename T, int F>
+Fixed<T, F> Fixed<T, F>::operator/(Fixed b) const{
+    if(b.raw == 0){
+        std::cout << "Warning: fixed point division by zero, saturating\n";
+        T max_raw = (T)(~(typename FixedWide<T>::unsigned_raw)0 >> 1);
+        return fromRaw(raw < 0? (T)(-max_raw - 1): max_raw);
+    }
+    return fromRaw((T)((Wide)raw*((Wide)1 << F)/b.raw));
+}
+
+template<typename T, int F>
+std::ostream& operator<<(std::ostream& os, Fixed<T, F> x){
+    return os << x.toDouble();
+}
+
+// ============= Fixed point functions =====================
+
+/**
+ * Fixed point number from a Q2.30 value, rounded to nearest
+ */
+template<typename T, int F>
+Fixed<T, F> fixedFromQ30(int32_t v){
+    const int down = F < 30? 30 - F: 0, up = F > 30? F - 30: 0;
+    int64_t rounded = ((int64_t)v + (((int64_t)1 << down) >> 1)) >> down;
+    return Fixed<T, F>::fromRaw((T)(rounded*((int64_t)1 << up)));
+}
+
+/**
+ * Sine from a quarter wave table with linear interpolation, within 5e-6 of the
+ * exact sine before rounding to F bits, and the same bits on every machine.
+ * Angles are reduced to a 32 bit fraction of a turn by an integer product, the
+ * only error being the rounding of 2^32/(2 pi), 6e-10 of the angle.
+ */
+template<typename T, int F>
+Fixed<T, F> sin(Fixed<T, F> radians){
+    typedef typename Fixed<T, F>::Wide Wide;
+    uint32_t turns = (uint32_t)(((Wide)radians.getRaw()*FIXED_TURNS_PER_RADIAN) >> F);
+    return fixedFromQ30<T, F>(fixedSinTurns(turns));
+}
+
+template<typename T, int F>
+Fixed<T, F> cos(Fixed<T, F> radians){
+    typedef typename Fixed<T, F>::Wide Wide;
+    uint32_t turns = (uint32_t)(((Wide)radians.getRaw()*FIXED_TURNS_PER_RADIAN) >> F);
+    return fixedFromQ30<T, F>(fixedSinTurns(turns + (1u << 30)));
+}
+
+/**
+ * Square root rounded down, 0 for negative numbers
+ */
+template<typename T, int F>
+Fixed<T, F> sqrt(Fixed<T, F> x){
+    typedef typename Fixed<T, F>::UnsignedWide U;
+    if(x.getRaw() <= 0) return Fixed<T, F>();
+    return Fixed<T, F>::fromRaw((T)fixedIsqrt<U>((U)x.getRaw() << F));
+}
+
+template<typename T, int F>
+Fixed<T, F> abs(Fixed<T, F> x){
+    return x.getRaw() < 0? -x: x;
+}
+
+/**
+ * Fixed point counterpart of Vectorf with the same operator set, for
+ * deterministic simulation. Sums of products (dot, cross, matrix products) are
+ * accumulated at full precision and rounded once, so the batch kernels below
+ * give the same bits.
+ * @tparam N dimension of the vector
+ * @tparam Q fixed point scalar type, Fixed16 or Fixed32
+ */
+template<size_t N, typename Q = Fixed16>
+class Vectorx{
+public:
+    Vectorx();
+    Vectorx(std::initializer_list<Q> input);
+    Q* get(){ return pos;}
+    const Q* get() const{ return pos;}
+    Q& operator[](size_t i){ return pos[i];}
+    Q operator[](size_t i) const{ return pos[i];}
+    Vectorx<N, Q> operator+(const Vectorx<N, Q>& V) const;
+    Vectorx<N, Q> operator-(const Vectorx<N, Q>& V) const;
+    Q operator*(const Vectorx<N, Q>& V) const; //dot product
+    Vectorx<N, Q> operator^(const Vectorx<N, Q>& V) const; //cross product
+    template<size_t n, typename R>
+    friend Vectorx<n, R> operator*(R c, const Vectorx<n, R>& V);
+    Q norm() const;
+    Q norm2() const; //square of norm to avoid sqrt operations
+    bool operator<(const Vectorx<N, Q>& other_vector) const; //between origin and other vector
+    bool operator<(Q dist) const; // norm is smaller than given norm
+    template<size_t n, typename R>
+    friend std::ostream& operator<<(std::ostream& os, const Vectorx<n, R>& V);
+
+    Vectorx<N, Q> normalize() const;
+    Vectorx<N, Q> rotate3(const std::string& plane, Q radians) const; //3d orthonormal rotation
+    Vectorx<N, Q> gRotate3(const Q axis[3], Q radians) const; // general 3d rotation
+    Vectorx<N, Q> reflect3(const std::string& plane) const; //reflection through a plane
+    Vectorx<N, Q> gReflect3(const Q normal[N]) const; //reflection through a plane specified by a normal
+private:
+    Q pos[N];
+
+    typename Q::UnsignedWide sumSquares() const; //2F fraction bits
+};
+
+/**
+ * Square fixed point matrix, the counterpart of Matrixf: elements are stored
+ * by columns, m[N*col + row], and initializer lists fill column by column
+ * @tparam N dimension of the square matrix
+ * @tparam Q fixed point scalar type
+ */
+template<size_t N, typename Q = Fixed16>
+class Matrixx{
+public:
+    Matrixx(); //identity
+    Matrixx(std::initializer_list<Q> elements); //column by column
+    Matrixx(std::initializer_list<std::initializer_list<Q>> elements); //one list per column
+    Vectorx<N, Q> row(size_t index) const;
+    Vectorx<N, Q> col(size_t index) const;
+    Q& at(size_t r, size_t c){ return m[c*N + r];}
+    Q at(size_t r, size_t c) const{ return m[c*N + r];}
+    Matrixx<N, Q> operator+(const Matrixx<N, Q>& M) const;
+    Matrixx<N, Q> operator-(const Matrixx<N, Q>& M) const;
+    Matrixx<N, Q> operator*(const Matrixx<N, Q>& M) const;
+    Vectorx<N, Q> operator*(const Vectorx<N, Q>& V) const; //left matrix mult
+    template<size_t n, typename R>
+    friend Matrixx<n, R> operator*(R c, const Matrixx<n, R>& M);
+    template<size_t n, typename R>
+    friend Vectorx<n, R> operator*(const Vectorx<n, R>& V, const Matrixx<n, R>& M);
+    Matrixx<N, Q> operator^(int power) const;
+    Matrixx<N, Q> transpose() const;
+    Q det() const;
+    Matrixx<N, Q> invert() const;
+private:
+    Q m[N*N];
+
+    static Q minorDet(const Q* elements, size_t n);
+    Q cofactor(size_t r, size_t c) const;
+};
+
+// ============= Batch kernels =====================
+// Q16.16 raw values in structure of arrays layout, 4 lanes at a time, giving
+// the same bits as the Vectorx<3, Fixed16> and Matrixx<3, Fixed16> operators.
+
+void fixedDot3(const int32_t* ax, const int32_t* ay, const int32_t* az,
+               const int32_t* bx, const int32_t* by, const int32_t* bz, size_t count, int32_t* out);
+void fixedCross3(const int32_t* ax, const int32_t* ay, const int32_t* az,
+                 const int32_t* bx, const int32_t* by, const int32_t* bz, size_t count,
+                 int32_t* cx, int32_t* cy, int32_t* cz);
+void fixedTransform3(const Matrixx<3, Fixed16>& M, const int32_t* x, const int32_t* y, const int32_t* z,
+                     size_t count, int32_t* out_x, int32_t* out_y, int32_t* out_z);
+void fixedNormalize3(int32_t* x, int32_t* y, int32_t* z, size_t count);
+
+// ============= Vectorx =====================
+
+template<size_t N, typename Q>
+Vectorx<N, Q>::Vectorx(){
+    for(size_t i = 0; i < N; i++) pos[i] = Q();
+}
+
+/**
+ * @param input the first N coordinates, missing ones are 0
+ */
+template<size_t N, typename Q>
+Vectorx<N, Q>::Vectorx(std::initializer_list<Q> input){
+    if(input.size() > N) std::cout << "Warning: more than " << N << " coordinates given, extra ones ignored\n";
+    size_t i = 0;
+    for(const Q* q = input.begin(); q != input.end() && i < N; q++) pos[i++] = *q;
+    for(; i < N; i++) pos[i] = Q();
+}
+
+template<size_t N, typename Q>
+Vectorx<N, Q> Vectorx<N, Q>::operator+(const Vectorx<N, Q>& V) const{
+    Vectorx<N, Q> r;
+    for(size_t i = 0; i < N; i++) r.pos[i] = pos[i] + V.pos[i];
+    return r;
+}
+
+template<size_t N, typename Q>
+Vectorx<N, Q> Vectorx<N, Q>::operator-(const Vectorx<N, Q>& V) const{
+    Vectorx<N, Q> r;
+    for(size_t i = 0; i < N; i++) r.pos[i] = pos[i] - V.pos[i];
+    return r;
+}
+
+/**
+ * Dot product, the products summed at full precision (wrapping) and rounded once
+ */
+template<size_t N, typename Q>
+Q Vectorx<N, Q>::operator*(const Vectorx<N, Q>& V) const{
+    typedef typename Q::UnsignedWide U;
+    U sum = 0;
+    for(size_t i = 0; i < N; i++) sum += (U)pos[i].wideProduct(V.pos[i]);
+    return Q::fromWide((typename Q::Wide)sum);
+}
+
+/**
+ * Cross product of 3d vectors, every coordinate rounded once
+ */
+template<size_t N, typename Q>
+Vectorx<N, Q> Vectorx<N, Q>::operator^(const Vectorx<N, Q>& V) const{
+    if(N != 3){
+        std::cout << "Warning: cross product of non 3d vectors. Returning input vector.\n";
+        return *this;
+    }
+    typedef typename Q::UnsignedWide U;
+    typedef typename Q::Wide W;
+    Vectorx<N, Q> r;
+    for(size_t i = 0; i < 3; i++){
+        size_t j = (i + 1)%3, k = (i + 2)%3;
+        r.pos[i] = Q::fromWide((W)((U)pos[j].wideProduct(V.pos[k]) - (U)pos[k].wideProduct(V.pos[j])));
+    }
+    return r;
+}
+
+template<size_t n, typename R>
+Vectorx<n, R> operator*(R c, const Vectorx<n, R>& V){
+    Vectorx<n, R> r;
+    for(size_t i = 0; i < n; i++) r.pos[i] = c*V.pos[i];
+    return r;
+}
+
+template<size_t N, typename Q>
+typename Q::UnsignedWide Vectorx<N, Q>::sumSquares() const{
+    typedef typename Q::UnsignedWide U;
+    U sum = 0;
+    for(size_t i = 0; i < N; i++) sum += (U)pos[i].wideProduct(pos[i]);
+    return sum;
+}
+
+/**
+ * Norm rounded down, from the integer square root of the exact sum of squares
+ */
+template<size_t N, typename Q>
+Q Vectorx<N, Q>::norm() const{
+    return Q::fromRaw((typename Q::Raw)fixedIsqrt(sumSquares()));
+}
+
+template<size_t N, typename Q>
+Q Vectorx<N, Q>::norm2() const{
+    return Q::fromWide((typename Q::Wide)sumSquares());
+}
+
+template<size_t N, typename Q>
+bool Vectorx<N, Q>::operator<(const Vectorx<N, Q>& other_vector) const{
+    return sumSquares() < other_vector.sumSquares();
+}
+
+template<size_t N, typename Q>
+bool Vectorx<N, Q>::operator<(Q dist) const{
+    if(dist.getRaw() <= 0) return false;
+    return sumSquares() < (typename Q::UnsignedWide)dist.wideProduct(dist);
+}
+
+template<size_t n, typename R>
+std::ostream& operator<<(std::ostream& os, const Vectorx<n, R>& V){
+    os << "(";
+    for(size_t i = 0; i < n; i++) os << V.pos[i] << (i + 1 < n? ", ": ")");
+    return os;
+}
+
+/**
+ * @return the unit vector along this vector, the zero vector for itself
+ */
+template<size_t N, typename Q>
+Vectorx<N, Q> Vectorx<N, Q>::normalize() const{
+    Q length = norm();
+    if(length.getRaw() == 0) return *this;
+    Vectorx<N, Q> r;
+    for(size_t i = 0; i < N; i++) r.pos[i] = pos[i]/length;
+    return r;
+}
+
+/**
+ * Counter clockwise rotation in a standard plane, seen from the positive side of its normal
+ * @param plane "xy"/"z" or "yz"/"x" or "xz"/"y"
+ * @param radians the amount to rotate the vector by
+ */
+template<size_t N, typename Q>
+Vectorx<N, Q> Vectorx<N, Q>::rotate3(const std::string& plane, Q radians) const{
+    if(N != 3){
+        std::cout << "Warning: called 3d rotate on non 3d vector. Returning input vector.\n";
+        return *this;
+    }
+    int a, b; //rotates a towards b
+    if(plane == "xy" || plane == "z"){ a = 0; b = 1;}
+    else if(plane == "yz" || plane == "x"){ a = 1; b = 2;}
+    else if(plane == "xz" || plane == "y"){ a = 2; b = 0;}
+    else{
+        std::cout << "Warning: invalid 3d plane or direction provided. Returning input vector.\n";
+        return *this;
+    }
+    typedef typename Q::UnsignedWide U;
+    typedef typename Q::Wide W;
+    Q c = cos(radians), s = sin(radians);
+    Vectorx<N, Q> r = *this;
+    r.pos[a] = Q::fromWide((W)((U)c.wideProduct(pos[a]) - (U)s.wideProduct(pos[b])));
+    r.pos[b] = Q::fromWide((W)((U)s.wideProduct(pos[a]) + (U)c.wideProduct(pos[b])));
+    return r;
+}
+
+/**
+ * General 3D rotation about an axis, Rodrigues' formula.
+ * Should only be used if necessary otherwise rotate3 should be used
+ * for rotation about the standard orthonormal axes.
+ * @param axis the normalized vector axis to rotate our vector around
+ * @param radians the amount to rotate the vector by, counter clockwise seen from the axis
+ */
+template<size_t N, typename Q>
+Vectorx<N, Q> Vectorx<N, Q>::gRotate3(const Q axis[3], Q radians) const{
+    if(N != 3){
+        std::cout << "Warning: called 3d rotate on non 3d vector. Returning input vector.\n";
+        return *this;
+    }
+    Vectorx<N, Q> k;
+    for(size_t i = 0; i < 3; i++) k.pos[i] = axis[i];
+    Q c = cos(radians), s = sin(radians);
+    Q along = (k*(*this))*(Q::fromInt(1) - c);
+    return c*(*this) + s*(k^(*this)) + along*k;
+}
+
+/**
+ * Reflection through a standard plane
+ * @param plane "xy"/"z" or "yz"/"x" or "xz"/"y"
+ */
+template<size_t N, typename Q>
+Vectorx<N, Q> Vectorx<N, Q>::reflect3(const std::string& plane) const{
+    if(N != 3){
+        std::cout << "Warning: 3D reflect method called on non-3D vector. Returning initial vector.\n";
+        return *this;
+    }
+    Vectorx<N, Q> r = *this;
+    if(plane == "xy" || plane == "z") r.pos[2] = -pos[2];
+    else if(plane == "xz" || plane == "y") r.pos[1] = -pos[1];
+    else if(plane == "yz" || plane == "x") r.pos[0] = -pos[0];
+    else std::cout << "Warning: invalid 3d plane provided. Returning initial vector.\n";
+    return r;
+}
+
+/**
+ * Reflection through the plane through the origin with a given unit normal: v - 2(v.n)n
+ */
+template<size_t N, typename Q>
+Vectorx<N, Q> Vectorx<N, Q>::gReflect3(const Q normal[N]) const{
+    if(N != 3){
+        std::cout << "Warning: general 3D reflect method called on non-3D vector. Returning initial vector.\n";
+        return *this;
+    }
+    Vectorx<N, Q> n;
+    for(size_t i = 0; i < N; i++) n.pos[i] = normal[i];
+    Q d = n*(*this);
+    return *this - (d + d)*n;
+}
+
+// ============= Matrixx =====================
+
+template<size_t N, typename Q>
+Matrixx<N, Q>::Matrixx(){
+    for(size_t i = 0; i < N*N; i++) m[i] = i%(N + 1) == 0? Q::fromInt(1): Q();
+}
+
+template<size_t N, typename Q>
+Matrixx<N, Q>::Matrixx(std::initializer_list<Q> elements){
+    if(elements.size() != N*N){
+        std::cout << "Warning: " << elements.size() << " elements given for a " << N << "x" << N
+                  << " matrix, missing ones are 0\n";
+    }
+    size_t i = 0;
+    for(const Q* q = elements.begin(); q != elements.end() && i < N*N; q++) m[i++] = *q;
+    for(; i < N*N; i++) m[i] = Q();
+}
+
+/**
+ * @param elements the column vectors in order, each padded with zeroes or truncated to N
+ */
+template<size_t N, typename Q>
+Matrixx<N, Q>::Matrixx(std::initializer_list<std::initializer_list<Q>> elements){
+    if(elements.size() > N) std::cout << "Warning: more than " << N << " columns given, extra ones ignored\n";
+    for(size_t i = 0; i < N*N; i++) m[i] = Q();
+    size_t c = 0;
+    for(const std::initializer_list<Q>* column = elements.begin(); column != elements.end() && c < N; column++, c++){
+        size_t r = 0;
+        for(const Q* q = column->begin(); q != column->end() && r < N; q++) m[c*N + r++] = *q;
+    }
+}
+
+template<size_t N, typename Q>
+Vectorx<N, Q> Matrixx<N, Q>::row(size_t index) const{
+    Vectorx<N, Q> r;
+    for(size_t c = 0; c < N; c++) r[c] = m[c*N + index];
+    return r;
+}
+
+template<size_t N, typename Q>
+Vectorx<N, Q> Matrixx<N, Q>::col(size_t index) const{
+    Vectorx<N, Q> r;
+    for(size_t c = 0; c < N; c++) r[c] = m[index*N + c];
+    return r;
+}
+
+template<size_t N, typename Q>
+Matrixx<N, Q> Matrixx<N, Q>::operator+(const Matrixx<N, Q>& M) const{
+    Matrixx<N, Q> r;
+    for(size_t i = 0; i < N*N; i++) r.m[i] = m[i] + M.m[i];
+    return r;
+}
+
+template<size_t N, typename Q>
+Matrixx<N, Q> Matrixx<N, Q>::operator-(const Matrixx<N, Q>& M) const{
+    Matrixx<N, Q> r;
+    for(size_t i = 0; i < N*N; i++) r.m[i] = m[i] - M.m[i];
+    return r;
+}
+
+template<size_t N, typename Q>
+Matrixx<N, Q> Matrixx<N, Q>::operator*(const Matrixx<N, Q>& M) const{
+    Matrixx<N, Q> r;
+    for(size_t i = 0; i < N; i++){
+        for(size_t j = 0; j < N; j++) r.at(i, j) = row(i)*M.col(j);
+    }
+    return r;
+}
+
+template<size_t N, typename Q>
+Vectorx<N, Q> Matrixx<N, Q>::operator*(const Vectorx<N, Q>& V) const{
+    Vectorx<N, Q> r;
+    for(size_t i = 0; i < N; i++) r[i] = row(i)*V;
+    return r;
+}
+
+template<size_t n, typename R>
+Matrixx<n, R> operator*(R c, const Matrixx<n, R>& M){
+    Matrixx<n, R> r;
+    for(size_t i = 0; i < n*n; i++) r.m[i] = c*M.m[i];
+    return r;
+}
+
+template<size_t n, typename R>
+Vectorx<n, R> operator*(const Vectorx<n, R>& V, const Matrixx<n, R>& M){
+    Vectorx<n, R> r;
+    for(size_t i = 0; i < n; i++) r[i] = V*M.col(i);
+    return r;
+}
+
+/**
+ * Supports both negative, zero and positive exponents.
+ * Negative powers can only be computed for invertible matrices.
+ * By convention, matrix^0 will yield the identity matrix of dim N.
+ */
+template<size_t N, typename Q>
+Matrixx<N, Q> Matrixx<N, Q>::operator^(int power) const{
+    Matrixx<N, Q> base = power < 0? invert(): *this;
+    Matrixx<N, Q> r;
+    for(int i = 0; i < (power < 0? -power: power); i++) r = r*base;
+    return r;
+}
+
+template<size_t N, typename Q>
+Matrixx<N, Q> Matrixx<N, Q>::transpose() const{
+    Matrixx<N, Q> r;
+    for(size_t i = 0; i < N; i++){
+        for(size_t j = 0; j < N; j++) r.at(j, i) = at(i, j);
+    }
+    return r;
+}
+
+/**
+ * Determinant of an n x n matrix, by cofactor expansion along the first
+ * column (the first row of the transpose when stored by columns)
+ */
+template<size_t N, typename Q>
+Q Matrixx<N, Q>::minorDet(const Q* elements, size_t n){
+    if(n == 1) return elements[0];
+    if(n == 2) return elements[0]*elements[3] - elements[1]*elements[2];
+    Q result;
+    Q sub[N*N];
+    for(size_t c = 0; c < n; c++){
+        for(size_t i = 1; i < n; i++){
+            for(size_t j = 0, k = 0; j < n; j++){
+                if(j != c) sub[(i - 1)*(n - 1) + k++] = elements[i*n + j];
+            }
+        }
+        Q term = elements[c]*minorDet(sub, n - 1);
+        result = c%2 == 0? result + term: result - term;
+    }
+    return result;
+}
+
+template<size_t N, typename Q>
+Q Matrixx<N, Q>::det() const{
+    return minorDet(m, N);
+}
+
+template<size_t N, typename Q>
+Q Matrixx<N, Q>::cofactor(size_t r, size_t c) const{
+    if(N == 1) return Q::fromInt(1);
+    Q sub[N*N];
+    for(size_t i = 0, k = 0; i < N; i++){
+        for(size_t j = 0; j < N; j++){
+            if(i != r && j != c) sub[k++] = at(i, j);
+        }
+    }
+    Q minor = minorDet(sub, N - 1);
+    return (r + c)%2 == 0? minor: -minor;
+}
+
+/**
+ * Inverse from the adjugate over the determinant
+ * @return the inverse, the matrix itself when it is singular
+ */
+template<size_t N, typename Q>
+Matrixx<N, Q> Matrixx<N, Q>::invert() const{
+    Q d = det();
+    if(d.getRaw() == 0){
+        std::cout << "Warning: inverting a singular matrix. Returning input matrix.\n";
+        return *this;
+    }
+    Matrixx<N, Q> r;
+    for(size_t i = 0; i < N; i++){
+        for(size_t j = 0; j < N; j++) r.at(j, i) = cofactor(i, j)/d;
+    }
+    return r;
+}
+
+#endif //GRAPHICSENGINE3D_FIXEDPOINT_H
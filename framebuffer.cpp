@@ -0,0 +1,194 @@
+#include "framebuffer.h"
+#include "profiler.h"
+#include <stdint.h>
+
+//Implementation details of the tiled Framebuffer
+
+namespace {
+
+const int PLANES = 4; //red, green, blue, depth
+const int DEPTH_PLANE = 3;
+
+}
+
+Framebuffer::Framebuffer(){
+    tiles = nullptr;
+    cleared = nullptr;
+    resize(0, 0);
+}
+
+Framebuffer::Framebuffer(int width, int height){
+    tiles = nullptr;
+    cleared = nullptr;
+    resize(width, height);
+}
+
+/**
+ * Reallocate the planes; the content is cleared to black at depth 1
+ * @param w width in pixels
+ * @param h height in pixels
+ */
+void Framebuffer::resize(int w, int h){
+    width = w > 0? w: 0;
+    height = h > 0? h: 0;
+    tiles_x = (width + FRAMEBUFFER_TILE_SIZE - 1)/FRAMEBUFFER_TILE_SIZE;
+    tiles_y = (height + FRAMEBUFFER_TILE_SIZE - 1)/FRAMEBUFFER_TILE_SIZE;
+    size_t bytes = (size_t)tileCount()*PLANES*FRAMEBUFFER_TILE_PIXELS*sizeof(float);
+    std::vector<char>().swap(storage);
+    storage.resize(bytes + (size_t)tileCount()*FRAMEBUFFER_ALIGNMENT + FRAMEBUFFER_ALIGNMENT);
+    uintptr_t base = (uintptr_t)storage.data();
+    tiles = (float*)((base + FRAMEBUFFER_ALIGNMENT - 1)/FRAMEBUFFER_ALIGNMENT*FRAMEBUFFER_ALIGNMENT);
+    cleared = (char*)tiles + bytes; //tile blocks are a multiple of the alignment
+    float black[3] = {0.0f, 0.0f, 0.0f};
+    clear(black, 1.0f);
+}
+
+/**
+ * Fast clear: records the clear values and marks every tile as pending
+ * @param color linear RGB clear color
+ * @param depth clear depth
+ */
+void Framebuffer::clear(const float color[3], float depth){
+    for(int c = 0; c < 3; c++) clear_color[c] = color[c];
+    clear_depth = depth;
+    for(int tile = 0; tile < tileCount(); tile++) clearFlag(tile) = 1;
+}
+
+char& Framebuffer::clearFlag(int tile) const{
+    return cleared[(size_t)tile*FRAMEBUFFER_ALIGNMENT];
+}
+
+float* Framebuffer::tileBlock(int tile){
+    float* block = tiles + (size_t)tile*PLANES*FRAMEBUFFER_TILE_PIXELS;
+    if(clearFlag(tile)){
+        for(int p = 0; p < PLANES; p++){
+            float value = p == DEPTH_PLANE? clear_depth: clear_color[p];
+            float* plane = block + p*FRAMEBUFFER_TILE_PIXELS;
+            for(int i = 0; i < FRAMEBUFFER_TILE_PIXELS; i++) plane[i] = value;
+        }
+        clearFlag(tile) = 0;
+    }
+    return block;
+}
+
+const float* Framebuffer::tileBlock(int tile) const{
+    return tiles + (size_t)tile*PLANES*FRAMEBUFFER_TILE_PIXELS;
+}
+
+/**
+ * Writable plane of one color channel of a tile, FRAMEBUFFER_TILE_PIXELS floats
+ * @param tile tile index
+ * @param channel 0 red, 1 green, 2 blue
+ */
+float* Framebuffer::tileColor(int tile, int channel){
+    return tileBlock(tile) + channel*FRAMEBUFFER_TILE_PIXELS;
+}
+
+/**
+ * Writable depth plane of a tile, FRAMEBUFFER_TILE_PIXELS floats
+ */
+float* Framebuffer::tileDepth(int tile){
+    return tileBlock(tile) + DEPTH_PLANE*FRAMEBUFFER_TILE_PIXELS;
+}
+
+bool Framebuffer::isTileCleared(int tile) const{
+    return clearFlag(tile) != 0;
+}
+
+int Framebuffer::tileAt(int x, int y) const{
+    return (y/FRAMEBUFFER_TILE_SIZE)*tiles_x + x/FRAMEBUFFER_TILE_SIZE;
+}
+
+void Framebuffer::setPixel(int x, int y, const float rgb[3]){
+    float* block = tileBlock(tileAt(x, y));
+    int i = (y%FRAMEBUFFER_TILE_SIZE)*FRAMEBUFFER_TILE_SIZE + x%FRAMEBUFFER_TILE_SIZE;
+    for(int c = 0; c < 3; c++) block[c*FRAMEBUFFER_TILE_PIXELS + i] = rgb[c];
+}
+
+void Framebuffer::getPixel(int x, int y, float rgb[3]) const{
+    int tile = tileAt(x, y);
+    if(clearFlag(tile)){
+        for(int c = 0; c < 3; c++) rgb[c] = clear_color[c];
+        return;
+    }
+    const float* block = tileBlock(tile);
+    int i = (y%FRAMEBUFFER_TILE_SIZE)*FRAMEBUFFER_TILE_SIZE + x%FRAMEBUFFER_TILE_SIZE;
+    for(int c = 0; c < 3; c++) rgb[c] = block[c*FRAMEBUFFER_TILE_PIXELS + i];
+}
+
+float Framebuffer::getDepth(int x, int y) const{
+    int tile = tileAt(x, y);
+    if(clearFlag(tile)) return clear_depth;
+    int i = (y%FRAMEBUFFER_TILE_SIZE)*FRAMEBUFFER_TILE_SIZE + x%FRAMEBUFFER_TILE_SIZE;
+    return tileBlock(tile)[DEPTH_PLANE*FRAMEBUFFER_TILE_PIXELS + i];
+}
+
+/**
+ * Less-than depth test that stores the depth when it passes
+ * @return whether the fragment is closer than the stored depth
+ */
+bool Framebuffer::depthTest(int x, int y, float depth){
+    float* plane = tileDepth(tileAt(x, y));
+    float& stored = plane[(y%FRAMEBUFFER_TILE_SIZE)*FRAMEBUFFER_TILE_SIZE + x%FRAMEBUFFER_TILE_SIZE];
+    if(depth >= stored) return false;
+    stored = depth;
+    return true;
+}
+
+/**
+ * Convert the whole color buffer to interleaved RGB rows
+ * @param rgb filled with 3*width*height floats
+ */
+void Framebuffer::resolve(float* rgb) const{
+    resolveRows(0, height, rgb);
+}
+
+/**
+ * Convert a band of rows to interleaved RGB, reading cleared tiles from the clear color
+ * @param first_row first row to convert
+ * @param row_count number of rows
+ * @param rgb filled with 3*width*row_count floats
+ */
+void Framebuffer::resolveRows(int first_row, int row_count, float* rgb) const{
+    PROFILE_ZONE("Framebuffer::resolveRows");
+    for(int y = first_row; y < first_row + row_count; y++){
+        float* out = rgb + (size_t)3*width*(y - first_row);
+        int ty = y/FRAMEBUFFER_TILE_SIZE;
+        int row = (y%FRAMEBUFFER_TILE_SIZE)*FRAMEBUFFER_TILE_SIZE;
+        for(int tx = 0; tx < tiles_x; tx++){
+            int tile = ty*tiles_x + tx;
+            int x0 = tx*FRAMEBUFFER_TILE_SIZE;
+            int span = width - x0 < FRAMEBUFFER_TILE_SIZE? width - x0: FRAMEBUFFER_TILE_SIZE;
+            if(clearFlag(tile)){
+                for(int i = 0; i < span; i++){
+                    for(int c = 0; c < 3; c++) out[3*(x0 + i) + c] = clear_color[c];
+                }
+                continue;
+            }
+            const float* block = tileBlock(tile) + row;
+            for(int i = 0; i < span; i++){
+                for(int c = 0; c < 3; c++) out[3*(x0 + i) + c] = block[c*FRAMEBUFFER_TILE_PIXELS + i];
+            }
+        }
+    }
+}
+
+int Framebuffer::getWidth() const{
+    return width;
+}
+
+int Framebuffer::getHeight() const{
+    return height;
+}
+
+int Framebuffer::tilesX() const{
+    return tiles_x;
+}
+
+int Framebuffer::tilesY() const{
+    return tiles_y;
+}
+
+int Framebuffer::tileCount() const{
+    return tiles_x*tiles_y;
+}
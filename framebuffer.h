@@ -0,0 +1,66 @@
+#ifndef GRAPHICSENGINE3D_FRAMEBUFFER_H
+#define GRAPHICSENGINE3D_FRAMEBUFFER_H
+
+#include <stddef.h>
+#include <vector>
+
+const int FRAMEBUFFER_TILE_SIZE = 8;
+const int FRAMEBUFFER_TILE_PIXELS = FRAMEBUFFER_TILE_SIZE*FRAMEBUFFER_TILE_SIZE;
+const size_t FRAMEBUFFER_ALIGNMENT = 64;
+
+/**
+ * Render target with linear RGB color and depth planes.
+ * Pixels are stored in square tiles of FRAMEBUFFER_TILE_SIZE^2 pixels, and every
+ * tile is one contiguous, cache line aligned block holding its red, green,
+ * blue and depth planes, so threads rendering different tiles never write to
+ * the same cache line.
+ * clear() is O(tile count): tiles are only marked as cleared, and their memory
+ * is filled the first time tileColor()/tileDepth() hands it out for writing.
+ * Tiles are numbered row by row, pixels inside a tile as well.
+ */
+class Framebuffer{
+public:
+    Framebuffer();
+    Framebuffer(int width, int height);
+    Framebuffer(const Framebuffer&) = delete; //tiles points into this object's own storage
+    Framebuffer& operator=(const Framebuffer&) = delete;
+    Framebuffer(Framebuffer&&) = default;
+    Framebuffer& operator=(Framebuffer&&) = default;
+    void resize(int width, int height);
+
+    void clear(const float color[3], float depth = 1.0f);
+    float* tileColor(int tile, int channel); //plane of one channel, for writing
+    float* tileDepth(int tile);
+    bool isTileCleared(int tile) const; //still holding the clear values only
+    int tileAt(int x, int y) const;
+
+    void setPixel(int x, int y, const float rgb[3]);
+    void getPixel(int x, int y, float rgb[3]) const;
+    float getDepth(int x, int y) const;
+    bool depthTest(int x, int y, float depth); //store depth when closer
+
+    void resolve(float* rgb) const; //3 floats per pixel, rows top to bottom
+    void resolveRows(int first_row, int row_count, float* rgb) const;
+
+    int getWidth() const;
+    int getHeight() const;
+    int tilesX() const;
+    int tilesY() const;
+    int tileCount() const;
+private:
+    int width;
+    int height;
+    int tiles_x;
+    int tiles_y;
+    std::vector<char> storage;
+    float* tiles; //aligned start of storage, 4 planes per tile
+    char* cleared; //after the tiles in storage, one flag per cache line so tiles never share one
+    float clear_color[3];
+    float clear_depth;
+
+    char& clearFlag(int tile) const; //nonzero while the tile holds the clear values only
+    float* tileBlock(int tile); //tile memory, filled with the clear values when pending
+    const float* tileBlock(int tile) const;
+};
+
+#endif //GRAPHICSENGINE3D_FRAMEBUFFER_H
@@ -0,0 +1,212 @@
+#include "imagewriter.h"
+#include "profiler.h"
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+//Implementation details of the streaming image writer
+
+namespace {
+
+/**
+ * Linear [0,1] value to an 8 bit sRGB code
+ */
+unsigned char encodeSRGB(float linear){
+    if(!(linear > 0.0f)) return 0;
+    if(linear >= 1.0f) return 255;
+    float s = linear <= 0.0031308f? 12.92f*linear: 1.055f*powf(linear, 1.0f/2.4f) - 0.055f;
+    return (unsigned char)(s*255.0f + 0.5f);
+}
+
+bool littleEndian(){
+    uint32_t tag = 1;
+    unsigned char first;
+    memcpy(&first, &tag, 1);
+    return first == 1;
+}
+
+}
+
+ImageWriter::ImageWriter(){
+    format = IMAGE_PPM;
+    width = 0;
+    height = 0;
+    frames = 0;
+    next_band = 0;
+    header_size = 0;
+    failed = false;
+}
+
+ImageWriter::~ImageWriter(){
+    close();
+}
+
+/**
+ * Create the output file and write its header
+ * @param path the file to write, replaced when it exists
+ * @param image_format encoding of the frames
+ * @param w width of the frames in pixels
+ * @param h height of the frames in pixels
+ * @return whether the file could be created
+ */
+bool ImageWriter::open(const std::string& path, ImageFormat image_format, int w, int h){
+    close();
+    if(w <= 0 || h <= 0){
+        std::cout << "Warning: image size must be positive.\n";
+        return false;
+    }
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if(!file){
+        std::cout << "Warning: could not write image " << path << "\n";
+        return false;
+    }
+    format = image_format;
+    width = w;
+    height = h;
+    frames = 0;
+    failed = false;
+    std::string header;
+    if(format == IMAGE_PPM) header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    if(format == IMAGE_PFM) header = "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n-1.0\n";
+    file.write(header.data(), header.size());
+    header_size = (std::streamoff)header.size();
+    int bands = (height + FRAMEBUFFER_TILE_SIZE - 1)/FRAMEBUFFER_TILE_SIZE;
+    band_done.assign(bands, 0);
+    tile_done.assign((size_t)bands*((width + FRAMEBUFFER_TILE_SIZE - 1)/FRAMEBUFFER_TILE_SIZE), 0);
+    next_band = 0;
+    rows.resize((size_t)3*width*FRAMEBUFFER_TILE_SIZE);
+    bytes.resize(format == IMAGE_PFM? (size_t)3*width*sizeof(float): (size_t)3*width*FRAMEBUFFER_TILE_SIZE);
+    return true;
+}
+
+/**
+ * Report a finished tile of the current frame. Encodes every band that became
+ * complete, in order, on the calling thread. Tiles of a framebuffer of another
+ * size, tiles reported twice and tiles arriving after a PPM or PFM image was
+ * finished are rejected.
+ * @param framebuffer the frame being rendered, of the size given to open()
+ * @param tile the finished tile
+ */
+void ImageWriter::tileDone(const Framebuffer& framebuffer, int tile){
+    std::lock_guard<std::mutex> guard(lock);
+    if(!file.is_open()) return;
+    if(framebuffer.getWidth() != width || framebuffer.getHeight() != height){
+        std::cout << "Warning: framebuffer size does not match the image being written.\n";
+        failed = true;
+        return;
+    }
+    if(format != IMAGE_RAW && frames > 0){
+        std::cout << "Warning: tile reported after the image was finished, ignored.\n";
+        return;
+    }
+    if(tile < 0 || tile >= framebuffer.tileCount() || tile_done[tile]){
+        std::cout << "Warning: invalid or already reported tile " << tile << " ignored.\n";
+        return;
+    }
+    tile_done[tile] = 1;
+    int band = tile/framebuffer.tilesX();
+    band_done[band]++;
+    while(next_band < (int)band_done.size() && band_done[next_band] == framebuffer.tilesX()){
+        writeBand(framebuffer, next_band);
+        next_band++;
+    }
+}
+
+/**
+ * Finish the current frame: bands with unreported tiles are written as they
+ * are, and the band counters are reset for the next frame (IMAGE_RAW only).
+ * @return whether every write of the frame succeeded
+ */
+bool ImageWriter::endFrame(const Framebuffer& framebuffer){
+    std::lock_guard<std::mutex> guard(lock);
+    if(!file.is_open()) return false;
+    if(framebuffer.getWidth() != width || framebuffer.getHeight() != height){
+        std::cout << "Warning: framebuffer size does not match the image being written.\n";
+        return false;
+    }
+    if(format != IMAGE_RAW && frames > 0){
+        std::cout << "Warning: PPM and PFM images hold a single frame.\n";
+        return false;
+    }
+    for(; next_band < (int)band_done.size(); next_band++) writeBand(framebuffer, next_band);
+    frames++;
+    band_done.assign(band_done.size(), 0);
+    tile_done.assign(tile_done.size(), 0);
+    next_band = 0;
+    file.flush();
+    bool ok = !failed && file.good();
+    failed = false;
+    return ok;
+}
+
+/**
+ * Encode the rows of a band and write them at their offset in the file.
+ * PFM stores rows bottom to top, so each row gets its own write.
+ */
+void ImageWriter::writeBand(const Framebuffer& framebuffer, int band){
+    PROFILE_ZONE("ImageWriter::writeBand");
+    int first = band*FRAMEBUFFER_TILE_SIZE;
+    int count = height - first < FRAMEBUFFER_TILE_SIZE? height - first: FRAMEBUFFER_TILE_SIZE;
+    framebuffer.resolveRows(first, count, rows.data());
+    size_t row_values = (size_t)3*width;
+    if(format == IMAGE_PFM){
+        bool swap = !littleEndian();
+        for(int r = 0; r < count; r++){
+            const float* src = rows.data() + r*row_values;
+            memcpy(bytes.data(), src, row_values*sizeof(float));
+            if(swap){
+                for(size_t i = 0; i < row_values; i++){
+                    unsigned char* b = bytes.data() + 4*i;
+                    std::swap(b[0], b[3]);
+                    std::swap(b[1], b[2]);
+                }
+            }
+            std::streamoff offset = header_size + (std::streamoff)(height - 1 - first - r)*row_values*sizeof(float);
+            file.seekp(offset);
+            file.write((const char*)bytes.data(), row_values*sizeof(float));
+        }
+    }
+    else{
+        for(size_t i = 0; i < count*row_values; i++) bytes[i] = encodeSRGB(rows[i]);
+        std::streamoff frame_size = (std::streamoff)height*row_values;
+        file.seekp(header_size + frames*frame_size + (std::streamoff)first*row_values);
+        file.write((const char*)bytes.data(), count*row_values);
+    }
+    if(!file) failed = true;
+}
+
+/**
+ * Close the file
+ * @return whether every write succeeded
+ */
+bool ImageWriter::close(){
+    if(!file.is_open()) return true;
+    file.close();
+    bool ok = !failed && !file.fail();
+    failed = false;
+    return ok;
+}
+
+bool ImageWriter::isOpen() const{
+    return file.is_open();
+}
+
+int ImageWriter::frameCount() const{
+    return frames;
+}
+
+/**
+ * Write a finished framebuffer as a single image
+ * @param path the file to write
+ * @param framebuffer the image
+ * @param format IMAGE_PPM or IMAGE_PFM, IMAGE_RAW writes a single raw frame
+ * @return whether the image was written
+ */
+bool ImageWriter::writeImage(const std::string& path, const Framebuffer& framebuffer, ImageFormat format){
+    ImageWriter writer;
+    if(!writer.open(path, format, framebuffer.getWidth(), framebuffer.getHeight())) return false;
+    bool ok = writer.endFrame(framebuffer);
+    return writer.close() && ok;
+}
@@ -0,0 +1,63 @@
+#ifndef GRAPHICSENGINE3D_IMAGEWRITER_H
+#define GRAPHICSENGINE3D_IMAGEWRITER_H
+
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "framebuffer.h"
+
+/**
+ * Output formats of the ImageWriter:
+ * IMAGE_PPM binary 8 bit RGB (P6), one frame, sRGB encoded
+ * IMAGE_PFM little endian float RGB (PF), one frame, linear
+ * IMAGE_RAW headerless 8 bit RGB frames appended one after the other, sRGB encoded
+ *           (readable as rawvideo rgb24 at the size given to open())
+ */
+enum ImageFormat{
+    IMAGE_PPM,
+    IMAGE_PFM,
+    IMAGE_RAW
+};
+
+/**
+ * Streaming encoder for headless renders. Renderer threads report finished
+ * tiles with tileDone(); as soon as every tile of the next band of
+ * FRAMEBUFFER_TILE_SIZE rows is done, that band is encoded straight from the
+ * Framebuffer and written at its place in the file. Only one band is ever
+ * buffered, never a second copy of the image.
+ */
+class ImageWriter{
+public:
+    ImageWriter();
+    ~ImageWriter();
+    ImageWriter(const ImageWriter&) = delete;
+    ImageWriter& operator=(const ImageWriter&) = delete;
+
+    bool open(const std::string& path, ImageFormat format, int width, int height);
+    void tileDone(const Framebuffer& framebuffer, int tile); //thread safe
+    bool endFrame(const Framebuffer& framebuffer); //write the bands that are left
+    bool close();
+    bool isOpen() const;
+    int frameCount() const;
+
+    static bool writeImage(const std::string& path, const Framebuffer& framebuffer, ImageFormat format);
+private:
+    std::ofstream file;
+    std::mutex lock;
+    ImageFormat format;
+    int width;
+    int height;
+    int frames;
+    int next_band;
+    std::vector<int> band_done; //finished tiles per band
+    std::vector<char> tile_done; //whether each tile was reported in the current frame
+    std::vector<float> rows;
+    std::vector<unsigned char> bytes;
+    std::streamoff header_size;
+    bool failed;
+
+    void writeBand(const Framebuffer& framebuffer, int band);
+};
+
+#endif //GRAPHICSENGINE3D_IMAGEWRITER_H
@@ -0,0 +1,274 @@
+#include "jobsystem.h"
+#include <algorithm>
+#include <iostream>
+
+//Implementation details of the work-stealing JobSystem and the TaskGraph
+
+namespace {
+
+thread_local int worker_index = -1;
+thread_local const void* worker_pool = nullptr;
+
+}
+
+// ==================== JobSystem ====================
+
+/**
+ * Start the worker threads
+ * @param threads total number of threads running jobs, including the thread that
+ *                waits on them; 1 runs every job on the waiting thread
+ */
+JobSystem::JobSystem(unsigned threads): queued(0), next_queue(0), sleeping(0), stopping(false){
+    unsigned total = threads? threads: std::max(1u, std::thread::hardware_concurrency());
+    unsigned worker_count = total - 1;
+    for(unsigned i = 0; i < (worker_count > 0? worker_count: 1); i++) queues.emplace_back(new Queue());
+    for(unsigned i = 0; i < worker_count; i++) workers.emplace_back(&JobSystem::workerLoop, this, (int)i);
+}
+
+JobSystem::~JobSystem(){
+    {
+        std::lock_guard<std::mutex> guard(sleep_lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(auto& t: workers) t.join();
+}
+
+/**
+ * Queue a job. On a worker of this pool the job goes to the back of its own
+ * deque, otherwise to the deques in turn.
+ * @param job the work
+ * @param counter incremented now, decremented when the job finished
+ */
+void JobSystem::submit(std::function<void()> job, JobCounter& counter){
+    counter.pending.fetch_add(1);
+    bool own = worker_pool == this && worker_index >= 0;
+    unsigned q = own? (unsigned)worker_index: next_queue.fetch_add(1)%queues.size();
+    {
+        std::lock_guard<std::mutex> guard(queues[q]->lock);
+        queues[q]->jobs.push_back(Job{std::move(job), &counter});
+    }
+    queued.fetch_add(1);
+    if(sleeping.load() > 0){ //only pay for the wake up when a worker is idle
+        {
+            std::lock_guard<std::mutex> guard(sleep_lock);
+        }
+        wake.notify_one();
+    }
+}
+
+/**
+ * Run jobs until every job submitted with counter has finished
+ */
+void JobSystem::wait(JobCounter& counter){
+    int index = worker_pool == this? worker_index: -1;
+    while(counter.pending.load() > 0){
+        if(!runOne(index)) std::this_thread::yield();
+    }
+}
+
+/**
+ * Split [begin, end) into chunks of at most grain indices and run body on
+ * each chunk in parallel; returns once every chunk is done
+ * @param body called as body(chunk_begin, chunk_end)
+ * @param grain chunk size, 0 picks 4 chunks per thread
+ */
+void JobSystem::parallelFor(size_t begin, size_t end, const std::function<void(size_t, size_t)>& body,
+                            size_t grain){
+    if(end <= begin) return;
+    size_t count = end - begin;
+    if(grain == 0) grain = std::max<size_t>(1, count/(4*threadCount()));
+    if(count <= grain || threadCount() == 1){
+        body(begin, end);
+        return;
+    }
+    JobCounter counter;
+    //the first chunk is kept for the calling thread
+    for(size_t first = begin + grain; first < end; first += grain){
+        size_t last = std::min(end, first + grain);
+        submit([&body, first, last](){ body(first, last);}, counter);
+    }
+    body(begin, begin + grain);
+    wait(counter);
+}
+
+unsigned JobSystem::threadCount() const{
+    return (unsigned)workers.size() + 1;
+}
+
+int JobSystem::workerIndex(){
+    return worker_index;
+}
+
+void JobSystem::workerLoop(int index){
+    worker_index = index;
+    worker_pool = this;
+    while(true){
+        if(runOne(index)) continue;
+        std::unique_lock<std::mutex> guard(sleep_lock);
+        sleeping.fetch_add(1);
+        wake.wait(guard, [this](){ return stopping.load() || queued.load() > 0;});
+        sleeping.fetch_sub(1);
+        if(stopping && queued.load() == 0) return;
+    }
+}
+
+/**
+ * Run one job from the thread's own deque or stolen from another
+ * @return whether a job was run
+ */
+bool JobSystem::runOne(int index){
+    Job job;
+    if(!(index >= 0 && pop(index, job)) && !steal(index, job)) return false;
+    queued.fetch_sub(1);
+    job.work();
+    job.counter->pending.fetch_sub(1);
+    return true;
+}
+
+bool JobSystem::pop(int index, Job& job){
+    Queue& q = *queues[index];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if(q.jobs.empty()) return false;
+    job = std::move(q.jobs.back());
+    q.jobs.pop_back();
+    return true;
+}
+
+/**
+ * Take the oldest job of another deque, visiting victims starting after the thief
+ */
+bool JobSystem::steal(int thief, Job& job){
+    size_t n = queues.size();
+    size_t start = thief >= 0? (size_t)thief + 1: next_queue.load();
+    for(size_t k = 0; k < n; k++){
+        Queue& q = *queues[(start + k)%n];
+        if((int)((start + k)%n) == thief) continue;
+        std::lock_guard<std::mutex> guard(q.lock);
+        if(q.jobs.empty()) continue;
+        job = std::move(q.jobs.front());
+        q.jobs.pop_front();
+        return true;
+    }
+    return false;
+}
+
+// ==================== TaskGraph ====================
+
+TaskGraph::TaskGraph(){
+    system = nullptr;
+}
+
+/**
+ * Add a task to the graph
+ * @param name label of the task, used by tooling
+ * @param work the task body
+ * @return the id of the task, used to declare dependencies
+ */
+int TaskGraph::addTask(const std::string& name, std::function<void()> work){
+    Task* task = new Task();
+    task->name = name;
+    task->work = std::move(work);
+    task->dependencies = 0;
+    task->remaining = 0;
+    tasks.emplace_back(task);
+    return (int)tasks.size() - 1;
+}
+
+/**
+ * Declare that after may only start once before has finished
+ */
+void TaskGraph::addDependency(int before, int after){
+    if(before < 0 || after < 0 || before >= (int)tasks.size() || after >= (int)tasks.size() || before == after){
+        std::cout << "Warning: invalid task dependency " << before << " -> " << after << "\n";
+        return;
+    }
+    tasks[before]->successors.push_back(after);
+    tasks[after]->dependencies++;
+}
+
+/**
+ * Start every task without dependencies; the others are started by the
+ * last task they depend on
+ * @return false when the graph is still running or has a dependency cycle
+ */
+bool TaskGraph::launch(JobSystem& jobs){
+    if(!isDone()){
+        std::cout << "Warning: task graph launched while still running.\n";
+        return false;
+    }
+    if(hasCycle()){
+        std::cout << "Warning: task graph has a dependency cycle.\n";
+        return false;
+    }
+    system = &jobs;
+    for(auto& task: tasks) task->remaining = task->dependencies;
+    //hold the counter up while roots are being submitted
+    done.pending.fetch_add(1);
+    for(size_t t = 0; t < tasks.size(); t++){
+        if(tasks[t]->dependencies == 0) start((int)t);
+    }
+    done.pending.fetch_sub(1);
+    return true;
+}
+
+/**
+ * Submit a task whose dependencies are done. Successors are submitted before
+ * the task's own job finishes so the graph counter never reaches zero early.
+ */
+void TaskGraph::start(int task){
+    system->submit([this, task](){
+        Task& t = *tasks[task];
+        t.work();
+        for(int next: t.successors){
+            if(tasks[next]->remaining.fetch_sub(1) == 1) start(next);
+        }
+    }, done);
+}
+
+/**
+ * Run jobs until every task of the graph has finished
+ */
+void TaskGraph::wait(){
+    if(system) system->wait(done);
+}
+
+bool TaskGraph::run(JobSystem& jobs){
+    if(!launch(jobs)) return false;
+    wait();
+    return true;
+}
+
+bool TaskGraph::isDone() const{
+    return done.pending.load() == 0;
+}
+
+size_t TaskGraph::taskCount() const{
+    return tasks.size();
+}
+
+const std::string& TaskGraph::taskName(int task) const{
+    return tasks[task]->name;
+}
+
+/**
+ * Kahn's algorithm: the graph is acyclic when every task can be ordered
+ */
+bool TaskGraph::hasCycle() const{
+    std::vector<int> indegree(tasks.size());
+    std::vector<int> ready;
+    for(size_t t = 0; t < tasks.size(); t++){
+        indegree[t] = tasks[t]->dependencies;
+        if(indegree[t] == 0) ready.push_back((int)t);
+    }
+    size_t ordered = 0;
+    while(!ready.empty()){
+        int t = ready.back();
+        ready.pop_back();
+        ordered++;
+        for(int next: tasks[t]->successors){
+            if(--indegree[next] == 0) ready.push_back(next);
+        }
+    }
+    return ordered != tasks.size();
+}
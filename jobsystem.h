@@ -0,0 +1,102 @@
+#ifndef GRAPHICSENGINE3D_JOBSYSTEM_H
+#define GRAPHICSENGINE3D_JOBSYSTEM_H
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Number of submitted jobs that have not finished yet. Waiting on a counter
+ * runs other jobs in the meantime.
+ */
+struct JobCounter{
+    std::atomic<size_t> pending;
+    JobCounter(): pending(0){}
+};
+
+/**
+ * Work-stealing thread pool. Each worker owns a deque: it pushes and pops
+ * its own jobs at the back (newest first, still hot in cache) while idle
+ * workers steal the oldest jobs from the front of a victim's deque.
+ * Jobs submitted from outside the pool are spread over the worker deques.
+ * Threads waiting on a JobCounter execute jobs instead of blocking, so jobs
+ * may submit and wait for nested work.
+ */
+class JobSystem{
+public:
+    explicit JobSystem(unsigned threads = 0); //0 uses every hardware thread, the caller counts as one
+    ~JobSystem();
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void submit(std::function<void()> job, JobCounter& counter);
+    void wait(JobCounter& counter);
+    void parallelFor(size_t begin, size_t end, const std::function<void(size_t, size_t)>& body,
+                     size_t grain = 0);
+    unsigned threadCount() const; //workers plus the calling thread
+    static int workerIndex(); //index of the calling worker thread, -1 outside any pool
+private:
+    struct Job{
+        std::function<void()> work;
+        JobCounter* counter;
+    };
+    struct Queue{
+        std::mutex lock;
+        std::deque<Job> jobs;
+    };
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued;
+    std::atomic<unsigned> next_queue;
+    std::atomic<int> sleeping;
+    std::atomic<bool> stopping;
+    std::mutex sleep_lock;
+    std::condition_variable wake;
+
+    void workerLoop(int index);
+    bool runOne(int index);
+    bool pop(int index, Job& job);
+    bool steal(int thief, Job& job);
+};
+
+/**
+ * Graph of tasks with dependencies, launched on a JobSystem. A task starts as
+ * soon as every task it depends on has finished, so independent stages
+ * (e.g. culling of the next frame and post-processing of the current one)
+ * overlap. A graph can be launched again once it finished.
+ */
+class TaskGraph{
+public:
+    TaskGraph();
+    int addTask(const std::string& name, std::function<void()> work);
+    void addDependency(int before, int after);
+    bool launch(JobSystem& jobs); //returns immediately
+    void wait();
+    bool run(JobSystem& jobs); //launch and wait
+    bool isDone() const;
+    size_t taskCount() const;
+    const std::string& taskName(int task) const;
+private:
+    struct Task{
+        std::string name;
+        std::function<void()> work;
+        std::vector<int> successors;
+        int dependencies;
+        std::atomic<int> remaining;
+    };
+    std::vector<std::unique_ptr<Task>> tasks;
+    JobCounter done;
+    JobSystem* system;
+
+    void start(int task);
+    bool hasCycle() const;
+};
+
+#endif //GRAPHICSENGINE3D_JOBSYSTEM_H
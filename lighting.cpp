@@ -0,0 +1,246 @@
+#include "lighting.h"
+#include "arena.h"
+#include "profiler.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+//Implementation details of the clustered light assignment
+
+namespace {
+
+inline float dot3(const float a[3], const float b[3]){
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+inline uint32_t floatBits(float f){
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+/**
+ * Tile holding a view space x (or y) over depth ratio, clamped to the tiles
+ * @param ratio x/depth
+ * @param tan_half tangent of the half field of view along that axis
+ * @param pixels image size along that axis
+ * @param tile_size pixels per tile
+ * @param tiles tile count along that axis
+ * @param flip whether pixel rows run against the axis (y)
+ */
+inline int tileOf(float ratio, float tan_half, int pixels, int tile_size, int tiles, bool flip){
+    float ndc = ratio/tan_half;
+    float p = (flip? 1 - ndc: ndc + 1)*0.5f*pixels;
+    p = std::min(std::max(p, -1.0f), (float)pixels + 1);
+    return std::min(std::max((int)floorf(p/tile_size), 0), tiles - 1);
+}
+
+}
+
+LightClusters::LightClusters(){
+    tiles_x = 0;
+    tiles_y = 0;
+    for(int s = 0; s <= LIGHT_CLUSTER_SLICES; s++) slice_depths[s] = 1;
+    slice_base = floatBits(1);
+    slice_shift = 31;
+    memset(slice_table, 0, sizeof(slice_table));
+    offsets.assign(1, 0);
+}
+
+/**
+ * Assign the lights to the clusters of a camera's frustum
+ * @param jobs job system running the assignment
+ * @param camera the camera, its aspect should match width/height
+ * @param width image width in pixels
+ * @param height image height in pixels
+ * @param tile_size pixels per cluster side on screen
+ * @param points point lights
+ * @param spots spot lights, with a unit direction
+ */
+void LightClusters::build(JobSystem& jobs, const Camera& camera, int width, int height, int tile_size,
+                          const std::vector<PointLight>& points, const std::vector<SpotLight>& spots){
+    PROFILE_ZONE("LightClusters::build");
+    const float* eye = camera.getPosition();
+    const float* right = camera.getRight();
+    const float* up = camera.getUp();
+    const float* forward = camera.getForward();
+    float near_plane = camera.getNear();
+    float far_plane = camera.getFar();
+    for(int s = 0; s <= LIGHT_CLUSTER_SLICES; s++){
+        slice_depths[s] = near_plane*powf(far_plane/near_plane, (float)s/LIGHT_CLUSTER_SLICES);
+    }
+    //the bits of positive floats grow with their value, about linearly in their logarithm,
+    //so equal bit ranges cover about equal parts of every slice
+    slice_base = floatBits(slice_depths[0]);
+    slice_shift = 0;
+    while(((floatBits(far_plane) - slice_base) >> slice_shift) >= (uint32_t)LIGHT_SLICE_TABLE_SIZE) slice_shift++;
+    for(int i = 0, s = 0; i < LIGHT_SLICE_TABLE_SIZE; i++){
+        uint32_t bits = slice_base + ((uint32_t)i << slice_shift);
+        float depth;
+        memcpy(&depth, &bits, sizeof(depth));
+        while(s < LIGHT_CLUSTER_SLICES - 1 && depth >= slice_depths[s + 1]) s++;
+        slice_table[i] = (uint8_t)s;
+    }
+    float tan_y = tanf(0.5f*camera.getFov()), tan_x = tan_y*camera.getAspect();
+    tiles_x = std::max(1, (width + tile_size - 1)/tile_size);
+    tiles_y = std::max(1, (height + tile_size - 1)/tile_size);
+    tile_x_bounds.resize(tiles_x + 1);
+    tile_y_bounds.resize(tiles_y + 1);
+    for(int i = 0; i <= tiles_x; i++) tile_x_bounds[i] = (2.0f*std::min(i*tile_size, width)/width - 1)*tan_x;
+    for(int j = 0; j <= tiles_y; j++) tile_y_bounds[j] = (1 - 2.0f*std::min(j*tile_size, height)/height)*tan_y;
+
+    size_t point_count = points.size();
+    bounds.resize(point_count + spots.size());
+    jobs.parallelFor(0, bounds.size(), [&](size_t begin, size_t end){
+        for(size_t l = begin; l < end; l++){
+            LightBounds& b = bounds[l];
+            float center[3], radius;
+            if(l < point_count){
+                for(int c = 0; c < 3; c++) center[c] = points[l].position[c];
+                radius = points[l].radius;
+            }
+            else{
+                //narrow cones fit in the sphere through the apex and the rim of their cap
+                const SpotLight& spot = spots[l - point_count];
+                radius = spot.radius;
+                float shift = 0;
+                if(spot.outer_cos >= 0.5f){
+                    radius = spot.radius/(2*spot.outer_cos);
+                    shift = radius;
+                }
+                for(int c = 0; c < 3; c++) center[c] = spot.position[c] + shift*spot.direction[c];
+            }
+            float v[3] = {center[0] - eye[0], center[1] - eye[1], center[2] - eye[2]};
+            b.center[0] = dot3(v, right);
+            b.center[1] = dot3(v, up);
+            b.center[2] = dot3(v, forward);
+            b.radius = radius*1.001f; //slack for the rounding of the fragment positions
+            float d0 = b.center[2] - b.radius, d1 = b.center[2] + b.radius;
+            b.slice_min = 0;
+            b.slice_max = -1;
+            if(!(radius > 0) || d1 < near_plane || d0 > far_plane) continue;
+            b.slice_min = slice(d0);
+            b.slice_max = slice(d1);
+            if(d0 < near_plane){ //around or behind the camera, any tile
+                b.tile_min[0] = 0; b.tile_max[0] = tiles_x - 1;
+                b.tile_min[1] = 0; b.tile_max[1] = tiles_y - 1;
+                continue;
+            }
+            //x/depth over the sphere's view space box is extreme at its nearest or farthest depth
+            float left = b.center[0] - b.radius, right_x = b.center[0] + b.radius;
+            float bottom = b.center[1] - b.radius, top = b.center[1] + b.radius;
+            b.tile_min[0] = tileOf(left/(left < 0? d0: d1), tan_x, width, tile_size, tiles_x, false);
+            b.tile_max[0] = tileOf(right_x/(right_x > 0? d0: d1), tan_x, width, tile_size, tiles_x, false);
+            b.tile_min[1] = tileOf(top/(top > 0? d0: d1), tan_y, height, tile_size, tiles_y, true);
+            b.tile_max[1] = tileOf(bottom/(bottom < 0? d0: d1), tan_y, height, tile_size, tiles_y, true);
+        }
+    }, 256);
+
+    //count the entries of every cluster, then fill the lists at their prefix sum offsets
+    offsets.assign(clusterCount() + 1, 0);
+    jobs.parallelFor(0, LIGHT_CLUSTER_SLICES, [&](size_t begin, size_t end){
+        for(size_t s = begin; s < end; s++) assignSlice((int)s, false);
+    }, 1);
+    for(size_t c = 0; c + 1 < offsets.size(); c++) offsets[c + 1] += offsets[c];
+    indices.resize(offsets.back());
+    jobs.parallelFor(0, LIGHT_CLUSTER_SLICES, [&](size_t begin, size_t end){
+        for(size_t s = begin; s < end; s++) assignSlice((int)s, true);
+    }, 1);
+    PROFILE_COUNTER("Light cluster entries", indices.size());
+}
+
+/**
+ * Walk the clusters of one slice touched by every light's bounding sphere
+ * @param fill false to count the entries of every cluster into offsets[cluster + 1],
+ *             true to write them at offsets[cluster]
+ */
+void LightClusters::assignSlice(int s, bool fill){
+    float d0 = slice_depths[s], d1 = slice_depths[s + 1];
+    size_t base = (size_t)s*tiles_x*tiles_y;
+    uint32_t* cursor = nullptr; //frame temporary of the job thread, released by FrameArena::resetAll()
+    if(fill){
+        cursor = FrameArena::forThread().allocateArray<uint32_t>((size_t)tiles_x*tiles_y);
+        std::copy(offsets.begin() + base, offsets.begin() + base + (size_t)tiles_x*tiles_y, cursor);
+    }
+    for(size_t l = 0; l < bounds.size(); l++){
+        const LightBounds& b = bounds[l];
+        if(s < b.slice_min || s > b.slice_max) continue;
+        float r2 = b.radius*b.radius;
+        float dz = std::max(0.0f, std::max(d0 - b.center[2], b.center[2] - d1));
+        for(int ty = b.tile_min[1]; ty <= b.tile_max[1]; ty++){
+            //view space box of the cluster: the frustum piece spans its ratios at both depths
+            float top = tile_y_bounds[ty], bottom = tile_y_bounds[ty + 1];
+            float y0 = std::min(bottom*d0, bottom*d1), y1 = std::max(top*d0, top*d1);
+            float dy = std::max(0.0f, std::max(y0 - b.center[1], b.center[1] - y1));
+            if(dy*dy + dz*dz > r2) continue;
+            for(int tx = b.tile_min[0]; tx <= b.tile_max[0]; tx++){
+                float left = tile_x_bounds[tx], right_x = tile_x_bounds[tx + 1];
+                float x0 = std::min(left*d0, left*d1), x1 = std::max(right_x*d0, right_x*d1);
+                float dx = std::max(0.0f, std::max(x0 - b.center[0], b.center[0] - x1));
+                if(dx*dx + dy*dy + dz*dz > r2) continue;
+                size_t tile = (size_t)ty*tiles_x + tx;
+                if(fill) indices[cursor[tile]++] = (uint32_t)l;
+                else offsets[base + tile + 1]++;
+            }
+        }
+    }
+}
+
+/**
+ * Depth slice of a view depth, clamped to the slices. The bucket of the depth's
+ * bits gives the slice of its smallest depth, then the slice bounds past it are
+ * stepped over: cheaper than a logarithm, and exactly the bounds lights are assigned with.
+ */
+int LightClusters::slice(float depth) const{
+    if(!(depth > slice_depths[0])) return 0;
+    uint32_t bucket = (floatBits(depth) - slice_base) >> slice_shift;
+    if(bucket >= (uint32_t)LIGHT_SLICE_TABLE_SIZE) return LIGHT_CLUSTER_SLICES - 1;
+    int s = slice_table[bucket];
+    while(s < LIGHT_CLUSTER_SLICES - 1 && depth >= slice_depths[s + 1]) s++;
+    return s;
+}
+
+int LightClusters::cluster(int tile_x, int tile_y, int s) const{
+    return (s*tiles_y + tile_y)*tiles_x + tile_x;
+}
+
+/**
+ * @param cluster cluster index, see cluster()
+ * @param count set to the number of lights of the cluster
+ * @return the light indices of the cluster, in increasing order
+ */
+const uint32_t* LightClusters::clusterLights(int cluster, uint32_t& count) const{
+    count = offsets[cluster + 1] - offsets[cluster];
+    return indices.data() + offsets[cluster];
+}
+
+/**
+ * Light list shared by every slice of a screen tile, common with few lights or large ones
+ * @param count set to the number of lights of the list
+ * @return the light indices, nullptr when the slices list different lights
+ */
+const uint32_t* LightClusters::columnLights(int tile_x, int tile_y, uint32_t& count) const{
+    const uint32_t* list = clusterLights(cluster(tile_x, tile_y, 0), count);
+    for(int s = 1; s < LIGHT_CLUSTER_SLICES; s++){
+        uint32_t n;
+        const uint32_t* other = clusterLights(cluster(tile_x, tile_y, s), n);
+        if(n != count || !std::equal(list, list + n, other)) return nullptr;
+    }
+    return list;
+}
+
+int LightClusters::tilesX() const{
+    return tiles_x;
+}
+
+int LightClusters::tilesY() const{
+    return tiles_y;
+}
+
+size_t LightClusters::clusterCount() const{
+    return (size_t)tiles_x*tiles_y*LIGHT_CLUSTER_SLICES;
+}
+
+size_t LightClusters::assignmentCount() const{
+    return indices.size();
+}
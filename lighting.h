@@ -0,0 +1,93 @@
+#ifndef GRAPHICSENGINE3D_LIGHTING_H
+#define GRAPHICSENGINE3D_LIGHTING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "camera.h"
+#include "jobsystem.h"
+
+const int LIGHT_CLUSTER_SLICES = 24; //depth slices of the view frustum, spaced exponentially
+const int LIGHT_SLICE_TABLE_SIZE = 1024; //buckets of the depth to slice lookup
+
+/**
+ * Point light with a finite range, linear RGB intensity
+ */
+struct PointLight{
+    float position[3];
+    float color[3];
+    float radius; //no light reaches past this distance
+};
+
+/**
+ * Point light restricted to a cone, fading from the inner cone to the outer one
+ */
+struct SpotLight{
+    float position[3];
+    float direction[3]; //axis of the cone, away from the light
+    float color[3];
+    float radius;
+    float inner_cos; //cosine of the half angle lit at full intensity
+    float outer_cos; //cosine of the half angle past which nothing is lit
+};
+
+/**
+ * Light from infinitely far away, lighting the whole scene
+ */
+struct DirectionalLight{
+    float direction[3]; //direction the light travels in
+    float color[3];
+};
+
+/**
+ * Light lists of the clusters of a view frustum, for forward shading of scenes
+ * with many lights. The screen is split into square tiles and the view depth
+ * into LIGHT_CLUSTER_SLICES slices, exponentially spaced from the near plane
+ * to the far plane, so clusters keep about the same proportions at any depth.
+ * Every point and spot light is listed in the clusters its bounding sphere
+ * touches. Slices are filled in parallel, and the lists keep the light order,
+ * so shading does not depend on the thread count.
+ * Light indices of a list are point lights first, then spot lights offset by
+ * the point light count.
+ * build() allocates from FrameArena::forThread() on the job threads; the
+ * memory comes back when the owner of the frame calls FrameArena::resetAll().
+ */
+class LightClusters{
+public:
+    LightClusters();
+    void build(JobSystem& jobs, const Camera& camera, int width, int height, int tile_size,
+               const std::vector<PointLight>& points, const std::vector<SpotLight>& spots);
+    int slice(float depth) const; //depth along the camera's forward axis, the w of clip space
+    int cluster(int tile_x, int tile_y, int slice) const;
+    const uint32_t* clusterLights(int cluster, uint32_t& count) const;
+    const uint32_t* columnLights(int tile_x, int tile_y, uint32_t& count) const;
+
+    int tilesX() const;
+    int tilesY() const;
+    size_t clusterCount() const;
+    size_t assignmentCount() const; //list entries over every cluster
+private:
+    struct LightBounds{
+        float center[3]; //view space: right, up, depth along the forward axis
+        float radius;
+        int tile_min[2];
+        int tile_max[2];
+        int slice_min;
+        int slice_max; //below slice_min for lights out of the frustum
+    };
+    int tiles_x;
+    int tiles_y;
+    std::vector<float> tile_x_bounds; //tiles_x + 1 view space x over depth, left to right
+    std::vector<float> tile_y_bounds; //tiles_y + 1 view space y over depth, top to bottom
+    float slice_depths[LIGHT_CLUSTER_SLICES + 1];
+    uint32_t slice_base; //bits of the near plane depth
+    int slice_shift; //bits of a depth past slice_base to a bucket of slice_table
+    uint8_t slice_table[LIGHT_SLICE_TABLE_SIZE]; //slice of the smallest depth of every bucket
+    std::vector<LightBounds> bounds;
+    std::vector<uint32_t> offsets; //first entry of every cluster, then the entry count
+    std::vector<uint32_t> indices;
+
+    void assignSlice(int slice, bool fill);
+};
+
+#endif //GRAPHICSENGINE3D_LIGHTING_H
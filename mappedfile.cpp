@@ -0,0 +1,150 @@
+#include "mappedfile.h"
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include <sys/stat.h>
+
+//Implementation details of read-only file mappings
+
+MappedFile::MappedFile(){
+    bytes = nullptr;
+    length = 0;
+#ifdef _WIN32
+    file_handle = INVALID_HANDLE_VALUE;
+    mapping_handle = nullptr;
+#else
+    fd = -1;
+#endif
+}
+
+MappedFile::~MappedFile(){
+    close();
+}
+
+/**
+ * Map a file for reading, closing any previous mapping first.
+ * Empty files open successfully with a null data() pointer.
+ * @param path the file to map
+ * @return whether the file could be mapped
+ */
+bool MappedFile::open(const std::string& path){
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE){
+        std::cout << "Warning: could not open file " << path << "\n";
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    file_handle = file;
+    if(!GetFileSizeEx(file, &file_size)){
+        std::cout << "Warning: could not read the size of file " << path << "\n";
+        close();
+        return false;
+    }
+    length = (size_t)file_size.QuadPart;
+    if(length == 0) return true;
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(mapping == nullptr){
+        std::cout << "Warning: could not map file " << path << "\n";
+        close();
+        return false;
+    }
+    mapping_handle = mapping;
+    bytes = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0){
+        std::cout << "Warning: could not open file " << path << "\n";
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0){
+        std::cout << "Warning: could not read the size of file " << path << "\n";
+        close();
+        return false;
+    }
+    length = (size_t)st.st_size;
+    if(length == 0) return true;
+    void* map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(map != MAP_FAILED){
+        bytes = (const char*)map;
+        madvise(map, length, MADV_SEQUENTIAL);
+    }
+#endif
+    if(bytes == nullptr){
+        std::cout << "Warning: could not map file " << path << "\n";
+        close();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Release the mapping and the file handle
+ */
+void MappedFile::close(){
+#ifdef _WIN32
+    if(bytes) UnmapViewOfFile(bytes);
+    if(mapping_handle) CloseHandle((HANDLE)mapping_handle);
+    if(file_handle != INVALID_HANDLE_VALUE) CloseHandle((HANDLE)file_handle);
+    mapping_handle = nullptr;
+    file_handle = INVALID_HANDLE_VALUE;
+#else
+    if(bytes) munmap((void*)bytes, length);
+    if(fd >= 0) ::close(fd);
+    fd = -1;
+#endif
+    bytes = nullptr;
+    length = 0;
+}
+
+bool MappedFile::isOpen() const{
+#ifdef _WIN32
+    return file_handle != INVALID_HANDLE_VALUE;
+#else
+    return fd >= 0;
+#endif
+}
+
+const char* MappedFile::data() const{
+    return bytes;
+}
+
+size_t MappedFile::size() const{
+    return length;
+}
+
+/**
+ * Size and last modification time of a file, used to detect changed assets
+ * @param path the file to query
+ * @param size filled with the size in bytes
+ * @param mtime filled with the modification time in nanoseconds since the
+ * epoch, so that two writes within one second differ (whole seconds on Windows)
+ * @return whether the file exists
+ */
+bool statFile(const std::string& path, uint64_t& size, int64_t& mtime){
+#ifdef _WIN32
+    struct __stat64 st; //plain stat has a 32 bit size on Windows
+    if(_stat64(path.c_str(), &st) != 0) return false;
+#else
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0) return false;
+#endif
+    size = (uint64_t)st.st_size;
+#if defined(_WIN32)
+    mtime = (int64_t)st.st_mtime*1000000000;
+#elif defined(__APPLE__)
+    mtime = (int64_t)st.st_mtimespec.tv_sec*1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    mtime = (int64_t)st.st_mtim.tv_sec*1000000000 + st.st_mtim.tv_nsec;
+#endif
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef GRAPHICSENGINE3D_MAPPEDFILE_H
+#define GRAPHICSENGINE3D_MAPPEDFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/**
+ * Read-only memory mapping of a whole file.
+ * The pages are loaded on demand by the OS, so large assets can be parsed
+ * in place without reading them into a buffer first.
+ * The mapping is released when the object is destroyed or close() is called.
+ */
+class MappedFile{
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const;
+    const char* data() const;
+    size_t size() const;
+private:
+    const char* bytes;
+    size_t length;
+#ifdef _WIN32
+    void* file_handle;
+    void* mapping_handle;
+#else
+    int fd;
+#endif
+};
+
+bool statFile(const std::string& path, uint64_t& size, int64_t& mtime); //size and modification time in ns
+
+#endif //GRAPHICSENGINE3D_MAPPEDFILE_H
@@ -1,8 +1,58 @@
 #include "matrix.h"
+#include "profiler.h"
 #include <iostream>
 #include <stddef.h>
 #include <math.h>
 
+//Implementation details of float square matrices 'Matrixf<N>' and general matrices.
+
+namespace {
+
+/**
+ * Determinant by cofactor (Laplace) expansion along the first column.
+ * @param m the n*n elements of the matrix, column-major
+ * @param n dimension of the matrix
+ * @return determinant of m
+ */
+float laplaceDet(const std::vector<float>& m, size_t n){
+    if(n == 1) return m[0];
+    if(n == 2) return m[0]*m[3] - m[2]*m[1];
+    float det = 0;
+    std::vector<float> minor((n - 1)*(n - 1));
+    for(size_t r = 0; r < n; r++){
+        size_t k = 0;
+        for(size_t c = 1; c < n; c++){
+            for(size_t i = 0; i < n; i++){
+                if(i != r) minor[k++] = m[c*n + i];
+            }
+        }
+        float sign = r%2 == 0 ? 1.0f : -1.0f;
+        det += sign*m[r]*laplaceDet(minor, n - 1);
+    }
+    return det;
+}
+
+/**
+ * Minor of a matrix with one row and one column removed
+ * @param m the n*n elements of the matrix, column-major
+ * @param n dimension of the matrix
+ * @param row removed row
+ * @param col removed column
+ * @return the (n-1)*(n-1) elements of the minor, column-major
+ */
+std::vector<float> minorOf(const std::vector<float>& m, size_t n, size_t row, size_t col){
+    std::vector<float> minor;
+    for(size_t c = 0; c < n; c++){
+        if(c == col) continue;
+        for(size_t r = 0; r < n; r++){
+            if(r != row) minor.push_back(m[c*n + r]);
+        }
+    }
+    return minor;
+}
+
+}
+
 //================= Matrixf:  Float square Matrix methods =======================
 /**
  * Default Square matrix initializer. Initializes a matrix to the identity.
@@ -11,8 +61,8 @@
 template<size_t N>
 Matrixf<N>::Matrixf() {
     size = N;
-    for(int i = 0; i < N; i++){
-        for(int j = 0; j < N; j++){
+    for(size_t i = 0; i < N; i++){
+        for(size_t j = 0; j < N; j++){
             if(i == j) {elems.push_back(1.0);}
             else {elems.push_back(0.0);}
         }
@@ -33,14 +83,11 @@ Matrixf<N>::Matrixf(std::initializer_list<float> elements) {
     size = N;
 
     for(auto &el: elements){
-        elems.push_back(el);
         if(elems.size() >= N*N){break;} //truncate additional elements
+        elems.push_back(el);
     }
     // pad with zeroes as necessary
-    for(int i = 0; i < elems.size() - N*N; i++){
-        elems.push_back(0);
-    };
-
+    elems.resize(N*N, 0.0);
 }
 
 /**
@@ -54,22 +101,20 @@ template<size_t N>
 Matrixf<N>::Matrixf(std::initializer_list<std::initializer_list<float>> elements) {
     size = N;
     for(auto el_list: elements){
+        if(elems.size() == N*N) break; // truncate extra columns
+        size_t count = 0;
         for(auto el: el_list){
+            if(count == N){break;} //truncate extra elements
             elems.push_back(el);
-            if(elems.size()%N == 0){break;} //truncate extra elements
+            count++;
         }
         //pad with zeroes as necessary
-        if(elems.size()%N != 0){
-            for(int i = 0; i < N - elems.size()%N; i++){
-                elems.push_back(0);
-            }
+        for(; count < N; count++){
+            elems.push_back(0);
         }
-        if(elems.size() == N*N) break; // truncate extra columns
     }
     //pads with zeroes if not enough columns are specified
-    for(int i = 0; i < N*N - elems.size(); i++){
-        elems.push_back(0.0);
-    }
+    elems.resize(N*N, 0.0);
 };
 
 /**
@@ -81,9 +126,7 @@ Matrixf<N>::Matrixf(std::initializer_list<std::initializer_list<float>> elements
 template<size_t N>
 Matrixf<N>::Matrixf(std::string &special_matrix){
     size = N;
-    for(int i = 0 ; i < N; i++){
-        elems.push_back(0.0);
-    }
+    elems.assign(N*N, 0.0);
     if(special_matrix == "i") elems[0] = 1.0;
     if(special_matrix == "j" && N>= 2) elems[N+1] = 1.0;
     if(special_matrix == "k" && N>=3 ) elems[2*N+2] = 1.0;
@@ -94,15 +137,16 @@ Matrixf<N>::Matrixf(std::string &special_matrix){
  * Returns a std::vector containing the row with given index
  * @tparam N size
  * @param index index(0-indexed) of the row we want
- * @return a copy of the matrix row at given index
+ * @return a copy of the matrix row at given index, empty if the index is invalid
  */
 template<size_t N>
 std::vector<float> Matrixf<N>::row(int index) {
-    if(index < 0 || index >= N){
-        std::cout << "Warning: Invalid row accessed";
-    }
     std::vector<float> row;
-    for(int i = 0; i < N; i++){
+    if(index < 0 || index >= (int)N){
+        std::cout << "Warning: Invalid row accessed\n";
+        return row;
+    }
+    for(size_t i = 0; i < N; i++){
         row.push_back(elems[i*N+index]);
     }
     return row;
@@ -112,17 +156,28 @@ std::vector<float> Matrixf<N>::row(int index) {
  * Returns a std::vector containing the column with given index
  * @tparam N size
  * @param index index(0-indexed) of the column we want
- * @return a copy of the matrix column at given index
+ * @return a copy of the matrix column at given index, empty if the index is invalid
  */
 template<size_t N>
 std::vector<float> Matrixf<N>::col(int index) {
-    if(index < 0 || index >= N){
-        std::cout<<"Warning: Invalid column accessed";
+    if(index < 0 || index >= (int)N){
+        std::cout<<"Warning: Invalid column accessed\n";
+        return std::vector<float>();
     }
-    std::vector<float> col = std::vector<float>(elems.begin()+N*index, elems.begin()+(N+1)*index);
+    std::vector<float> col = std::vector<float>(elems.begin()+N*index, elems.begin()+N*(index+1));
     return col;
 }
 
+/**
+ * The elements of the matrix, by columns: m[N*col + row]
+ * @tparam N size
+ * @return pointer to the N*N elements, valid while the matrix is
+ */
+template<size_t N>
+const float* Matrixf<N>::data() const {
+    return elems.data();
+}
+
 /**
  * Standard matrix algebra addition
  * @tparam N Dimension of square matrix
@@ -131,11 +186,10 @@ std::vector<float> Matrixf<N>::col(int index) {
  */
 template<size_t N>
 Matrixf<N> Matrixf<N>::operator+(Matrixf<N> M) const {
-    std::vector<float> new_elems;
-    for(int i = 0; i < N*N; i++){
-        new_elems.push_back(elems[i] + M.elems[i]);
+    Matrixf<N> add_matrix = M;
+    for(size_t i = 0; i < N*N; i++){
+        add_matrix.elems[i] = elems[i] + M.elems[i];
     }
-    Matrixf<N> add_matrix = {new_elems};
     return add_matrix;
 }
 
@@ -147,11 +201,10 @@ Matrixf<N> Matrixf<N>::operator+(Matrixf<N> M) const {
  */
 template<size_t N>
 Matrixf<N> Matrixf<N>::operator-(Matrixf<N> M) const {
-    std::vector<float> new_elems;
-    for(int i = 0; i < N*N; i++){
-        new_elems.push_back(elems[i] - M.elems[i]);
+    Matrixf<N> sub_matrix = M;
+    for(size_t i = 0; i < N*N; i++){
+        sub_matrix.elems[i] = elems[i] - M.elems[i];
     }
-    Matrixf<N> sub_matrix = {new_elems};
     return sub_matrix;
 }
 
@@ -165,53 +218,73 @@ Matrixf<N> Matrixf<N>::operator-(Matrixf<N> M) const {
  */
 template<size_t N>
 Matrixf<N> operator*(float c, Matrixf<N> M) {
-    std::vector<float> new_elems;
-    for(int i = 0; i < N*N; i++){
-        new_elems.push_back(c*M.elems[i]);
+    for(size_t i = 0; i < N*N; i++){
+        M.elems[i] *= c;
     }
-    Matrixf<N> scal_matrix = {new_elems};
-    return scal_matrix;
+    return M;
 }
 
 /**
  * Standard matrix algebra multiplication.
- * Elements are added by column to construct matrices, so matrix multiplication
- * algorithm multiplies by rows then cols, instead of the (standard other way around)
+ * Elements are stored by column, so the product is built column by column:
+ * (MK)(row, col) = sum over k of M(row, k)*K(k, col).
  * @tparam N dimension of the square matrix
- * @param M the matrix to multiply with
+ * @param M the left matrix
+ * @param K the right matrix
  * @return Square Matrix obtained from matrix multiplication
  */
 template<size_t N>
 Matrixf<N> operator*(Matrixf<N> M, Matrixf<N> K) {
-    std::vector<float> new_elems;
-    for(int i = 0; i < N; i ++){
-        for(int j = 0; j < N; j++){
-
-            new_elems.push_back(M.dotProduct(M.get_row(j), K.get_col(i)));
+    PROFILE_ZONE("Matrixf::multiply");
+    Matrixf<N> m_matrix;
+    for(size_t col = 0; col < N; col++){
+        for(size_t row = 0; row < N; row++){
+            float sum = 0;
+            for(size_t k = 0; k < N; k++) sum += M.elems[k*N + row]*K.elems[col*N + k];
+            m_matrix.elems[col*N + row] = sum;
         }
     }
-    Matrixf<N> m_matrix = {new_elems};
     return m_matrix;
 }
 
+/**
+ * Matrix vector product T*V, V being a column vector
+ * @tparam N dimension
+ * @param T the transformation matrix
+ * @param V the vector to transform
+ * @return the transformed vector, collision parameter preserved
+ */
 template<size_t N>
 Vectorf<N> operator*(Matrixf<N> T, Vectorf<N> V){
-    float new_pos[N];
-    for(int i = 0; i < N; i++){
-        Vectorf<N> Ti{T.row(i)};
-        new_pos[i] = Ti*V;
+    Vectorf<N> product = V;
+    float* in = V.get();
+    float* out = product.get();
+    for(size_t row = 0; row < N; row++){
+        float sum = 0;
+        for(size_t k = 0; k < N; k++) sum += T.elems[k*N + row]*in[k];
+        out[row] = sum;
     }
-    return Vectorf<N>{*new_pos};
+    return product;
 }
 
+/**
+ * Vector matrix product V*M, V being a row vector
+ * @tparam N dimension
+ * @param V the row vector
+ * @param M the matrix
+ * @return the vector of dot products of V with the columns of M, collision parameter preserved
+ */
 template<size_t N>
 Vectorf<N> operator*(Vectorf<N> V, Matrixf<N> M){
-    float new_pos[N];
-    for(int i = 0; i < N; i++){
-        Vectorf<N> Mi{M.col(i)};
-        new_pos[i] = V*Mi;
+    Vectorf<N> product = V;
+    float* in = V.get();
+    float* out = product.get();
+    for(size_t col = 0; col < N; col++){
+        float sum = 0;
+        for(size_t k = 0; k < N; k++) sum += in[k]*M.elems[col*N + k];
+        out[col] = sum;
     }
-    return Vectorf<N>{*new_pos};
+    return product;
 }
 
 
@@ -230,10 +303,11 @@ Matrixf<N> Matrixf<N>::operator^(int power) {
         return Matrixf<N>(); //the identity matrix of dim N
      }
 
-     Matrixf<N> new_matrix = this;
-     if(power < 0) new_matrix = this->invert();
+     Matrixf<N> base = *this;
+     if(power < 0) base = this->invert();
 
-     for(int i = 1; i < abs(power); i++){new_matrix = new_matrix*new_matrix;}
+     Matrixf<N> new_matrix = base;
+     for(int i = 1; i < abs(power); i++){new_matrix = new_matrix*base;}
      return new_matrix;
 
 }
@@ -248,10 +322,10 @@ Matrixf<N> Matrixf<N>::operator^(int power) {
 template<size_t N>
 float Matrixf<N>::dotProduct(const std::vector<float> row, const std::vector<float> col) {
     if(row.size() != col.size()){
-        std::cout << "Warning--Mismatched size: vector arguments for dotProduct";
+        std::cout << "Warning--Mismatched size: vector arguments for dotProduct\n";
     }
     float res = 0;
-    for(int i = 0; i < row.size(); i++){
+    for(size_t i = 0; i < row.size() && i < col.size(); i++){
         res += row[i]*col[i];
     }
     return res;
@@ -264,68 +338,22 @@ float Matrixf<N>::dotProduct(const std::vector<float> row, const std::vector<flo
  */
 template<size_t N>
 Matrixf<N> Matrixf<N>::invert() {
-    float res_det = this->det();
-    if(res_det == 0) return this; //non-invertible, return self
-    float adjoint[N][N] = adj(this);
-
-    std::vector<float> inv_elems;
-    for(int col = 0; col < N; col++){
-        for(int row = 0; row < N; row++){
-            inv_elems.push_back(adjoint[row][col]/res_det);
-        }
-    }
-    return Matrixf<N>{inv_elems};
-
+    PROFILE_ZONE("Matrixf::invert");
+    float res_det = det(*this);
+    if(res_det == 0) return *this; //non-invertible, return self
+    return (1/res_det)*adj(*this);
 }
 
 /**
- * The determinant of a square matrix.
- * Converts Matrixf object to 2D array to be called by helper methods.
+ * The determinant of a square matrix, by cofactor expansion.
  * @tparam N Dimension of the square matrix
  * @param M The matrix whose determinant we want to find.
  * @return determinant of matrix M
  */
 template<size_t N>
 float det(Matrixf<N> M) {
-    float submatrix[N][N];
-    //constructing reusable 2-D float array
-    for(int row = 0; row < N; row++){
-        for(int col = 0; col < N; col++){
-            submatrix[row][col] = M[row][col];
-        }
-    }
-    return M.det(submatrix, M.size);
-}
-
-/**
- * Determinant helper function, uses 2D array of floats to compute
- * cofactors & determinants
- * @tparam N dimension of the square matrix
- * @param M the 2D array representing the matrix M
- * @param cur_size dimension of submatrix when recursively calculating det
- * @return determinant of M
- */
-template<size_t N>
-float det(float matrix[N][N], size_t cur_size) {
-    float det = 0;
-    float submatrix[N][N];
-    if(cur_size == 1) return matrix[0][0]; // should only happen if N = 1 from the start
-    if(cur_size == 2) return matrix[0][0]*matrix[1][1] - matrix[0][1]*matrix[1][0];
-    else{
-        for(int x = 0; x < cur_size; x++){
-            int subi = 0;
-            for(int i = 0; i < cur_size; i++){
-                int subj = 0;
-                for(int j = 0; j < cur_size; j++){
-                    if(j == x) continue;
-                    submatrix[subi][subj] = matrix[i][j];
-                    subj++;
-                }
-            }
-            det = det + (pow(-1,x))*matrix[0][x]* det(submatrix, cur_size-1);
-        }
-    }
-    return det;
+    PROFILE_ZONE("Matrixf::det");
+    return laplaceDet(M.elems, N);
 }
 
 /**
@@ -341,94 +369,61 @@ std::vector<float> Matrixf<N>::operator[](int index) {
 
 
 /**
- * Public method for determining the adjoint of a matrix.
- * Returns a 2D array representing the matrix, for use in invert()
- * matrixf method.
+ * The adjugate (classical adjoint) of a matrix, the transpose of its cofactor matrix,
+ * for use in the invert() matrixf method.
  * @tparam N dimension of the square matrix
- * @param M the matrix whose adjoint we want to find
+ * @param M the matrix whose adjugate we want to find
+ * @return the adjugate matrix
  */
 template<size_t N>
-void adj(Matrixf<N> M){
-    float submatrix[N][N];
-    //constructing reusable 2-D float array
-    for(int row = 0; row < N; row++){
-        for(int col = 0; col < N; col++){
-            submatrix[row][col] = M[row][col];
+Matrixf<N> adj(Matrixf<N> M){
+    Matrixf<N> ADJ;
+    if(N == 1) return ADJ; // the 1x1 identity
+    for(size_t row = 0; row < N; row++){
+        for(size_t col = 0; col < N; col++){
+            float s = (row + col)%2 == 0 ? 1.0f : -1.0f;
+            // cofactor (row, col) lands at (col, row)
+            ADJ.elems[row*N + col] = s*laplaceDet(minorOf(M.elems, N, row, col), N - 1);
         }
     }
-    float adj[N][N];
-    adj(submatrix, adj); // copy adjoint matrix to 2d array data
-    return adj;
-
+    return ADJ;
 }
 
 
-/**
- * Adjoint helper functiion that takes 2D array representation
- * of a matrixf object. Copies adjoint matrix entries to a 2D array.
- * @tparam N dimension of the square matrix
- * @param matrix the matrix whose adjoint we want to find
- * @param ADJ 2D array whose memory is allocated for use to copy adjoint data into
- */
-template<size_t N>
-void adj(float matrix[N][N], float ADJ[N][N]) {
-    if(N == 1) {ADJ[0][0] = 1; return;}
-    int s = 1;
-    float t[N][N];
-    for(int i = 0; i < N; i++){
-        for(int j = 0; j < N; j++){
-            getCofactor(matrix,t,i,j,N);
-            s = (i+j)%2 == 0? 1: -1;
-            ADJ[j][i] = s* det(t, N-1);
-        }
-    }
-}
-
-/**
- * Helper function to calculate the cofactor of a given entry of a matrix.
- * @tparam N dimension of the square matrix
- * @param matrix the2d array representation of a matrix
- *          whose cofactor entries we want to find
- * @param temp 2d array used to store cofactor calculations
- * @param p index to row we just removed in cofactor expansion
- * @param q index to col we just removed in cofactor expansion
- * @param n submatrix size at given iteration
- */
-template<size_t N>
-void getCofactor(float matrix[N][N], float temp[N][N], int p, int q, int n){
-    int i =0; int j = 0;
-    for(int r = 0; r < n; r++){
-        for(int c = 0; c <n; c++){
-            if(r!= p && c!=q){
-                temp[i][j++] = matrix[r][c];
-                if(j == n-1){
-                    j = 0; i++;
-                }
-            }
-        }
-    }
-}
-
-
-
 /**
  * Vector product of vectors resulting in square matrix.
  * @tparam N dimension of the vectors
  * @param A col vector
  * @param B row vector
- * @return matrix from col-row vector product
+ * @return matrix from col-row vector product, (A B^T)(row, col) = A[row]*B[col]
  */
 template<size_t N>
 Matrixf<N> Matrixf<N>::mProduct(Vectorf<N> A, Vectorf<N> B){
-    float new_elems[N*N];
-    for(int i = 0; i < N; i++){
-        for(int j = 0; j < N; j++){
-            new_elems[i*N+j] = A.pos[j]*B.pos[i];
+    Matrixf<N> product;
+    float* a = A.get();
+    float* b = B.get();
+    for(size_t col = 0; col < N; col++){
+        for(size_t row = 0; row < N; row++){
+            product.elems[col*N + row] = a[row]*b[col];
         }
     }
-    return Matrixf<N>{*new_elems};
+    return product;
 }
 
+#define GRAPHICSENGINE3D_MATRIXF(n) \
+template class Matrixf<n>; \
+template Matrixf<n> operator*(float c, Matrixf<n> M); \
+template Matrixf<n> operator*(Matrixf<n> M, Matrixf<n> K); \
+template Vectorf<n> operator*(Matrixf<n> T, Vectorf<n> V); \
+template Vectorf<n> operator*(Vectorf<n> V, Matrixf<n> M); \
+template float det(Matrixf<n> M); \
+template Matrixf<n> adj(Matrixf<n> M);
+GRAPHICSENGINE3D_MATRIXF(1)
+GRAPHICSENGINE3D_MATRIXF(2)
+GRAPHICSENGINE3D_MATRIXF(3)
+GRAPHICSENGINE3D_MATRIXF(4)
+#undef GRAPHICSENGINE3D_MATRIXF
+
 
 //================NMatrixf: Float nxm general Matrix methods=====================
 
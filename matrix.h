@@ -1,3 +1,6 @@
+#ifndef GRAPHICSENGINE3D_MATRIX_H
+#define GRAPHICSENGINE3D_MATRIX_H
+
 #include <stddef.h>
 #include <vector>
 #include "vector.h"
@@ -7,6 +10,7 @@
 /***
  * Square Matrix object that only stores floats
  * Used to speed up computations
+ * Elements are stored by columns, definitions live in matrix.cpp, instantiated for N = 1 to 4.
  * @tparam N dimension of the square matrix
  */
 template<size_t N>
@@ -37,15 +41,13 @@ public:
     friend float det(Matrixf<n> M);
 
     template<size_t n>
-    friend float* adj(Matrixf<n> M);
+    friend Matrixf<n> adj(Matrixf<n> M);
     static Matrixf<N> mProduct(Vectorf<N> A, Vectorf<N> B);
+    const float* data() const; //N*N elements, column-major: m[N*col + row]
 private:
     friend class Vectorf<N>;
     size_t size;
     std::vector<float> elems;
-    friend float det(float matrix[N][N], size_t cur_size);
-    friend void adj(float matrix[N][N], float ADJ[N][N]);
-    friend void getCofactor(float matrix[N][N], float temp[N][N], int p, int q, int n);
 };
 
 
@@ -92,3 +94,4 @@ private:
 //    template<typename U> Matrix(const Matrix_ref<U,N>&);
 };
 
+#endif //GRAPHICSENGINE3D_MATRIX_H
@@ -0,0 +1,54 @@
+#include "mesh.h"
+#include <cfloat>
+
+//Implementation details of the structure of arrays triangle mesh
+
+size_t Mesh::vertexCount() const{
+    return px.size();
+}
+
+size_t Mesh::triangleCount() const{
+    return indices.size()/3;
+}
+
+bool Mesh::hasNormals() const{
+    return !nx.empty() && nx.size() == px.size();
+}
+
+/**
+ * Resize every vertex stream at once so the streams never disagree in length
+ * @param count number of vertices
+ * @param normals whether the normal streams are kept, they are emptied otherwise
+ */
+void Mesh::resizeVertices(size_t count, bool normals){
+    px.resize(count); py.resize(count); pz.resize(count);
+    size_t ncount = normals? count: 0;
+    nx.resize(ncount); ny.resize(ncount); nz.resize(ncount);
+}
+
+/**
+ * Release every stream
+ */
+void Mesh::clear(){
+    px.clear(); py.clear(); pz.clear();
+    nx.clear(); ny.clear(); nz.clear();
+    indices.clear();
+}
+
+/**
+ * Axis aligned bounds of the vertex positions.
+ * An empty mesh yields inverted bounds (bmin = FLT_MAX, bmax = -FLT_MAX).
+ * @param bmin filled with the minimum corner
+ * @param bmax filled with the maximum corner
+ */
+void Mesh::computeBounds(float bmin[3], float bmax[3]) const{
+    for(int i = 0; i < 3; i++){ bmin[i] = FLT_MAX; bmax[i] = -FLT_MAX;}
+    for(size_t v = 0; v < px.size(); v++){
+        if(px[v] < bmin[0]) bmin[0] = px[v];
+        if(px[v] > bmax[0]) bmax[0] = px[v];
+        if(py[v] < bmin[1]) bmin[1] = py[v];
+        if(py[v] > bmax[1]) bmax[1] = py[v];
+        if(pz[v] < bmin[2]) bmin[2] = pz[v];
+        if(pz[v] > bmax[2]) bmax[2] = pz[v];
+    }
+}
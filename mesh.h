@@ -0,0 +1,31 @@
+#ifndef GRAPHICSENGINE3D_MESH_H
+#define GRAPHICSENGINE3D_MESH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Indexed triangle mesh stored as structure of arrays: one stream per
+ * vertex component, so batch kernels read contiguous floats and the
+ * streams can be handed directly to BVH::build().
+ * Normal streams are either empty or as long as the position streams.
+ */
+struct Mesh{
+    std::vector<float> px;
+    std::vector<float> py;
+    std::vector<float> pz;
+    std::vector<float> nx;
+    std::vector<float> ny;
+    std::vector<float> nz;
+    std::vector<uint32_t> indices; //3 vertex indices per triangle
+
+    size_t vertexCount() const;
+    size_t triangleCount() const;
+    bool hasNormals() const;
+    void resizeVertices(size_t count, bool normals);
+    void clear();
+    void computeBounds(float bmin[3], float bmax[3]) const;
+};
+
+#endif //GRAPHICSENGINE3D_MESH_H
@@ -0,0 +1,267 @@
+#include "meshcache.h"
+#include "profiler.h"
+#include "meshloader.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string.h>
+
+//Implementation details of the memory mapped binary mesh cache
+
+namespace {
+
+const char MAGIC[8] = {'G', 'E', '3', 'D', 'M', 'E', 'S', 'H'};
+const uint32_t ENDIAN_TAG = 0x01020304;
+
+uint64_t alignUp(uint64_t offset){
+    return (offset + MESH_CACHE_ALIGNMENT - 1)/MESH_CACHE_ALIGNMENT*MESH_CACHE_ALIGNMENT;
+}
+
+/**
+ * Check that every index in the mapped streams stays in range, so a corrupt
+ * cache cannot send the BVH traversal or the index buffer out of the mapping.
+ * Node 1 is the unused slot after the root that keeps siblings paired.
+ */
+bool validIndices(const char* data, const MeshCacheHeader* h){
+    const uint32_t* indices = (const uint32_t*)(data + h->offset[CACHE_INDICES]);
+    for(uint64_t i = 0; i < 3*h->triangle_count; i++){
+        if(indices[i] >= h->vertex_count) return false;
+    }
+    const uint32_t* order = (const uint32_t*)(data + h->offset[CACHE_BVH_ORDER]);
+    for(uint64_t t = 0; t < h->triangle_count; t++){
+        if(order[t] >= h->triangle_count) return false;
+    }
+    if((h->node_count == 0) != (h->triangle_count == 0) || h->node_count == 1) return false;
+    const BVHNode* nodes = (const BVHNode*)(data + h->offset[CACHE_BVH_NODES]);
+    for(uint64_t n = 0; n < h->node_count; n++){
+        if(n == 1) continue;
+        const BVHNode& node = nodes[n];
+        bool valid = node.count > 0? (uint64_t)node.leftFirst + node.count <= h->triangle_count
+                                   : node.leftFirst > std::max(n, (uint64_t)1) //node 1 is padding
+                                     && (uint64_t)node.leftFirst + 1 < h->node_count;
+        if(!valid) return false;
+    }
+    return true;
+}
+
+}
+
+MeshCache::MeshCache(){
+    header = nullptr;
+}
+
+/**
+ * Write a mesh and its BVH as a cache file. The file is written next to its
+ * final location and renamed once complete, so readers never map a partial file.
+ * @param cache_path the file to write
+ * @param mesh the mesh to store
+ * @param bvh hierarchy built over the mesh streams
+ * @param source_size size of the source asset, used to detect changes
+ * @param source_mtime modification time of the source asset, as given by statFile
+ * @return whether the file was written
+ */
+bool MeshCache::write(const std::string& cache_path, const Mesh& mesh, const BVH& bvh,
+                      uint64_t source_size, int64_t source_mtime){
+    if(bvh.triangleCount() != mesh.triangleCount()){
+        std::cout << "Warning: mesh cache BVH was not built over the cached mesh.\n";
+        return false;
+    }
+    MeshCacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = MESH_CACHE_VERSION;
+    h.endian_tag = ENDIAN_TAG;
+    h.source_size = source_size;
+    h.source_mtime = source_mtime;
+    h.vertex_count = mesh.vertexCount();
+    h.triangle_count = mesh.triangleCount();
+    h.node_count = bvh.nodeCount();
+    mesh.computeBounds(h.bmin, h.bmax);
+
+    bool normals = mesh.hasNormals();
+    const void* data[CACHE_STREAM_COUNT] = {mesh.px.data(), mesh.py.data(), mesh.pz.data(),
+                                            mesh.nx.data(), mesh.ny.data(), mesh.nz.data(),
+                                            mesh.indices.data(), bvh.getNodes(), bvh.getTriangleOrder()};
+    uint64_t vertex_bytes = h.vertex_count*sizeof(float);
+    uint64_t sizes[CACHE_STREAM_COUNT] = {vertex_bytes, vertex_bytes, vertex_bytes,
+                                          normals? vertex_bytes: 0, normals? vertex_bytes: 0, normals? vertex_bytes: 0,
+                                          3*h.triangle_count*sizeof(uint32_t), h.node_count*sizeof(BVHNode),
+                                          h.triangle_count*sizeof(uint32_t)};
+    uint64_t cursor = alignUp(sizeof(MeshCacheHeader));
+    for(int s = 0; s < CACHE_STREAM_COUNT; s++){
+        h.offset[s] = cursor;
+        h.size[s] = sizes[s];
+        cursor = alignUp(cursor + sizes[s]);
+    }
+    h.file_size = cursor;
+
+    std::string tmp_path = cache_path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if(!out){
+        std::cout << "Warning: could not write mesh cache " << cache_path << "\n";
+        return false;
+    }
+    static const char padding[MESH_CACHE_ALIGNMENT] = {};
+    out.write((const char*)&h, sizeof(h));
+    uint64_t written = sizeof(h);
+    for(int s = 0; s < CACHE_STREAM_COUNT; s++){
+        out.write(padding, h.offset[s] - written);
+        out.write((const char*)data[s], h.size[s]);
+        written = h.offset[s] + h.size[s];
+    }
+    out.write(padding, h.file_size - written);
+    out.close();
+    if(!out){
+        std::cout << "Warning: could not write mesh cache " << cache_path << "\n";
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    std::remove(cache_path.c_str()); //rename does not replace existing files on Windows
+    if(std::rename(tmp_path.c_str(), cache_path.c_str()) != 0){
+        std::cout << "Warning: could not move mesh cache into place " << cache_path << "\n";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Map a cache file and validate its header and indices. The BVH is attached
+ * to the mapped nodes, nothing is copied.
+ * @param cache_path the cache file
+ * @return whether the file is a valid cache of the current version
+ */
+bool MeshCache::open(const std::string& cache_path){
+    close();
+    if(!file.open(cache_path)) return false;
+    const MeshCacheHeader* h = (const MeshCacheHeader*)file.data();
+    bool valid = file.size() >= sizeof(MeshCacheHeader) && memcmp(h->magic, MAGIC, sizeof(MAGIC)) == 0
+                 && h->version == MESH_CACHE_VERSION && h->endian_tag == ENDIAN_TAG
+                 && h->file_size == file.size();
+    if(valid){
+        uint64_t vertex_bytes = h->vertex_count*sizeof(float);
+        uint64_t expected[CACHE_STREAM_COUNT] = {vertex_bytes, vertex_bytes, vertex_bytes,
+                                                 h->size[CACHE_NX], h->size[CACHE_NX], h->size[CACHE_NX],
+                                                 3*h->triangle_count*sizeof(uint32_t), h->node_count*sizeof(BVHNode),
+                                                 h->triangle_count*sizeof(uint32_t)};
+        valid = h->size[CACHE_NX] == 0 || h->size[CACHE_NX] == vertex_bytes;
+        for(int s = 0; s < CACHE_STREAM_COUNT; s++){
+            valid = valid && h->size[s] == expected[s] && h->offset[s]%MESH_CACHE_ALIGNMENT == 0
+                    && h->offset[s] + h->size[s] <= h->file_size;
+        }
+        valid = valid && validIndices(file.data(), h);
+    }
+    if(!valid){
+        std::cout << "Warning: " << cache_path << " is not a valid version "
+                  << MESH_CACHE_VERSION << " mesh cache.\n";
+        close();
+        return false;
+    }
+    header = h;
+    bvh.attach((const BVHNode*)(file.data() + h->offset[CACHE_BVH_NODES]), h->node_count,
+               (const uint32_t*)(file.data() + h->offset[CACHE_BVH_ORDER]),
+               getStream(CACHE_PX), getStream(CACHE_PY), getStream(CACHE_PZ), getIndices(), h->triangle_count);
+    return true;
+}
+
+/**
+ * Load a source asset through its cache stored at defaultCachePath()
+ * @param source_path the OBJ or PLY asset
+ * @return whether a valid cache is open afterwards
+ */
+bool MeshCache::load(const std::string& source_path){
+    return load(source_path, defaultCachePath(source_path));
+}
+
+/**
+ * Load a source asset through its cache. The cache is used as is when it
+ * matches the source size and modification time; otherwise the source is
+ * parsed, a BVH built, and the cache rewritten before being mapped.
+ * When the source does not exist an existing cache is used without checks.
+ * @param source_path the OBJ or PLY asset
+ * @param cache_path the cache file to use or regenerate
+ * @return whether a valid cache is open afterwards
+ */
+bool MeshCache::load(const std::string& source_path, const std::string& cache_path){
+    PROFILE_ZONE("MeshCache::load");
+    close();
+    uint64_t source_size, cache_size;
+    int64_t source_mtime, cache_mtime;
+    bool has_source = statFile(source_path, source_size, source_mtime);
+    bool has_cache = statFile(cache_path, cache_size, cache_mtime);
+    if(!has_source){
+        if(has_cache) return open(cache_path);
+        std::cout << "Warning: mesh source " << source_path << " does not exist.\n";
+        return false;
+    }
+    if(has_cache && open(cache_path)){
+        if(matchesSource(source_size, source_mtime)) return true;
+        close();
+    }
+
+    Mesh mesh;
+    if(!loadMesh(source_path, mesh)) return false;
+    BVH hierarchy;
+    hierarchy.build(mesh.px.data(), mesh.py.data(), mesh.pz.data(), mesh.indices.data(), mesh.triangleCount());
+    if(!write(cache_path, mesh, hierarchy, source_size, source_mtime)) return false;
+    return open(cache_path);
+}
+
+/**
+ * Release the mapping, invalidating every pointer handed out by the cache
+ */
+void MeshCache::close(){
+    bvh.attach(nullptr, 0, nullptr, nullptr, nullptr, nullptr, nullptr, 0);
+    header = nullptr;
+    file.close();
+}
+
+/**
+ * Cache location used when none is given: next to the source with a .ge3dmesh suffix
+ */
+std::string MeshCache::defaultCachePath(const std::string& source_path){
+    return source_path + ".ge3dmesh";
+}
+
+bool MeshCache::matchesSource(uint64_t source_size, int64_t source_mtime) const{
+    return header && header->source_size == source_size && header->source_mtime == source_mtime;
+}
+
+bool MeshCache::isOpen() const{
+    return header != nullptr;
+}
+
+size_t MeshCache::vertexCount() const{
+    return header? header->vertex_count: 0;
+}
+
+size_t MeshCache::triangleCount() const{
+    return header? header->triangle_count: 0;
+}
+
+bool MeshCache::hasNormals() const{
+    return header && header->size[CACHE_NX] > 0;
+}
+
+/**
+ * Pointer into the mapping for one vertex stream
+ * @param stream one of CACHE_PX ... CACHE_NZ
+ * @return the stream, nullptr when the cache is closed or the stream absent
+ */
+const float* MeshCache::getStream(MeshCacheStream stream) const{
+    if(!header || stream > CACHE_NZ || header->size[stream] == 0) return nullptr;
+    return (const float*)(file.data() + header->offset[stream]);
+}
+
+const uint32_t* MeshCache::getIndices() const{
+    if(!header) return nullptr;
+    return (const uint32_t*)(file.data() + header->offset[CACHE_INDICES]);
+}
+
+const BVH& MeshCache::getBVH() const{
+    return bvh;
+}
+
+const MeshCacheHeader& MeshCache::getHeader() const{
+    return *header;
+}
@@ -0,0 +1,78 @@
+#ifndef GRAPHICSENGINE3D_MESHCACHE_H
+#define GRAPHICSENGINE3D_MESHCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include "bvh.h"
+#include "mappedfile.h"
+#include "mesh.h"
+
+const uint32_t MESH_CACHE_VERSION = 1;
+const size_t MESH_CACHE_ALIGNMENT = 64;
+
+/**
+ * Streams stored in a mesh cache file, in file order
+ */
+enum MeshCacheStream{
+    CACHE_PX, CACHE_PY, CACHE_PZ, CACHE_NX, CACHE_NY, CACHE_NZ,
+    CACHE_INDICES, CACHE_BVH_NODES, CACHE_BVH_ORDER, CACHE_STREAM_COUNT
+};
+
+/**
+ * Fixed size header at the start of a mesh cache file.
+ * Every stream starts at a multiple of MESH_CACHE_ALIGNMENT bytes;
+ * a stream that is absent (e.g. normals) has size 0.
+ */
+struct MeshCacheHeader{
+    char magic[8]; //"GE3DMESH"
+    uint32_t version;
+    uint32_t endian_tag; //0x01020304 as written by the producing machine
+    uint64_t source_size;
+    int64_t source_mtime; //nanoseconds since the epoch
+    uint64_t vertex_count;
+    uint64_t triangle_count;
+    uint64_t node_count;
+    float bmin[3];
+    float bmax[3];
+    uint64_t offset[CACHE_STREAM_COUNT];
+    uint64_t size[CACHE_STREAM_COUNT];
+    uint64_t file_size;
+};
+
+/**
+ * Versioned binary mesh cache that is memory mapped and used in place:
+ * the vertex streams, index buffer and BVH are read straight from the
+ * mapping with no parsing and no copy.
+ * open() validates the file, load() additionally regenerates it from the
+ * source asset (OBJ/PLY) when the source size or modification time changed
+ * or the cache was written by another format version.
+ */
+class MeshCache{
+public:
+    MeshCache();
+    bool open(const std::string& cache_path);
+    bool load(const std::string& source_path); //cache next to the source
+    bool load(const std::string& source_path, const std::string& cache_path);
+    void close();
+    static bool write(const std::string& cache_path, const Mesh& mesh, const BVH& bvh,
+                      uint64_t source_size, int64_t source_mtime);
+    static std::string defaultCachePath(const std::string& source_path);
+
+    bool isOpen() const;
+    size_t vertexCount() const;
+    size_t triangleCount() const;
+    bool hasNormals() const;
+    const float* getStream(MeshCacheStream stream) const; //nullptr when absent
+    const uint32_t* getIndices() const;
+    const BVH& getBVH() const;
+    const MeshCacheHeader& getHeader() const;
+private:
+    MappedFile file;
+    const MeshCacheHeader* header;
+    BVH bvh;
+
+    bool matchesSource(uint64_t source_size, int64_t source_mtime) const;
+};
+
+#endif //GRAPHICSENGINE3D_MESHCACHE_H
@@ -0,0 +1,840 @@
+#include "meshloader.h"
+#include "profiler.h"
+#include "mappedfile.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <iostream>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include <math.h>
+
+//Implementation details of the OBJ and PLY mesh loaders
+
+namespace {
+
+const size_t MIN_CHUNK_SIZE = 1 << 20; // smaller chunks are not worth handing to a thread
+const int CHUNKS_PER_THREAD = 4;
+
+unsigned workerCount(unsigned threads){
+    return threads? threads: std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ * Run fn(i) for every job i in [0, jobs) on up to `threads` threads.
+ * Jobs are claimed from an atomic counter so uneven chunks balance out.
+ */
+template<typename F>
+void runJobs(size_t jobs, unsigned threads, const F& fn){
+    std::atomic<size_t> next(0);
+    auto work = [&](){
+        for(size_t i = next++; i < jobs; i = next++) fn(i);
+    };
+    std::vector<std::thread> pool;
+    for(size_t t = 1; t < std::min((size_t)threads, jobs); t++) pool.emplace_back(work);
+    work();
+    for(auto& t: pool) t.join();
+}
+
+/**
+ * Split [begin, end) in at most `count` ranges that each start at the beginning of a line
+ * @return the count+1 (or fewer) range boundaries, first is begin and last is end
+ */
+std::vector<const char*> splitLines(const char* begin, const char* end, size_t count){
+    std::vector<const char*> bounds;
+    bounds.push_back(begin);
+    size_t size = end - begin;
+    for(size_t i = 1; i < count; i++){
+        const char* p = std::max(begin + size*i/count, bounds.back());
+        const char* nl = (const char*)memchr(p, '\n', end - p);
+        p = nl? nl+1: end;
+        if(p > bounds.back() && p < end) bounds.push_back(p);
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+size_t chunkCount(size_t size, unsigned workers){
+    return std::max((size_t)1, std::min((size_t)workers*CHUNKS_PER_THREAD, size/MIN_CHUNK_SIZE + 1));
+}
+
+inline bool isBlank(char c){
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skipBlanks(const char* p, const char* end){
+    while(p < end && isBlank(*p)) p++;
+    return p;
+}
+
+inline const char* skipToken(const char* p, const char* end){
+    while(p < end && !isBlank(*p) && *p != '\n') p++;
+    return p;
+}
+
+inline const char* lineEnd(const char* p, const char* end){
+    const char* nl = (const char*)memchr(p, '\n', end - p);
+    return nl? nl: end;
+}
+
+inline const char* nextLine(const char* p, const char* end){
+    const char* nl = (const char*)memchr(p, '\n', end - p);
+    return nl? nl+1: end;
+}
+
+/**
+ * Number of whitespace separated tokens between p and the end of its line
+ */
+inline int countTokens(const char* p, const char* end){
+    int tokens = 0;
+    const char* e = lineEnd(p, end);
+    while(true){
+        p = skipBlanks(p, e);
+        if(p >= e) return tokens;
+        tokens++;
+        p = skipToken(p, e);
+    }
+}
+
+/**
+ * Locale independent decimal parser working on unterminated buffers.
+ * Up to 19 significant digits are kept, which is more than a float can hold.
+ * @param p read position, advanced past the number
+ * @param end end of the buffer
+ * @param out the parsed value
+ * @return false when no number starts at p
+ */
+bool parseFloat(const char*& p, const char* end, float& out){
+    static const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    p = skipBlanks(p, end);
+    bool neg = false;
+    if(p < end && (*p == '-' || *p == '+')){ neg = *p == '-'; p++;}
+    uint64_t mant = 0;
+    int exp10 = 0;
+    int digits = 0;
+    bool any = false;
+    while(p < end && *p >= '0' && *p <= '9'){
+        if(digits < 19){ mant = mant*10 + (*p - '0'); if(mant) digits++;}
+        else exp10++;
+        any = true;
+        p++;
+    }
+    if(p < end && *p == '.'){
+        p++;
+        while(p < end && *p >= '0' && *p <= '9'){
+            if(digits < 19){ mant = mant*10 + (*p - '0'); exp10--; if(mant) digits++;}
+            any = true;
+            p++;
+        }
+    }
+    if(!any) return false;
+    if(p < end && (*p == 'e' || *p == 'E')){
+        p++;
+        bool eneg = false;
+        if(p < end && (*p == '-' || *p == '+')){ eneg = *p == '-'; p++;}
+        int e = 0;
+        while(p < end && *p >= '0' && *p <= '9'){ if(e < 10000) e = e*10 + (*p - '0'); p++;}
+        exp10 += eneg? -e: e;
+    }
+    double v = (double)mant;
+    if(exp10 < 0) v = exp10 >= -22? v/POW10[-exp10]: v*pow(10.0, exp10);
+    else if(exp10 > 0) v = exp10 <= 22? v*POW10[exp10]: v*pow(10.0, exp10);
+    out = (float)(neg? -v: v);
+    return true;
+}
+
+/**
+ * Signed decimal integer parser working on unterminated buffers
+ * @return false when no integer starts at p or it does not fit a long long
+ */
+bool parseInt(const char*& p, const char* end, long long& out){
+    p = skipBlanks(p, end);
+    bool neg = false;
+    if(p < end && (*p == '-' || *p == '+')){ neg = *p == '-'; p++;}
+    if(p >= end || *p < '0' || *p > '9') return false;
+    long long v = 0;
+    while(p < end && *p >= '0' && *p <= '9'){
+        if(v > (LLONG_MAX - (*p - '0'))/10) return false;
+        v = v*10 + (*p - '0');
+        p++;
+    }
+    out = neg? -v: v;
+    return true;
+}
+
+// ==================== OBJ ====================
+
+struct ObjCounts{
+    size_t vertices;
+    size_t normals;
+    size_t triangles;
+};
+
+/**
+ * First OBJ pass: count the positions, normals and triangles of a chunk
+ */
+ObjCounts countObj(const char* p, const char* end){
+    ObjCounts c{0, 0, 0};
+    for(; p < end; p = nextLine(p, end)){
+        const char* q = skipBlanks(p, end);
+        if(end - q < 2) continue;
+        if(q[0] == 'v'){
+            if(isBlank(q[1])) c.vertices++;
+            else if(q[1] == 'n' && end - q > 2 && isBlank(q[2])) c.normals++;
+        }
+        else if(q[0] == 'f' && isBlank(q[1])){
+            int corners = countTokens(q+1, end);
+            if(corners >= 3) c.triangles += corners - 2;
+        }
+    }
+    return c;
+}
+
+/**
+ * Resolve an OBJ index (1-based, or negative relative to the last vertex)
+ * @param idx the index as written in the file
+ * @param seen number of vertices defined before the face
+ * @param total number of vertices in the file
+ * @param out the 0-based vertex index
+ * @return whether the index refers to an existing vertex
+ */
+inline bool resolveObjIndex(long long idx, size_t seen, size_t total, uint32_t& out){
+    long long v = idx > 0? idx - 1: (long long)seen + idx;
+    if(idx == 0 || v < 0 || v >= (long long)total) return false;
+    out = (uint32_t)v;
+    return true;
+}
+
+/**
+ * Second OBJ pass: parse a chunk into the mesh at the offsets given by the prefix sums
+ * @return false when the chunk contains a malformed statement
+ */
+bool parseObjChunk(const char* p, const char* end, const ObjCounts& offset, size_t total_vertices,
+                   bool normals, Mesh& mesh){
+    size_t v = offset.vertices;
+    size_t n = offset.normals;
+    uint32_t* tri = mesh.indices.data() + 3*offset.triangles;
+    for(; p < end; p = nextLine(p, end)){
+        const char* q = skipBlanks(p, end);
+        if(end - q < 2) continue;
+        if(q[0] == 'v' && isBlank(q[1])){
+            q++;
+            if(!parseFloat(q, end, mesh.px[v]) || !parseFloat(q, end, mesh.py[v])
+               || !parseFloat(q, end, mesh.pz[v])) return false;
+            v++;
+        }
+        else if(q[0] == 'v' && q[1] == 'n' && end - q > 2 && isBlank(q[2])){
+            if(!normals) continue;
+            q += 2;
+            if(!parseFloat(q, end, mesh.nx[n]) || !parseFloat(q, end, mesh.ny[n])
+               || !parseFloat(q, end, mesh.nz[n])) return false;
+            n++;
+        }
+        else if(q[0] == 'f' && isBlank(q[1])){
+            const char* e = lineEnd(q, end);
+            q++;
+            uint32_t first = 0, prev = 0, cur = 0;
+            int corner = 0;
+            while(true){
+                q = skipBlanks(q, e);
+                if(q >= e) break;
+                long long idx;
+                if(!parseInt(q, e, idx) || !resolveObjIndex(idx, v, total_vertices, cur)) return false;
+                q = skipToken(q, e); //skip the texture and normal indices of the corner
+                if(corner == 0) first = cur;
+                else if(corner >= 2){ tri[0] = first; tri[1] = prev; tri[2] = cur; tri += 3;}
+                prev = cur;
+                corner++;
+            }
+        }
+    }
+    return true;
+}
+
+// ==================== PLY ====================
+
+enum PlyType{ PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64, PLY_INVALID};
+
+struct PlyProperty{
+    std::string name;
+    PlyType type;
+    bool is_list;
+    PlyType count_type;
+};
+
+struct PlyElement{
+    std::string name;
+    size_t count;
+    std::vector<PlyProperty> props;
+};
+
+enum PlyFormat{ PLY_ASCII, PLY_BINARY_LE, PLY_BINARY_BE};
+
+PlyType plyType(const std::string& s){
+    if(s == "char" || s == "int8") return PLY_INT8;
+    if(s == "uchar" || s == "uint8") return PLY_UINT8;
+    if(s == "short" || s == "int16") return PLY_INT16;
+    if(s == "ushort" || s == "uint16") return PLY_UINT16;
+    if(s == "int" || s == "int32") return PLY_INT32;
+    if(s == "uint" || s == "uint32") return PLY_UINT32;
+    if(s == "float" || s == "float32") return PLY_FLOAT32;
+    if(s == "double" || s == "float64") return PLY_FLOAT64;
+    return PLY_INVALID;
+}
+
+size_t plySize(PlyType t){
+    static const size_t SIZES[] = {1, 1, 2, 2, 4, 4, 4, 8, 0};
+    return SIZES[t];
+}
+
+/**
+ * Read one binary PLY scalar as a double, swapping bytes for big endian files
+ * @param p first byte of the scalar
+ * @param end end of the body, the scalar must fit before it
+ * @param value filled with the scalar
+ * @return false when the body ends before the scalar does
+ */
+inline bool readPlyScalar(const char* p, const char* end, PlyType t, bool swap, double& value){
+    unsigned char b[8];
+    size_t n = plySize(t);
+    if(p > end || (size_t)(end - p) < n) return false;
+    memcpy(b, p, n);
+    if(swap) std::reverse(b, b+n);
+    switch(t){
+        case PLY_INT8: { int8_t v; memcpy(&v, b, 1); value = v; break;}
+        case PLY_UINT8: { uint8_t v; memcpy(&v, b, 1); value = v; break;}
+        case PLY_INT16: { int16_t v; memcpy(&v, b, 2); value = v; break;}
+        case PLY_UINT16: { uint16_t v; memcpy(&v, b, 2); value = v; break;}
+        case PLY_INT32: { int32_t v; memcpy(&v, b, 4); value = v; break;}
+        case PLY_UINT32: { uint32_t v; memcpy(&v, b, 4); value = v; break;}
+        case PLY_FLOAT32: { float v; memcpy(&v, b, 4); value = v; break;}
+        case PLY_FLOAT64: { double v; memcpy(&v, b, 8); value = v; break;}
+        default: value = 0;
+    }
+    return true;
+}
+
+/**
+ * Read the length prefix of a binary PLY list
+ * @return false when the body ends first, or the length is negative or larger
+ * than the bytes left
+ */
+inline bool readPlyCount(const char* p, const char* end, PlyType t, bool swap, size_t& count){
+    double n;
+    if(!readPlyScalar(p, end, t, swap, n) || n < 0 || n > (double)(end - p)) return false;
+    count = (size_t)n;
+    return true;
+}
+
+/**
+ * Parse the PLY header
+ * @param body filled with the first byte after end_header
+ * @return false when the header is malformed
+ */
+bool parsePlyHeader(const char* data, const char* end, PlyFormat& format,
+                    std::vector<PlyElement>& elements, const char*& body){
+    if(end - data < 4 || strncmp(data, "ply", 3) != 0){
+        std::cout << "Warning: PLY data does not start with the ply magic.\n";
+        return false;
+    }
+    bool has_format = false;
+    for(const char* p = nextLine(data, end); p < end; p = nextLine(p, end)){
+        std::vector<std::string> tokens;
+        const char* e = lineEnd(p, end);
+        for(const char* q = skipBlanks(p, e); q < e; q = skipBlanks(q, e)){
+            const char* t = skipToken(q, e);
+            tokens.push_back(std::string(q, t));
+            q = t;
+        }
+        if(tokens.empty() || tokens[0] == "comment" || tokens[0] == "obj_info") continue;
+        if(tokens[0] == "end_header"){
+            body = nextLine(p, end);
+            return has_format;
+        }
+        if(tokens[0] == "format" && tokens.size() >= 2){
+            if(tokens[1] == "ascii") format = PLY_ASCII;
+            else if(tokens[1] == "binary_little_endian") format = PLY_BINARY_LE;
+            else if(tokens[1] == "binary_big_endian") format = PLY_BINARY_BE;
+            else break;
+            has_format = true;
+        }
+        else if(tokens[0] == "element" && tokens.size() >= 3){
+            elements.push_back(PlyElement{tokens[1], (size_t)strtoull(tokens[2].c_str(), nullptr, 10), {}});
+        }
+        else if(tokens[0] == "property" && !elements.empty()){
+            PlyProperty prop;
+            if(tokens.size() >= 5 && tokens[1] == "list"){
+                prop = PlyProperty{tokens[4], plyType(tokens[3]), true, plyType(tokens[2])};
+            }
+            else if(tokens.size() >= 3){
+                prop = PlyProperty{tokens[2], plyType(tokens[1]), false, PLY_INVALID};
+            }
+            else break;
+            if(prop.type == PLY_INVALID || (prop.is_list && prop.count_type == PLY_INVALID)) break;
+            elements.back().props.push_back(prop);
+        }
+        else break;
+    }
+    std::cout << "Warning: malformed PLY header.\n";
+    return false;
+}
+
+/**
+ * Index of the vertex components in an element's property list, -1 when absent
+ */
+struct PlyVertexLayout{
+    int component[6]; //x, y, z, nx, ny, nz
+};
+
+PlyVertexLayout vertexLayout(const PlyElement& vertex){
+    static const char* NAMES[6] = {"x", "y", "z", "nx", "ny", "nz"};
+    PlyVertexLayout layout;
+    for(int c = 0; c < 6; c++){
+        layout.component[c] = -1;
+        for(size_t i = 0; i < vertex.props.size(); i++){
+            if(vertex.props[i].name == NAMES[c] && !vertex.props[i].is_list) layout.component[c] = (int)i;
+        }
+    }
+    return layout;
+}
+
+int faceListIndex(const PlyElement& face){
+    for(size_t i = 0; i < face.props.size(); i++){
+        if(face.props[i].is_list && (face.props[i].name == "vertex_indices" || face.props[i].name == "vertex_index")){
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Destination stream of every vertex property, nullptr for the properties
+ * the mesh does not keep
+ */
+std::vector<float*> vertexTargets(const PlyElement& vertex, Mesh& mesh){
+    PlyVertexLayout layout = vertexLayout(vertex);
+    float* streams[6] = {mesh.px.data(), mesh.py.data(), mesh.pz.data(),
+                         mesh.nx.data(), mesh.ny.data(), mesh.nz.data()};
+    int components = mesh.hasNormals()? 6: 3;
+    std::vector<float*> targets(vertex.props.size(), nullptr);
+    for(int c = 0; c < components; c++) targets[layout.component[c]] = streams[c];
+    return targets;
+}
+
+/**
+ * Read the length of an ascii PLY list, which needs a blank and a digit per entry
+ * @return false when it is not a count, negative or longer than the rest of the line
+ */
+bool parseAsciiListLength(const char*& q, const char* e, long long& n){
+    return parseInt(q, e, n) && n >= 0 && n <= (e - q)/2;
+}
+
+/**
+ * Skip the ascii face properties that precede the vertex index list
+ * @return false when a list count could not be parsed
+ */
+bool skipAsciiFaceProps(const char*& q, const char* e, const PlyElement& face, int list_prop){
+    for(int i = 0; i < list_prop; i++){
+        long long n = 1;
+        if(face.props[i].is_list && !parseAsciiListLength(q, e, n)) return false;
+        for(long long k = 0; k < n; k++){ q = skipToken(skipBlanks(q, e), e);}
+    }
+    return true;
+}
+
+/**
+ * Parse an ascii PLY body. Every element occupies one line, so the body is split
+ * in line aligned chunks, the lines of each chunk are counted to give it a global
+ * line number, vertices are parsed and face triangles counted, and a last pass
+ * writes the triangles at their prefix summed offsets.
+ */
+bool parsePlyAscii(const char* body, const char* end, const std::vector<PlyElement>& elements,
+                   size_t vertex_elem, size_t face_elem, Mesh& mesh, unsigned workers){
+    const PlyElement& vertex = elements[vertex_elem];
+    const PlyElement& face = elements[face_elem];
+    std::vector<float*> targets = vertexTargets(vertex, mesh);
+    int list_prop = faceListIndex(face);
+    size_t vertex_line = 0, face_line = 0, line = 0;
+    for(size_t e = 0; e < elements.size(); e++){
+        if(e == vertex_elem) vertex_line = line;
+        if(e == face_elem) face_line = line;
+        line += elements[e].count;
+    }
+
+    std::vector<const char*> bounds = splitLines(body, end, chunkCount(end - body, workers));
+    size_t chunks = bounds.size() - 1;
+    std::vector<size_t> first_line(chunks+1, 0);
+    runJobs(chunks, workers, [&](size_t c){
+        size_t lines = 0;
+        for(const char* p = bounds[c]; p < bounds[c+1]; p = nextLine(p, bounds[c+1])) lines++;
+        first_line[c+1] = lines;
+    });
+    for(size_t c = 0; c < chunks; c++) first_line[c+1] += first_line[c];
+
+    std::vector<size_t> tri_offset(chunks+1, 0);
+    std::atomic<bool> ok(true);
+    runJobs(chunks, workers, [&](size_t c){
+        size_t l = first_line[c];
+        size_t tris = 0;
+        for(const char* p = bounds[c]; p < bounds[c+1]; p = nextLine(p, bounds[c+1]), l++){
+            const char* e = lineEnd(p, bounds[c+1]);
+            const char* q = p;
+            if(l >= vertex_line && l < vertex_line + vertex.count){
+                size_t v = l - vertex_line;
+                for(size_t i = 0; i < vertex.props.size(); i++){
+                    float value;
+                    if(vertex.props[i].is_list){
+                        long long n;
+                        if(!parseAsciiListLength(q, e, n)){ ok = false; return;}
+                        for(long long k = 0; k < n; k++){ q = skipToken(skipBlanks(q, e), e);}
+                        continue;
+                    }
+                    if(!parseFloat(q, e, value)){ ok = false; return;}
+                    if(targets[i]) targets[i][v] = value;
+                }
+            }
+            else if(l >= face_line && l < face_line + face.count){
+                long long n;
+                if(!skipAsciiFaceProps(q, e, face, list_prop) || !parseAsciiListLength(q, e, n)){ ok = false; return;}
+                if(n >= 3) tris += n - 2;
+            }
+        }
+        tri_offset[c+1] = tris;
+    });
+    if(!ok) return false;
+    for(size_t c = 0; c < chunks; c++) tri_offset[c+1] += tri_offset[c];
+    mesh.indices.resize(3*tri_offset[chunks]);
+
+    size_t vertex_count = vertex.count;
+    runJobs(chunks, workers, [&](size_t c){
+        size_t l = first_line[c];
+        if(l >= face_line + face.count || first_line[c+1] <= face_line) return;
+        uint32_t* tri = mesh.indices.data() + 3*tri_offset[c];
+        for(const char* p = bounds[c]; p < bounds[c+1]; p = nextLine(p, bounds[c+1]), l++){
+            if(l < face_line || l >= face_line + face.count) continue;
+            const char* e = lineEnd(p, bounds[c+1]);
+            const char* q = p;
+            long long n, idx;
+            skipAsciiFaceProps(q, e, face, list_prop);
+            parseInt(q, e, n);
+            uint32_t corner[3];
+            for(long long k = 0; k < n; k++){
+                if(!parseInt(q, e, idx) || idx < 0 || idx >= (long long)vertex_count){ ok = false; return;}
+                if(k < 2) corner[k] = (uint32_t)idx;
+                else{
+                    corner[2] = (uint32_t)idx;
+                    tri[0] = corner[0]; tri[1] = corner[1]; tri[2] = corner[2];
+                    tri += 3;
+                    corner[1] = corner[2];
+                }
+            }
+        }
+    });
+    return ok;
+}
+
+/**
+ * Check that the element counts of the header fit in the body before anything
+ * is allocated for them: an ascii record takes at least a digit and a blank
+ * or line break per property, a binary record its scalars and list lengths.
+ * @return false when the body is too small for the declared records
+ */
+bool plyCountsFit(const std::vector<PlyElement>& elements, PlyFormat format, size_t body_size){
+    size_t left = body_size + 1; //the last ascii line may have no line break
+    for(auto& element: elements){
+        size_t record = 0;
+        for(auto& prop: element.props) record += format == PLY_ASCII? 2: plySize(prop.is_list? prop.count_type: prop.type);
+        if(format == PLY_ASCII) record = std::max(record, (size_t)1);
+        if(record == 0) continue;
+        if(element.count > left/record) return false;
+        left -= element.count*record;
+    }
+    return true;
+}
+
+/**
+ * Byte size of one record of an element, 0 when it has list properties
+ */
+size_t fixedStride(const PlyElement& element){
+    size_t stride = 0;
+    for(auto& prop: element.props){
+        if(prop.is_list) return 0;
+        stride += plySize(prop.type);
+    }
+    return stride;
+}
+
+/**
+ * Skip one record of an element with list properties
+ * @return the next record, nullptr when the body ends first
+ */
+const char* skipPlyRecord(const char* p, const char* end, const PlyElement& element, bool swap){
+    for(auto& prop: element.props){
+        size_t n = 1;
+        if(prop.is_list){
+            if(!readPlyCount(p, end, prop.count_type, swap, n)) return nullptr;
+            p += plySize(prop.count_type);
+        }
+        if((size_t)(end - p) < n*plySize(prop.type)) return nullptr;
+        p += n*plySize(prop.type);
+    }
+    return p;
+}
+
+/**
+ * Parse a binary PLY body. Vertex records have a fixed stride and are decoded
+ * in parallel ranges; face records have variable length and are decoded with
+ * one counting and one writing sweep.
+ */
+bool parsePlyBinary(const char* body, const char* end, const std::vector<PlyElement>& elements,
+                    size_t vertex_elem, size_t face_elem, bool swap, Mesh& mesh, unsigned workers){
+    const PlyElement& vertex = elements[vertex_elem];
+    const PlyElement& face = elements[face_elem];
+    size_t vertex_stride = fixedStride(vertex);
+    if(vertex_stride == 0){
+        std::cout << "Warning: PLY vertex elements with list properties are not supported.\n";
+        return false;
+    }
+    std::vector<float*> targets = vertexTargets(vertex, mesh);
+    int list_prop = faceListIndex(face);
+    std::vector<size_t> prop_offset(vertex.props.size());
+    size_t off = 0;
+    for(size_t i = 0; i < vertex.props.size(); i++){ prop_offset[i] = off; off += plySize(vertex.props[i].type);}
+
+    //locate the vertex and face records
+    const char* p = body;
+    const char* vertex_data = nullptr;
+    const char* face_data = nullptr;
+    for(size_t e = 0; e < elements.size() && p != nullptr; e++){
+        if(e == vertex_elem) vertex_data = p;
+        if(e == face_elem){ face_data = p; break;}
+        size_t stride = fixedStride(elements[e]);
+        if(stride > 0) p = elements[e].count <= (size_t)(end - p)/stride? p + stride*elements[e].count: nullptr;
+        else for(size_t r = 0; r < elements[e].count && p != nullptr; r++) p = skipPlyRecord(p, end, elements[e], swap);
+    }
+    if(vertex_data == nullptr || face_data == nullptr || vertex.count > (size_t)(end - vertex_data)/vertex_stride){
+        std::cout << "Warning: truncated PLY body.\n";
+        return false;
+    }
+
+    size_t ranges = chunkCount(vertex_stride*vertex.count, workers);
+    runJobs(ranges, workers, [&](size_t r){
+        size_t v0 = vertex.count*r/ranges;
+        size_t v1 = vertex.count*(r+1)/ranges;
+        for(size_t v = v0; v < v1; v++){
+            const char* rec = vertex_data + v*vertex_stride;
+            for(size_t i = 0; i < targets.size(); i++){
+                double value;
+                if(targets[i] && readPlyScalar(rec + prop_offset[i], end, vertex.props[i].type, swap, value)){
+                    targets[i][v] = (float)value;
+                }
+            }
+        }
+    });
+
+    size_t tris = 0;
+    p = face_data;
+    for(size_t f = 0; f < face.count; f++){
+        for(int i = 0; i < (int)face.props.size(); i++){
+            const PlyProperty& prop = face.props[i];
+            size_t n = 1;
+            if(prop.is_list){
+                if(!readPlyCount(p, end, prop.count_type, swap, n)){ std::cout << "Warning: truncated PLY body.\n"; return false;}
+                p += plySize(prop.count_type);
+                if(i == list_prop && n >= 3) tris += n - 2;
+            }
+            if((size_t)(end - p) < n*plySize(prop.type)){ std::cout << "Warning: truncated PLY body.\n"; return false;}
+            p += n*plySize(prop.type);
+        }
+    }
+    mesh.indices.resize(3*tris);
+    uint32_t* tri = mesh.indices.data();
+    p = face_data;
+    for(size_t f = 0; f < face.count; f++){
+        for(int i = 0; i < (int)face.props.size(); i++){
+            const PlyProperty& prop = face.props[i];
+            if(!prop.is_list){ p += plySize(prop.type); continue;}
+            size_t n = 0;
+            readPlyCount(p, end, prop.count_type, swap, n); //the counting sweep checked every record fits
+            p += plySize(prop.count_type);
+            if(i != list_prop){ p += n*plySize(prop.type); continue;}
+            uint32_t corner[3];
+            for(size_t k = 0; k < n; k++, p += plySize(prop.type)){
+                double idx = -1;
+                readPlyScalar(p, end, prop.type, swap, idx);
+                if(idx < 0 || idx >= vertex.count){
+                    std::cout << "Warning: PLY face index out of range.\n";
+                    return false;
+                }
+                if(k < 2) corner[k] = (uint32_t)idx;
+                else{
+                    tri[0] = corner[0]; tri[1] = corner[1]; tri[2] = (uint32_t)idx;
+                    tri += 3;
+                    corner[1] = (uint32_t)idx;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Lowercase extension of a path, without the dot
+ */
+std::string extension(const std::string& path){
+    size_t dot = path.find_last_of('.');
+    if(dot == std::string::npos) return "";
+    std::string ext = path.substr(dot+1);
+    for(auto& c: ext) c = (char)tolower(c);
+    return ext;
+}
+
+}
+
+/**
+ * Parse OBJ text already in memory. Only positions, normals and faces are read;
+ * normals are kept only when there is exactly one per position, since the
+ * mesh has a single index stream.
+ * @param data the OBJ text, need not be null terminated
+ * @param size byte size of the text
+ * @param mesh filled with the parsed mesh
+ * @param threads number of threads, 0 uses every hardware thread
+ * @return whether the text was parsed successfully
+ */
+bool parseOBJ(const char* data, size_t size, Mesh& mesh, unsigned threads){
+    PROFILE_ZONE("parseOBJ");
+    mesh.clear();
+    unsigned workers = workerCount(threads);
+    const char* end = data + size;
+    std::vector<const char*> bounds = splitLines(data, end, chunkCount(size, workers));
+    size_t chunks = bounds.size() - 1;
+
+    std::vector<ObjCounts> offsets(chunks+1, ObjCounts{0, 0, 0});
+    runJobs(chunks, workers, [&](size_t c){ offsets[c+1] = countObj(bounds[c], bounds[c+1]);});
+    for(size_t c = 0; c < chunks; c++){
+        offsets[c+1].vertices += offsets[c].vertices;
+        offsets[c+1].normals += offsets[c].normals;
+        offsets[c+1].triangles += offsets[c].triangles;
+    }
+    const ObjCounts& total = offsets[chunks];
+    bool normals = total.normals > 0 && total.normals == total.vertices;
+    mesh.resizeVertices(total.vertices, normals);
+    mesh.indices.resize(3*total.triangles);
+
+    std::atomic<bool> ok(true);
+    runJobs(chunks, workers, [&](size_t c){
+        if(!parseObjChunk(bounds[c], bounds[c+1], offsets[c], total.vertices, normals, mesh)) ok = false;
+    });
+    if(!ok){
+        std::cout << "Warning: malformed OBJ statement or face index out of range.\n";
+        mesh.clear();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Parse PLY data already in memory. The vertex element must have x, y and z
+ * properties, nx/ny/nz are loaded when all three are present.
+ * @param data the PLY file contents
+ * @param size byte size of the contents
+ * @param mesh filled with the parsed mesh
+ * @param threads number of threads, 0 uses every hardware thread
+ * @return whether the data was parsed successfully
+ */
+bool parsePLY(const char* data, size_t size, Mesh& mesh, unsigned threads){
+    PROFILE_ZONE("parsePLY");
+    mesh.clear();
+    const char* end = data + size;
+    PlyFormat format = PLY_ASCII;
+    std::vector<PlyElement> elements;
+    const char* body = nullptr;
+    if(!parsePlyHeader(data, end, format, elements, body)) return false;
+
+    size_t vertex_elem = elements.size(), face_elem = elements.size();
+    for(size_t e = 0; e < elements.size(); e++){
+        if(elements[e].name == "vertex") vertex_elem = e;
+        if(elements[e].name == "face") face_elem = e;
+    }
+    if(vertex_elem == elements.size()){
+        std::cout << "Warning: PLY data has no vertex element.\n";
+        return false;
+    }
+    PlyVertexLayout layout = vertexLayout(elements[vertex_elem]);
+    if(layout.component[0] < 0 || layout.component[1] < 0 || layout.component[2] < 0){
+        std::cout << "Warning: PLY vertex element has no x, y, z properties.\n";
+        return false;
+    }
+    if(face_elem == elements.size()){
+        elements.push_back(PlyElement{"face", 0, {}}); //point cloud
+        face_elem = elements.size() - 1;
+    }
+    if(elements[face_elem].count > 0 && faceListIndex(elements[face_elem]) < 0){
+        std::cout << "Warning: PLY face element has no vertex_indices list.\n";
+        return false;
+    }
+    if(!plyCountsFit(elements, format, end - body)){
+        std::cout << "Warning: PLY element counts exceed the data size.\n";
+        return false;
+    }
+    bool normals = layout.component[3] >= 0 && layout.component[4] >= 0 && layout.component[5] >= 0;
+    mesh.resizeVertices(elements[vertex_elem].count, normals);
+
+    unsigned workers = workerCount(threads);
+    bool ok;
+    if(format == PLY_ASCII) ok = parsePlyAscii(body, end, elements, vertex_elem, face_elem, mesh, workers);
+    else{
+        uint16_t probe = 1;
+        bool little_endian_host = *(unsigned char*)&probe == 1;
+        bool swap = (format == PLY_BINARY_LE) != little_endian_host;
+        ok = parsePlyBinary(body, end, elements, vertex_elem, face_elem, swap, mesh, workers);
+    }
+    if(!ok){
+        std::cout << "Warning: malformed PLY body.\n";
+        mesh.clear();
+    }
+    return ok;
+}
+
+/**
+ * Memory map and parse an OBJ file
+ * @param path the file to load
+ * @param mesh filled with the parsed mesh
+ * @param threads number of threads, 0 uses every hardware thread
+ * @return whether the file was loaded successfully
+ */
+bool loadOBJ(const std::string& path, Mesh& mesh, unsigned threads){
+    MappedFile file;
+    if(!file.open(path)) return false;
+    return parseOBJ(file.data(), file.size(), mesh, threads);
+}
+
+/**
+ * Memory map and parse a PLY file
+ * @param path the file to load
+ * @param mesh filled with the parsed mesh
+ * @param threads number of threads, 0 uses every hardware thread
+ * @return whether the file was loaded successfully
+ */
+bool loadPLY(const std::string& path, Mesh& mesh, unsigned threads){
+    MappedFile file;
+    if(!file.open(path)) return false;
+    return parsePLY(file.data(), file.size(), mesh, threads);
+}
+
+/**
+ * Load a mesh file, choosing the parser from the file extension (.obj or .ply)
+ * @param path the file to load
+ * @param mesh filled with the parsed mesh
+ * @param threads number of threads, 0 uses every hardware thread
+ * @return whether the file was loaded successfully
+ */
+bool loadMesh(const std::string& path, Mesh& mesh, unsigned threads){
+    std::string ext = extension(path);
+    if(ext == "obj") return loadOBJ(path, mesh, threads);
+    if(ext == "ply") return loadPLY(path, mesh, threads);
+    std::cout << "Warning: unsupported mesh format " << path << "\n";
+    return false;
+}
@@ -0,0 +1,24 @@
+#ifndef GRAPHICSENGINE3D_MESHLOADER_H
+#define GRAPHICSENGINE3D_MESHLOADER_H
+
+#include <stddef.h>
+#include <string>
+#include "mesh.h"
+
+/**
+ * Mesh import for Wavefront OBJ and Stanford PLY (ascii and binary).
+ * Files are memory mapped and split in line aligned chunks that are parsed
+ * by all threads at once: a first pass counts the elements of every chunk,
+ * a prefix sum gives each chunk its output offsets, and a second pass parses
+ * straight into the Mesh streams. No per-vertex strings or vectors are created.
+ * Polygons are fan triangulated. Each function returns false and prints a
+ * warning when the input is malformed; mesh is left empty in that case.
+ * threads == 0 uses every hardware thread.
+ */
+bool loadMesh(const std::string& path, Mesh& mesh, unsigned threads = 0); //dispatch on extension
+bool loadOBJ(const std::string& path, Mesh& mesh, unsigned threads = 0);
+bool loadPLY(const std::string& path, Mesh& mesh, unsigned threads = 0);
+bool parseOBJ(const char* data, size_t size, Mesh& mesh, unsigned threads = 0);
+bool parsePLY(const char* data, size_t size, Mesh& mesh, unsigned threads = 0);
+
+#endif //GRAPHICSENGINE3D_MESHLOADER_H
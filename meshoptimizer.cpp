@@ -0,0 +1,167 @@
+#include "meshoptimizer.h"
+#include "profiler.h"
+#include <vector>
+
+//Implementation details of the vertex cache and vertex fetch optimizers
+
+namespace {
+
+/**
+ * Vertex to triangle adjacency in compressed rows:
+ * the triangles using vertex v are triangles[offsets[v]] ... triangles[offsets[v+1]-1]
+ */
+struct Adjacency{
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+};
+
+void buildAdjacency(const uint32_t* indices, size_t index_count, size_t vertex_count, Adjacency& adj){
+    adj.offsets.assign(vertex_count+1, 0);
+    for(size_t i = 0; i < index_count; i++) adj.offsets[indices[i]+1]++;
+    for(size_t v = 0; v < vertex_count; v++) adj.offsets[v+1] += adj.offsets[v];
+    adj.triangles.resize(index_count);
+    std::vector<uint32_t> fill(adj.offsets.begin(), adj.offsets.end()-1);
+    for(size_t i = 0; i < index_count; i++) adj.triangles[fill[indices[i]]++] = (uint32_t)(i/3);
+}
+
+}
+
+/**
+ * Simulate a FIFO post-transform vertex cache over an index buffer
+ * @param indices 3 vertex indices per triangle
+ * @param index_count number of indices
+ * @param vertex_count number of vertices the indices refer to
+ * @param cache_size number of entries of the simulated cache
+ * @return the cache statistics of the index buffer
+ */
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t index_count, size_t vertex_count,
+                                    unsigned cache_size){
+    VertexCacheStats stats{0, index_count/3, 0, 0.0, 0.0};
+    std::vector<size_t> cached_at(vertex_count, 0); //transform counter when the vertex entered the cache
+    std::vector<bool> seen(vertex_count, false);
+    for(size_t i = 0; i < index_count; i++){
+        uint32_t v = indices[i];
+        if(!seen[v] || stats.transforms - cached_at[v] > cache_size){ //same eviction rule as optimizeVertexCache
+            stats.transforms++;
+            cached_at[v] = stats.transforms - 1;
+            if(!seen[v]){ seen[v] = true; stats.vertices++;}
+        }
+    }
+    if(stats.triangles > 0) stats.acmr = (float)stats.transforms/stats.triangles;
+    if(stats.vertices > 0) stats.atvr = (float)stats.transforms/stats.vertices;
+    return stats;
+}
+
+/**
+ * Reorder triangles for post-transform vertex cache locality with Tipsify
+ * (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality
+ * and Reduced Overdraw", 2007). Runs in linear time: triangles are emitted
+ * in fans around a vertex, and the next fan vertex is the neighbour that is
+ * still in the cache and will stay there while its remaining triangles are emitted.
+ * @param indices 3 vertex indices per triangle, reordered in place
+ * @param index_count number of indices
+ * @param vertex_count number of vertices the indices refer to
+ * @param cache_size number of entries of the target cache
+ */
+void optimizeVertexCache(uint32_t* indices, size_t index_count, size_t vertex_count, unsigned cache_size){
+    PROFILE_ZONE("optimizeVertexCache");
+    size_t tri_count = index_count/3;
+    if(tri_count == 0) return;
+    Adjacency adj;
+    buildAdjacency(indices, index_count, vertex_count, adj);
+
+    std::vector<uint32_t> live(vertex_count);
+    for(size_t v = 0; v < vertex_count; v++) live[v] = adj.offsets[v+1] - adj.offsets[v];
+    std::vector<size_t> cache_time(vertex_count, 0);
+    std::vector<bool> emitted(tri_count, false);
+    std::vector<uint32_t> dead_end;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(index_count);
+    size_t time = cache_size + 1;
+    size_t cursor = 0;
+
+    long long fan = 0;
+    while(fan < (long long)vertex_count && live[fan] == 0) fan++;
+    while(fan >= 0 && fan < (long long)vertex_count){
+        candidates.clear();
+        for(uint32_t k = adj.offsets[fan]; k < adj.offsets[fan+1]; k++){
+            uint32_t t = adj.triangles[k];
+            if(emitted[t]) continue;
+            for(int c = 0; c < 3; c++){
+                uint32_t v = indices[3*t+c];
+                output.push_back(v);
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if(time - cache_time[v] > cache_size){ cache_time[v] = time; time++;}
+            }
+            emitted[t] = true;
+        }
+
+        //pick the candidate still in cache with the oldest entry, so it is used before it is evicted
+        long long next = -1;
+        long long best = -1;
+        for(uint32_t v: candidates){
+            if(live[v] == 0) continue;
+            long long priority = 0;
+            if(time - cache_time[v] + 2*live[v] <= cache_size) priority = time - cache_time[v];
+            if(priority > best){ best = priority; next = v;}
+        }
+        if(next < 0){
+            //dead end: fall back to recently used vertices, then to any vertex with triangles left
+            while(!dead_end.empty()){
+                uint32_t v = dead_end.back();
+                dead_end.pop_back();
+                if(live[v] > 0){ next = v; break;}
+            }
+            while(next < 0 && cursor < vertex_count){
+                if(live[cursor] > 0) next = cursor;
+                cursor++;
+            }
+        }
+        fan = next;
+    }
+    for(size_t i = 0; i < output.size(); i++) indices[i] = output[i];
+}
+
+/**
+ * Reorder vertices in the order the index buffer first references them, so
+ * vertex fetches walk the streams sequentially. Unreferenced vertices are dropped.
+ * Should run after optimizeVertexCache, since it depends on the triangle order.
+ * @param mesh the mesh whose streams and indices are rewritten
+ * @return the new number of vertices
+ */
+size_t optimizeVertexFetch(Mesh& mesh){
+    PROFILE_ZONE("optimizeVertexFetch");
+    const uint32_t UNUSED = 0xffffffffu;
+    size_t vertex_count = mesh.vertexCount();
+    std::vector<uint32_t> remap(vertex_count, UNUSED);
+    uint32_t next = 0;
+    for(auto& idx: mesh.indices){
+        if(remap[idx] == UNUSED) remap[idx] = next++;
+        idx = remap[idx];
+    }
+    std::vector<float> scratch(next);
+    std::vector<float>* streams[6] = {&mesh.px, &mesh.py, &mesh.pz, &mesh.nx, &mesh.ny, &mesh.nz};
+    int stream_count = mesh.hasNormals()? 6: 3;
+    for(int s = 0; s < stream_count; s++){
+        std::vector<float>& stream = *streams[s];
+        for(size_t v = 0; v < vertex_count; v++){
+            if(remap[v] != UNUSED) scratch[remap[v]] = stream[v];
+        }
+        stream.swap(scratch);
+        scratch.resize(next);
+    }
+    return next;
+}
+
+/**
+ * Run the vertex cache then the vertex fetch optimization on a mesh
+ * @param mesh the mesh to optimize in place
+ * @param cache_size number of entries of the target vertex cache
+ */
+void optimizeMesh(Mesh& mesh, unsigned cache_size){
+    optimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertexCount(), cache_size);
+    optimizeVertexFetch(mesh);
+}
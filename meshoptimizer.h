@@ -0,0 +1,31 @@
+#ifndef GRAPHICSENGINE3D_MESHOPTIMIZER_H
+#define GRAPHICSENGINE3D_MESHOPTIMIZER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "mesh.h"
+
+/**
+ * Post-transform vertex cache statistics of an index buffer, simulated
+ * with a FIFO cache of the given size.
+ * acmr: average cache miss ratio, transformed vertices per triangle (0.5 is ideal on large grids, 3 is worst).
+ * atvr: average transform to vertex ratio, transformed vertices per referenced vertex (1 is ideal).
+ */
+struct VertexCacheStats{
+    size_t transforms;
+    size_t triangles;
+    size_t vertices;
+    float acmr;
+    float atvr;
+};
+
+const unsigned DEFAULT_VERTEX_CACHE_SIZE = 16;
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t index_count, size_t vertex_count,
+                                    unsigned cache_size = DEFAULT_VERTEX_CACHE_SIZE);
+void optimizeVertexCache(uint32_t* indices, size_t index_count, size_t vertex_count,
+                         unsigned cache_size = DEFAULT_VERTEX_CACHE_SIZE); //triangle order
+size_t optimizeVertexFetch(Mesh& mesh); //vertex order, returns the new vertex count
+void optimizeMesh(Mesh& mesh, unsigned cache_size = DEFAULT_VERTEX_CACHE_SIZE);
+
+#endif //GRAPHICSENGINE3D_MESHOPTIMIZER_H
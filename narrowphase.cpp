@@ -0,0 +1,574 @@
+#include "narrowphase.h"
+#include "profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <math.h>
+
+//Implementation details of GJK, EPA and the narrowphase
+
+namespace {
+
+/**
+ * Plain 3 float vector kept in registers, with the operators of Vectorf:
+ * ^ is the cross product and * between two vectors the dot product
+ */
+struct Vec3{
+    float x, y, z;
+    Vec3(){}
+    Vec3(float a, float b, float c): x(a), y(b), z(c){}
+    explicit Vec3(const float* p): x(p[0]), y(p[1]), z(p[2]){}
+    void store(float* p) const{ p[0] = x; p[1] = y; p[2] = z;}
+};
+
+inline Vec3 operator+(Vec3 a, Vec3 b){ return Vec3(a.x + b.x, a.y + b.y, a.z + b.z);}
+inline Vec3 operator-(Vec3 a, Vec3 b){ return Vec3(a.x - b.x, a.y - b.y, a.z - b.z);}
+inline Vec3 operator-(Vec3 a){ return Vec3(-a.x, -a.y, -a.z);}
+inline Vec3 operator*(float c, Vec3 a){ return Vec3(c*a.x, c*a.y, c*a.z);}
+inline float operator*(Vec3 a, Vec3 b){ return a.x*b.x + a.y*b.y + a.z*b.z;}
+inline Vec3 operator^(Vec3 a, Vec3 b){ return Vec3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x);}
+
+/**
+ * Rotate v by the unit quaternion q, or by its inverse when inverse is set
+ */
+inline Vec3 rotate(const float q[4], Vec3 v, bool inverse){
+    Vec3 u = inverse? Vec3(-q[0], -q[1], -q[2]): Vec3(q[0], q[1], q[2]);
+    Vec3 t = 2.0f*(u ^ v);
+    return v + q[3]*t + (u ^ t);
+}
+
+/**
+ * Furthest point of the core of a shape along d, in world space
+ */
+Vec3 supportCore(const ShapeInstance& s, Vec3 d){
+    const ConvexShape& shape = *s.shape;
+    Vec3 local = rotate(s.rotation, d, true);
+    Vec3 p(0, 0, 0);
+    switch(shape.type){
+        case SHAPE_BOX:
+            p = Vec3(local.x < 0? -shape.half_extents[0]: shape.half_extents[0],
+                     local.y < 0? -shape.half_extents[1]: shape.half_extents[1],
+                     local.z < 0? -shape.half_extents[2]: shape.half_extents[2]);
+            break;
+        case SHAPE_CAPSULE:
+            p.y = local.y < 0? -shape.half_extents[1]: shape.half_extents[1];
+            break;
+        case SHAPE_HULL:{
+            const float* q = shape.points;
+            float best = -INFINITY;
+            for(size_t i = 0; i < shape.point_count; i++, q += 3){
+                float dot = local.x*q[0] + local.y*q[1] + local.z*q[2];
+                if(dot > best){
+                    best = dot;
+                    p = Vec3(q);
+                }
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return Vec3(s.position) + rotate(s.rotation, p, false);
+}
+
+/**
+ * Point of the Minkowski difference of the cores, with the points of a and b it comes from
+ */
+struct SupportPoint{
+    Vec3 w;
+    Vec3 a;
+    Vec3 b;
+};
+
+inline SupportPoint support(const ShapeInstance& a, const ShapeInstance& b, Vec3 d){
+    SupportPoint p;
+    p.a = supportCore(a, d);
+    p.b = supportCore(b, -d);
+    p.w = p.a - p.b;
+    return p;
+}
+
+struct Simplex{
+    SupportPoint p[4];
+    float weight[4]; //barycentric coordinates of the point closest to the origin
+    int count;
+};
+
+/**
+ * Closest point to the origin of the triangle p[i0] p[i1] p[i2] (Ericson 5.1.5),
+ * written as the smallest sub simplex holding it
+ */
+int closestOnTriangle(const SupportPoint* p, int i0, int i1, int i2, int index[3], float weight[3]){
+    Vec3 a = p[i0].w, b = p[i1].w, c = p[i2].w;
+    Vec3 ab = b - a, ac = c - a;
+    float d1 = -(ab*a), d2 = -(ac*a);
+    if(d1 <= 0 && d2 <= 0){ index[0] = i0; weight[0] = 1; return 1;}
+    float d3 = -(ab*b), d4 = -(ac*b);
+    if(d3 >= 0 && d4 <= d3){ index[0] = i1; weight[0] = 1; return 1;}
+    float vc = d1*d4 - d3*d2;
+    if(vc <= 0 && d1 >= 0 && d3 <= 0){
+        float v = d1/(d1 - d3);
+        index[0] = i0; index[1] = i1; weight[0] = 1 - v; weight[1] = v;
+        return 2;
+    }
+    float d5 = -(ab*c), d6 = -(ac*c);
+    if(d6 >= 0 && d5 <= d6){ index[0] = i2; weight[0] = 1; return 1;}
+    float vb = d5*d2 - d1*d6;
+    if(vb <= 0 && d2 >= 0 && d6 <= 0){
+        float w = d2/(d2 - d6);
+        index[0] = i0; index[1] = i2; weight[0] = 1 - w; weight[1] = w;
+        return 2;
+    }
+    float va = d3*d6 - d5*d4;
+    if(va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0){
+        float w = (d4 - d3)/((d4 - d3) + (d5 - d6));
+        index[0] = i1; index[1] = i2; weight[0] = 1 - w; weight[1] = w;
+        return 2;
+    }
+    float denom = 1/(va + vb + vc);
+    float v = vb*denom, w = vc*denom;
+    index[0] = i0; index[1] = i1; index[2] = i2;
+    weight[0] = 1 - v - w; weight[1] = v; weight[2] = w;
+    return 3;
+}
+
+/**
+ * Replace the simplex by the smallest sub simplex holding its point closest to the origin
+ * @return that point; the simplex keeps 4 points only when it contains the origin
+ */
+Vec3 reduceSimplex(Simplex& s){
+    int index[3] = {0, 0, 0};
+    float weight[3] = {1, 0, 0};
+    int count = 1;
+    if(s.count == 2){
+        Vec3 ab = s.p[1].w - s.p[0].w;
+        float t = -(s.p[0].w*ab)/(ab*ab);
+        if(!(t > 0)) count = 1;
+        else if(t >= 1){ index[0] = 1;}
+        else{ count = 2; index[1] = 1; weight[0] = 1 - t; weight[1] = t;}
+    }
+    else if(s.count == 3){
+        count = closestOnTriangle(s.p, 0, 1, 2, index, weight);
+    }
+    else if(s.count == 4){
+        //faces and their opposite vertex; faces the origin is outside of are candidates
+        static const int faces[4][4] = {{0, 1, 2, 3}, {0, 2, 3, 1}, {0, 3, 1, 2}, {1, 3, 2, 0}};
+        float best = INFINITY;
+        bool inside = true;
+        for(int f = 0; f < 4; f++){
+            const int* v = faces[f];
+            Vec3 a = s.p[v[0]].w;
+            Vec3 n = (s.p[v[1]].w - a) ^ (s.p[v[2]].w - a);
+            float side_origin = -(n*a), side_opposite = n*(s.p[v[3]].w - a);
+            if(side_origin*side_opposite >= 0 && fabsf(side_opposite) > 1e-12f) continue;
+            inside = false;
+            int fi[3];
+            float fw[3];
+            int fc = closestOnTriangle(s.p, v[0], v[1], v[2], fi, fw);
+            Vec3 c(0, 0, 0);
+            for(int k = 0; k < fc; k++) c = c + fw[k]*s.p[fi[k]].w;
+            if(c*c < best){
+                best = c*c;
+                count = fc;
+                for(int k = 0; k < fc; k++){ index[k] = fi[k]; weight[k] = fw[k];}
+            }
+        }
+        if(inside){
+            for(int k = 0; k < 4; k++) s.weight[k] = 0.25f;
+            return Vec3(0, 0, 0);
+        }
+    }
+    SupportPoint kept[3];
+    for(int k = 0; k < count; k++) kept[k] = s.p[index[k]];
+    Vec3 v(0, 0, 0);
+    for(int k = 0; k < count; k++){
+        s.p[k] = kept[k];
+        s.weight[k] = weight[k];
+        v = v + weight[k]*kept[k].w;
+    }
+    s.count = count;
+    return v;
+}
+
+struct GJKResult{
+    bool separated; //further apart than the early out distance
+    bool overlap; //the cores intersect
+    Vec3 v; //point of the Minkowski difference closest to the origin
+    Vec3 point_a;
+    Vec3 point_b;
+    int iterations;
+};
+
+/**
+ * Distance between the cores of two shapes
+ * @param guess first search direction, e.g. the result of the last frame
+ * @param early_out stop as soon as the cores are known to be further apart than this
+ */
+void gjk(const ShapeInstance& a, const ShapeInstance& b, Vec3 guess, float early_out, Simplex& s, GJKResult& r){
+    Vec3 v = guess;
+    if(!(v*v > 1e-12f)) v = Vec3(a.position) - Vec3(b.position);
+    if(!(v*v > 1e-12f)) v = Vec3(1, 0, 0);
+    s.count = 0;
+    r.separated = false;
+    r.overlap = false;
+    float limit = early_out*early_out;
+    for(r.iterations = 1; r.iterations <= GJK_MAX_ITERATIONS; r.iterations++){
+        SupportPoint w = support(a, b, -v);
+        float vv = v*v, vw = v*w.w;
+        if(vw > 0 && vw*vw > vv*limit){
+            r.separated = true;
+            r.v = v;
+            return;
+        }
+        bool repeated = false;
+        for(int k = 0; k < s.count; k++) repeated = repeated || (s.p[k].w - w.w)*(s.p[k].w - w.w) < 1e-12f;
+        if(s.count > 0 && (repeated || vv - vw <= 1e-6f*vv)) break;
+        //float rounding on an almost flat simplex can move v away; keep the last progress instead
+        Simplex previous = s;
+        s.p[s.count++] = w;
+        Vec3 next = reduceSimplex(s);
+        if(previous.count > 0 && s.count < 4 && next*next >= vv){
+            s = previous;
+            break;
+        }
+        v = next;
+        if(s.count == 4 || v*v < 1e-10f){
+            r.overlap = true;
+            break;
+        }
+    }
+    r.iterations = std::min(r.iterations, GJK_MAX_ITERATIONS);
+    r.v = v;
+    r.point_a = Vec3(0, 0, 0);
+    r.point_b = Vec3(0, 0, 0);
+    for(int k = 0; k < s.count; k++){
+        r.point_a = r.point_a + s.weight[k]*s.p[k].a;
+        r.point_b = r.point_b + s.weight[k]*s.p[k].b;
+    }
+}
+
+/**
+ * Grow the simplex GJK stopped with into a tetrahedron, for EPA
+ * @return false when the Minkowski difference is flat
+ */
+bool completeSimplex(const ShapeInstance& a, const ShapeInstance& b, Simplex& s){
+    static const Vec3 axes[3] = {Vec3(1, 0, 0), Vec3(0, 1, 0), Vec3(0, 0, 1)};
+    if(s.count == 0) s.p[s.count++] = support(a, b, Vec3(1, 0, 0));
+    if(s.count == 1){
+        for(int k = 0; k < 6 && s.count == 1; k++){
+            SupportPoint p = support(a, b, (k < 3? 1.0f: -1.0f)*axes[k%3]);
+            Vec3 d = p.w - s.p[0].w;
+            if(d*d > 1e-10f) s.p[s.count++] = p;
+        }
+    }
+    if(s.count == 2){
+        Vec3 e = s.p[1].w - s.p[0].w;
+        for(int k = 0; k < 6 && s.count == 2; k++){
+            Vec3 dir = e ^ axes[k%3];
+            if(dir*dir < 1e-12f) continue;
+            SupportPoint p = support(a, b, (k < 3? 1.0f: -1.0f)*dir);
+            Vec3 c = e ^ (p.w - s.p[0].w);
+            if(c*c > 1e-10f*(e*e)) s.p[s.count++] = p;
+        }
+    }
+    if(s.count == 3){
+        Vec3 n = (s.p[1].w - s.p[0].w) ^ (s.p[2].w - s.p[0].w);
+        for(int k = 0; k < 2 && s.count == 3; k++){
+            SupportPoint p = support(a, b, k == 0? n: -n);
+            float h = n*(p.w - s.p[0].w);
+            if(h*h > 1e-10f*(n*n)) s.p[s.count++] = p;
+        }
+    }
+    return s.count == 4;
+}
+
+struct EPAFace{
+    int v[3];
+    Vec3 n; //unit, pointing away from the origin
+    float d; //distance of the plane to the origin
+};
+
+bool makeFace(const SupportPoint* vertices, int i0, int i1, int i2, EPAFace& f){
+    Vec3 a = vertices[i0].w;
+    Vec3 n = (vertices[i1].w - a) ^ (vertices[i2].w - a);
+    float len = sqrtf(n*n);
+    if(!(len > 1e-12f)) return false;
+    f.v[0] = i0; f.v[1] = i1; f.v[2] = i2;
+    f.n = (1/len)*n;
+    f.d = f.n*a;
+    return true;
+}
+
+/**
+ * Expanding polytope: penetration of the cores, from a tetrahedron around the origin
+ * @param normal set to the direction of least penetration, from a towards b
+ * @return penetration depth of the cores, -1 when the polytope degenerated
+ */
+float epa(const ShapeInstance& a, const ShapeInstance& b, const Simplex& s, Vec3& normal, Vec3& point_a, Vec3& point_b){
+    SupportPoint vertices[EPA_MAX_VERTICES];
+    EPAFace faces[EPA_MAX_FACES];
+    int edges[3*EPA_MAX_FACES][2];
+    int vertex_count = 4, face_count = 0;
+    for(int k = 0; k < 4; k++) vertices[k] = s.p[k];
+    static const int tetra[4][4] = {{0, 1, 2, 3}, {0, 3, 1, 2}, {0, 2, 3, 1}, {1, 3, 2, 0}};
+    for(int f = 0; f < 4; f++){
+        const int* t = tetra[f];
+        Vec3 n = (vertices[t[1]].w - vertices[t[0]].w) ^ (vertices[t[2]].w - vertices[t[0]].w);
+        bool flip = n*(vertices[t[3]].w - vertices[t[0]].w) > 0;
+        if(makeFace(vertices, t[0], flip? t[2]: t[1], flip? t[1]: t[2], faces[face_count])) face_count++;
+    }
+    if(face_count < 4) return -1;
+
+    int closest = 0;
+    for(int iteration = 0; iteration < GJK_MAX_ITERATIONS; iteration++){
+        closest = 0;
+        for(int f = 1; f < face_count; f++) if(faces[f].d < faces[closest].d) closest = f;
+        EPAFace face = faces[closest];
+        SupportPoint w = support(a, b, face.n);
+        float grow = face.n*w.w - face.d;
+        if(grow < 1e-4f*std::max(1.0f, face.d) || vertex_count == EPA_MAX_VERTICES) break;
+        int added = vertex_count++;
+        vertices[added] = w;
+
+        //drop the faces w sees and keep the edges they share with no other dropped face
+        int edge_count = 0, kept = 0;
+        for(int f = 0; f < face_count; f++){
+            if(faces[f].n*(w.w - vertices[faces[f].v[0]].w) <= 0){
+                faces[kept++] = faces[f];
+                continue;
+            }
+            for(int e = 0; e < 3; e++){
+                int e0 = faces[f].v[e], e1 = faces[f].v[(e + 1)%3];
+                bool shared = false;
+                for(int k = 0; k < edge_count && !shared; k++){
+                    if(edges[k][0] == e1 && edges[k][1] == e0){
+                        edges[k][0] = edges[--edge_count][0];
+                        edges[k][1] = edges[edge_count][1];
+                        shared = true;
+                    }
+                }
+                if(!shared){
+                    edges[edge_count][0] = e0;
+                    edges[edge_count][1] = e1;
+                    edge_count++;
+                }
+            }
+        }
+        if(kept + edge_count > EPA_MAX_FACES){
+            faces[0] = face;
+            face_count = 1;
+            break;
+        }
+        face_count = kept;
+        for(int e = 0; e < edge_count; e++){
+            if(makeFace(vertices, edges[e][0], edges[e][1], added, faces[face_count])) face_count++;
+        }
+        if(face_count == 0) return -1;
+    }
+    closest = 0;
+    for(int f = 1; f < face_count; f++) if(faces[f].d < faces[closest].d) closest = f;
+    const EPAFace& face = faces[closest];
+
+    //barycentric coordinates of the origin projected on the face
+    Vec3 p = face.d*face.n;
+    const SupportPoint& v0 = vertices[face.v[0]];
+    const SupportPoint& v1 = vertices[face.v[1]];
+    const SupportPoint& v2 = vertices[face.v[2]];
+    Vec3 e0 = v1.w - v0.w, e1 = v2.w - v0.w, e2 = p - v0.w;
+    float d00 = e0*e0, d01 = e0*e1, d11 = e1*e1, d20 = e2*e0, d21 = e2*e1;
+    float denom = d00*d11 - d01*d01;
+    float u1 = denom != 0? (d11*d20 - d01*d21)/denom: 0.0f;
+    float u2 = denom != 0? (d00*d21 - d01*d20)/denom: 0.0f;
+    float u0 = 1 - u1 - u2;
+    point_a = u0*v0.a + u1*v1.a + u2*v2.a;
+    point_b = u0*v0.b + u1*v1.b + u2*v2.b;
+    normal = face.n;
+    return face.d;
+}
+
+/**
+ * Contact of two shapes and the number of GJK iterations it took
+ */
+bool collide(const ShapeInstance& a, const ShapeInstance& b, Contact& contact, float* direction, int& iterations){
+    float margin = a.shape->radius + b.shape->radius;
+    Vec3 guess = direction? Vec3(direction): Vec3(0, 0, 0);
+    Simplex s;
+    GJKResult r;
+    gjk(a, b, guess, margin, s, r);
+    iterations = r.iterations;
+    if(direction) r.v.store(direction);
+    if(r.separated){
+        contact.depth = -INFINITY;
+        return false;
+    }
+    Vec3 normal, pa, pb;
+    float depth;
+    if(!r.overlap){
+        float distance = sqrtf(r.v*r.v);
+        normal = (-1/distance)*r.v;
+        depth = margin - distance;
+        pa = r.point_a;
+        pb = r.point_b;
+    }
+    else{
+        float core_depth = completeSimplex(a, b, s)? epa(a, b, s, normal, pa, pb): -1;
+        if(core_depth < 0){
+            //flat Minkowski difference: the cores just touch
+            normal = Vec3(b.position) - Vec3(a.position);
+            if(!(normal*normal > 1e-12f)) normal = Vec3(0, 1, 0);
+            normal = (1/sqrtf(normal*normal))*normal;
+            core_depth = 0;
+            pa = r.point_a;
+            pb = r.point_b;
+        }
+        depth = margin + core_depth;
+        if(direction) (-normal).store(direction);
+    }
+    (pa + a.shape->radius*normal).store(contact.point_a);
+    (pb - b.shape->radius*normal).store(contact.point_b);
+    normal.store(contact.normal);
+    contact.depth = depth;
+    return depth >= 0;
+}
+
+}
+
+// ====== Shapes ======
+
+ConvexShape makeSphere(float radius){
+    return ConvexShape{SHAPE_SPHERE, radius, {0, 0, 0}, nullptr, 0};
+}
+
+ConvexShape makeBox(const float half_extents[3], float radius){
+    return ConvexShape{SHAPE_BOX, radius, {half_extents[0], half_extents[1], half_extents[2]}, nullptr, 0};
+}
+
+/**
+ * @param half_height half the length of the segment between the centers of the caps
+ */
+ConvexShape makeCapsule(float radius, float half_height){
+    return ConvexShape{SHAPE_CAPSULE, radius, {0, half_height, 0}, nullptr, 0};
+}
+
+/**
+ * @param points 3 floats per vertex, kept by pointer so they must outlive the shape;
+ * points inside the hull are allowed but cost support time
+ */
+ConvexShape makeHull(const float* points, size_t point_count, float radius){
+    return ConvexShape{SHAPE_HULL, radius, {0, 0, 0}, points, point_count};
+}
+
+/**
+ * Axis aligned bounds of a placed shape, e.g. for ColliderBounds::set()
+ */
+void shapeBounds(const ShapeInstance& shape, float bmin[3], float bmax[3]){
+    static const Vec3 axes[3] = {Vec3(1, 0, 0), Vec3(0, 1, 0), Vec3(0, 0, 1)};
+    float r = shape.shape->radius;
+    for(int k = 0; k < 3; k++){
+        bmax[k] = supportCore(shape, axes[k])*axes[k] + r;
+        bmin[k] = supportCore(shape, -axes[k])*axes[k] - r;
+    }
+}
+
+// ====== GJK and EPA ======
+
+/**
+ * Contact between two convex shapes: GJK on the cores, then EPA when they overlap
+ * @param contact filled when the shapes touch (a and b are left to the caller)
+ * @param direction optional, in: separating direction of the last frame, out: the one of this frame
+ * @return true when the shapes touch
+ */
+bool collideShapes(const ShapeInstance& a, const ShapeInstance& b, Contact& contact, float* direction){
+    int iterations;
+    return collide(a, b, contact, direction, iterations);
+}
+
+/**
+ * Distance between the surfaces of two shapes, with the closest points
+ * @return 0 and the points of the deepest contact when they intersect
+ */
+float shapeDistance(const ShapeInstance& a, const ShapeInstance& b, float point_a[3], float point_b[3]){
+    Simplex s;
+    GJKResult r;
+    gjk(a, b, Vec3(0, 0, 0), INFINITY, s, r);
+    float distance = sqrtf(r.v*r.v);
+    float margin = a.shape->radius + b.shape->radius;
+    if(r.overlap || distance <= margin){
+        Contact contact;
+        collideShapes(a, b, contact);
+        for(int c = 0; c < 3; c++){ point_a[c] = contact.point_a[c]; point_b[c] = contact.point_b[c];}
+        return 0;
+    }
+    Vec3 n = (-1/distance)*r.v;
+    (r.point_a + a.shape->radius*n).store(point_a);
+    (r.point_b - b.shape->radius*n).store(point_b);
+    return distance - margin;
+}
+
+// ====== Narrowphase ======
+
+Narrowphase::Narrowphase(){
+    iterations = 0;
+}
+
+/**
+ * Contacts of every touching pair
+ * @param shapes the colliders the pairs index
+ * @param pairs candidate pairs, e.g. from SweepAndPrune or SpatialHashGrid
+ * @param contacts replaced by the contacts, in the order of the pairs
+ */
+void Narrowphase::findContacts(JobSystem& jobs, const std::vector<ShapeInstance>& shapes,
+                               const std::vector<ColliderPair>& pairs, std::vector<Contact>& contacts){
+    PROFILE_ZONE("Narrowphase::findContacts");
+    size_t n = pairs.size();
+    results.resize(n);
+    touching.assign(n, 0);
+    next_cache.resize(n);
+    std::atomic<size_t> total(0);
+    jobs.parallelFor(0, n, [&](size_t begin, size_t end){
+        size_t local = 0;
+        for(size_t i = begin; i < end; i++){
+            const ColliderPair& pair = pairs[i];
+            CachedDirection& next = next_cache[i];
+            next.key = (uint64_t)pair.a << 32 | pair.b;
+            next.direction[0] = next.direction[1] = next.direction[2] = 0;
+            if(pair.a >= shapes.size() || pair.b >= shapes.size()) continue;
+            auto found = std::lower_bound(cache.begin(), cache.end(), next.key,
+                                          [](const CachedDirection& c, uint64_t key){ return c.key < key;});
+            if(found != cache.end() && found->key == next.key){
+                for(int c = 0; c < 3; c++) next.direction[c] = found->direction[c];
+            }
+            int its;
+            Contact& contact = results[i];
+            touching[i] = collide(shapes[pair.a], shapes[pair.b], contact, next.direction, its);
+            contact.a = pair.a;
+            contact.b = pair.b;
+            local += its;
+        }
+        total += local;
+    }, 256);
+    iterations = total;
+
+    contacts.clear();
+    for(size_t i = 0; i < n; i++){
+        if(touching[i]) contacts.push_back(results[i]);
+        else if(pairs[i].a >= shapes.size() || pairs[i].b >= shapes.size()){
+            std::cout << "Warning: pair " << pairs[i].a << " " << pairs[i].b << " outside of "
+                      << shapes.size() << " shapes\n";
+        }
+    }
+    std::sort(next_cache.begin(), next_cache.end(),
+              [](const CachedDirection& x, const CachedDirection& y){ return x.key < y.key;});
+    cache.swap(next_cache);
+}
+
+size_t Narrowphase::lastIterations() const{
+    return iterations;
+}
+
+/**
+ * Forget the directions of the last frame, e.g. after teleporting the shapes
+ */
+void Narrowphase::clearCache(){
+    cache.clear();
+}
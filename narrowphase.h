@@ -0,0 +1,88 @@
+#ifndef GRAPHICSENGINE3D_NARROWPHASE_H
+#define GRAPHICSENGINE3D_NARROWPHASE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "broadphase.h"
+#include "jobsystem.h"
+
+const int GJK_MAX_ITERATIONS = 64;
+const int EPA_MAX_VERTICES = 64;
+const int EPA_MAX_FACES = 128;
+
+enum ShapeType{
+    SHAPE_SPHERE,
+    SHAPE_BOX,
+    SHAPE_CAPSULE,
+    SHAPE_HULL
+};
+
+/**
+ * Convex shape in its local frame: a core (point, box, segment or point cloud)
+ * inflated by a radius. GJK and EPA run on the cores and add the radii after,
+ * so spheres and capsules are exact and rounded boxes or hulls come for free.
+ */
+struct ConvexShape{
+    ShapeType type;
+    float radius;
+    float half_extents[3]; //box; a capsule's segment runs along y from -half_extents[1] to half_extents[1]
+    const float* points; //hull vertices, 3 floats each, not owned
+    size_t point_count;
+};
+
+ConvexShape makeSphere(float radius);
+ConvexShape makeBox(const float half_extents[3], float radius = 0);
+ConvexShape makeCapsule(float radius, float half_height);
+ConvexShape makeHull(const float* points, size_t point_count, float radius = 0);
+
+/**
+ * Shape placed in the world
+ */
+struct ShapeInstance{
+    const ConvexShape* shape;
+    float position[3];
+    float rotation[4]; //unit quaternion (x, y, z, w), as in PhysicsWorld
+};
+
+/**
+ * Deepest point of contact between two shapes
+ */
+struct Contact{
+    uint32_t a;
+    uint32_t b;
+    float normal[3]; //unit, from a towards b
+    float depth; //penetration, negative for the separation of shapes that don't touch
+    float point_a[3]; //on the surface of a, deepest inside b
+    float point_b[3]; //on the surface of b, deepest inside a
+};
+
+bool collideShapes(const ShapeInstance& a, const ShapeInstance& b, Contact& contact, float* direction = nullptr);
+float shapeDistance(const ShapeInstance& a, const ShapeInstance& b, float point_a[3], float point_b[3]);
+void shapeBounds(const ShapeInstance& shape, float bmin[3], float bmax[3]);
+
+/**
+ * Contacts of the broadphase pairs, computed in parallel. The separating
+ * direction found for every pair seeds GJK on the next frame, so coherent
+ * motion converges in a couple of iterations. Nothing is allocated per pair.
+ */
+class Narrowphase{
+public:
+    Narrowphase();
+    void findContacts(JobSystem& jobs, const std::vector<ShapeInstance>& shapes,
+                      const std::vector<ColliderPair>& pairs, std::vector<Contact>& contacts);
+    size_t lastIterations() const; //GJK iterations of the last findContacts call
+    void clearCache();
+private:
+    struct CachedDirection{
+        uint64_t key; //a << 32 | b
+        float direction[3];
+    };
+    std::vector<CachedDirection> cache; //sorted by key
+    std::vector<CachedDirection> next_cache;
+    std::vector<Contact> results;
+    std::vector<uint8_t> touching;
+    size_t iterations;
+};
+
+#endif //GRAPHICSENGINE3D_NARROWPHASE_H
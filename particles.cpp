@@ -0,0 +1,258 @@
+#include "particles.h"
+#include "profiler.h"
+#include "simd.h"
+#include <algorithm>
+#include <math.h>
+
+//Implementation details of the particle system
+
+namespace {
+
+/**
+ * Sine of x in [-pi, pi], parabola refined once, within 0.001 of sinf
+ */
+inline Float4 sinApprox(Float4 x){
+    Float4 y = Float4(1.27323954f)*x - Float4(0.405284735f)*x*abs(x);
+    return Float4(0.225f)*(y*abs(y) - y) + y;
+}
+
+inline void sinCos(Float4 x, Float4& s, Float4& c){
+    Float4 two_pi(6.28318531f), pi(3.14159265f);
+    Float4 wrapped = x - two_pi*floor(x*Float4(0.159154943f) + Float4(0.5f));
+    s = sinApprox(wrapped);
+    //cos x = sin(x + pi/2), wrapped back to [-pi, pi]
+    Float4 shifted = wrapped + Float4(1.57079633f);
+    c = sinApprox(shifted - ((shifted > pi) & two_pi));
+}
+
+/**
+ * Curl of the potential (sin Y cos Z, sin Z cos X, sin X cos Y), divided by the frequency,
+ * with X, Y and Z the scaled coordinates drifting with time. Divergence free, so it
+ * stirs particles without bunching them up; components stay within [-2, 2].
+ */
+inline void curl4(Float4 x, Float4 y, Float4 z, Float4 frequency, Float4 t[3], Float4& cx, Float4& cy, Float4& cz){
+    Float4 sx, cosx, sy, cosy, sz, cosz;
+    sinCos(frequency*x + t[0], sx, cosx);
+    sinCos(frequency*y + t[1], sy, cosy);
+    sinCos(frequency*z + t[2], sz, cosz);
+    Float4 zero(0.0f);
+    cx = zero - (sx*sy + cosz*cosx);
+    cy = zero - (sy*sz + cosx*cosy);
+    cz = zero - (sz*sx + cosy*cosz);
+}
+
+inline void curlPhases(float time, Float4 t[3]){
+    t[0] = Float4(time);
+    t[1] = Float4(1.3f*time);
+    t[2] = Float4(0.7f*time);
+}
+
+inline size_t padLanes(size_t count){
+    return (count + 3) & ~(size_t)3;
+}
+
+}
+
+ParticleSystem::ParticleSystem(JobSystem& job_system, size_t capacity){
+    jobs = &job_system;
+    max_particles = capacity;
+    live = 0;
+    for(int s = 0; s < PARTICLE_STREAM_COUNT; s++){
+        streams[s].assign(padLanes(capacity), 0.0f);
+        back[s].assign(padLanes(capacity), 0.0f);
+    }
+    gravity[0] = 0; gravity[1] = -9.81f; gravity[2] = 0;
+    drag = 0;
+    curl_strength = 0;
+    curl_frequency = 1;
+    time = 0;
+    color[0] = color[1] = color[2] = 1;
+    fade_time = 0;
+    seed = 0x9e3779b9u;
+}
+
+/**
+ * Uniform in [0, 1)
+ */
+float ParticleSystem::random(){
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return (seed >> 8)*(1.0f/16777216.0f);
+}
+
+/**
+ * Spawn particles after the live ones
+ * @return the number spawned, less than count when the capacity is reached
+ */
+size_t ParticleSystem::emit(const ParticleEmitter& emitter, size_t count){
+    size_t n = std::min(count, max_particles - live);
+    float* p[PARTICLE_STREAM_COUNT];
+    for(int s = 0; s < PARTICLE_STREAM_COUNT; s++) p[s] = streams[s].data() + live;
+    for(size_t i = 0; i < n; i++){
+        for(int c = 0; c < 3; c++){
+            p[PARTICLE_PX + c][i] = emitter.position[c];
+            p[PARTICLE_VX + c][i] = emitter.velocity[c] + emitter.spread*(2*random() - 1);
+        }
+        p[PARTICLE_LIFE][i] = emitter.lifetime[0] + (emitter.lifetime[1] - emitter.lifetime[0])*random();
+        p[PARTICLE_SIZE][i] = emitter.size;
+    }
+    live += n;
+    return n;
+}
+
+/**
+ * Advance every particle by dt and remove the ones whose life ran out
+ */
+void ParticleSystem::update(float dt){
+    PROFILE_ZONE("ParticleSystem::update");
+    size_t chunks = (live + PARTICLE_CHUNK - 1)/PARTICLE_CHUNK;
+    chunk_offsets.assign(chunks + 1, 0);
+    const float* life = streams[PARTICLE_LIFE].data();
+    jobs->parallelFor(0, chunks, [&](size_t begin, size_t end){
+        for(size_t chunk = begin; chunk < end; chunk++){
+            size_t first = chunk*PARTICLE_CHUNK, last = std::min(live, first + PARTICLE_CHUNK);
+            size_t alive = 0;
+            for(size_t i = first; i < last; i++) alive += life[i] > dt;
+            chunk_offsets[chunk + 1] = alive;
+        }
+    }, 1);
+    for(size_t chunk = 0; chunk < chunks; chunk++) chunk_offsets[chunk + 1] += chunk_offsets[chunk];
+
+    jobs->parallelFor(0, chunks, [&](size_t begin, size_t end){
+        const float* in[PARTICLE_STREAM_COUNT];
+        float* out[PARTICLE_STREAM_COUNT];
+        for(int s = 0; s < PARTICLE_STREAM_COUNT; s++){
+            in[s] = streams[s].data();
+            out[s] = back[s].data();
+        }
+        Float4 h(dt), keep(1/(1 + dt*drag)), strength(curl_strength), frequency(curl_frequency);
+        Float4 g[3] = {Float4(gravity[0]), Float4(gravity[1]), Float4(gravity[2])};
+        Float4 phases[3];
+        curlPhases(time, phases);
+        bool curl = curl_strength != 0;
+        for(size_t chunk = begin; chunk < end; chunk++){
+            size_t first = chunk*PARTICLE_CHUNK, last = std::min(live, first + PARTICLE_CHUNK);
+            size_t o = chunk_offsets[chunk];
+            for(size_t i = first; i < last; i += 4){
+                Float4 life4 = Float4::load(in[PARTICLE_LIFE] + i);
+                int lanes = (int)std::min<size_t>(4, last - i);
+                int bits = mask(life4 > h) & ((1 << lanes) - 1);
+                if(bits == 0) continue;
+                Float4 v[PARTICLE_STREAM_COUNT];
+                for(int c = 0; c < 3; c++){
+                    v[PARTICLE_PX + c] = Float4::load(in[PARTICLE_PX + c] + i);
+                    v[PARTICLE_VX + c] = Float4::load(in[PARTICLE_VX + c] + i) + h*g[c];
+                }
+                if(curl){
+                    Float4 c[3];
+                    curl4(v[PARTICLE_PX], v[PARTICLE_PY], v[PARTICLE_PZ], frequency, phases, c[0], c[1], c[2]);
+                    for(int k = 0; k < 3; k++) v[PARTICLE_VX + k] = v[PARTICLE_VX + k] + h*strength*c[k];
+                }
+                for(int c = 0; c < 3; c++){
+                    v[PARTICLE_VX + c] = v[PARTICLE_VX + c]*keep;
+                    v[PARTICLE_PX + c] = v[PARTICLE_PX + c] + h*v[PARTICLE_VX + c];
+                }
+                v[PARTICLE_LIFE] = life4 - h;
+                v[PARTICLE_SIZE] = Float4::load(in[PARTICLE_SIZE] + i);
+
+                if(bits == 15){
+                    for(int s = 0; s < PARTICLE_STREAM_COUNT; s++) v[s].store(out[s] + o);
+                    o += 4;
+                    continue;
+                }
+                float lanes_out[PARTICLE_STREAM_COUNT][4];
+                for(int s = 0; s < PARTICLE_STREAM_COUNT; s++) v[s].store(lanes_out[s]);
+                for(int lane = 0; lane < 4; lane++){
+                    if(!(bits >> lane & 1)) continue;
+                    for(int s = 0; s < PARTICLE_STREAM_COUNT; s++) out[s][o] = lanes_out[s][lane];
+                    o++;
+                }
+            }
+        }
+    }, 1);
+
+    for(int s = 0; s < PARTICLE_STREAM_COUNT; s++) streams[s].swap(back[s]);
+    live = chunk_offsets[chunks];
+    time += dt;
+    PROFILE_COUNTER("Live particles", live);
+}
+
+void ParticleSystem::setGravity(const float g[3]){
+    for(int c = 0; c < 3; c++) gravity[c] = g[c];
+}
+
+void ParticleSystem::setDrag(float d){
+    drag = std::max(0.0f, d);
+}
+
+/**
+ * @param strength acceleration scale of the curl noise field, 0 turns it off
+ * @param frequency spatial frequency, features are about 2 pi/frequency wide
+ */
+void ParticleSystem::setCurlNoise(float strength, float frequency){
+    curl_strength = strength;
+    curl_frequency = frequency;
+}
+
+void ParticleSystem::setColor(const float rgb[3], float fade){
+    for(int c = 0; c < 3; c++) color[c] = rgb[c];
+    fade_time = std::max(0.0f, fade);
+}
+
+const float* ParticleSystem::getColor() const{
+    return color;
+}
+
+float ParticleSystem::getFadeTime() const{
+    return fade_time;
+}
+
+size_t ParticleSystem::count() const{
+    return live;
+}
+
+size_t ParticleSystem::capacity() const{
+    return max_particles;
+}
+
+/**
+ * count() floats, followed by padding up to a multiple of 4
+ */
+const float* ParticleSystem::stream(ParticleStream s) const{
+    return streams[s].data();
+}
+
+float* ParticleSystem::stream(ParticleStream s){
+    return streams[s].data();
+}
+
+// ====== Curl noise ======
+
+/**
+ * Sample the curl noise velocity field used by ParticleSystem::update()
+ * @param px, py, pz SoA positions
+ * @param count number of positions
+ * @param frequency spatial frequency of the field
+ * @param time animation time of the field, in seconds
+ * @param cx, cy, cz filled with the field, components within [-2, 2]
+ */
+void curlNoise(const float* px, const float* py, const float* pz, size_t count, float frequency, float time,
+               float* cx, float* cy, float* cz){
+    Float4 phases[3];
+    curlPhases(time, phases);
+    Float4 f(frequency);
+    for(size_t i = 0; i < count; i += 4){
+        float x[4] = {0, 0, 0, 0}, y[4] = {0, 0, 0, 0}, z[4] = {0, 0, 0, 0};
+        size_t lanes = std::min<size_t>(4, count - i);
+        std::copy(px + i, px + i + lanes, x);
+        std::copy(py + i, py + i + lanes, y);
+        std::copy(pz + i, pz + i + lanes, z);
+        Float4 c[3];
+        curl4(Float4::load(x), Float4::load(y), Float4::load(z), f, phases, c[0], c[1], c[2]);
+        c[0].store(x); c[1].store(y); c[2].store(z);
+        std::copy(x, x + lanes, cx + i);
+        std::copy(y, y + lanes, cy + i);
+        std::copy(z, z + lanes, cz + i);
+    }
+}
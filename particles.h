@@ -0,0 +1,81 @@
+#ifndef GRAPHICSENGINE3D_PARTICLES_H
+#define GRAPHICSENGINE3D_PARTICLES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "jobsystem.h"
+
+const size_t PARTICLE_CHUNK = 16384; //particles per update job, a multiple of 4
+
+/**
+ * Per particle streams of a ParticleSystem, one float per particle each
+ */
+enum ParticleStream{
+    PARTICLE_PX, PARTICLE_PY, PARTICLE_PZ,
+    PARTICLE_VX, PARTICLE_VY, PARTICLE_VZ,
+    PARTICLE_LIFE, //seconds left, the particle dies when it runs out
+    PARTICLE_SIZE, //sprite radius in world units
+    PARTICLE_STREAM_COUNT
+};
+
+/**
+ * Spawn parameters of a burst of particles
+ */
+struct ParticleEmitter{
+    float position[3];
+    float velocity[3];
+    float spread; //random velocity added, uniform in a cube of this half size
+    float lifetime[2]; //uniform between min and max, in seconds
+    float size;
+};
+
+/**
+ * Particles stored as structure of arrays, in 4 float lanes: every stream is
+ * padded to a multiple of 4 so the kernels never need a scalar tail.
+ * update() integrates gravity, drag and a curl noise velocity field, 4
+ * particles at a time, in parallel chunks of PARTICLE_CHUNK particles. Dead
+ * particles are removed by stream compaction: the survivors of every chunk
+ * are counted first, then written to their prefix sum offsets in a second set
+ * of streams by the same pass that updates them, keeping their order.
+ */
+class ParticleSystem{
+public:
+    ParticleSystem(JobSystem& jobs, size_t capacity);
+    size_t emit(const ParticleEmitter& emitter, size_t count);
+    void update(float dt);
+
+    void setGravity(const float gravity[3]);
+    void setDrag(float drag); //fraction of the velocity lost per second
+    void setCurlNoise(float strength, float frequency);
+    void setColor(const float rgb[3], float fade_time); //sprites fade out over their last fade_time seconds
+    const float* getColor() const;
+    float getFadeTime() const;
+
+    size_t count() const;
+    size_t capacity() const;
+    const float* stream(ParticleStream s) const;
+    float* stream(ParticleStream s);
+private:
+    JobSystem* jobs;
+    std::vector<float> streams[PARTICLE_STREAM_COUNT];
+    std::vector<float> back[PARTICLE_STREAM_COUNT]; //compaction target, swapped with streams
+    std::vector<size_t> chunk_offsets;
+    size_t live;
+    size_t max_particles;
+    float gravity[3];
+    float drag;
+    float curl_strength;
+    float curl_frequency;
+    float time;
+    float color[3];
+    float fade_time;
+    uint32_t seed;
+
+    float random();
+};
+
+void curlNoise(const float* px, const float* py, const float* pz, size_t count, float frequency, float time,
+               float* cx, float* cy, float* cz);
+
+#endif //GRAPHICSENGINE3D_PARTICLES_H
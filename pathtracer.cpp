@@ -0,0 +1,334 @@
+#include "pathtracer.h"
+#include "profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <math.h>
+
+//Implementation details of the progressive path tracer
+
+namespace {
+
+const int TILE_SIZE = 16;
+const int RUSSIAN_ROULETTE_DEPTH = 3;
+const float RAY_EPSILON = 1e-4f;
+const float TWO_PI = 6.28318531f;
+
+/**
+ * Integer hash used to decorrelate the random streams of pixels and passes
+ */
+inline uint32_t hash(uint32_t x){
+    x ^= x >> 16; x *= 0x7feb352du;
+    x ^= x >> 15; x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+/**
+ * xorshift32 step, returns a float uniformly distributed in [0,1)
+ */
+inline float random(uint32_t& state){
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state >> 8)*(1.0f/16777216.0f);
+}
+
+/**
+ * Cosine weighted direction on the hemisphere around the unit normal n
+ */
+void sampleHemisphere(const float n[3], uint32_t& rng, float dir[3]){
+    float r1 = random(rng);
+    float r2 = random(rng);
+    float phi = TWO_PI*r1;
+    float r = sqrtf(r2);
+    float lx = r*cosf(phi);
+    float ly = r*sinf(phi);
+    float lz = sqrtf(std::max(0.0f, 1 - r2));
+    //orthonormal basis around n (Duff et al. 2017)
+    float s = n[2] >= 0? 1.0f: -1.0f;
+    float a = -1.0f/(s + n[2]);
+    float b = n[0]*n[1]*a;
+    float t[3] = {1 + s*n[0]*n[0]*a, s*b, -s*n[0]};
+    float bt[3] = {b, s + n[1]*n[1]*a, -n[1]};
+    for(int i = 0; i < 3; i++) dir[i] = lx*t[i] + ly*bt[i] + lz*n[i];
+}
+
+}
+
+/**
+ * Path tracer rendering images of the given size, with a neutral grey sky,
+ * at most 4 bounces and one worker per hardware thread.
+ * @param w image width in pixels
+ * @param h image height in pixels
+ */
+PathTracer::PathTracer(int w, int h){
+    width = w;
+    height = h;
+    max_depth = 4;
+    thread_count = 0;
+    bvh = nullptr;
+    px = nullptr; py = nullptr; pz = nullptr;
+    indices = nullptr;
+    material_ids = nullptr;
+    PathMaterial grey{{0.7, 0.7, 0.7}, {0.0, 0.0, 0.0}};
+    materials.push_back(grey);
+    for(int i = 0; i < 3; i++){ sky_horizon[i] = 1.0; sky_zenith[i] = 1.0;}
+    accum.resize(3*(size_t)width*height);
+    reset();
+}
+
+/**
+ * Set the geometry to render. The arrays are referenced, not copied.
+ * @param hierarchy BVH built over the same positions and indices
+ * @param x x coordinates of the vertices
+ * @param y y coordinates of the vertices
+ * @param z z coordinates of the vertices
+ * @param idx 3 vertex indices per triangle
+ * @param mat_ids material index per triangle, nullptr renders everything with materials[0]
+ * @param mats the materials indexed by mat_ids
+ */
+void PathTracer::setScene(const BVH* hierarchy, const float* x, const float* y, const float* z,
+                          const uint32_t* idx, const uint32_t* mat_ids,
+                          const std::vector<PathMaterial>& mats){
+    bvh = hierarchy;
+    px = x; py = y; pz = z;
+    indices = idx;
+    material_ids = mat_ids;
+    if(mats.empty()){
+        std::cout << "Warning: path tracer scene set without materials, keeping the default material.\n";
+    }
+    else materials = mats;
+    reset();
+}
+
+/**
+ * Set the environment seen by rays leaving the scene, interpolated from
+ * the horizon color to the zenith color with the ray's elevation.
+ * @param horizon linear RGB at and below the horizon
+ * @param zenith linear RGB straight up
+ */
+void PathTracer::setSky(const float horizon[3], const float zenith[3]){
+    for(int i = 0; i < 3; i++){ sky_horizon[i] = horizon[i]; sky_zenith[i] = zenith[i];}
+    reset();
+}
+
+/**
+ * @param depth maximum number of bounces after the primary hit
+ */
+void PathTracer::setMaxDepth(int depth){
+    max_depth = std::max(0, depth);
+    reset();
+}
+
+/**
+ * @param threads number of worker threads, 0 uses every hardware thread
+ */
+void PathTracer::setThreadCount(unsigned threads){
+    thread_count = threads;
+}
+
+/**
+ * Drop the accumulated samples and statistics
+ */
+void PathTracer::reset(){
+    std::fill(accum.begin(), accum.end(), 0.0f);
+    samples = 0;
+    total_rays = 0;
+    total_seconds = 0;
+    pass_rays = 0;
+    pass_seconds = 0;
+}
+
+/**
+ * Render one sample per pixel and add it to the accumulation buffer.
+ * Tiles are claimed from an atomic counter so faster threads pick up
+ * the remaining work of slower ones.
+ * @param camera the camera to render from, should not change between passes without reset()
+ */
+void PathTracer::renderPass(const Camera& camera){
+    PROFILE_ZONE("PathTracer::renderPass");
+    if(bvh == nullptr){
+        std::cout << "Warning: path tracer pass rendered without a scene.\n";
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    int tiles_x = (width + TILE_SIZE - 1)/TILE_SIZE;
+    int tiles_y = (height + TILE_SIZE - 1)/TILE_SIZE;
+    int tile_count = tiles_x*tiles_y;
+    unsigned workers = thread_count? thread_count: std::max(1u, std::thread::hardware_concurrency());
+    workers = std::min(workers, (unsigned)tile_count);
+
+    std::atomic<int> next_tile(0);
+    std::atomic<unsigned long long> rays(0);
+    auto work = [&](){
+        unsigned long long local_rays = 0;
+        for(int tile = next_tile++; tile < tile_count; tile = next_tile++){
+            local_rays += renderTile(camera, tile);
+        }
+        rays += local_rays;
+    };
+    std::vector<std::thread> threads;
+    for(unsigned i = 1; i < workers; i++) threads.emplace_back(work);
+    work();
+    for(auto& t: threads) t.join();
+
+    samples++;
+    pass_rays = rays;
+    pass_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    total_rays += pass_rays;
+    total_seconds += pass_seconds;
+    PROFILE_COUNTER("PathTracer rays", pass_rays);
+    PROFILE_FRAME();
+}
+
+/**
+ * Render one sample for every pixel of a tile, 2x2 pixels at a time
+ * @param camera the camera to render from
+ * @param tile index of the tile in row major order
+ * @return number of rays traced
+ */
+unsigned long long PathTracer::renderTile(const Camera& camera, int tile){
+    PROFILE_ZONE("PathTracer::renderTile");
+    int tiles_x = (width + TILE_SIZE - 1)/TILE_SIZE;
+    int x0 = (tile%tiles_x)*TILE_SIZE;
+    int y0 = (tile/tiles_x)*TILE_SIZE;
+    int x1 = std::min(x0 + TILE_SIZE, width);
+    int y1 = std::min(y0 + TILE_SIZE, height);
+    unsigned long long rays = 0;
+
+    for(int y = y0; y < y1; y += 2){
+        for(int x = x0; x < x1; x += 2){
+            RayPacket4 packet;
+            uint32_t rng[4];
+            int pixel[4];
+            for(int l = 0; l < 4; l++){
+                int lx = x + (l & 1);
+                int ly = y + (l >> 1);
+                pixel[l] = (lx < x1 && ly < y1)? ly*width + lx: -1;
+                rng[l] = hash((uint32_t)(pixel[l] + 1) ^ hash((uint32_t)samples*0x9e3779b9u)) | 1u;
+                float o[3], d[3];
+                camera.generateRay((lx + random(rng[l]))/width, (ly + random(rng[l]))/height, o, d);
+                for(int a = 0; a < 3; a++){ packet.origin[a][l] = o[a]; packet.dir[a][l] = d[a];}
+                packet.tMax[l] = pixel[l] >= 0? camera.getFar(): 0.0f; //disabled lanes never hit
+            }
+            bvh->intersect4(packet);
+            for(int l = 0; l < 4; l++){
+                if(pixel[l] < 0) continue;
+                rays++;
+                float o[3] = {packet.origin[0][l], packet.origin[1][l], packet.origin[2][l]};
+                float d[3] = {packet.dir[0][l], packet.dir[1][l], packet.dir[2][l]};
+                Hit hit{packet.t[l], packet.u[l], packet.v[l], packet.triangle[l]};
+                float radiance[3];
+                rays += tracePath(o, d, hit, rng[l], radiance);
+                float* out = &accum[3*(size_t)pixel[l]];
+                for(int a = 0; a < 3; a++) out[a] += radiance[a];
+            }
+        }
+    }
+    return rays;
+}
+
+/**
+ * Follow a path from its primary hit, bouncing diffusely until it leaves
+ * the scene, reaches max_depth or is terminated by russian roulette.
+ * @param origin primary ray origin
+ * @param dir primary ray direction
+ * @param primary the primary hit, computed by the packet trace
+ * @param rng random state of the pixel
+ * @param radiance filled with the radiance carried back along the path
+ * @return number of secondary rays traced
+ */
+unsigned long long PathTracer::tracePath(const float origin[3], const float dir[3], const Hit& primary,
+                                         uint32_t& rng, float radiance[3]) const{
+    float throughput[3] = {1.0, 1.0, 1.0};
+    float o[3] = {origin[0], origin[1], origin[2]};
+    float d[3] = {dir[0], dir[1], dir[2]};
+    Hit hit = primary;
+    unsigned long long rays = 0;
+    for(int i = 0; i < 3; i++) radiance[i] = 0.0;
+
+    for(int depth = 0; ; depth++){
+        if(hit.triangle == BVH::NO_HIT){
+            float env[3];
+            sky(d, env);
+            for(int i = 0; i < 3; i++) radiance[i] += throughput[i]*env[i];
+            break;
+        }
+        const PathMaterial& mat = materials[material_ids? material_ids[hit.triangle]: 0];
+        for(int i = 0; i < 3; i++) radiance[i] += throughput[i]*mat.emission[i];
+        if(depth >= max_depth) break;
+
+        uint32_t i0 = indices[3*hit.triangle]; uint32_t i1 = indices[3*hit.triangle+1];
+        uint32_t i2 = indices[3*hit.triangle+2];
+        float e1[3] = {px[i1]-px[i0], py[i1]-py[i0], pz[i1]-pz[i0]};
+        float e2[3] = {px[i2]-px[i0], py[i2]-py[i0], pz[i2]-pz[i0]};
+        float n[3] = {e1[1]*e2[2] - e1[2]*e2[1], e1[2]*e2[0] - e1[0]*e2[2], e1[0]*e2[1] - e1[1]*e2[0]};
+        float len = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        if(len == 0) break; //degenerate triangle
+        float facing = (n[0]*d[0] + n[1]*d[1] + n[2]*d[2]) > 0? -1.0f/len: 1.0f/len;
+        for(int i = 0; i < 3; i++) n[i] *= facing;
+
+        for(int i = 0; i < 3; i++) throughput[i] *= mat.albedo[i];
+        if(depth >= RUSSIAN_ROULETTE_DEPTH){
+            float p = std::max(throughput[0], std::max(throughput[1], throughput[2]));
+            if(random(rng) >= p) break;
+            for(int i = 0; i < 3; i++) throughput[i] /= p;
+        }
+
+        for(int i = 0; i < 3; i++) o[i] = o[i] + hit.t*d[i] + RAY_EPSILON*n[i];
+        sampleHemisphere(n, rng, d);
+        Ray ray{o, d, 1e30f};
+        bvh->intersect(ray, hit);
+        rays++;
+    }
+    return rays;
+}
+
+/**
+ * Environment radiance in a direction
+ */
+void PathTracer::sky(const float dir[3], float color[3]) const{
+    float w = std::max(0.0f, dir[1]);
+    for(int i = 0; i < 3; i++) color[i] = (1 - w)*sky_horizon[i] + w*sky_zenith[i];
+}
+
+/**
+ * Average the accumulated samples into an image
+ * @param rgb output buffer of 3*width*height floats
+ */
+void PathTracer::resolve(float* rgb) const{
+    float scale = samples > 0? 1.0f/samples: 0.0f;
+    for(size_t i = 0; i < accum.size(); i++) rgb[i] = accum[i]*scale;
+}
+
+int PathTracer::getWidth() const{
+    return width;
+}
+
+int PathTracer::getHeight() const{
+    return height;
+}
+
+int PathTracer::getSampleCount() const{
+    return samples;
+}
+
+unsigned long long PathTracer::getRayCount() const{
+    return total_rays;
+}
+
+/**
+ * @return rays traced per second over every pass since the last reset()
+ */
+double PathTracer::raysPerSecond() const{
+    return total_seconds > 0? total_rays/total_seconds: 0.0;
+}
+
+/**
+ * @return rays traced per second during the last pass
+ */
+double PathTracer::lastPassRaysPerSecond() const{
+    return pass_seconds > 0? pass_rays/pass_seconds: 0.0;
+}
@@ -0,0 +1,75 @@
+#ifndef GRAPHICSENGINE3D_PATHTRACER_H
+#define GRAPHICSENGINE3D_PATHTRACER_H
+
+#include <stdint.h>
+#include <vector>
+#include "bvh.h"
+#include "camera.h"
+
+/**
+ * Diffuse surface description used by the path tracer.
+ * Colors are linear RGB.
+ */
+struct PathMaterial{
+    float albedo[3];
+    float emission[3];
+};
+
+/**
+ * Progressive CPU path tracer for headless reference renders.
+ * Every renderPass() adds one sample per pixel to an accumulation buffer,
+ * so a noisy preview can be resolved after the first pass and refined after that.
+ * The image is split in square tiles that worker threads claim one at a time.
+ * Primary rays are traced as 2x2 pixel packets, bounces as single rays.
+ */
+class PathTracer{
+public:
+    PathTracer(int width, int height);
+    void setScene(const BVH* bvh, const float* px, const float* py, const float* pz,
+                  const uint32_t* indices, const uint32_t* material_ids,
+                  const std::vector<PathMaterial>& materials);
+    void setSky(const float horizon[3], const float zenith[3]);
+    void setMaxDepth(int depth);
+    void setThreadCount(unsigned threads); //0 uses every hardware thread
+
+    void reset(); //drop accumulated samples, e.g. after the camera moved
+    void renderPass(const Camera& camera);
+    void resolve(float* rgb) const; //averaged linear RGB, 3 floats per pixel, rows top to bottom
+
+    int getWidth() const;
+    int getHeight() const;
+    int getSampleCount() const;
+    unsigned long long getRayCount() const;
+    double raysPerSecond() const; //over every pass since reset()
+    double lastPassRaysPerSecond() const;
+
+private:
+    int width;
+    int height;
+    int max_depth;
+    unsigned thread_count;
+    int samples;
+    std::vector<float> accum;
+
+    const BVH* bvh;
+    const float* px;
+    const float* py;
+    const float* pz;
+    const uint32_t* indices;
+    const uint32_t* material_ids;
+    std::vector<PathMaterial> materials;
+    float sky_horizon[3];
+    float sky_zenith[3];
+
+    unsigned long long total_rays;
+    double total_seconds;
+    unsigned long long pass_rays;
+    double pass_seconds;
+
+    unsigned long long renderTile(const Camera& camera, int tile);
+    unsigned long long tracePath(const float origin[3], const float dir[3], const Hit& primary,
+                                 uint32_t& rng, float radiance[3]) const;
+    void sky(const float dir[3], float color[3]) const;
+};
+
+#endif //GRAPHICSENGINE3D_PATHTRACER_H
@@ -0,0 +1,359 @@
+#include "physics.h"
+#include "profiler.h"
+#include "simd.h"
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+#include <numeric>
+
+//Implementation details of the rigid body world
+
+namespace {
+
+int findRoot(std::vector<int>& parent, int i){
+    while(parent[i] != i){
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+}
+
+PhysicsWorld::PhysicsWorld(JobSystem& job_system){
+    jobs = &job_system;
+    islands = 0;
+    dirty = false;
+    gravity[0] = 0; gravity[1] = -9.81f; gravity[2] = 0;
+    linear_damping = 0;
+    angular_damping = 0;
+    fixed_dt = 1/60.0f;
+    max_steps = 8;
+    accumulator = 0;
+    batches.push_back(0);
+}
+
+/**
+ * Add a body at rest with the identity orientation
+ * @param position center of mass
+ * @param mass 0 or less makes a static body, which keeps the velocity it is given (kinematic)
+ * @param inertia principal moments of inertia in body space; 0 locks the rotation about that axis
+ * @return handle of the body
+ */
+int PhysicsWorld::addBody(const float position[3], float mass, const float inertia[3]){
+    int handle = (int)slot_of.size();
+    slot_of.push_back((int)handle_of.size());
+    handle_of.push_back(handle);
+    for(int s = 0; s < BODY_STREAM_COUNT; s++) streams[s].push_back(0.0f);
+    float* p[BODY_STREAM_COUNT];
+    for(int s = 0; s < BODY_STREAM_COUNT; s++) p[s] = &streams[s].back();
+    *p[BODY_PX] = position[0]; *p[BODY_PY] = position[1]; *p[BODY_PZ] = position[2];
+    *p[BODY_QW] = 1;
+    if(mass > 0){
+        *p[BODY_INV_MASS] = 1/mass;
+        for(int c = 0; c < 3; c++){
+            float inverse = inertia[c] > 0? 1/inertia[c]: 0.0f;
+            *p[BODY_INV_IX + c] = inverse;
+            *p[BODY_INV_IXX + c] = inverse;
+        }
+    }
+    dirty = true;
+    return handle;
+}
+
+void PhysicsWorld::setGravity(const float g[3]){
+    for(int c = 0; c < 3; c++) gravity[c] = g[c];
+}
+
+/**
+ * Velocity damping, as fractions of the velocity lost per second
+ */
+void PhysicsWorld::setDamping(float linear, float angular){
+    linear_damping = std::max(0.0f, linear);
+    angular_damping = std::max(0.0f, angular);
+}
+
+void PhysicsWorld::setVelocity(int body, const float linear[3], const float angular[3]){
+    int i = slot_of[body];
+    for(int c = 0; c < 3; c++){
+        streams[BODY_VX + c][i] = linear[c];
+        streams[BODY_WX + c][i] = angular[c];
+    }
+}
+
+/**
+ * @param rotation quaternion (x, y, z, w), normalized here
+ */
+void PhysicsWorld::setOrientation(int body, const float rotation[4]){
+    int i = slot_of[body];
+    float len = sqrtf(rotation[0]*rotation[0] + rotation[1]*rotation[1] + rotation[2]*rotation[2]
+                      + rotation[3]*rotation[3]);
+    if(len == 0){
+        std::cout << "Warning: zero quaternion given as orientation of body " << body << "\n";
+        return;
+    }
+    for(int c = 0; c < 4; c++) streams[BODY_QX + c][i] = rotation[c]/len;
+}
+
+/**
+ * Force through the center of mass for the next step
+ */
+void PhysicsWorld::applyForce(int body, const float force[3]){
+    int i = slot_of[body];
+    for(int c = 0; c < 3; c++) streams[BODY_FX + c][i] += force[c];
+}
+
+/**
+ * World space torque for the next step
+ */
+void PhysicsWorld::applyTorque(int body, const float torque[3]){
+    int i = slot_of[body];
+    for(int c = 0; c < 3; c++) streams[BODY_TX + c][i] += torque[c];
+}
+
+void PhysicsWorld::getPosition(int body, float position[3]) const{
+    int i = slot_of[body];
+    for(int c = 0; c < 3; c++) position[c] = streams[BODY_PX + c][i];
+}
+
+void PhysicsWorld::getOrientation(int body, float rotation[4]) const{
+    int i = slot_of[body];
+    for(int c = 0; c < 4; c++) rotation[c] = streams[BODY_QX + c][i];
+}
+
+void PhysicsWorld::getVelocity(int body, float linear[3], float angular[3]) const{
+    int i = slot_of[body];
+    for(int c = 0; c < 3; c++){
+        linear[c] = streams[BODY_VX + c][i];
+        angular[c] = streams[BODY_WX + c][i];
+    }
+}
+
+// ====== Islands ======
+
+/**
+ * Put two bodies in the same island, e.g. for a contact or a joint.
+ * Static bodies never join islands, so they don't chain everything resting on them together.
+ * @return false when a handle is invalid
+ */
+bool PhysicsWorld::link(int a, int b){
+    if(a < 0 || b < 0 || a >= (int)slot_of.size() || b >= (int)slot_of.size()){
+        std::cout << "Warning: link between bodies " << a << " and " << b << " of a world of "
+                  << slot_of.size() << " bodies\n";
+        return false;
+    }
+    link_pairs.push_back(a);
+    link_pairs.push_back(b);
+    dirty = true;
+    return true;
+}
+
+void PhysicsWorld::clearLinks(){
+    if(!link_pairs.empty()) dirty = true;
+    link_pairs.clear();
+}
+
+/**
+ * Find the islands and rewrite the streams with every island contiguous,
+ * islands ordered by their first handle and packed into batches.
+ */
+void PhysicsWorld::layout(){
+    PROFILE_ZONE("PhysicsWorld::layout");
+    int count = (int)slot_of.size();
+    const std::vector<float>& inv_mass = streams[BODY_INV_MASS];
+    std::vector<int> parent(count);
+    std::iota(parent.begin(), parent.end(), 0);
+    for(size_t l = 0; l < link_pairs.size(); l += 2){
+        int a = link_pairs[l], b = link_pairs[l + 1];
+        if(inv_mass[slot_of[a]] == 0 || inv_mass[slot_of[b]] == 0) continue;
+        int ra = findRoot(parent, a), rb = findRoot(parent, b);
+        if(ra != rb) parent[std::max(ra, rb)] = std::min(ra, rb);
+    }
+
+    //counting sort of the handles by island, islands numbered by first handle
+    std::vector<int> island_of(count), island_id(count, -1), sizes;
+    for(int h = 0; h < count; h++){
+        int root = findRoot(parent, h);
+        if(island_id[root] < 0){
+            island_id[root] = (int)sizes.size();
+            sizes.push_back(0);
+        }
+        island_of[h] = island_id[root];
+        sizes[island_of[h]]++;
+    }
+    islands = sizes.size();
+    std::vector<int> offsets(islands + 1, 0), order(count);
+    for(size_t i = 0; i < islands; i++) offsets[i + 1] = offsets[i] + sizes[i];
+    std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+    for(int h = 0; h < count; h++) order[cursor[island_of[h]]++] = h;
+
+    //islands fill a batch until the next one would overflow it, batches start on 4 lanes
+    std::vector<int> new_handle_of;
+    batches.assign(1, 0);
+    for(size_t i = 0; i < islands; i++){
+        size_t batch_size = new_handle_of.size() - batches.back();
+        if(batch_size > 0 && batch_size + sizes[i] > PHYSICS_BATCH_BODIES){
+            new_handle_of.resize((new_handle_of.size() + 3) & ~(size_t)3, -1);
+            batches.push_back(new_handle_of.size());
+        }
+        new_handle_of.insert(new_handle_of.end(), order.begin() + offsets[i], order.begin() + offsets[i + 1]);
+    }
+    new_handle_of.resize((new_handle_of.size() + 3) & ~(size_t)3, -1);
+    batches.push_back(new_handle_of.size());
+
+    for(int s = 0; s < BODY_STREAM_COUNT; s++){
+        std::vector<float> moved(new_handle_of.size(), s == BODY_QW? 1.0f: 0.0f);
+        for(size_t i = 0; i < new_handle_of.size(); i++){
+            if(new_handle_of[i] >= 0) moved[i] = streams[s][slot_of[new_handle_of[i]]];
+        }
+        streams[s].swap(moved);
+    }
+    handle_of.swap(new_handle_of);
+    for(size_t i = 0; i < handle_of.size(); i++){
+        if(handle_of[i] >= 0) slot_of[handle_of[i]] = (int)i;
+    }
+    dirty = false;
+}
+
+// ====== Integration ======
+
+/**
+ * Semi-implicit Euler on slots [first, last), both multiples of 4: velocities
+ * from forces first, then positions and orientations from the new velocities.
+ * The gyroscopic term is left out, which keeps the step stable for thin bodies.
+ */
+void PhysicsWorld::integrate(size_t first, size_t last, float dt){
+    float* p[BODY_STREAM_COUNT];
+    for(int s = 0; s < BODY_STREAM_COUNT; s++) p[s] = streams[s].data();
+    Float4 h(dt), half_h(0.5f*dt), zero(0.0f), one(1.0f), two(2.0f);
+    Float4 linear_keep(1/(1 + dt*linear_damping)), angular_keep(1/(1 + dt*angular_damping));
+    Float4 g[3] = {Float4(gravity[0]), Float4(gravity[1]), Float4(gravity[2])};
+
+    for(size_t i = first; i < last; i += 4){
+        Float4 inv_mass = Float4::load(p[BODY_INV_MASS] + i);
+        Float4 dynamic = inv_mass > zero;
+        Float4 v[3], w[3], f[3], t[3];
+        for(int c = 0; c < 3; c++){
+            v[c] = Float4::load(p[BODY_VX + c] + i);
+            w[c] = Float4::load(p[BODY_WX + c] + i);
+            f[c] = Float4::load(p[BODY_FX + c] + i);
+            t[c] = Float4::load(p[BODY_TX + c] + i);
+            v[c] = (v[c] + h*((g[c] & dynamic) + f[c]*inv_mass))*linear_keep;
+            Float4 position = Float4::load(p[BODY_PX + c] + i) + h*v[c];
+            position.store(p[BODY_PX + c] + i);
+            v[c].store(p[BODY_VX + c] + i);
+            zero.store(p[BODY_FX + c] + i);
+            zero.store(p[BODY_TX + c] + i);
+        }
+
+        //world inverse inertia R D R^T
+        Float4 qx = Float4::load(p[BODY_QX] + i), qy = Float4::load(p[BODY_QY] + i);
+        Float4 qz = Float4::load(p[BODY_QZ] + i), qw = Float4::load(p[BODY_QW] + i);
+        Float4 xx = qx*qx, yy = qy*qy, zz = qz*qz, xy = qx*qy, xz = qx*qz, yz = qy*qz;
+        Float4 wx = qw*qx, wy = qw*qy, wz = qw*qz;
+        Float4 r[3][3] = {{one - two*(yy + zz), two*(xy - wz), two*(xz + wy)},
+                          {two*(xy + wz), one - two*(xx + zz), two*(yz - wx)},
+                          {two*(xz - wy), two*(yz + wx), one - two*(xx + yy)}};
+        Float4 d[3] = {Float4::load(p[BODY_INV_IX] + i), Float4::load(p[BODY_INV_IY] + i),
+                       Float4::load(p[BODY_INV_IZ] + i)};
+        Float4 a[3][3];
+        for(int row = 0; row < 3; row++){
+            for(int col = row; col < 3; col++){
+                a[row][col] = r[row][0]*d[0]*r[col][0] + r[row][1]*d[1]*r[col][1] + r[row][2]*d[2]*r[col][2];
+                a[col][row] = a[row][col];
+            }
+        }
+        a[0][0].store(p[BODY_INV_IXX] + i); a[1][1].store(p[BODY_INV_IYY] + i); a[2][2].store(p[BODY_INV_IZZ] + i);
+        a[0][1].store(p[BODY_INV_IXY] + i); a[0][2].store(p[BODY_INV_IXZ] + i); a[1][2].store(p[BODY_INV_IYZ] + i);
+        for(int c = 0; c < 3; c++){
+            w[c] = (w[c] + h*(a[c][0]*t[0] + a[c][1]*t[1] + a[c][2]*t[2]))*angular_keep;
+            w[c].store(p[BODY_WX + c] + i);
+        }
+
+        //q += dt/2 (w, 0) q, then renormalize
+        Float4 nx = qx + half_h*(w[0]*qw + w[1]*qz - w[2]*qy);
+        Float4 ny = qy + half_h*(w[1]*qw + w[2]*qx - w[0]*qz);
+        Float4 nz = qz + half_h*(w[2]*qw + w[0]*qy - w[1]*qx);
+        Float4 nw = qw - half_h*(w[0]*qx + w[1]*qy + w[2]*qz);
+        Float4 inv_len = one/sqrt(nx*nx + ny*ny + nz*nz + nw*nw);
+        (nx*inv_len).store(p[BODY_QX] + i);
+        (ny*inv_len).store(p[BODY_QY] + i);
+        (nz*inv_len).store(p[BODY_QZ] + i);
+        (nw*inv_len).store(p[BODY_QW] + i);
+    }
+}
+
+/**
+ * Advance every body by dt, one job per batch of islands
+ */
+void PhysicsWorld::step(float dt){
+    PROFILE_ZONE("PhysicsWorld::step");
+    if(dirty) layout();
+    jobs->parallelFor(0, batches.size() - 1, [this, dt](size_t begin, size_t end){
+        for(size_t b = begin; b < end; b++) integrate(batches[b], batches[b + 1], dt);
+    }, 1);
+}
+
+/**
+ * Fixed timestep mode for update(); dt of 0 makes update() take one step of the frame time
+ * @param max_steps steps per update at most, time beyond them is dropped so a slow frame can't snowball
+ */
+void PhysicsWorld::setFixedTimestep(float dt, int steps){
+    fixed_dt = std::max(0.0f, dt);
+    max_steps = std::max(1, steps);
+    accumulator = 0;
+}
+
+/**
+ * Advance the world by the time of a frame
+ * @return number of steps taken
+ */
+int PhysicsWorld::update(float frame_time){
+    if(fixed_dt == 0){
+        step(frame_time);
+        return 1;
+    }
+    accumulator += frame_time;
+    int steps = 0;
+    while(accumulator >= fixed_dt && steps < max_steps){
+        step(fixed_dt);
+        accumulator -= fixed_dt;
+        steps++;
+    }
+    if(accumulator >= fixed_dt) accumulator = fmodf(accumulator, fixed_dt);
+    return steps;
+}
+
+float PhysicsWorld::getInterpolationAlpha() const{
+    return fixed_dt > 0? accumulator/fixed_dt: 0.0f;
+}
+
+// ====== Accessors ======
+
+size_t PhysicsWorld::bodyCount() const{
+    return slot_of.size();
+}
+
+size_t PhysicsWorld::islandCount(){
+    if(dirty) layout();
+    return islands;
+}
+
+size_t PhysicsWorld::slotCount() const{
+    return handle_of.size();
+}
+
+int PhysicsWorld::slotOf(int body) const{
+    return slot_of[body];
+}
+
+/**
+ * One float per slot, see slotOf(); padding slots hold a static body at the origin
+ */
+float* PhysicsWorld::stream(BodyStream s){
+    return streams[s].data();
+}
+
+const float* PhysicsWorld::stream(BodyStream s) const{
+    return streams[s].data();
+}
@@ -0,0 +1,85 @@
+#ifndef GRAPHICSENGINE3D_PHYSICS_H
+#define GRAPHICSENGINE3D_PHYSICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "jobsystem.h"
+
+const size_t PHYSICS_BATCH_BODIES = 1024; //islands are packed into batches of about this many bodies
+
+/**
+ * Per body streams of a PhysicsWorld, one float per body each
+ */
+enum BodyStream{
+    BODY_PX, BODY_PY, BODY_PZ, //center of mass position
+    BODY_VX, BODY_VY, BODY_VZ, //linear velocity
+    BODY_WX, BODY_WY, BODY_WZ, //angular velocity, world space
+    BODY_QX, BODY_QY, BODY_QZ, BODY_QW, //orientation, unit quaternion
+    BODY_FX, BODY_FY, BODY_FZ, //accumulated force, cleared every step
+    BODY_TX, BODY_TY, BODY_TZ, //accumulated torque, cleared every step
+    BODY_INV_MASS, //0 for static bodies
+    BODY_INV_IX, BODY_INV_IY, BODY_INV_IZ, //inverse inertia, diagonal in body space
+    BODY_INV_IXX, BODY_INV_IYY, BODY_INV_IZZ, //world inverse inertia tensor of the last step,
+    BODY_INV_IXY, BODY_INV_IXZ, BODY_INV_IYZ, //symmetric so 6 floats
+    BODY_STREAM_COUNT
+};
+
+/**
+ * Rigid bodies stored as structure of arrays and integrated with semi-implicit
+ * Euler, 4 bodies at a time.
+ * Bodies joined by link() (contacts, joints) form islands. The streams keep
+ * every island contiguous and islands are packed into batches that start on a
+ * multiple of 4 bodies, so each batch is integrated by its own job without
+ * sharing a lane with another one. Slots between batches hold inert padding.
+ * Bodies are referred to by handles, since their slots move when islands change.
+ */
+class PhysicsWorld{
+public:
+    explicit PhysicsWorld(JobSystem& jobs);
+    int addBody(const float position[3], float mass, const float inertia[3]);
+    void setGravity(const float gravity[3]);
+    void setDamping(float linear, float angular);
+    void setVelocity(int body, const float linear[3], const float angular[3]);
+    void setOrientation(int body, const float rotation[4]);
+    void applyForce(int body, const float force[3]);
+    void applyTorque(int body, const float torque[3]);
+    void getPosition(int body, float position[3]) const;
+    void getOrientation(int body, float rotation[4]) const;
+    void getVelocity(int body, float linear[3], float angular[3]) const;
+
+    bool link(int a, int b);
+    void clearLinks();
+
+    void step(float dt);
+    void setFixedTimestep(float dt, int max_steps = 8);
+    int update(float frame_time);
+    float getInterpolationAlpha() const; //leftover fraction of a fixed step, for rendering
+
+    size_t bodyCount() const;
+    size_t islandCount();
+    size_t slotCount() const; //bodies plus padding
+    int slotOf(int body) const;
+    float* stream(BodyStream s);
+    const float* stream(BodyStream s) const;
+private:
+    JobSystem* jobs;
+    std::vector<float> streams[BODY_STREAM_COUNT];
+    std::vector<int> slot_of; //by handle
+    std::vector<int> handle_of; //by slot, -1 for padding
+    std::vector<size_t> batches; //first slot of every batch, then the slot count
+    std::vector<int> link_pairs; //2 handles per link
+    size_t islands;
+    bool dirty; //bodies or links changed since the last layout
+    float gravity[3];
+    float linear_damping;
+    float angular_damping;
+    float fixed_dt;
+    int max_steps;
+    float accumulator;
+
+    void layout();
+    void integrate(size_t first, size_t last, float dt);
+};
+
+#endif //GRAPHICSENGINE3D_PHYSICS_H
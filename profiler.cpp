@@ -0,0 +1,198 @@
+#include "profiler.h"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <math.h>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <vector>
+
+//Implementation details of the Profiler
+
+namespace {
+
+/**
+ * Single producer event ring of one thread. The owner writes a slot and then
+ * publishes it by advancing head; readers only look at published slots.
+ */
+struct EventRing{
+    ProfileEvent events[PROFILER_RING_SIZE];
+    std::atomic<uint64_t> head;
+    int thread_id;
+    EventRing(int id): head(0), thread_id(id){}
+};
+
+std::mutex registry_lock;
+std::vector<std::unique_ptr<EventRing>> rings; //kept after their thread exits, until exported
+std::vector<EventRing*> free_rings; //rings of exited threads, events kept
+std::atomic<bool> enabled(true);
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+/**
+ * The ring of one thread, handed back to the free list when the thread exits.
+ * A thread that finds no ring (all PROFILER_MAX_THREADS in use) stops asking.
+ */
+struct RingHandle{
+    EventRing* ring = nullptr;
+    bool refused = false;
+    ~RingHandle(){
+        if(!ring) return;
+        std::lock_guard<std::mutex> guard(registry_lock);
+        free_rings.push_back(ring);
+    }
+};
+
+/**
+ * The ring of the calling thread: a free one if any, else a new one
+ * @return the ring, nullptr once the registry is full
+ */
+EventRing* localRing(){
+    static thread_local RingHandle handle;
+    if(!handle.ring && !handle.refused){
+        std::lock_guard<std::mutex> guard(registry_lock);
+        if(!free_rings.empty()){
+            handle.ring = free_rings.back(); //continues in the trace lane of the exited thread
+            free_rings.pop_back();
+        }
+        else if(rings.size() < PROFILER_MAX_THREADS){
+            rings.emplace_back(new EventRing((int)rings.size()));
+            handle.ring = rings.back().get();
+        }
+        else{
+            std::cout << "Warning: more than " << PROFILER_MAX_THREADS << " threads profiled, events dropped\n";
+            handle.refused = true;
+        }
+    }
+    return handle.ring;
+}
+
+void record(const ProfileEvent& event){
+    if(!enabled.load(std::memory_order_relaxed)) return;
+    EventRing* ring = localRing();
+    if(!ring) return;
+    uint64_t h = ring->head.load(std::memory_order_relaxed);
+    ring->events[h%PROFILER_RING_SIZE] = event;
+    ring->head.store(h + 1, std::memory_order_release);
+}
+
+/**
+ * Escape a zone name for a JSON string
+ */
+std::string jsonString(const char* s){
+    std::string out = "\"";
+    for(; *s; s++){
+        if(*s == '"' || *s == '\\') out += '\\';
+        if((unsigned char)*s < 0x20) continue;
+        out += *s;
+    }
+    return out + "\"";
+}
+
+}
+
+/**
+ * Time stamp used by the events, nanoseconds since the profiler started
+ */
+uint64_t Profiler::now(){
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Profiler::zone(const char* name, uint64_t start, uint64_t end){
+    record(ProfileEvent{name, start, end, 0.0, PROFILE_EVENT_ZONE});
+}
+
+void Profiler::counter(const char* name, double value){
+    record(ProfileEvent{name, now(), 0, value, PROFILE_EVENT_COUNTER});
+}
+
+void Profiler::frameMark(){
+    record(ProfileEvent{"frame", now(), 0, 0.0, PROFILE_EVENT_FRAME});
+}
+
+void Profiler::setEnabled(bool on){
+    enabled = on;
+}
+
+bool Profiler::isEnabled(){
+    return enabled;
+}
+
+/**
+ * Drop every captured event
+ */
+void Profiler::clear(){
+    std::lock_guard<std::mutex> guard(registry_lock);
+    for(auto& ring: rings) ring->head.store(0);
+}
+
+/**
+ * Number of events currently held by the rings
+ */
+size_t Profiler::eventCount(){
+    std::lock_guard<std::mutex> guard(registry_lock);
+    size_t count = 0;
+    for(auto& ring: rings){
+        uint64_t h = ring->head.load(std::memory_order_acquire);
+        count += (size_t)(h < PROFILER_RING_SIZE? h: PROFILER_RING_SIZE);
+    }
+    return count;
+}
+
+/**
+ * Number of rings allocated so far, one per thread alive at the same time
+ */
+size_t Profiler::ringCount(){
+    std::lock_guard<std::mutex> guard(registry_lock);
+    return rings.size();
+}
+
+/**
+ * Write the captured events as Chrome trace JSON: zones as complete events,
+ * counters as counter events (null when not finite) and frame marks as
+ * global instant events.
+ * @param path the file to write
+ * @return whether the file was written
+ */
+bool Profiler::exportChromeTrace(const std::string& path){
+    std::ofstream out(path, std::ios::trunc);
+    if(!out){
+        std::cout << "Warning: could not write trace " << path << "\n";
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(registry_lock);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    bool first = true;
+    char buffer[64];
+    for(auto& ring: rings){
+        uint64_t h = ring->head.load(std::memory_order_acquire);
+        uint64_t begin = h > PROFILER_RING_SIZE? h - PROFILER_RING_SIZE: 0;
+        for(uint64_t i = begin; i < h; i++){
+            const ProfileEvent& e = ring->events[i%PROFILER_RING_SIZE];
+            if(!first) out << ",\n";
+            first = false;
+            snprintf(buffer, sizeof(buffer), "%.3f", e.start/1000.0);
+            out << "{\"name\":" << jsonString(e.name) << ",\"pid\":1,\"tid\":" << ring->thread_id
+                << ",\"ts\":" << buffer;
+            if(e.type == PROFILE_EVENT_ZONE){
+                snprintf(buffer, sizeof(buffer), "%.3f", (e.end - e.start)/1000.0);
+                out << ",\"ph\":\"X\",\"dur\":" << buffer << "}";
+            }
+            else if(e.type == PROFILE_EVENT_COUNTER){
+                if(isfinite(e.value)) snprintf(buffer, sizeof(buffer), "%.17g", e.value);
+                else snprintf(buffer, sizeof(buffer), "null"); //JSON has no nan or inf
+                out << ",\"ph\":\"C\",\"args\":{\"value\":" << buffer << "}}";
+            }
+            else out << ",\"ph\":\"i\",\"s\":\"g\"}";
+        }
+    }
+    out << "\n]}\n";
+    out.close();
+    if(!out){
+        std::cout << "Warning: could not write trace " << path << "\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,81 @@
+#ifndef GRAPHICSENGINE3D_PROFILER_H
+#define GRAPHICSENGINE3D_PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/**
+ * Built-in profiling. Instrumented code uses the macros below, which expand
+ * to nothing unless the engine is compiled with GE3D_PROFILE defined:
+ * PROFILE_ZONE("name")            times the enclosing scope
+ * PROFILE_COUNTER("name", value)  records a counter sample
+ * PROFILE_FRAME()                 marks the end of a frame
+ * Names must be string literals (only the pointer is stored).
+ * Every thread records into its own ring buffer of PROFILER_RING_SIZE events
+ * without locks; the oldest events are overwritten when a ring is full.
+ * The ring of a thread that exits goes to the next new thread, and at most
+ * PROFILER_MAX_THREADS rings are allocated: threads beyond that record nothing.
+ * Profiler::exportChromeTrace() writes the captured events as Chrome trace
+ * JSON (chrome://tracing, Perfetto).
+ */
+const size_t PROFILER_RING_SIZE = 1 << 16;
+const size_t PROFILER_MAX_THREADS = 64;
+
+enum ProfileEventType{
+    PROFILE_EVENT_ZONE,
+    PROFILE_EVENT_COUNTER,
+    PROFILE_EVENT_FRAME
+};
+
+struct ProfileEvent{
+    const char* name;
+    uint64_t start; //nanoseconds since the profiler started
+    uint64_t end; //zones only
+    double value; //counters only
+    ProfileEventType type;
+};
+
+class Profiler{
+public:
+    static uint64_t now();
+    static void zone(const char* name, uint64_t start, uint64_t end);
+    static void counter(const char* name, double value);
+    static void frameMark();
+
+    static void setEnabled(bool enabled); //capture is on by default
+    static bool isEnabled();
+    static void clear(); //only while no thread records
+    static size_t eventCount();
+    static size_t ringCount(); //rings allocated so far, at most PROFILER_MAX_THREADS
+    static bool exportChromeTrace(const std::string& path); //only while no thread records
+};
+
+/**
+ * Scoped timer recording a zone from construction to destruction
+ */
+class ProfileZone{
+public:
+    explicit ProfileZone(const char* zone_name): name(zone_name), start(Profiler::now()){}
+    ~ProfileZone(){ Profiler::zone(name, start, Profiler::now());}
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+private:
+    const char* name;
+    uint64_t start;
+};
+
+#define GE3D_PROFILE_CONCAT_(a, b) a##b
+#define GE3D_PROFILE_CONCAT(a, b) GE3D_PROFILE_CONCAT_(a, b)
+
+#ifdef GE3D_PROFILE
+#define PROFILE_ZONE(name) ProfileZone GE3D_PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#define PROFILE_COUNTER(name, value) Profiler::counter(name, (double)(value))
+#define PROFILE_FRAME() Profiler::frameMark()
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_COUNTER(name, value) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#endif
+
+#endif //GRAPHICSENGINE3D_PROFILER_H
@@ -0,0 +1,357 @@
+#include "projection.h"
+#include "profiler.h"
+#include "simd.h"
+#include <iostream>
+#include <math.h>
+#include <string.h>
+
+//Implementation details of the batched projection kernels
+
+// ==================== Matrices ====================
+
+/**
+ * Plane from its Vectorf::orthoProject3 name
+ * @param name "xy" or "z", "xz" or "y", "yz" or "x"
+ * @param plane filled with the plane
+ * @return whether the name is known
+ */
+bool parsePlane(const std::string& name, ProjectionPlane& plane){
+    if(name == "xy" || name == "z") plane = PLANE_XY;
+    else if(name == "xz" || name == "y") plane = PLANE_XZ;
+    else if(name == "yz" || name == "x") plane = PLANE_YZ;
+    else{
+        std::cout << "Warning: unknown projection plane " << name << "\n";
+        return false;
+    }
+    return true;
+}
+
+void identityMatrix(float m[16]){
+    for(int i = 0; i < 16; i++) m[i] = (i%5 == 0)? 1.0f: 0.0f;
+}
+
+/**
+ * Product of two column-major 4x4 matrices
+ * @param a left factor, applied last
+ * @param b right factor, applied first
+ * @param out filled with a*b
+ */
+void multiplyMatrix(const float a[16], const float b[16], float out[16]){
+    float r[16];
+    for(int col = 0; col < 4; col++){
+        for(int row = 0; row < 4; row++){
+            r[4*col + row] = a[row]*b[4*col] + a[4 + row]*b[4*col + 1]
+                             + a[8 + row]*b[4*col + 2] + a[12 + row]*b[4*col + 3];
+        }
+    }
+    for(int i = 0; i < 16; i++) out[i] = r[i];
+}
+
+/**
+ * Perspective projection of a right handed view space looking down -z
+ * @param fov vertical field of view in radians
+ * @param aspect width over height of the image
+ * @param near_plane distance to the near clipping plane
+ * @param far_plane distance to the far clipping plane
+ * @param m filled with the projection matrix
+ */
+void perspectiveMatrix(float fov, float aspect, float near_plane, float far_plane, float m[16]){
+    float f = 1.0f/tanf(0.5f*fov);
+    for(int i = 0; i < 16; i++) m[i] = 0.0f;
+    m[0] = f/aspect;
+    m[5] = f;
+    m[10] = (far_plane + near_plane)/(near_plane - far_plane);
+    m[11] = -1.0f;
+    m[14] = 2.0f*far_plane*near_plane/(near_plane - far_plane);
+}
+
+/**
+ * Orthographic projection of the view box [left,right]x[bottom,top]x[-near,-far]
+ * (right handed view space looking down -z) onto clip space
+ * @param m filled with the projection matrix
+ */
+void orthographicMatrix(float left, float right, float bottom, float top,
+                        float near_plane, float far_plane, float m[16]){
+    for(int i = 0; i < 16; i++) m[i] = 0.0f;
+    m[0] = 2.0f/(right - left);
+    m[5] = 2.0f/(top - bottom);
+    m[10] = -2.0f/(far_plane - near_plane);
+    m[12] = -(right + left)/(right - left);
+    m[13] = -(top + bottom)/(top - bottom);
+    m[14] = -(far_plane + near_plane)/(far_plane - near_plane);
+    m[15] = 1.0f;
+}
+
+/**
+ * Orthogonal projection onto a coordinate plane through the origin,
+ * the matrix form of Vectorf::orthoProject3
+ * @param m filled with the projection matrix
+ */
+void orthoPlaneMatrix(ProjectionPlane plane, float m[16]){
+    identityMatrix(m);
+    int axis = plane == PLANE_XY? 2: plane == PLANE_XZ? 1: 0;
+    m[5*axis] = 0.0f;
+}
+
+/**
+ * Oblique (parallel) projection along dir onto a coordinate plane through the origin,
+ * the matrix form of Vectorf::oblProject3
+ * @param dir projection direction, must not be parallel to the plane
+ * @param m filled with the projection matrix, identity when dir is parallel to the plane
+ * @return whether dir crosses the plane
+ */
+bool obliquePlaneMatrix(ProjectionPlane plane, const float dir[3], float m[16]){
+    identityMatrix(m);
+    int axis = plane == PLANE_XY? 2: plane == PLANE_XZ? 1: 0;
+    if(dir[axis] == 0.0f){
+        std::cout << "Warning: oblique projection direction is parallel to the plane.\n";
+        return false;
+    }
+    for(int row = 0; row < 3; row++) m[4*axis + row] = row == axis? 0.0f: -dir[row]/dir[axis];
+    return true;
+}
+
+Matrixf<4> orthographicMatrix(float left, float right, float bottom, float top,
+                              float near_plane, float far_plane){
+    float m[16];
+    orthographicMatrix(left, right, bottom, top, near_plane, far_plane, m);
+    return toMatrix(m);
+}
+
+Matrixf<4> orthoPlaneMatrix(ProjectionPlane plane){
+    float m[16];
+    orthoPlaneMatrix(plane, m);
+    return toMatrix(m);
+}
+
+Matrixf<4> obliquePlaneMatrix(ProjectionPlane plane, Vectorf<3> dir){
+    float m[16];
+    obliquePlaneMatrix(plane, dir.get(), m);
+    return toMatrix(m);
+}
+
+/**
+ * Copy an engine matrix into the 16 float layout of the batch kernels
+ */
+void toArray(Matrixf<4> M, float m[16]){
+    const float* elems = M.data(); //same column-major order
+    for(int i = 0; i < 16; i++) m[i] = elems[i];
+}
+
+/**
+ * Engine matrix from the 16 float layout of the batch kernels
+ */
+Matrixf<4> toMatrix(const float m[16]){
+    return Matrixf<4>{{m[0], m[1], m[2], m[3]}, {m[4], m[5], m[6], m[7]},
+                      {m[8], m[9], m[10], m[11]}, {m[12], m[13], m[14], m[15]}};
+}
+
+// ==================== Perspective batch ====================
+
+namespace {
+
+//4 bit lane mask spread to one bit per byte, lane 0 in the lowest byte
+const uint32_t LANE_BYTES[16] = {
+    0x00000000, 0x00000001, 0x00000100, 0x00000101, 0x00010000, 0x00010001, 0x00010100, 0x00010101,
+    0x01000000, 0x01000001, 0x01000100, 0x01000101, 0x01010000, 0x01010001, 0x01010100, 0x01010101
+};
+
+/**
+ * Project 4 vertices: transform, clip codes, perspective divide and viewport.
+ * Vertices on or behind the eye plane (w <= 0) get CLIP_NEAR and are divided by 1
+ * so no infinities leak into later stages.
+ * @return the 4 clip codes packed one per byte
+ */
+inline uint32_t project4(const Float4* m, Float4 x, Float4 y, Float4 z, Float4 half_w, Float4 half_h,
+                         Float4& sx, Float4& sy, Float4& sz, Float4& rhw){
+    Float4 cx = m[0]*x + m[4]*y + m[8]*z + m[12];
+    Float4 cy = m[1]*x + m[5]*y + m[9]*z + m[13];
+    Float4 cz = m[2]*x + m[6]*y + m[10]*z + m[14];
+    Float4 cw = m[3]*x + m[7]*y + m[11]*z + m[15];
+    Float4 neg_w = Float4(0.0f) - cw;
+    int masks[6] = {mask(cx < neg_w), mask(cx > cw), mask(cy < neg_w), mask(cy > cw),
+                    mask(cz < neg_w), mask(cz > cw)};
+    uint32_t codes = 0;
+    for(int plane = 0; plane < 6; plane++) codes |= LANE_BYTES[masks[plane]] << plane;
+    Float4 one(1.0f);
+    rhw = one/select(cw > Float4(0.0f), cw, one);
+    sx = (cx*rhw + one)*half_w;
+    sy = (one - cy*rhw)*half_h;
+    sz = (cz*rhw + one)*Float4(0.5f);
+    return codes;
+}
+
+}
+
+/**
+ * Project a vertex array to screen space in a single pass: model-view-projection
+ * transform, perspective divide and viewport transform, 4 vertices at a time.
+ * @param transform model-view-projection matrix
+ * @param px, py, pz SoA vertex positions
+ * @param count number of vertices
+ * @param width, height viewport size in pixels
+ * @param sx, sy filled with pixel coordinates, (0,0) at the top left corner
+ * @param sz filled with depth, 0 on the near plane and 1 on the far plane
+ * @param rhw filled with 1/w, for perspective correct interpolation
+ * @param clip optionally filled with the ClipBits of each vertex
+ * @return the number of vertices inside the view frustum
+ */
+size_t projectVertices(const float transform[16], const float* px, const float* py, const float* pz,
+                       size_t count, int width, int height,
+                       float* sx, float* sy, float* sz, float* rhw, uint8_t* clip){
+    PROFILE_ZONE("projectVertices");
+    Float4 half_w(0.5f*width), half_h(0.5f*height);
+    Float4 m[16]; //broadcast once, the outputs could alias transform otherwise
+    for(int k = 0; k < 16; k++) m[k] = Float4(transform[k]);
+    Float4 x, y, z, w;
+    size_t inside = 0;
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4){
+        uint32_t codes = project4(m, Float4::load(px + i), Float4::load(py + i), Float4::load(pz + i),
+                                  half_w, half_h, x, y, z, w);
+        x.store(sx + i); y.store(sy + i); z.store(sz + i); w.store(rhw + i);
+        for(int lane = 0; lane < 4; lane++){
+            uint8_t code = (uint8_t)(codes >> 8*lane);
+            if(clip) clip[i + lane] = code;
+            inside += code == 0;
+        }
+    }
+    if(i < count){ //tail, padded to a full batch
+        float in[3][4] = {}, out[4][4];
+        size_t rest = count - i;
+        for(size_t k = 0; k < rest; k++){
+            in[0][k] = px[i + k]; in[1][k] = py[i + k]; in[2][k] = pz[i + k];
+        }
+        uint32_t codes = project4(m, Float4::load(in[0]), Float4::load(in[1]), Float4::load(in[2]),
+                                  half_w, half_h, x, y, z, w);
+        x.store(out[0]); y.store(out[1]); z.store(out[2]); w.store(out[3]);
+        for(size_t k = 0; k < rest; k++){
+            sx[i + k] = out[0][k]; sy[i + k] = out[1][k]; sz[i + k] = out[2][k]; rhw[i + k] = out[3][k];
+            uint8_t code = (uint8_t)(codes >> 8*k);
+            if(clip) clip[i + k] = code;
+            inside += code == 0;
+        }
+    }
+    return inside;
+}
+
+/**
+ * projectVertices with an engine matrix
+ */
+size_t projectVertices(Matrixf<4> transform, const float* px, const float* py, const float* pz,
+                       size_t count, int width, int height,
+                       float* sx, float* sy, float* sz, float* rhw, uint8_t* clip){
+    float m[16];
+    toArray(transform, m);
+    return projectVertices(m, px, py, pz, count, width, height, sx, sy, sz, rhw, clip);
+}
+
+// ==================== Parallel projection batches ====================
+
+/**
+ * Project a vertex array through an affine (orthographic) transform and the
+ * viewport, without a perspective divide. Used for shadow maps, where the
+ * light's view and orthographic matrices are fused into transform.
+ * @param transform affine model-view-projection matrix, its last row is ignored
+ * @param px, py, pz SoA vertex positions
+ * @param count number of vertices
+ * @param width, height viewport size in pixels
+ * @param sx, sy filled with pixel coordinates, (0,0) at the top left corner
+ * @param sz filled with depth, 0 on the near plane and 1 on the far plane
+ * @param clip optionally filled with the ClipBits of each vertex
+ * @return the number of vertices inside the view box
+ */
+size_t projectOrthographic(const float transform[16], const float* px, const float* py, const float* pz,
+                           size_t count, int width, int height,
+                           float* sx, float* sy, float* sz, uint8_t* clip){
+    PROFILE_ZONE("projectOrthographic");
+    const float* m = transform;
+    Float4 half_w(0.5f*width), half_h(0.5f*height), one(1.0f), half(0.5f), neg_one(-1.0f);
+    Float4 m0(m[0]), m4(m[4]), m8(m[8]), m12(m[12]);
+    Float4 m1(m[1]), m5(m[5]), m9(m[9]), m13(m[13]);
+    Float4 m2(m[2]), m6(m[6]), m10(m[10]), m14(m[14]);
+    size_t inside = 0;
+    for(size_t i = 0; i < count; i += 4){
+        size_t rest = count - i < 4? count - i: 4;
+        float in[3][4] = {}, out[3][4];
+        const float *x_in = px + i, *y_in = py + i, *z_in = pz + i;
+        if(rest < 4){ //tail, padded to a full batch
+            memcpy(in[0], px + i, rest*sizeof(float));
+            memcpy(in[1], py + i, rest*sizeof(float));
+            memcpy(in[2], pz + i, rest*sizeof(float));
+            x_in = in[0]; y_in = in[1]; z_in = in[2];
+        }
+        Float4 x = Float4::load(x_in), y = Float4::load(y_in), z = Float4::load(z_in);
+        Float4 cx = m0*x + m4*y + m8*z + m12;
+        Float4 cy = m1*x + m5*y + m9*z + m13;
+        Float4 cz = m2*x + m6*y + m10*z + m14;
+        int masks[6] = {mask(cx < neg_one), mask(cx > one), mask(cy < neg_one), mask(cy > one),
+                        mask(cz < neg_one), mask(cz > one)};
+        float* x_out = rest < 4? out[0]: sx + i;
+        float* y_out = rest < 4? out[1]: sy + i;
+        float* z_out = rest < 4? out[2]: sz + i;
+        ((cx + one)*half_w).store(x_out);
+        ((one - cy)*half_h).store(y_out);
+        ((cz + one)*half).store(z_out);
+        uint32_t codes = 0;
+        for(int plane = 0; plane < 6; plane++) codes |= LANE_BYTES[masks[plane]] << plane;
+        for(size_t lane = 0; lane < rest; lane++){
+            uint8_t code = (uint8_t)(codes >> 8*lane);
+            if(clip) clip[i + lane] = code;
+            inside += code == 0;
+            if(rest < 4){
+                sx[i + lane] = out[0][lane]; sy[i + lane] = out[1][lane]; sz[i + lane] = out[2][lane];
+            }
+        }
+    }
+    return inside;
+}
+
+/**
+ * Orthogonal projection of a vertex array onto a coordinate plane, written as
+ * 2D plane coordinates: (x,y) for PLANE_XY, (x,z) for PLANE_XZ, (y,z) for PLANE_YZ
+ * @param u, v filled with the plane coordinates
+ */
+void orthoProject(ProjectionPlane plane, const float* px, const float* py, const float* pz, size_t count,
+                  float* u, float* v){
+    const float* first = plane == PLANE_YZ? py: px;
+    const float* second = plane == PLANE_XY? py: pz;
+    memcpy(u, first, count*sizeof(float));
+    memcpy(v, second, count*sizeof(float));
+}
+
+/**
+ * Oblique projection of a vertex array along dir onto a coordinate plane,
+ * written as 2D plane coordinates in the order of orthoProject.
+ * The plane is resolved once into stream pointers and two slopes, outside the loop.
+ * @param dir projection direction, must not be parallel to the plane
+ * @param u, v filled with the plane coordinates
+ * @return whether dir crosses the plane, nothing is written otherwise
+ */
+bool obliqueProject(ProjectionPlane plane, const float dir[3], const float* px, const float* py, const float* pz,
+                    size_t count, float* u, float* v){
+    PROFILE_ZONE("obliqueProject");
+    int axis = plane == PLANE_XY? 2: plane == PLANE_XZ? 1: 0;
+    if(dir[axis] == 0.0f){
+        std::cout << "Warning: oblique projection direction is parallel to the plane.\n";
+        return false;
+    }
+    //u = a - s*depth, v = b - t*depth where depth is the coordinate along the plane normal
+    const float* a = plane == PLANE_YZ? py: px;
+    const float* b = plane == PLANE_XY? py: pz;
+    const float* depth = plane == PLANE_XY? pz: plane == PLANE_XZ? py: px;
+    float s = (plane == PLANE_YZ? dir[1]: dir[0])/dir[axis];
+    float t = (plane == PLANE_XY? dir[1]: dir[2])/dir[axis];
+    Float4 s4(s), t4(t);
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4){
+        Float4 d = Float4::load(depth + i);
+        (Float4::load(a + i) - s4*d).store(u + i);
+        (Float4::load(b + i) - t4*d).store(v + i);
+    }
+    for(; i < count; i++){
+        u[i] = a[i] - s*depth[i];
+        v[i] = b[i] - t*depth[i];
+    }
+    return true;
+}
@@ -0,0 +1,69 @@
+#ifndef GRAPHICSENGINE3D_PROJECTION_H
+#define GRAPHICSENGINE3D_PROJECTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include "matrix.h"
+
+/**
+ * Batched vertex projection. Transforms are 4x4 matrices stored as 16 floats
+ * in column-major order, the element order of Matrixf (m[4*col + row]), and
+ * apply to column vectors: clip = M * (x, y, z, 1).
+ * Clip space follows the OpenGL convention (x, y, z in [-w, w]); the viewport
+ * transform maps it to pixels with (0,0) at the top left corner and depth in [0,1].
+ */
+
+/**
+ * Frustum plane bits of a projected vertex, set when the vertex is outside that plane
+ */
+enum ClipBits{
+    CLIP_LEFT = 1,
+    CLIP_RIGHT = 2,
+    CLIP_BOTTOM = 4,
+    CLIP_TOP = 8,
+    CLIP_NEAR = 16,
+    CLIP_FAR = 32
+};
+
+/**
+ * Coordinate planes of the orthographic and oblique projections, named
+ * like the plane strings of Vectorf::orthoProject3 ("xy"/"z", "xz"/"y", "yz"/"x")
+ */
+enum ProjectionPlane{
+    PLANE_XY,
+    PLANE_XZ,
+    PLANE_YZ
+};
+
+bool parsePlane(const std::string& name, ProjectionPlane& plane);
+
+void identityMatrix(float m[16]);
+void multiplyMatrix(const float a[16], const float b[16], float out[16]); //out = a*b, out may alias a or b
+void perspectiveMatrix(float fov, float aspect, float near_plane, float far_plane, float m[16]);
+void orthographicMatrix(float left, float right, float bottom, float top,
+                        float near_plane, float far_plane, float m[16]);
+void orthoPlaneMatrix(ProjectionPlane plane, float m[16]);
+bool obliquePlaneMatrix(ProjectionPlane plane, const float dir[3], float m[16]);
+Matrixf<4> orthographicMatrix(float left, float right, float bottom, float top,
+                              float near_plane, float far_plane);
+Matrixf<4> orthoPlaneMatrix(ProjectionPlane plane);
+Matrixf<4> obliquePlaneMatrix(ProjectionPlane plane, Vectorf<3> dir);
+void toArray(Matrixf<4> M, float m[16]);
+Matrixf<4> toMatrix(const float m[16]);
+
+size_t projectVertices(const float transform[16], const float* px, const float* py, const float* pz,
+                       size_t count, int width, int height,
+                       float* sx, float* sy, float* sz, float* rhw, uint8_t* clip = nullptr);
+size_t projectVertices(Matrixf<4> transform, const float* px, const float* py, const float* pz,
+                       size_t count, int width, int height,
+                       float* sx, float* sy, float* sz, float* rhw, uint8_t* clip = nullptr);
+size_t projectOrthographic(const float transform[16], const float* px, const float* py, const float* pz,
+                           size_t count, int width, int height,
+                           float* sx, float* sy, float* sz, uint8_t* clip = nullptr);
+void orthoProject(ProjectionPlane plane, const float* px, const float* py, const float* pz, size_t count,
+                  float* u, float* v);
+bool obliqueProject(ProjectionPlane plane, const float dir[3], const float* px, const float* py, const float* pz,
+                    size_t count, float* u, float* v);
+
+#endif //GRAPHICSENGINE3D_PROJECTION_H
@@ -0,0 +1,780 @@
+#include "rasterizer.h"
+#include "profiler.h"
+#include "projection.h"
+#include "simd.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <math.h>
+
+//Implementation details of the tile based rasterizer
+
+namespace {
+
+/**
+ * Vertex of a triangle being clipped against the near plane
+ */
+struct ClipVertex{
+    float world[3];
+    float normal[3];
+    float clip[4];
+};
+
+/**
+ * Whether a pixel center lying exactly on the edge a->b belongs to the triangle.
+ * Two triangles sharing an edge see it in opposite directions, so exactly one owns it.
+ */
+inline bool ownsEdge(float ax, float ay, float bx, float by){
+    return by < ay || (by == ay && bx > ax);
+}
+
+/**
+ * Lights reaching the fragments of one cluster
+ */
+struct FragmentLights{
+    const PointLight* points;
+    uint32_t point_count;
+    const SpotLight* spots;
+    const DirectionalLight* directionals;
+    size_t directional_count;
+    const uint32_t* list; //cluster light indices, spot lights offset by point_count
+    uint32_t count;
+    const ShadowCascades* shadows; //shadows of the first directional light, nullptr without
+};
+
+inline void normalizeDirection(float d[3]){
+    float len = sqrtf(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+    if(len > 0) for(int c = 0; c < 3; c++) d[c] /= len;
+}
+
+/**
+ * Lambert shading of a fragment
+ * @param p world space position
+ * @param n world space normal, not normalized, turned toward the eye
+ * @param eye camera position
+ * @param albedo diffuse color
+ * @param lights the lights of the fragment's cluster and the directional lights
+ * @param ambient ambient light
+ * @param view_depth depth of p along the camera's forward axis
+ * @param out filled with the linear RGB color
+ */
+inline void shade(const float p[3], float n[3], const float eye[3], const float albedo[3],
+                  const FragmentLights& lights, const float ambient[3], float view_depth, float out[3]){
+    for(int c = 0; c < 3; c++) out[c] = ambient[c]*albedo[c];
+    float len = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+    if(len == 0) return;
+    float facing = n[0]*(eye[0] - p[0]) + n[1]*(eye[1] - p[1]) + n[2]*(eye[2] - p[2]) < 0? -1.0f/len: 1.0f/len;
+    for(int c = 0; c < 3; c++) n[c] *= facing;
+    for(uint32_t k = 0; k < lights.count; k++){
+        uint32_t index = lights.list[k];
+        const SpotLight* spot = index >= lights.point_count? &lights.spots[index - lights.point_count]: nullptr;
+        const float* position = spot? spot->position: lights.points[index].position;
+        const float* color = spot? spot->color: lights.points[index].color;
+        float radius = spot? spot->radius: lights.points[index].radius;
+        float l[3] = {position[0] - p[0], position[1] - p[1], position[2] - p[2]};
+        float d2 = l[0]*l[0] + l[1]*l[1] + l[2]*l[2];
+        float r2 = radius*radius;
+        if(d2 >= r2 || d2 == 0) continue;
+        float d = sqrtf(d2);
+        float ndl = (n[0]*l[0] + n[1]*l[1] + n[2]*l[2])/d;
+        if(ndl <= 0) continue;
+        float falloff = 1 - d2/r2;
+        float intensity = ndl*falloff*falloff;
+        if(spot){
+            float axis = -(l[0]*spot->direction[0] + l[1]*spot->direction[1] + l[2]*spot->direction[2])/d;
+            if(axis <= spot->outer_cos) continue;
+            float t = spot->inner_cos > spot->outer_cos?
+                      std::min(1.0f, (axis - spot->outer_cos)/(spot->inner_cos - spot->outer_cos)): 1.0f;
+            intensity *= t*t*(3 - 2*t);
+        }
+        for(int c = 0; c < 3; c++) out[c] += albedo[c]*color[c]*intensity;
+    }
+    for(size_t i = 0; i < lights.directional_count; i++){
+        const DirectionalLight& light = lights.directionals[i];
+        float ndl = -(n[0]*light.direction[0] + n[1]*light.direction[1] + n[2]*light.direction[2]);
+        if(ndl <= 0) continue;
+        if(i == 0 && lights.shadows) ndl *= lights.shadows->visibility(p, n, view_depth);
+        for(int c = 0; c < 3; c++) out[c] += albedo[c]*light.color[c]*ndl;
+    }
+}
+}
+
+/**
+ * Rasterizer running its stages on a job system, with a dim white ambient light,
+ * no lights and back face culling enabled
+ * @param system the job system, must outlive the rasterizer
+ */
+Rasterizer::Rasterizer(JobSystem& system){
+    jobs = &system;
+    for(int c = 0; c < 3; c++) ambient[c] = 0.1f;
+    cull_back = true;
+    stats = RasterStats{};
+    bins_x = 0;
+    bins_y = 0;
+}
+
+void Rasterizer::setLights(const std::vector<PointLight>& point_lights){
+    lights = point_lights;
+}
+
+/**
+ * @param spots spot lights, their directions need not be normalized
+ */
+void Rasterizer::setSpotLights(const std::vector<SpotLight>& spots){
+    spot_lights = spots;
+    for(SpotLight& light: spot_lights) normalizeDirection(light.direction);
+}
+
+/**
+ * @param directionals directional lights, their directions need not be normalized
+ */
+void Rasterizer::setDirectionalLights(const std::vector<DirectionalLight>& directionals){
+    directional_lights = directionals;
+    for(DirectionalLight& light: directional_lights) normalizeDirection(light.direction);
+}
+
+void Rasterizer::setAmbient(const float light[3]){
+    for(int c = 0; c < 3; c++) ambient[c] = light[c];
+}
+
+/**
+ * @param enabled whether clockwise triangles are dropped, otherwise both sides are shaded
+ */
+void Rasterizer::setBackfaceCulling(bool enabled){
+    cull_back = enabled;
+}
+
+/**
+ * Shadows of the first directional light, off by default
+ * @param cascades number of shadow cascades, 0 turns shadows off
+ * @param resolution texels per side of every cascade's depth map
+ * @param distance view depth past which nothing is shadowed
+ */
+void Rasterizer::setShadows(int cascades, int resolution, float distance){
+    shadows.setCascades(cascades, resolution, distance);
+}
+
+const RasterStats& Rasterizer::getStats() const{
+    return stats;
+}
+
+/**
+ * Shadow cascades fitted and rendered by the last render call
+ */
+const ShadowCascades& Rasterizer::getShadows() const{
+    return shadows;
+}
+
+/**
+ * Render a frame into target, on top of its current content (clear it first
+ * for a new frame). The camera aspect should match the target's.
+ * The light assignment draws temporaries from the FrameArena of the job
+ * threads and does not release them, since other code may hold memory from
+ * the same arenas: the caller ends the frame with FrameArena::resetAll().
+ * @param camera the camera to render from
+ * @param objects the scene, meshes must stay alive during the call
+ * @param target the render target
+ */
+void Rasterizer::render(const Camera& camera, const std::vector<RenderObject>& objects, Framebuffer& target){
+    PROFILE_ZONE("Rasterizer::render");
+    typedef std::chrono::steady_clock Clock;
+    int width = target.getWidth();
+    int height = target.getHeight();
+    stats = RasterStats{};
+
+    Clock::time_point start = Clock::now();
+    transformVertices(camera, objects, width, height);
+    Clock::time_point transformed = Clock::now();
+    if(shadows.cascadeCount() > 0 && !directional_lights.empty()){
+        shadows.fit(camera, directional_lights[0].direction);
+        renderShadowMaps(objects);
+    }
+    Clock::time_point shadow_mapped = Clock::now();
+    clusters.build(*jobs, camera, width, height, RASTER_BIN_SIZE, lights, spot_lights);
+    Clock::time_point clustered = Clock::now();
+    binTriangles(camera, objects, width, height);
+    Clock::time_point binned = Clock::now();
+
+    std::atomic<size_t> fragments(0), light_tests(0);
+    const float* eye = camera.getPosition();
+    jobs->parallelFor(0, bins.size(), [&](size_t begin, size_t end){
+        size_t count = 0, tests = 0;
+        for(size_t bin = begin; bin < end; bin++) count += rasterBin((int)bin, eye, objects, target, tests);
+        fragments += count;
+        light_tests += tests;
+    }, 1);
+    Clock::time_point rasterized = Clock::now();
+
+    stats.transform = std::chrono::duration<double>(transformed - start).count();
+    stats.shadows = std::chrono::duration<double>(shadow_mapped - transformed).count();
+    stats.lighting = std::chrono::duration<double>(clustered - shadow_mapped).count();
+    stats.bin = std::chrono::duration<double>(binned - clustered).count();
+    stats.raster = std::chrono::duration<double>(rasterized - binned).count();
+    stats.fragments = fragments;
+    stats.light_tests = light_tests;
+    PROFILE_COUNTER("Rasterizer fragments", stats.fragments);
+}
+
+// ====== Transform ======
+
+/**
+ * Transform every vertex of the scene to world space, then project it,
+ * in parallel chunks that may span several objects
+ */
+void Rasterizer::transformVertices(const Camera& camera, const std::vector<RenderObject>& objects,
+                                   int width, int height){
+    PROFILE_ZONE("Rasterizer::transformVertices");
+    vertex_base.resize(objects.size() + 1);
+    vertex_base[0] = 0;
+    for(size_t o = 0; o < objects.size(); o++){
+        vertex_base[o + 1] = vertex_base[o] + (objects[o].mesh? objects[o].mesh->vertexCount(): 0);
+    }
+    size_t total = vertex_base.back();
+    for(std::vector<float>* stream: {&wx, &wy, &wz, &nx, &ny, &nz, &sx, &sy, &sz, &rhw}) stream->resize(total);
+    clip.resize(total);
+    float view_projection[16];
+    camera.getViewProjectionMatrix(view_projection);
+
+    jobs->parallelFor(0, total, [&](size_t begin, size_t end){
+        size_t o = std::upper_bound(vertex_base.begin(), vertex_base.end(), begin) - vertex_base.begin() - 1;
+        for(; begin < end; o++){
+            size_t stop = std::min(end, vertex_base[o + 1]);
+            if(stop == begin) continue;
+            const Mesh& mesh = *objects[o].mesh;
+            const float* m = objects[o].transform;
+            size_t first = begin - vertex_base[o];
+            size_t count = stop - begin;
+            const float *x = &mesh.px[first], *y = &mesh.py[first], *z = &mesh.pz[first];
+            for(size_t i = 0; i < count; i++){ //affine model matrix, the last row is ignored
+                wx[begin + i] = m[0]*x[i] + m[4]*y[i] + m[8]*z[i] + m[12];
+                wy[begin + i] = m[1]*x[i] + m[5]*y[i] + m[9]*z[i] + m[13];
+                wz[begin + i] = m[2]*x[i] + m[6]*y[i] + m[10]*z[i] + m[14];
+            }
+            if(mesh.hasNormals()){
+                x = &mesh.nx[first]; y = &mesh.ny[first]; z = &mesh.nz[first];
+                for(size_t i = 0; i < count; i++){
+                    nx[begin + i] = m[0]*x[i] + m[4]*y[i] + m[8]*z[i];
+                    ny[begin + i] = m[1]*x[i] + m[5]*y[i] + m[9]*z[i];
+                    nz[begin + i] = m[2]*x[i] + m[6]*y[i] + m[10]*z[i];
+                }
+            }
+            else{
+                std::fill(&nx[begin], &nx[begin] + count, 0.0f);
+                std::fill(&ny[begin], &ny[begin] + count, 0.0f);
+                std::fill(&nz[begin], &nz[begin] + count, 0.0f);
+            }
+            projectVertices(view_projection, &wx[begin], &wy[begin], &wz[begin], count, width, height,
+                            &sx[begin], &sy[begin], &sz[begin], &rhw[begin], &clip[begin]);
+            begin = stop;
+        }
+    }, 4096);
+}
+
+// ====== Shadow maps ======
+
+/**
+ * Render the depth map of every shadow cascade from the world space vertices
+ * of the frame: project them with the cascade's light matrix, bin the
+ * triangles overlapping the map, then rasterize every bin. With back face
+ * culling on, only the faces turned to the light cast shadows, as closed
+ * meshes hide their back faces behind them anyway.
+ */
+void Rasterizer::renderShadowMaps(const std::vector<RenderObject>& objects){
+    PROFILE_ZONE("Rasterizer::renderShadowMaps");
+    size_t total = vertex_base.back();
+    for(std::vector<float>* stream: {&lx, &ly, &lz}) stream->resize(total);
+    int size = shadows.getResolution();
+    int bins_side = (size + RASTER_BIN_SIZE - 1)/RASTER_BIN_SIZE;
+    shadow_bins.resize((size_t)bins_side*bins_side);
+
+    for(int cascade = 0; cascade < shadows.cascadeCount(); cascade++){
+        const float* m = shadows.lightMatrix(cascade);
+        jobs->parallelFor(0, total, [&](size_t begin, size_t end){
+            for(size_t i = begin; i < end; i++){
+                lx[i] = m[0]*wx[i] + m[4]*wy[i] + m[8]*wz[i] + m[12];
+                ly[i] = m[1]*wx[i] + m[5]*wy[i] + m[9]*wz[i] + m[13];
+                //casters in front of the cascade are flattened onto its near plane
+                lz[i] = std::max(0.0f, m[2]*wx[i] + m[6]*wy[i] + m[10]*wz[i] + m[14]);
+            }
+        }, 4096);
+
+        for(std::vector<uint32_t>& bin: shadow_bins) bin.clear();
+        shadow_triangles.clear();
+        for(size_t o = 0; o < objects.size(); o++){
+            if(objects[o].mesh == nullptr) continue;
+            const std::vector<uint32_t>& indices = objects[o].mesh->indices;
+            uint32_t base = (uint32_t)vertex_base[o];
+            for(size_t t = 0; t + 2 < indices.size(); t += 3){
+                uint32_t i0 = base + indices[t], i1 = base + indices[t + 1], i2 = base + indices[t + 2];
+                if(std::min(lz[i0], std::min(lz[i1], lz[i2])) > 1) continue; //behind every receiver
+                //a negative area faces the light, y pointing down the map
+                float area = (lx[i1] - lx[i0])*(ly[i2] - ly[i0]) - (ly[i1] - ly[i0])*(lx[i2] - lx[i0]);
+                if(area < 0) std::swap(i1, i2);
+                else if(cull_back || !(area > 0)) continue;
+                float min_x = std::min(lx[i0], std::min(lx[i1], lx[i2])), max_x = std::max(lx[i0], std::max(lx[i1], lx[i2]));
+                float min_y = std::min(ly[i0], std::min(ly[i1], ly[i2])), max_y = std::max(ly[i0], std::max(ly[i1], ly[i2]));
+                int x0 = (int)std::max(0.0f, ceilf(min_x - 0.5f));
+                int y0 = (int)std::max(0.0f, ceilf(min_y - 0.5f));
+                int x1 = (int)std::min((float)size - 1, floorf(max_x - 0.5f));
+                int y1 = (int)std::min((float)size - 1, floorf(max_y - 0.5f));
+                if(x0 > x1 || y0 > y1) continue;
+
+                uint32_t id = (uint32_t)shadow_triangles.size()/3;
+                shadow_triangles.insert(shadow_triangles.end(), {i0, i1, i2});
+                for(int by = y0/RASTER_BIN_SIZE; by <= y1/RASTER_BIN_SIZE; by++){
+                    for(int bx = x0/RASTER_BIN_SIZE; bx <= x1/RASTER_BIN_SIZE; bx++){
+                        shadow_bins[by*bins_side + bx].push_back(id);
+                    }
+                }
+            }
+        }
+        stats.shadow_triangles += shadow_triangles.size()/3;
+
+        float* map = shadows.depthMap(cascade);
+        jobs->parallelFor(0, shadow_bins.size(), [&](size_t begin, size_t end){
+            for(size_t bin = begin; bin < end; bin++) rasterShadowBin((int)bin, bins_side, map);
+        }, 1);
+    }
+}
+
+/**
+ * Clear one bin of a shadow map, then keep the nearest depth of its triangles.
+ * Rows are walked 4 pixels at a time with the edge functions and the depth
+ * plane stepped incrementally: nothing else is interpolated. The map size is
+ * a multiple of 4, so aligned groups of 4 pixels never cross a bin or a row.
+ * @param bin the bin index
+ * @param bins_side bins per side of the map
+ * @param map depth map of the cascade
+ */
+void Rasterizer::rasterShadowBin(int bin, int bins_side, float* map) const{
+    int size = shadows.getResolution();
+    int bin_x0 = (bin%bins_side)*RASTER_BIN_SIZE;
+    int bin_y0 = (bin/bins_side)*RASTER_BIN_SIZE;
+    int bin_x1 = std::min(bin_x0 + RASTER_BIN_SIZE, size) - 1;
+    int bin_y1 = std::min(bin_y0 + RASTER_BIN_SIZE, size) - 1;
+    for(int py = bin_y0; py <= bin_y1; py++) std::fill(map + (size_t)py*size + bin_x0, map + (size_t)py*size + bin_x1 + 1, 1.0f);
+    Float4 lane(0.5f, 1.5f, 2.5f, 3.5f), zero(0.0f);
+
+    for(uint32_t id: shadow_bins[bin]){
+        uint32_t v[3] = {shadow_triangles[3*id], shadow_triangles[3*id + 1], shadow_triangles[3*id + 2]};
+        float x[3], y[3], z[3];
+        for(int k = 0; k < 3; k++){ x[k] = lx[v[k]]; y[k] = ly[v[k]]; z[k] = lz[v[k]];}
+        float inv_area = 1.0f/((x[1] - x[0])*(y[2] - y[0]) - (y[1] - y[0])*(x[2] - x[0]));
+        float dzdx = ((z[1] - z[0])*(y[2] - y[0]) - (z[2] - z[0])*(y[1] - y[0]))*inv_area;
+        float dzdy = ((z[2] - z[0])*(x[1] - x[0]) - (z[1] - z[0])*(x[2] - x[0]))*inv_area;
+
+        float min_x = std::min(x[0], std::min(x[1], x[2])), max_x = std::max(x[0], std::max(x[1], x[2]));
+        float min_y = std::min(y[0], std::min(y[1], y[2])), max_y = std::max(y[0], std::max(y[1], y[2]));
+        int px0 = (int)std::max((float)bin_x0, ceilf(min_x - 0.5f)) & ~3;
+        int py0 = (int)std::max((float)bin_y0, ceilf(min_y - 0.5f));
+        int px1 = (int)std::min((float)bin_x1, floorf(max_x - 0.5f));
+        int py1 = (int)std::min((float)bin_y1, floorf(max_y - 0.5f));
+
+        //edge k runs from vertex k + 1 to vertex k + 2, positive inside; shared edges are drawn twice, harmlessly
+        float edge_dx[3], edge_dy[3], ex[3], ey[3];
+        for(int k = 0; k < 3; k++){
+            int a = (k + 1)%3, b = (k + 2)%3;
+            ex[k] = x[a]; ey[k] = y[a];
+            edge_dx[k] = x[b] - x[a];
+            edge_dy[k] = y[b] - y[a];
+        }
+        //values at the first group of a row, less the terms depending on the row
+        Float4 first_x = Float4((float)px0) + lane;
+        Float4 edge_x[3], edge_step[3];
+        for(int k = 0; k < 3; k++){
+            edge_x[k] = Float4(edge_dy[k])*(first_x - Float4(ex[k]));
+            edge_step[k] = Float4(-4*edge_dy[k]);
+        }
+        Float4 depth_x = Float4(dzdx)*(first_x - Float4(x[0])), depth_step(4*dzdx);
+        float cy = py0 + 0.5f;
+        Float4 row_e[3];
+        for(int k = 0; k < 3; k++) row_e[k] = Float4(edge_dx[k]*(cy - ey[k])) - edge_x[k];
+        Float4 row_depth = Float4(z[0] + dzdy*(cy - y[0])) + depth_x;
+        for(int py = py0; py <= py1; py++){
+            Float4 e[3] = {row_e[0], row_e[1], row_e[2]};
+            Float4 depth = row_depth;
+            float* row = map + (size_t)py*size;
+            for(int px = px0; px <= px1; px += 4){
+                Float4 old = Float4::load(row + px);
+                Float4 write = (e[0] >= zero) & (e[1] >= zero) & (e[2] >= zero) & (depth < old);
+                if(mask(write)) select(write, depth, old).store(row + px);
+                for(int k = 0; k < 3; k++) e[k] = e[k] + edge_step[k];
+                depth = depth + depth_step;
+            }
+            for(int k = 0; k < 3; k++) row_e[k] = row_e[k] + Float4(edge_dx[k]);
+            row_depth = row_depth + Float4(dzdy);
+        }
+    }
+}
+
+// ====== Binning ======
+
+/**
+ * Cull every triangle outside the frustum, clip the ones crossing the near
+ * plane and add the rest to the bins they overlap, in submission order
+ */
+void Rasterizer::binTriangles(const Camera& camera, const std::vector<RenderObject>& objects, int width, int height){
+    PROFILE_ZONE("Rasterizer::binTriangles");
+    bins_x = (width + RASTER_BIN_SIZE - 1)/RASTER_BIN_SIZE;
+    bins_y = (height + RASTER_BIN_SIZE - 1)/RASTER_BIN_SIZE;
+    bins.resize((size_t)bins_x*bins_y);
+    for(std::vector<uint32_t>& bin: bins) bin.clear();
+    triangles.clear();
+    triangle_object.clear();
+    float view_projection[16];
+    camera.getViewProjectionMatrix(view_projection);
+
+    for(size_t o = 0; o < objects.size(); o++){
+        if(objects[o].mesh == nullptr) continue;
+        const std::vector<uint32_t>& indices = objects[o].mesh->indices;
+        uint32_t base = (uint32_t)vertex_base[o];
+        stats.triangles += indices.size()/3;
+        for(size_t t = 0; t + 2 < indices.size(); t += 3){
+            uint32_t i0 = base + indices[t], i1 = base + indices[t + 1], i2 = base + indices[t + 2];
+            uint8_t c0 = clip[i0], c1 = clip[i1], c2 = clip[i2];
+            if(c0 & c1 & c2) continue; //outside one frustum plane
+            if((c0 | c1 | c2) & CLIP_NEAR) clipNear(view_projection, i0, i1, i2, (uint32_t)o, width, height);
+            else binTriangle(i0, i1, i2, (uint32_t)o, width, height);
+        }
+    }
+    stats.binned = triangle_object.size();
+}
+
+/**
+ * Cull a triangle in front of the near plane by facing and coverage, then bin it
+ */
+void Rasterizer::binTriangle(uint32_t i0, uint32_t i1, uint32_t i2, uint32_t object, int width, int height){
+    float area = (sx[i1] - sx[i0])*(sy[i2] - sy[i0]) - (sy[i1] - sy[i0])*(sx[i2] - sx[i0]);
+    //counter clockwise in clip space is a negative area with y pointing down
+    if(area < 0) std::swap(i1, i2);
+    else if(cull_back || !(area > 0)) return;
+
+    //pixels whose center is inside the bounding box
+    float min_x = std::min(sx[i0], std::min(sx[i1], sx[i2])), max_x = std::max(sx[i0], std::max(sx[i1], sx[i2]));
+    float min_y = std::min(sy[i0], std::min(sy[i1], sy[i2])), max_y = std::max(sy[i0], std::max(sy[i1], sy[i2]));
+    int x0 = (int)std::max(0.0f, ceilf(min_x - 0.5f));
+    int y0 = (int)std::max(0.0f, ceilf(min_y - 0.5f));
+    int x1 = (int)std::min((float)width - 1, floorf(max_x - 0.5f));
+    int y1 = (int)std::min((float)height - 1, floorf(max_y - 0.5f));
+    if(x0 > x1 || y0 > y1) return;
+
+    uint32_t id = (uint32_t)triangle_object.size();
+    triangles.push_back(i0);
+    triangles.push_back(i1);
+    triangles.push_back(i2);
+    triangle_object.push_back(object);
+    for(int by = y0/RASTER_BIN_SIZE; by <= y1/RASTER_BIN_SIZE; by++){
+        for(int bx = x0/RASTER_BIN_SIZE; bx <= x1/RASTER_BIN_SIZE; bx++) bins[by*bins_x + bx].push_back(id);
+    }
+}
+
+/**
+ * Clip a triangle against the near plane (z + w >= 0 in clip space), adding
+ * the new vertices to the frame's vertex streams and binning the 1 or 2 triangles left
+ */
+void Rasterizer::clipNear(const float vp[16], uint32_t i0, uint32_t i1, uint32_t i2, uint32_t object,
+                          int width, int height){
+    ClipVertex in[3], out[4];
+    uint32_t ids[3] = {i0, i1, i2}, out_ids[4];
+    for(int k = 0; k < 3; k++){
+        uint32_t i = ids[k];
+        float p[3] = {wx[i], wy[i], wz[i]};
+        ClipVertex& v = in[k];
+        for(int c = 0; c < 3; c++) v.world[c] = p[c];
+        v.normal[0] = nx[i]; v.normal[1] = ny[i]; v.normal[2] = nz[i];
+        for(int r = 0; r < 4; r++) v.clip[r] = vp[r]*p[0] + vp[4 + r]*p[1] + vp[8 + r]*p[2] + vp[12 + r];
+    }
+    int count = 0;
+    for(int k = 0; k < 3; k++){
+        const ClipVertex& a = in[k];
+        const ClipVertex& b = in[(k + 1)%3];
+        float da = a.clip[2] + a.clip[3], db = b.clip[2] + b.clip[3];
+        if(da >= 0){
+            out[count] = a;
+            out_ids[count++] = ids[k];
+        }
+        if((da >= 0) != (db >= 0)){
+            float t = da/(da - db);
+            ClipVertex& v = out[count];
+            for(int c = 0; c < 3; c++){
+                v.world[c] = a.world[c] + t*(b.world[c] - a.world[c]);
+                v.normal[c] = a.normal[c] + t*(b.normal[c] - a.normal[c]);
+            }
+            for(int r = 0; r < 4; r++) v.clip[r] = a.clip[r] + t*(b.clip[r] - a.clip[r]);
+            out_ids[count++] = (uint32_t)wx.size();
+            float w = 1.0f/v.clip[3];
+            wx.push_back(v.world[0]); wy.push_back(v.world[1]); wz.push_back(v.world[2]);
+            nx.push_back(v.normal[0]); ny.push_back(v.normal[1]); nz.push_back(v.normal[2]);
+            sx.push_back((v.clip[0]*w + 1)*0.5f*width);
+            sy.push_back((1 - v.clip[1]*w)*0.5f*height);
+            sz.push_back((v.clip[2]*w + 1)*0.5f);
+            rhw.push_back(w);
+            clip.push_back(0);
+        }
+    }
+    for(int k = 1; k + 1 < count; k++) binTriangle(out_ids[0], out_ids[k], out_ids[k + 1], object, width, height);
+}
+
+// ====== Rasterization ======
+
+/**
+ * Rasterize, depth test and shade the triangles of one bin, one framebuffer tile at a time
+ * @param bin the bin index
+ * @param eye camera position
+ * @param objects the scene
+ * @param target the render target
+ * @param light_tests increased by the number of lights evaluated
+ * @return the number of shaded fragments
+ */
+size_t Rasterizer::rasterBin(int bin, const float eye[3], const std::vector<RenderObject>& objects,
+                             Framebuffer& target, size_t& light_tests) const{
+    int bin_x0 = (bin%bins_x)*RASTER_BIN_SIZE;
+    int bin_y0 = (bin/bins_x)*RASTER_BIN_SIZE;
+    int bin_x1 = std::min(bin_x0 + RASTER_BIN_SIZE, target.getWidth()) - 1;
+    int bin_y1 = std::min(bin_y0 + RASTER_BIN_SIZE, target.getHeight()) - 1;
+    size_t fragments = 0;
+    //the bins are the screen tiles of the light clusters, s below is the view depth of a fragment
+    FragmentLights fragment_lights = {lights.data(), (uint32_t)lights.size(), spot_lights.data(),
+                                      directional_lights.data(), directional_lights.size(), nullptr, 0,
+                                      shadows.cascadeCount() > 0? &shadows: nullptr};
+    int tile_x = bin%bins_x, tile_y = bin/bins_x;
+    const uint32_t* column = clusters.columnLights(tile_x, tile_y, fragment_lights.count);
+    if(column) fragment_lights.list = column;
+
+    for(uint32_t id: bins[bin]){
+        uint32_t v[3] = {triangles[3*id], triangles[3*id + 1], triangles[3*id + 2]};
+        float x[3], y[3];
+        for(int k = 0; k < 3; k++){ x[k] = sx[v[k]]; y[k] = sy[v[k]];}
+        float inv_area = 1.0f/((x[1] - x[0])*(y[2] - y[0]) - (y[1] - y[0])*(x[2] - x[0]));
+        //the edge opposite to vertex k weights vertex k
+        float ex[3] = {x[1], x[2], x[0]}, ey[3] = {y[1], y[2], y[0]};
+        float edge_dx[3], edge_dy[3];
+        bool owned[3];
+        for(int k = 0; k < 3; k++){
+            int b = (k + 2)%3;
+            edge_dx[k] = x[b] - ex[k];
+            edge_dy[k] = y[b] - ey[k];
+            owned[k] = ownsEdge(ex[k], ey[k], x[b], y[b]);
+        }
+        //vertex attributes premultiplied by 1/w for perspective correct interpolation,
+        //copied to locals since the tile stores below could alias the member streams
+        float z[3], r[3], attr[3][6];
+        for(int k = 0; k < 3; k++){
+            uint32_t i = v[k];
+            z[k] = sz[i];
+            r[k] = rhw[i];
+            float a[6] = {wx[i], wy[i], wz[i], nx[i], ny[i], nz[i]};
+            for(int c = 0; c < 6; c++) attr[k][c] = a[c]*r[k];
+        }
+        bool flat = nx[v[0]] == 0 && ny[v[0]] == 0 && nz[v[0]] == 0;
+        float face[3] = {0, 0, 0};
+        if(flat){
+            float e1[3] = {wx[v[1]] - wx[v[0]], wy[v[1]] - wy[v[0]], wz[v[1]] - wz[v[0]]};
+            float e2[3] = {wx[v[2]] - wx[v[0]], wy[v[2]] - wy[v[0]], wz[v[2]] - wz[v[0]]};
+            face[0] = e1[1]*e2[2] - e1[2]*e2[1];
+            face[1] = e1[2]*e2[0] - e1[0]*e2[2];
+            face[2] = e1[0]*e2[1] - e1[1]*e2[0];
+        }
+        const float* albedo = objects[triangle_object[id]].albedo;
+        //the light list is the same over the triangle when its vertices share a depth slice,
+        //looked up at the first shaded fragment since most small triangles end up hidden
+        int slice_near = column? 0: -1, slice_far = slice_near;
+
+        float min_x = std::min(x[0], std::min(x[1], x[2])), max_x = std::max(x[0], std::max(x[1], x[2]));
+        float min_y = std::min(y[0], std::min(y[1], y[2])), max_y = std::max(y[0], std::max(y[1], y[2]));
+        int px0 = (int)std::max((float)bin_x0, ceilf(min_x - 0.5f));
+        int py0 = (int)std::max((float)bin_y0, ceilf(min_y - 0.5f));
+        int px1 = (int)std::min((float)bin_x1, floorf(max_x - 0.5f));
+        int py1 = (int)std::min((float)bin_y1, floorf(max_y - 0.5f));
+
+        for(int ty = py0/FRAMEBUFFER_TILE_SIZE; ty <= py1/FRAMEBUFFER_TILE_SIZE; ty++){
+            for(int tx = px0/FRAMEBUFFER_TILE_SIZE; tx <= px1/FRAMEBUFFER_TILE_SIZE; tx++){
+                int tile = ty*target.tilesX() + tx;
+                float* depth = target.tileDepth(tile);
+                float* color[3] = {target.tileColor(tile, 0), target.tileColor(tile, 1), target.tileColor(tile, 2)};
+                int y_begin = std::max(py0, ty*FRAMEBUFFER_TILE_SIZE);
+                int y_end = std::min(py1, ty*FRAMEBUFFER_TILE_SIZE + FRAMEBUFFER_TILE_SIZE - 1);
+                int x_begin = std::max(px0, tx*FRAMEBUFFER_TILE_SIZE);
+                int x_end = std::min(px1, tx*FRAMEBUFFER_TILE_SIZE + FRAMEBUFFER_TILE_SIZE - 1);
+                for(int py = y_begin; py <= y_end; py++){
+                    float cy = py + 0.5f;
+                    for(int px = x_begin; px <= x_end; px++){
+                        float cx = px + 0.5f;
+                        float w[3];
+                        bool inside = true;
+                        for(int k = 0; k < 3; k++){
+                            float e = edge_dx[k]*(cy - ey[k]) - edge_dy[k]*(cx - ex[k]);
+                            inside = inside && (e > 0 || (e == 0 && owned[k]));
+                            w[k] = e*inv_area;
+                        }
+                        if(!inside) continue;
+                        float depth_value = w[0]*z[0] + w[1]*z[1] + w[2]*z[2];
+                        int i = (py - ty*FRAMEBUFFER_TILE_SIZE)*FRAMEBUFFER_TILE_SIZE + px - tx*FRAMEBUFFER_TILE_SIZE;
+                        if(depth_value >= depth[i] || depth_value > 1.0f) continue;
+                        depth[i] = depth_value;
+
+                        float s = 1.0f/(w[0]*r[0] + w[1]*r[1] + w[2]*r[2]);
+                        float a[6];
+                        for(int c = 0; c < 6; c++) a[c] = (w[0]*attr[0][c] + w[1]*attr[1][c] + w[2]*attr[2][c])*s;
+                        float* n = flat? face: a + 3;
+                        float normal[3] = {n[0], n[1], n[2]};
+                        float rgb[3];
+                        if(slice_near < 0){
+                            slice_near = clusters.slice(1/std::max(r[0], std::max(r[1], r[2])));
+                            slice_far = clusters.slice(1/std::min(r[0], std::min(r[1], r[2])));
+                            int cluster = clusters.cluster(tile_x, tile_y, slice_near);
+                            fragment_lights.list = clusters.clusterLights(cluster, fragment_lights.count);
+                        }
+                        if(slice_near != slice_far){
+                            int cluster = clusters.cluster(tile_x, tile_y, clusters.slice(s));
+                            fragment_lights.list = clusters.clusterLights(cluster, fragment_lights.count);
+                        }
+                        shade(a, normal, eye, albedo, fragment_lights, ambient, s, rgb);
+                        light_tests += fragment_lights.count + fragment_lights.directional_count;
+                        for(int c = 0; c < 3; c++) color[c][i] = rgb[c];
+                        fragments++;
+                    }
+                }
+            }
+        }
+    }
+    return fragments;
+}
+
+// ====== Point sprites ======
+
+/**
+ * Draw every live particle as a round sprite of its world size, added to the
+ * target's color and faded out over the system's fade time. Sprites are depth
+ * tested against the target, so render the opaque scene first; they write no depth.
+ * @param camera the camera to render from
+ * @param particles the particles, not updated during the call
+ * @param target the render target
+ */
+void Rasterizer::renderParticles(const Camera& camera, const ParticleSystem& particles, Framebuffer& target){
+    PROFILE_ZONE("Rasterizer::renderParticles");
+    typedef std::chrono::steady_clock Clock;
+    int width = target.getWidth();
+    int height = target.getHeight();
+    stats = RasterStats{};
+
+    Clock::time_point start = Clock::now();
+    size_t total = particles.count();
+    for(std::vector<float>* stream: {&sx, &sy, &sz, &rhw, &sprite_radius, &sprite_weight}) stream->resize(total);
+    clip.resize(total);
+    float view_projection[16], projection[16];
+    camera.getViewProjectionMatrix(view_projection);
+    camera.getProjectionMatrix(projection);
+    float scale = 0.5f*height*projection[5]; //pixels per world unit at w = 1
+    const float* px = particles.stream(PARTICLE_PX);
+    const float* py = particles.stream(PARTICLE_PY);
+    const float* pz = particles.stream(PARTICLE_PZ);
+    const float* size = particles.stream(PARTICLE_SIZE);
+    jobs->parallelFor(0, total, [&](size_t begin, size_t end){
+        projectVertices(view_projection, px + begin, py + begin, pz + begin, end - begin, width, height,
+                        &sx[begin], &sy[begin], &sz[begin], &rhw[begin], &clip[begin]);
+        for(size_t i = begin; i < end; i++){
+            //sprites smaller than a pixel could fall between pixel centers, grow them and dim them instead
+            float r = size[i]*scale*rhw[i];
+            sprite_radius[i] = std::max(r, 1.0f);
+            sprite_weight[i] = r < 1.0f? r*r: 1.0f;
+        }
+    }, 4096);
+    Clock::time_point transformed = Clock::now();
+    binSprites(particles, width, height);
+    Clock::time_point binned = Clock::now();
+
+    std::atomic<size_t> fragments(0);
+    jobs->parallelFor(0, bins.size(), [&](size_t begin, size_t end){
+        size_t count = 0;
+        for(size_t bin = begin; bin < end; bin++) count += rasterSpriteBin((int)bin, particles, target);
+        fragments += count;
+    }, 1);
+    Clock::time_point rasterized = Clock::now();
+
+    stats.transform = std::chrono::duration<double>(transformed - start).count();
+    stats.bin = std::chrono::duration<double>(binned - transformed).count();
+    stats.raster = std::chrono::duration<double>(rasterized - binned).count();
+    stats.fragments = fragments;
+    PROFILE_COUNTER("Rasterizer fragments", stats.fragments);
+}
+
+/**
+ * Add every sprite in front of the near plane and before the far plane to the bins its square overlaps
+ */
+void Rasterizer::binSprites(const ParticleSystem& particles, int width, int height){
+    PROFILE_ZONE("Rasterizer::binSprites");
+    bins_x = (width + RASTER_BIN_SIZE - 1)/RASTER_BIN_SIZE;
+    bins_y = (height + RASTER_BIN_SIZE - 1)/RASTER_BIN_SIZE;
+    bins.resize((size_t)bins_x*bins_y);
+    for(std::vector<uint32_t>& bin: bins) bin.clear();
+    size_t total = particles.count();
+    stats.triangles = total;
+    for(size_t i = 0; i < total; i++){
+        if(clip[i] & (CLIP_NEAR | CLIP_FAR)) continue;
+        float r = sprite_radius[i];
+        int bx0 = (int)std::max(0.0f, floorf((sx[i] - r)/RASTER_BIN_SIZE));
+        int by0 = (int)std::max(0.0f, floorf((sy[i] - r)/RASTER_BIN_SIZE));
+        int bx1 = (int)std::min((float)bins_x - 1, floorf((sx[i] + r)/RASTER_BIN_SIZE));
+        int by1 = (int)std::min((float)bins_y - 1, floorf((sy[i] + r)/RASTER_BIN_SIZE));
+        if(bx0 > bx1 || by0 > by1) continue;
+        for(int by = by0; by <= by1; by++){
+            for(int bx = bx0; bx <= bx1; bx++) bins[by*bins_x + bx].push_back((uint32_t)i);
+        }
+        stats.binned++;
+    }
+}
+
+/**
+ * Blend the sprites of one bin, with a (1 - d^2/r^2)^2 falloff from their center
+ * @return the number of blended fragments
+ */
+size_t Rasterizer::rasterSpriteBin(int bin, const ParticleSystem& particles, Framebuffer& target) const{
+    int bin_x0 = (bin%bins_x)*RASTER_BIN_SIZE;
+    int bin_y0 = (bin/bins_x)*RASTER_BIN_SIZE;
+    int bin_x1 = std::min(bin_x0 + RASTER_BIN_SIZE, target.getWidth()) - 1;
+    int bin_y1 = std::min(bin_y0 + RASTER_BIN_SIZE, target.getHeight()) - 1;
+    const float* life = particles.stream(PARTICLE_LIFE);
+    const float* tint = particles.getColor();
+    float fade_time = particles.getFadeTime();
+    size_t fragments = 0;
+
+    for(uint32_t id: bins[bin]){
+        float x = sx[id], y = sy[id], depth_value = sz[id], r = sprite_radius[id];
+        float fade = fade_time > 0? std::min(1.0f, life[id]/fade_time): 1.0f;
+        float rgb[3];
+        for(int c = 0; c < 3; c++) rgb[c] = tint[c]*fade*sprite_weight[id];
+        float inv_r2 = 1.0f/(r*r);
+        int px0 = (int)std::max((float)bin_x0, ceilf(x - r - 0.5f));
+        int py0 = (int)std::max((float)bin_y0, ceilf(y - r - 0.5f));
+        int px1 = (int)std::min((float)bin_x1, floorf(x + r - 0.5f));
+        int py1 = (int)std::min((float)bin_y1, floorf(y + r - 0.5f));
+        if(px0 > px1 || py0 > py1) continue;
+
+        for(int ty = py0/FRAMEBUFFER_TILE_SIZE; ty <= py1/FRAMEBUFFER_TILE_SIZE; ty++){
+            for(int tx = px0/FRAMEBUFFER_TILE_SIZE; tx <= px1/FRAMEBUFFER_TILE_SIZE; tx++){
+                int tile = ty*target.tilesX() + tx;
+                float* depth = target.tileDepth(tile);
+                float* color[3] = {target.tileColor(tile, 0), target.tileColor(tile, 1), target.tileColor(tile, 2)};
+                int y_begin = std::max(py0, ty*FRAMEBUFFER_TILE_SIZE);
+                int y_end = std::min(py1, ty*FRAMEBUFFER_TILE_SIZE + FRAMEBUFFER_TILE_SIZE - 1);
+                int x_begin = std::max(px0, tx*FRAMEBUFFER_TILE_SIZE);
+                int x_end = std::min(px1, tx*FRAMEBUFFER_TILE_SIZE + FRAMEBUFFER_TILE_SIZE - 1);
+                for(int py = y_begin; py <= y_end; py++){
+                    float dy = py + 0.5f - y;
+                    for(int px = x_begin; px <= x_end; px++){
+                        float dx = px + 0.5f - x;
+                        float falloff = 1.0f - (dx*dx + dy*dy)*inv_r2;
+                        if(falloff <= 0) continue;
+                        int i = (py - ty*FRAMEBUFFER_TILE_SIZE)*FRAMEBUFFER_TILE_SIZE + px - tx*FRAMEBUFFER_TILE_SIZE;
+                        if(depth_value >= depth[i]) continue;
+                        falloff *= falloff;
+                        for(int c = 0; c < 3; c++) color[c][i] += rgb[c]*falloff;
+                        fragments++;
+                    }
+                }
+            }
+        }
+    }
+    return fragments;
+}
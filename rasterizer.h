@@ -0,0 +1,114 @@
+#ifndef GRAPHICSENGINE3D_RASTERIZER_H
+#define GRAPHICSENGINE3D_RASTERIZER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "camera.h"
+#include "framebuffer.h"
+#include "jobsystem.h"
+#include "lighting.h"
+#include "mesh.h"
+#include "particles.h"
+#include "shadows.h"
+
+const int RASTER_BIN_SIZE = 64; //multiple of FRAMEBUFFER_TILE_SIZE, so no tile is shared by two bins
+
+/**
+ * Instance of a mesh in a scene
+ */
+struct RenderObject{
+    const Mesh* mesh;
+    float transform[16]; //model matrix, column-major (see projection.h); normals use its upper 3x3
+    float albedo[3];
+};
+
+/**
+ * Work done by the last Rasterizer::render or renderParticles call, times are wall times in seconds
+ */
+struct RasterStats{
+    double transform; //world transform and projection of every vertex
+    double shadows; //depth passes of the shadow cascades
+    double lighting; //assignment of the point and spot lights to the light clusters
+    double bin; //culling, near plane clipping and binning of every triangle
+    double raster; //rasterization, depth test and shading of every bin
+    size_t triangles; //submitted
+    size_t binned; //left after frustum, back face and near plane handling
+    size_t fragments; //shaded fragments, overdraw included
+    size_t light_tests; //lights evaluated by the shaded fragments
+    size_t shadow_triangles; //binned over every shadow cascade
+};
+
+/**
+ * Tile based forward rasterizer for headless renders.
+ * Vertices are transformed to world space and projected with projectVertices,
+ * triangles are culled, clipped against the near plane and sorted into bins of
+ * RASTER_BIN_SIZE^2 pixels, then every bin is rasterized by a single job, in
+ * submission order, so the image does not depend on the thread count.
+ * Fragments passing the depth test are shaded with a Lambert term per light
+ * plus an ambient term; meshes without normals are shaded flat. Point and spot
+ * lights are assigned to LightClusters whose screen tiles are the bins, so a
+ * fragment only evaluates the lights of its cluster, plus the directional lights.
+ * The first directional light can cast shadows through ShadowCascades: before
+ * the main pass, every cascade is rendered by a depth only pass over the same
+ * world space vertices, binned the same way, which interpolates nothing but
+ * the depth, 4 pixels at a time.
+ * Front faces are counter clockwise, as in OpenGL.
+ * renderParticles() draws particles as round additive sprites on top of a
+ * rendered frame: they are depth tested against it but write no depth.
+ */
+class Rasterizer{
+public:
+    explicit Rasterizer(JobSystem& jobs);
+    void setLights(const std::vector<PointLight>& lights);
+    void setSpotLights(const std::vector<SpotLight>& lights);
+    void setDirectionalLights(const std::vector<DirectionalLight>& lights);
+    void setAmbient(const float ambient[3]);
+    void setBackfaceCulling(bool enabled);
+    void setShadows(int cascades, int resolution, float distance);
+    void render(const Camera& camera, const std::vector<RenderObject>& objects, Framebuffer& target);
+    void renderParticles(const Camera& camera, const ParticleSystem& particles, Framebuffer& target);
+    const RasterStats& getStats() const;
+    const ShadowCascades& getShadows() const;
+private:
+    JobSystem* jobs;
+    std::vector<PointLight> lights;
+    std::vector<SpotLight> spot_lights;
+    std::vector<DirectionalLight> directional_lights;
+    LightClusters clusters;
+    ShadowCascades shadows;
+    float ambient[3];
+    bool cull_back;
+    RasterStats stats;
+
+    //frame data, kept between frames to reuse the allocations
+    std::vector<size_t> vertex_base; //first vertex of every object, then the vertex count
+    std::vector<float> wx, wy, wz; //world space positions
+    std::vector<float> nx, ny, nz; //world space normals, 0 for meshes without normals
+    std::vector<float> sx, sy, sz, rhw;
+    std::vector<uint8_t> clip;
+    std::vector<float> sprite_radius; //pixels
+    std::vector<float> sprite_weight; //energy kept by sprites grown to the minimum radius
+    std::vector<uint32_t> triangles; //3 vertices per binned triangle, ordered to a positive area on screen
+    std::vector<uint32_t> triangle_object;
+    std::vector<std::vector<uint32_t>> bins;
+    int bins_x;
+    int bins_y;
+    std::vector<float> lx, ly, lz; //shadow map texel positions and depths of the current cascade
+    std::vector<uint32_t> shadow_triangles; //3 vertices per triangle, ordered to a positive area on the map
+    std::vector<std::vector<uint32_t>> shadow_bins;
+
+    void transformVertices(const Camera& camera, const std::vector<RenderObject>& objects, int width, int height);
+    void renderShadowMaps(const std::vector<RenderObject>& objects);
+    void rasterShadowBin(int bin, int bins_side, float* map) const;
+    void binTriangles(const Camera& camera, const std::vector<RenderObject>& objects, int width, int height);
+    void binTriangle(uint32_t i0, uint32_t i1, uint32_t i2, uint32_t object, int width, int height);
+    void clipNear(const float view_projection[16], uint32_t i0, uint32_t i1, uint32_t i2, uint32_t object,
+                  int width, int height);
+    size_t rasterBin(int bin, const float eye[3], const std::vector<RenderObject>& objects,
+                     Framebuffer& target, size_t& light_tests) const;
+    void binSprites(const ParticleSystem& particles, int width, int height);
+    size_t rasterSpriteBin(int bin, const ParticleSystem& particles, Framebuffer& target) const;
+};
+
+#endif //GRAPHICSENGINE3D_RASTERIZER_H
@@ -0,0 +1,186 @@
+#include "shadows.h"
+#include "simd.h"
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+
+//Implementation details of the cascaded shadow maps
+
+namespace {
+
+const float SHADOW_FILTER_MARGIN = 2; //texels around a lookup read by its 4x4 filter footprint
+const float SHADOW_NORMAL_OFFSET = 1.5f; //texels receivers are pushed along their normal
+const float SHADOW_DEPTH_BIAS = 0.5f; //texels of depth
+
+inline float dot3(const float a[3], const float b[3]){
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+}
+
+ShadowCascades::ShadowCascades(){
+    count = 0;
+    resolution = 0;
+    distance = 0;
+    for(int c = 0; c <= SHADOW_MAX_CASCADES; c++) splits[c] = 0;
+    for(int c = 0; c < SHADOW_MAX_CASCADES; c++){
+        std::fill(matrices[c], matrices[c] + 16, 0.0f);
+        texel[c] = 0;
+    }
+}
+
+/**
+ * @param cascades number of cascades, 0 turns shadows off, at most SHADOW_MAX_CASCADES
+ * @param size texels per side of every depth map, rounded up to a multiple of 4
+ * @param max_distance view depth past which nothing is shadowed
+ */
+void ShadowCascades::setCascades(int cascades, int size, float max_distance){
+    if(cascades < 0 || cascades > SHADOW_MAX_CASCADES){
+        std::cout << "Warning: shadow cascade count " << cascades << " out of [0, " << SHADOW_MAX_CASCADES << "]\n";
+        cascades = std::min(std::max(cascades, 0), SHADOW_MAX_CASCADES);
+    }
+    if(cascades > 0 && (size < 8 || !(max_distance > 0))){
+        std::cout << "Warning: shadow maps need at least 8 texels and a positive distance, shadows disabled\n";
+        cascades = 0;
+    }
+    count = cascades;
+    resolution = count > 0? (size + 3)/4*4: 0;
+    distance = count > 0? max_distance: 0;
+    maps.assign((size_t)count*resolution*resolution, 1.0f);
+}
+
+/**
+ * Fit the cascades to a camera's frustum
+ * @param camera the camera the scene is rendered from
+ * @param light_direction unit direction the light travels in
+ */
+void ShadowCascades::fit(const Camera& camera, const float light_direction[3]){
+    if(count == 0) return;
+    const float* eye = camera.getPosition();
+    const float* forward = camera.getForward();
+    float near_plane = camera.getNear();
+    float far_plane = std::max(near_plane, std::min(distance, camera.getFar()));
+    for(int c = 0; c <= count; c++){
+        float t = (float)c/count;
+        splits[c] = 0.5f*(near_plane*powf(far_plane/near_plane, t) + near_plane + (far_plane - near_plane)*t);
+    }
+    splits[0] = near_plane;
+    splits[count] = far_plane;
+
+    //light basis, only depending on the light direction so it stays fixed over frames,
+    //right handed with the light looking down -z like a camera, so windings match the main pass
+    const float* d = light_direction;
+    float reference[3] = {0, 1, 0};
+    if(fabsf(d[1]) > 0.99f){ reference[0] = 1; reference[1] = 0;}
+    float right[3] = {reference[1]*d[2] - reference[2]*d[1], reference[2]*d[0] - reference[0]*d[2],
+                      reference[0]*d[1] - reference[1]*d[0]};
+    float len = sqrtf(dot3(right, right));
+    for(int k = 0; k < 3; k++) right[k] /= len;
+    float up[3] = {right[1]*d[2] - right[2]*d[1], right[2]*d[0] - right[0]*d[2], right[0]*d[1] - right[1]*d[0]};
+
+    float tan_y = tanf(0.5f*camera.getFov()), tan_x = tan_y*camera.getAspect();
+    float k2 = tan_x*tan_x + tan_y*tan_y; //squared distance to the frustum corners over depth
+    for(int c = 0; c < count; c++){
+        //smallest sphere through the corners of the slice, centered on the view axis
+        float d0 = splits[c], d1 = splits[c + 1];
+        float depth = std::min(d1, 0.5f*(d0 + d1)*(1 + k2));
+        float radius = sqrtf(std::max((depth - d0)*(depth - d0) + d0*d0*k2, (d1 - depth)*(d1 - depth) + d1*d1*k2));
+        float center[3];
+        for(int k = 0; k < 3; k++) center[k] = eye[k] + depth*forward[k];
+        float size = 2*radius/resolution;
+        float origin_x = floorf(dot3(center, right)/size)*size;
+        float origin_y = floorf(dot3(center, up)/size)*size;
+        float origin_z = dot3(center, d) - radius;
+
+        //texel x along right, texel y against up so rows run down the map, depth along the light
+        float* m = matrices[c];
+        for(int k = 0; k < 3; k++){
+            m[4*k] = right[k]/size;
+            m[4*k + 1] = -up[k]/size;
+            m[4*k + 2] = d[k]/(2*radius);
+            m[4*k + 3] = 0;
+        }
+        m[12] = 0.5f*resolution - origin_x/size;
+        m[13] = 0.5f*resolution + origin_y/size;
+        m[14] = -origin_z/(2*radius);
+        m[15] = 1;
+        texel[c] = size;
+    }
+}
+
+/**
+ * Fraction of the light reaching a point, filtered over 3x3 texels of the
+ * first cascade holding the point with the filter's footprint
+ * @param p world space position
+ * @param n unit normal on the lit side, receivers are offset along it against self shadowing
+ * @param view_depth depth of p along the camera's forward axis
+ * @return 1 when lit, 0 when in shadow, 1 past the shadow distance
+ */
+float ShadowCascades::visibility(const float p[3], const float n[3], float view_depth) const{
+    if(count == 0 || !(view_depth < splits[count])) return 1;
+    int c = 0;
+    while(c + 1 < count && view_depth >= splits[c + 1]) c++;
+    for(; c < count; c++){
+        const float* m = matrices[c];
+        float offset = SHADOW_NORMAL_OFFSET*texel[c];
+        float q[3] = {p[0] + offset*n[0], p[1] + offset*n[1], p[2] + offset*n[2]};
+        float u = m[0]*q[0] + m[4]*q[1] + m[8]*q[2] + m[12];
+        float v = m[1]*q[0] + m[5]*q[1] + m[9]*q[2] + m[13];
+        if(!(u >= SHADOW_FILTER_MARGIN && v >= SHADOW_FILTER_MARGIN &&
+             u <= resolution - SHADOW_FILTER_MARGIN && v <= resolution - SHADOW_FILTER_MARGIN)) continue;
+        float z = m[2]*q[0] + m[6]*q[1] + m[10]*q[2] + m[14] - SHADOW_DEPTH_BIAS/resolution;
+
+        //a 3x3 texel box moved by the fraction of the texel center: weights 1 - f, 1, 1, f along each axis
+        float fx = u - 0.5f, fy = v - 0.5f;
+        int x0 = (int)floorf(fx), y0 = (int)floorf(fy);
+        fx -= x0;
+        fy -= y0;
+        float row_weights[4] = {1 - fy, 1, 1, fy};
+        const float* texels = depthMap(c) + (size_t)(y0 - 1)*resolution + x0 - 1;
+        Float4 reference(z), one(1.0f), lit(0.0f);
+        for(int r = 0; r < 4; r++){
+            lit = lit + Float4(row_weights[r])*((Float4::load(texels + (size_t)r*resolution) >= reference) & one);
+        }
+        lit = lit*Float4(1 - fx, 1, 1, fx);
+        return (lit[0] + lit[1] + lit[2] + lit[3])*(1.0f/9);
+    }
+    return 1;
+}
+
+int ShadowCascades::cascadeCount() const{
+    return count;
+}
+
+int ShadowCascades::getResolution() const{
+    return resolution;
+}
+
+float ShadowCascades::getDistance() const{
+    return distance;
+}
+
+/**
+ * @param cascade 0 to cascadeCount(), cascade c covers view depths from splitDepth(c) to splitDepth(c + 1)
+ */
+float ShadowCascades::splitDepth(int cascade) const{
+    return splits[cascade];
+}
+
+/**
+ * World to shadow map matrix of a cascade, column-major: x and y in texels, depth in [0, 1]
+ */
+const float* ShadowCascades::lightMatrix(int cascade) const{
+    return matrices[cascade];
+}
+
+float ShadowCascades::texelSize(int cascade) const{
+    return texel[cascade];
+}
+
+float* ShadowCascades::depthMap(int cascade){
+    return maps.data() + (size_t)cascade*resolution*resolution;
+}
+
+const float* ShadowCascades::depthMap(int cascade) const{
+    return maps.data() + (size_t)cascade*resolution*resolution;
+}
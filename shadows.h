@@ -0,0 +1,49 @@
+#ifndef GRAPHICSENGINE3D_SHADOWS_H
+#define GRAPHICSENGINE3D_SHADOWS_H
+
+#include <stddef.h>
+#include <vector>
+#include "camera.h"
+
+const int SHADOW_MAX_CASCADES = 4;
+
+/**
+ * Cascaded shadow maps of one directional light.
+ * The view depth up to the shadow distance is split into cascades, half
+ * logarithmically and half uniformly, and every cascade is a square
+ * orthographic depth map looking down the light direction around the bounding
+ * sphere of its piece of the camera frustum. The sphere only depends on the
+ * camera's projection, so the world size of a texel stays the same when the
+ * camera turns, and the map origin is snapped to whole texels, so the texels
+ * do not crawl when it moves: shadow edges keep still.
+ * Depth maps are row major, depth 0 nearest to the light. Casters in front of
+ * a cascade's depth range are clamped to 0 by the depth pass, so they still
+ * cast shadows. Lookups filter 3x3 texels with bilinear weights, 4 texels of a
+ * row at a time.
+ */
+class ShadowCascades{
+public:
+    ShadowCascades();
+    void setCascades(int count, int resolution, float distance);
+    void fit(const Camera& camera, const float light_direction[3]);
+    float visibility(const float p[3], const float n[3], float view_depth) const;
+
+    int cascadeCount() const;
+    int getResolution() const;
+    float getDistance() const;
+    float splitDepth(int cascade) const;
+    const float* lightMatrix(int cascade) const;
+    float texelSize(int cascade) const;
+    float* depthMap(int cascade);
+    const float* depthMap(int cascade) const;
+private:
+    int count;
+    int resolution;
+    float distance;
+    float splits[SHADOW_MAX_CASCADES + 1]; //view depths bounding the cascades
+    float matrices[SHADOW_MAX_CASCADES][16]; //world to texel x, y and depth, column-major
+    float texel[SHADOW_MAX_CASCADES]; //world size of a texel
+    std::vector<float> maps;
+};
+
+#endif //GRAPHICSENGINE3D_SHADOWS_H
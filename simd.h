@@ -0,0 +1,238 @@
+#ifndef GRAPHICSENGINE3D_SIMD_H
+#define GRAPHICSENGINE3D_SIMD_H
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GRAPHICSENGINE3D_SSE 1
+#include <emmintrin.h>
+#else
+#include <math.h>
+#include <string.h>
+#endif
+#include <stdint.h>
+
+/**
+ * 4-wide float lane type used by the batch kernels (ray packets, vertex batches).
+ * Maps onto SSE registers when available and falls back to plain arrays
+ * otherwise, so every kernel has exactly one implementation.
+ * Comparisons return lane masks (all bits set where true) to be used with
+ * select(), any() and mask().
+ */
+struct Float4{
+#ifdef GRAPHICSENGINE3D_SSE
+    __m128 v;
+    Float4(){}
+    Float4(__m128 x): v(x){}
+    explicit Float4(float s): v(_mm_set1_ps(s)){}
+    Float4(float a, float b, float c, float d): v(_mm_setr_ps(a, b, c, d)){}
+    static Float4 load(const float* p){ return Float4(_mm_loadu_ps(p));}
+    void store(float* p) const{ _mm_storeu_ps(p, v);}
+    float operator[](int i) const{ float t[4]; store(t); return t[i];}
+#else
+    float v[4];
+    Float4(){}
+    explicit Float4(float s){ v[0] = s; v[1] = s; v[2] = s; v[3] = s;}
+    Float4(float a, float b, float c, float d){ v[0] = a; v[1] = b; v[2] = c; v[3] = d;}
+    static Float4 load(const float* p){ return Float4(p[0], p[1], p[2], p[3]);}
+    void store(float* p) const{ for(int i = 0; i < 4; i++) p[i] = v[i];}
+    float operator[](int i) const{ return v[i];}
+#endif
+};
+
+#ifdef GRAPHICSENGINE3D_SSE
+inline Float4 operator+(Float4 a, Float4 b){ return _mm_add_ps(a.v, b.v);}
+inline Float4 operator-(Float4 a, Float4 b){ return _mm_sub_ps(a.v, b.v);}
+inline Float4 operator*(Float4 a, Float4 b){ return _mm_mul_ps(a.v, b.v);}
+inline Float4 operator/(Float4 a, Float4 b){ return _mm_div_ps(a.v, b.v);}
+inline Float4 min(Float4 a, Float4 b){ return _mm_min_ps(a.v, b.v);}
+inline Float4 max(Float4 a, Float4 b){ return _mm_max_ps(a.v, b.v);}
+inline Float4 sqrt(Float4 a){ return _mm_sqrt_ps(a.v);}
+inline Float4 operator<(Float4 a, Float4 b){ return _mm_cmplt_ps(a.v, b.v);}
+inline Float4 operator<=(Float4 a, Float4 b){ return _mm_cmple_ps(a.v, b.v);}
+inline Float4 operator>(Float4 a, Float4 b){ return _mm_cmpgt_ps(a.v, b.v);}
+inline Float4 operator>=(Float4 a, Float4 b){ return _mm_cmpge_ps(a.v, b.v);}
+inline Float4 operator&(Float4 a, Float4 b){ return _mm_and_ps(a.v, b.v);}
+inline Float4 operator|(Float4 a, Float4 b){ return _mm_or_ps(a.v, b.v);}
+inline Float4 andNot(Float4 m, Float4 a){ return _mm_andnot_ps(m.v, a.v);} // a where m is false
+inline Float4 select(Float4 m, Float4 a, Float4 b){ return _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v));}
+inline int mask(Float4 m){ return _mm_movemask_ps(m.v);}
+inline Float4 abs(Float4 a){ return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v);}
+inline Float4 floor(Float4 a){
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.0f)));
+}
+inline void transpose(Float4& a, Float4& b, Float4& c, Float4& d){ _MM_TRANSPOSE4_PS(a.v, b.v, c.v, d.v);}
+#else
+#define GRAPHICSENGINE3D_FLOAT4_OP(op) \
+inline Float4 operator op(Float4 a, Float4 b){ \
+    return Float4(a.v[0] op b.v[0], a.v[1] op b.v[1], a.v[2] op b.v[2], a.v[3] op b.v[3]);}
+GRAPHICSENGINE3D_FLOAT4_OP(+)
+GRAPHICSENGINE3D_FLOAT4_OP(-)
+GRAPHICSENGINE3D_FLOAT4_OP(*)
+GRAPHICSENGINE3D_FLOAT4_OP(/)
+#undef GRAPHICSENGINE3D_FLOAT4_OP
+
+inline float laneMask(bool b){ union{ unsigned u; float f;} m; m.u = b? 0xffffffffu: 0u; return m.f;}
+inline unsigned laneBits(float f){ union{ unsigned u; float f;} m; m.f = f; return m.u;}
+inline float laneFloat(unsigned u){ union{ unsigned u; float f;} m; m.u = u; return m.f;}
+
+#define GRAPHICSENGINE3D_FLOAT4_CMP(op) \
+inline Float4 operator op(Float4 a, Float4 b){ \
+    return Float4(laneMask(a.v[0] op b.v[0]), laneMask(a.v[1] op b.v[1]), \
+                  laneMask(a.v[2] op b.v[2]), laneMask(a.v[3] op b.v[3]));}
+GRAPHICSENGINE3D_FLOAT4_CMP(<)
+GRAPHICSENGINE3D_FLOAT4_CMP(<=)
+GRAPHICSENGINE3D_FLOAT4_CMP(>)
+GRAPHICSENGINE3D_FLOAT4_CMP(>=)
+#undef GRAPHICSENGINE3D_FLOAT4_CMP
+
+inline Float4 operator&(Float4 a, Float4 b){
+    Float4 r;
+    for(int i = 0; i < 4; i++) r.v[i] = laneFloat(laneBits(a.v[i]) & laneBits(b.v[i]));
+    return r;
+}
+inline Float4 operator|(Float4 a, Float4 b){
+    Float4 r;
+    for(int i = 0; i < 4; i++) r.v[i] = laneFloat(laneBits(a.v[i]) | laneBits(b.v[i]));
+    return r;
+}
+inline Float4 andNot(Float4 m, Float4 a){
+    Float4 r;
+    for(int i = 0; i < 4; i++) r.v[i] = laneFloat(~laneBits(m.v[i]) & laneBits(a.v[i]));
+    return r;
+}
+inline Float4 select(Float4 m, Float4 a, Float4 b){ return (m & a) | andNot(m, b);}
+inline int mask(Float4 m){
+    int r = 0;
+    for(int i = 0; i < 4; i++) r |= (laneBits(m.v[i]) >> 31) << i;
+    return r;
+}
+inline Float4 min(Float4 a, Float4 b){
+    return Float4(a.v[0] < b.v[0]? a.v[0]: b.v[0], a.v[1] < b.v[1]? a.v[1]: b.v[1],
+                  a.v[2] < b.v[2]? a.v[2]: b.v[2], a.v[3] < b.v[3]? a.v[3]: b.v[3]);
+}
+inline Float4 max(Float4 a, Float4 b){
+    return Float4(a.v[0] > b.v[0]? a.v[0]: b.v[0], a.v[1] > b.v[1]? a.v[1]: b.v[1],
+                  a.v[2] > b.v[2]? a.v[2]: b.v[2], a.v[3] > b.v[3]? a.v[3]: b.v[3]);
+}
+inline Float4 sqrt(Float4 a){
+    return Float4(sqrtf(a.v[0]), sqrtf(a.v[1]), sqrtf(a.v[2]), sqrtf(a.v[3]));
+}
+inline Float4 abs(Float4 a){ return max(a, Float4(0.0f) - a);}
+inline Float4 floor(Float4 a){
+    Float4 r;
+    for(int i = 0; i < 4; i++){ r.v[i] = (float)(int)a.v[i]; if(r.v[i] > a.v[i]) r.v[i] -= 1.0f;}
+    return r;
+}
+inline void transpose(Float4& a, Float4& b, Float4& c, Float4& d){ //rows become columns
+    Float4* rows[4] = {&a, &b, &c, &d};
+    for(int i = 0; i < 4; i++){
+        for(int j = i + 1; j < 4; j++){
+            float t = rows[i]->v[j]; rows[i]->v[j] = rows[j]->v[i]; rows[j]->v[i] = t;
+        }
+    }
+}
+#endif
+
+inline bool any(Float4 m){ return mask(m) != 0;}
+inline bool all(Float4 m){ return mask(m) == 0xf;}
+
+/**
+ * 4-wide int32 lane type of the fixed point batch kernels. Additions wrap like
+ * unsigned integers. Products are kept at full precision in pairs of 64 bit
+ * lanes, lanes 0 and 2 in one Int4 and lanes 1 and 3 in another, summed with
+ * add64() and brought back to 32 bit lanes by narrow64(), so a kernel rounds
+ * exactly like the scalar fixed point code it replaces.
+ */
+struct Int4{
+#ifdef GRAPHICSENGINE3D_SSE
+    __m128i v;
+    Int4(){}
+    Int4(__m128i x): v(x){}
+    explicit Int4(int32_t s): v(_mm_set1_epi32(s)){}
+    static Int4 load(const int32_t* p){ return Int4(_mm_loadu_si128((const __m128i*)p));}
+    void store(int32_t* p) const{ _mm_storeu_si128((__m128i*)p, v);}
+    int32_t operator[](int i) const{ int32_t t[4]; store(t); return t[i];}
+#else
+    int32_t v[4];
+    Int4(){}
+    explicit Int4(int32_t s){ v[0] = s; v[1] = s; v[2] = s; v[3] = s;}
+    static Int4 load(const int32_t* p){ Int4 r; for(int i = 0; i < 4; i++) r.v[i] = p[i]; return r;}
+    void store(int32_t* p) const{ for(int i = 0; i < 4; i++) p[i] = v[i];}
+    int32_t operator[](int i) const{ return v[i];}
+#endif
+};
+
+#ifdef GRAPHICSENGINE3D_SSE
+inline Int4 operator+(Int4 a, Int4 b){ return _mm_add_epi32(a.v, b.v);}
+inline Int4 operator-(Int4 a, Int4 b){ return _mm_sub_epi32(a.v, b.v);}
+inline Int4 add64(Int4 a, Int4 b){ return _mm_add_epi64(a.v, b.v);}
+inline Int4 sub64(Int4 a, Int4 b){ return _mm_sub_epi64(a.v, b.v);}
+/**
+ * Signed 64 bit products of every lane: lanes 0 and 2 into even, 1 and 3 into odd.
+ * SSE2 only multiplies unsigned lanes, a negative factor adds 2^32 times the
+ * other one to the unsigned product, taken back from its high half.
+ */
+inline void mulWide(Int4 a, Int4 b, Int4& even, Int4& odd){
+    __m128i correction = _mm_add_epi32(_mm_and_si128(_mm_srai_epi32(a.v, 31), b.v),
+                                       _mm_and_si128(_mm_srai_epi32(b.v, 31), a.v));
+    even = _mm_sub_epi64(_mm_mul_epu32(a.v, b.v), _mm_slli_epi64(correction, 32));
+    odd = _mm_sub_epi64(_mm_mul_epu32(_mm_srli_epi64(a.v, 32), _mm_srli_epi64(b.v, 32)),
+                        _mm_and_si128(correction, _mm_set_epi32(-1, 0, -1, 0)));
+}
+/**
+ * Low 32 bits of the 64 bit lanes of even and odd shifted right, back in lane order
+ * @param shift 1 to 31
+ */
+inline Int4 narrow64(Int4 even, Int4 odd, int shift){
+    __m128i low = _mm_srli_epi64(even.v, shift);
+    __m128i high = _mm_slli_epi64(odd.v, 32 - shift);
+    __m128i high_lanes = _mm_set_epi32(-1, 0, -1, 0);
+    return _mm_or_si128(_mm_andnot_si128(high_lanes, low), _mm_and_si128(high_lanes, high));
+}
+#else
+inline Int4 operator+(Int4 a, Int4 b){
+    Int4 r;
+    for(int i = 0; i < 4; i++) r.v[i] = (int32_t)((uint32_t)a.v[i] + (uint32_t)b.v[i]);
+    return r;
+}
+inline Int4 operator-(Int4 a, Int4 b){
+    Int4 r;
+    for(int i = 0; i < 4; i++) r.v[i] = (int32_t)((uint32_t)a.v[i] - (uint32_t)b.v[i]);
+    return r;
+}
+inline Int4 add64(Int4 a, Int4 b){
+    uint64_t x[2], y[2];
+    memcpy(x, a.v, sizeof(x));
+    memcpy(y, b.v, sizeof(y));
+    x[0] += y[0]; x[1] += y[1];
+    memcpy(a.v, x, sizeof(x));
+    return a;
+}
+inline Int4 sub64(Int4 a, Int4 b){
+    uint64_t x[2], y[2];
+    memcpy(x, a.v, sizeof(x));
+    memcpy(y, b.v, sizeof(y));
+    x[0] -= y[0]; x[1] -= y[1];
+    memcpy(a.v, x, sizeof(x));
+    return a;
+}
+inline void mulWide(Int4 a, Int4 b, Int4& even, Int4& odd){
+    int64_t e[2] = {(int64_t)a.v[0]*b.v[0], (int64_t)a.v[2]*b.v[2]};
+    int64_t o[2] = {(int64_t)a.v[1]*b.v[1], (int64_t)a.v[3]*b.v[3]};
+    memcpy(even.v, e, sizeof(e));
+    memcpy(odd.v, o, sizeof(o));
+}
+inline Int4 narrow64(Int4 even, Int4 odd, int shift){
+    uint64_t e[2], o[2];
+    memcpy(e, even.v, sizeof(e));
+    memcpy(o, odd.v, sizeof(o));
+    Int4 r;
+    r.v[0] = (int32_t)(uint32_t)(e[0] >> shift);
+    r.v[1] = (int32_t)(uint32_t)(o[0] >> shift);
+    r.v[2] = (int32_t)(uint32_t)(e[1] >> shift);
+    r.v[3] = (int32_t)(uint32_t)(o[1] >> shift);
+    return r;
+}
+#endif
+
+#endif //GRAPHICSENGINE3D_SIMD_H
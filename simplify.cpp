@@ -0,0 +1,357 @@
+#include "simplify.h"
+#include "profiler.h"
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <math.h>
+
+//Implementation details of quadric error metric simplification and LOD selection
+
+// ==================== Quadric ====================
+
+Quadric Quadric::zero(){
+    Quadric z;
+    for(int i = 0; i < 10; i++) z.q[i] = 0.0;
+    return z;
+}
+
+/**
+ * Quadric of the plane ax + by + cz + d = 0, (a, b, c) a unit normal
+ * @param weight scale of the quadric, typically the area of the face
+ */
+Quadric Quadric::plane(double a, double b, double c, double d, double weight){
+    Quadric p;
+    p.q[0] = weight*a*a; p.q[1] = weight*a*b; p.q[2] = weight*a*c; p.q[3] = weight*a*d;
+    p.q[4] = weight*b*b; p.q[5] = weight*b*c; p.q[6] = weight*b*d;
+    p.q[7] = weight*c*c; p.q[8] = weight*c*d;
+    p.q[9] = weight*d*d;
+    return p;
+}
+
+Quadric Quadric::operator+(const Quadric& other) const{
+    Quadric s;
+    for(int i = 0; i < 10; i++) s.q[i] = q[i] + other.q[i];
+    return s;
+}
+
+Quadric& Quadric::operator+=(const Quadric& other){
+    for(int i = 0; i < 10; i++) q[i] += other.q[i];
+    return *this;
+}
+
+/**
+ * Sum of squared distances (weighted) from a point to the planes of the quadric
+ */
+double Quadric::error(double x, double y, double z) const{
+    return q[0]*x*x + 2*q[1]*x*y + 2*q[2]*x*z + 2*q[3]*x
+           + q[4]*y*y + 2*q[5]*y*z + 2*q[6]*y
+           + q[7]*z*z + 2*q[8]*z
+           + q[9];
+}
+
+/**
+ * Expand the quadric into the engine's square matrix type, columns in order
+ */
+Matrixf<4> Quadric::toMatrix() const{
+    return Matrixf<4>{{(float)q[0], (float)q[1], (float)q[2], (float)q[3]},
+                      {(float)q[1], (float)q[4], (float)q[5], (float)q[6]},
+                      {(float)q[2], (float)q[5], (float)q[7], (float)q[8]},
+                      {(float)q[3], (float)q[6], (float)q[8], (float)q[9]}};
+}
+
+// ==================== Simplifier ====================
+
+namespace {
+
+const double BOUNDARY_WEIGHT = 100.0; //keeps open borders in place
+const double FLIP_THRESHOLD = 0.2; //min cosine between a face normal before and after a collapse
+
+struct Collapse{
+    double cost;
+    uint32_t from;
+    uint32_t to;
+    uint32_t from_version;
+    uint32_t to_version;
+    bool operator>(const Collapse& other) const{ return cost > other.cost;}
+};
+
+/**
+ * Edge collapse state for one mesh. Triangles are edited in place and
+ * stale queue entries are detected with per-vertex version counters.
+ */
+class Simplifier{
+public:
+    explicit Simplifier(const Mesh& mesh);
+    bool step(double& cost); //perform the cheapest valid collapse
+    size_t liveTriangles() const{ return live_triangles;}
+    void collect(std::vector<uint32_t>& out) const;
+private:
+    const Mesh& mesh;
+    std::vector<uint32_t> tris;
+    std::vector<bool> tri_dead;
+    std::vector<std::vector<uint32_t>> vertex_tris;
+    std::vector<Quadric> quadrics;
+    std::vector<uint32_t> version;
+    std::vector<bool> vertex_dead;
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+    size_t live_triangles;
+
+    void pushEdge(uint32_t u, uint32_t v);
+    bool valid(uint32_t from, uint32_t to) const;
+    void faceNormal(uint32_t a, uint32_t b, uint32_t c, double n[3]) const;
+};
+
+void Simplifier::faceNormal(uint32_t a, uint32_t b, uint32_t c, double n[3]) const{
+    double e1[3] = {(double)mesh.px[b]-mesh.px[a], (double)mesh.py[b]-mesh.py[a], (double)mesh.pz[b]-mesh.pz[a]};
+    double e2[3] = {(double)mesh.px[c]-mesh.px[a], (double)mesh.py[c]-mesh.py[a], (double)mesh.pz[c]-mesh.pz[a]};
+    n[0] = e1[1]*e2[2] - e1[2]*e2[1];
+    n[1] = e1[2]*e2[0] - e1[0]*e2[2];
+    n[2] = e1[0]*e2[1] - e1[1]*e2[0];
+}
+
+/**
+ * Build vertex quadrics from the face planes, add constraint planes along
+ * boundary edges, and queue every edge. Face planes are not area weighted so
+ * the square root of a collapse cost bounds the distance to every plane merged
+ * into the vertex, which makes it usable as a world space error.
+ */
+Simplifier::Simplifier(const Mesh& m): mesh(m){
+    size_t vertex_count = mesh.vertexCount();
+    tris = mesh.indices;
+    size_t tri_count = tris.size()/3;
+    tri_dead.assign(tri_count, false);
+    vertex_tris.resize(vertex_count);
+    quadrics.assign(vertex_count, Quadric::zero());
+    version.assign(vertex_count, 0);
+    vertex_dead.assign(vertex_count, false);
+    live_triangles = tri_count;
+
+    std::vector<uint64_t> edges;
+    edges.reserve(3*tri_count);
+    for(size_t t = 0; t < tri_count; t++){
+        uint32_t v[3] = {tris[3*t], tris[3*t+1], tris[3*t+2]};
+        double n[3];
+        faceNormal(v[0], v[1], v[2], n);
+        double len = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        if(len > 0){
+            for(int i = 0; i < 3; i++) n[i] /= len;
+            double d = -(n[0]*mesh.px[v[0]] + n[1]*mesh.py[v[0]] + n[2]*mesh.pz[v[0]]);
+            Quadric face = Quadric::plane(n[0], n[1], n[2], d, 1.0);
+            for(int i = 0; i < 3; i++) quadrics[v[i]] += face;
+        }
+        for(int i = 0; i < 3; i++){
+            vertex_tris[v[i]].push_back((uint32_t)t);
+            uint32_t a = std::min(v[i], v[(i+1)%3]);
+            uint32_t b = std::max(v[i], v[(i+1)%3]);
+            edges.push_back((uint64_t)a << 32 | b);
+        }
+    }
+
+    //edges used by a single triangle are boundaries: add a plane through the edge, perpendicular to the face
+    std::sort(edges.begin(), edges.end());
+    for(size_t i = 0; i < edges.size();){
+        size_t j = i;
+        while(j < edges.size() && edges[j] == edges[i]) j++;
+        uint32_t a = (uint32_t)(edges[i] >> 32);
+        uint32_t b = (uint32_t)edges[i];
+        if(j - i == 1){
+            for(uint32_t t: vertex_tris[a]){
+                uint32_t* v = &tris[3*t];
+                if(v[0] != b && v[1] != b && v[2] != b) continue;
+                double n[3];
+                faceNormal(v[0], v[1], v[2], n);
+                double e[3] = {(double)mesh.px[b]-mesh.px[a], (double)mesh.py[b]-mesh.py[a], (double)mesh.pz[b]-mesh.pz[a]};
+                double c[3] = {e[1]*n[2] - e[2]*n[1], e[2]*n[0] - e[0]*n[2], e[0]*n[1] - e[1]*n[0]};
+                double len = sqrt(c[0]*c[0] + c[1]*c[1] + c[2]*c[2]);
+                if(len == 0) break;
+                for(int k = 0; k < 3; k++) c[k] /= len;
+                double d = -(c[0]*mesh.px[a] + c[1]*mesh.py[a] + c[2]*mesh.pz[a]);
+                Quadric border = Quadric::plane(c[0], c[1], c[2], d, BOUNDARY_WEIGHT);
+                quadrics[a] += border;
+                quadrics[b] += border;
+                break;
+            }
+        }
+        pushEdge(a, b);
+        i = j;
+    }
+}
+
+/**
+ * Queue the cheaper direction of collapsing the edge (u, v)
+ */
+void Simplifier::pushEdge(uint32_t u, uint32_t v){
+    Quadric q = quadrics[u] + quadrics[v];
+    double to_v = q.error(mesh.px[v], mesh.py[v], mesh.pz[v]);
+    double to_u = q.error(mesh.px[u], mesh.py[u], mesh.pz[u]);
+    if(to_v <= to_u) queue.push(Collapse{std::max(0.0, to_v), u, v, version[u], version[v]});
+    else queue.push(Collapse{std::max(0.0, to_u), v, u, version[v], version[u]});
+}
+
+/**
+ * A collapse is rejected when it would flip or degenerate one of the
+ * triangles that survive it.
+ */
+bool Simplifier::valid(uint32_t from, uint32_t to) const{
+    for(uint32_t t: vertex_tris[from]){
+        if(tri_dead[t]) continue;
+        const uint32_t* v = &tris[3*t];
+        if(v[0] == to || v[1] == to || v[2] == to) continue; //removed by the collapse
+        uint32_t moved[3] = {v[0] == from? to: v[0], v[1] == from? to: v[1], v[2] == from? to: v[2]};
+        double n0[3], n1[3];
+        faceNormal(v[0], v[1], v[2], n0);
+        faceNormal(moved[0], moved[1], moved[2], n1);
+        double l0 = sqrt(n0[0]*n0[0] + n0[1]*n0[1] + n0[2]*n0[2]);
+        double l1 = sqrt(n1[0]*n1[0] + n1[1]*n1[1] + n1[2]*n1[2]);
+        if(l1 == 0) return false;
+        if(n0[0]*n1[0] + n0[1]*n1[1] + n0[2]*n1[2] < FLIP_THRESHOLD*l0*l1) return false;
+    }
+    return true;
+}
+
+/**
+ * Pop queue entries until a current and valid collapse is found, and perform it
+ * @param cost filled with the quadric error of the collapse
+ * @return false when no collapse is left
+ */
+bool Simplifier::step(double& cost){
+    while(!queue.empty()){
+        Collapse c = queue.top();
+        queue.pop();
+        if(vertex_dead[c.from] || vertex_dead[c.to]) continue;
+        if(version[c.from] != c.from_version || version[c.to] != c.to_version) continue;
+        if(!valid(c.from, c.to)) continue;
+
+        quadrics[c.to] += quadrics[c.from];
+        vertex_dead[c.from] = true;
+        version[c.to]++;
+        for(uint32_t t: vertex_tris[c.from]){
+            if(tri_dead[t]) continue;
+            uint32_t* v = &tris[3*t];
+            if(v[0] == c.to || v[1] == c.to || v[2] == c.to){
+                tri_dead[t] = true;
+                live_triangles--;
+                continue;
+            }
+            for(int i = 0; i < 3; i++){ if(v[i] == c.from) v[i] = c.to;}
+            vertex_tris[c.to].push_back(t);
+        }
+        std::vector<uint32_t>().swap(vertex_tris[c.from]);
+
+        //drop dead triangles from the survivor's list and requeue its edges
+        std::vector<uint32_t>& around = vertex_tris[c.to];
+        around.erase(std::remove_if(around.begin(), around.end(),
+                                    [this](uint32_t t){ return (bool)tri_dead[t];}), around.end());
+        for(uint32_t t: around){
+            for(int i = 0; i < 3; i++){
+                uint32_t w = tris[3*t+i];
+                if(w != c.to) pushEdge(c.to, w);
+            }
+        }
+        cost = c.cost;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Copy the live triangles into an index buffer
+ */
+void Simplifier::collect(std::vector<uint32_t>& out) const{
+    out.clear();
+    out.reserve(3*live_triangles);
+    for(size_t t = 0; t < tri_dead.size(); t++){
+        if(tri_dead[t]) continue;
+        out.push_back(tris[3*t]); out.push_back(tris[3*t+1]); out.push_back(tris[3*t+2]);
+    }
+}
+
+}
+
+/**
+ * Simplify a mesh down to a triangle budget with quadric error metric edge collapses
+ * @param mesh the source mesh
+ * @param target_triangles stop once at most this many triangles are left
+ * @param indices filled with the simplified index buffer, over the source vertex streams
+ * @param error optionally filled with the geometric error reached, in world units
+ * @return the number of triangles left, larger than the target when no valid collapse remains
+ */
+size_t simplifyMesh(const Mesh& mesh, size_t target_triangles, std::vector<uint32_t>& indices, float* error){
+    PROFILE_ZONE("simplifyMesh");
+    Simplifier simplifier(mesh);
+    double max_cost = 0, cost;
+    while(simplifier.liveTriangles() > target_triangles && simplifier.step(cost)){
+        max_cost = std::max(max_cost, cost);
+    }
+    simplifier.collect(indices);
+    if(error) *error = (float)sqrt(max_cost);
+    return indices.size()/3;
+}
+
+/**
+ * Build a chain of levels of detail in a single simplification run: the index
+ * buffer is captured every time the triangle count falls below the next budget.
+ * @param mesh the source mesh, becomes level 0
+ * @param max_levels maximum number of levels, including level 0
+ * @param reduction triangle budget of each level relative to the previous one
+ * @param min_triangles no level is built below this many triangles
+ * @return the chain of levels, finest first
+ */
+LodChain buildLodChain(const Mesh& mesh, int max_levels, float reduction, size_t min_triangles){
+    PROFILE_ZONE("buildLodChain");
+    LodChain chain;
+    chain.levels.push_back(LodLevel{mesh.indices, 0.0f});
+    if(reduction <= 0 || reduction >= 1){
+        std::cout << "Warning: LOD reduction must be in (0,1), building only the source level.\n";
+        return chain;
+    }
+    Simplifier simplifier(mesh);
+    double max_cost = 0, cost;
+    size_t budget = mesh.triangleCount();
+    for(int level = 1; level < max_levels; level++){
+        budget = (size_t)(budget*reduction);
+        if(budget < min_triangles) break;
+        size_t before = simplifier.liveTriangles();
+        while(simplifier.liveTriangles() > budget && simplifier.step(cost)){
+            max_cost = std::max(max_cost, cost);
+        }
+        if(simplifier.liveTriangles() == before) break; //nothing left to collapse
+        LodLevel lod;
+        simplifier.collect(lod.indices);
+        lod.error = (float)sqrt(max_cost);
+        chain.levels.push_back(lod);
+        if(simplifier.liveTriangles() > budget) break;
+    }
+    return chain;
+}
+
+/**
+ * Choose the coarsest level whose geometric error projects to at most
+ * pixel_error pixels on screen. Objects entirely behind the camera or
+ * smaller than a pixel get the coarsest level.
+ * @param chain the levels of the object
+ * @param camera the camera the object is seen from
+ * @param center center of the object's bounding sphere
+ * @param radius radius of the object's bounding sphere
+ * @param viewport_height height of the viewport in pixels
+ * @param pixel_error largest acceptable error in pixels
+ * @return index of the level to draw
+ */
+int selectLod(const LodChain& chain, const Camera& camera, const float center[3], float radius,
+              int viewport_height, float pixel_error){
+    int coarsest = (int)chain.levels.size() - 1;
+    if(coarsest <= 0) return 0;
+    const float* eye = camera.getPosition();
+    float d[3] = {center[0]-eye[0], center[1]-eye[1], center[2]-eye[2]};
+    const float* forward = camera.getForward();
+    if(d[0]*forward[0] + d[1]*forward[1] + d[2]*forward[2] < -radius) return coarsest; //behind the camera
+    float distance = sqrtf(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]) - radius;
+    if(distance <= camera.getNear()) return 0; //camera inside the bounds
+    float pixels_per_unit = viewport_height/(2*tanf(0.5f*camera.getFov())*distance);
+    if(2*radius*pixels_per_unit < 1) return coarsest;
+    for(int level = coarsest; level > 0; level--){
+        if(chain.levels[level].error*pixels_per_unit <= pixel_error) return level;
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+#ifndef GRAPHICSENGINE3D_SIMPLIFY_H
+#define GRAPHICSENGINE3D_SIMPLIFY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "camera.h"
+#include "matrix.h"
+#include "mesh.h"
+
+/**
+ * Garland-Heckbert error quadric: the symmetric 4x4 matrix sum of p*p^T over
+ * the planes p = (a, b, c, d) around a vertex, i.e. Matrixf<4>::mProduct(p, p).
+ * Only the upper triangle is stored, in doubles, so accumulating and
+ * evaluating quadrics in the simplifier's inner loop never allocates.
+ */
+struct Quadric{
+    double q[10]; //aa ab ac ad bb bc bd cc cd dd
+
+    static Quadric zero();
+    static Quadric plane(double a, double b, double c, double d, double weight);
+    Quadric operator+(const Quadric& other) const;
+    Quadric& operator+=(const Quadric& other);
+    double error(double x, double y, double z) const; //v^T Q v with v = (x, y, z, 1)
+    Matrixf<4> toMatrix() const;
+};
+
+/**
+ * One level of detail: an index buffer over the vertex streams of the source mesh,
+ * and the geometric error of the level in world units.
+ */
+struct LodLevel{
+    std::vector<uint32_t> indices;
+    float error;
+};
+
+/**
+ * Discrete chain of levels of detail, finest (the source mesh) first.
+ * Every level reuses the source vertex streams: collapses move a vertex onto
+ * one of its neighbours, so no new vertices are created.
+ */
+struct LodChain{
+    std::vector<LodLevel> levels;
+};
+
+size_t simplifyMesh(const Mesh& mesh, size_t target_triangles, std::vector<uint32_t>& indices,
+                    float* error = nullptr);
+LodChain buildLodChain(const Mesh& mesh, int max_levels, float reduction = 0.5f,
+                       size_t min_triangles = 64);
+int selectLod(const LodChain& chain, const Camera& camera, const float center[3], float radius,
+              int viewport_height, float pixel_error = 1.0f);
+
+#endif //GRAPHICSENGINE3D_SIMPLIFY_H
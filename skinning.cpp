@@ -0,0 +1,272 @@
+#include "skinning.h"
+#include "profiler.h"
+#include "projection.h"
+#include "simd.h"
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+
+//Implementation details of linear blend skinning
+
+size_t SkinWeights::vertexCount() const{
+    return joints.size()/SKIN_INFLUENCES;
+}
+
+/**
+ * Pack per-vertex joint influences: the SKIN_INFLUENCES largest weights of every
+ * vertex are kept, renormalized and quantized to 8 bits so that they sum to 255 exactly.
+ * A vertex without any positive weight is bound rigidly to its first joint.
+ * @param joints influences joint indices per vertex
+ * @param weights influences weights per vertex
+ * @param influences number of influences per vertex in the input
+ * @param count number of vertices
+ * @param skin filled with the packed influences
+ * @return false when a joint index does not fit in 8 bits
+ */
+bool packSkinWeights(const uint32_t* joints, const float* weights, size_t influences, size_t count,
+                     SkinWeights& skin){
+    skin.joints.assign(SKIN_INFLUENCES*count, 0);
+    skin.weights.assign(SKIN_INFLUENCES*count, 0);
+    skin.max_joint = -1;
+    std::vector<std::pair<float, uint32_t>> sorted(influences);
+    for(size_t v = 0; v < count; v++){
+        for(size_t k = 0; k < influences; k++){
+            sorted[k] = std::make_pair(weights[v*influences + k], joints[v*influences + k]);
+        }
+        //heaviest first, lower joint index first on ties so the packing is deterministic
+        std::sort(sorted.begin(), sorted.end(), [](const std::pair<float, uint32_t>& a,
+                                                   const std::pair<float, uint32_t>& b){
+            return a.first > b.first || (a.first == b.first && a.second < b.second);
+        });
+        size_t kept = std::min<size_t>(SKIN_INFLUENCES, influences);
+        float total = 0;
+        for(size_t k = 0; k < kept; k++) total += std::max(0.0f, sorted[k].first);
+
+        uint8_t* out_joints = &skin.joints[SKIN_INFLUENCES*v];
+        uint8_t* out_weights = &skin.weights[SKIN_INFLUENCES*v];
+        if(total <= 0){
+            uint32_t joint = influences? joints[v*influences]: 0;
+            if(joint > 255){
+                std::cout << "Warning: skin joint index " << joint << " does not fit the 8 bit palette index\n";
+                return false;
+            }
+            out_joints[0] = (uint8_t)joint;
+            out_weights[0] = 255;
+            skin.max_joint = std::max(skin.max_joint, (int)joint);
+            continue;
+        }
+        //largest remainder rounding, so the weights sum to exactly 255
+        float remainder[SKIN_INFLUENCES] = {};
+        int sum = 0;
+        for(size_t k = 0; k < kept; k++){
+            float scaled = std::max(0.0f, sorted[k].first)/total*255.0f;
+            int q = (int)scaled;
+            out_weights[k] = (uint8_t)q;
+            remainder[k] = scaled - q;
+            sum += q;
+        }
+        for(; sum < 255; sum++){
+            size_t best = std::max_element(remainder, remainder + kept) - remainder;
+            out_weights[best]++;
+            remainder[best] = -1;
+        }
+        for(size_t k = 0; k < kept; k++){
+            if(out_weights[k] == 0) continue;
+            if(sorted[k].second > 255){
+                std::cout << "Warning: skin joint index " << sorted[k].second
+                          << " does not fit the 8 bit palette index\n";
+                return false;
+            }
+            out_joints[k] = (uint8_t)sorted[k].second;
+            skin.max_joint = std::max(skin.max_joint, (int)sorted[k].second);
+        }
+    }
+    return true;
+}
+
+/**
+ * Build the skinning palette: the affine part of joint_transform * inverse_bind
+ * for every joint, as SKIN_PALETTE_STRIDE floats (4 columns of 3 rows)
+ * @param joint_transforms 16 floats per joint, column-major model space joint transforms
+ * @param inverse_bind 16 floats per joint, inverse bind pose transforms, nullptr when
+ *                     joint_transforms already include them
+ * @param count number of joints
+ * @param palette filled with SKIN_PALETTE_STRIDE*count floats
+ */
+void buildSkinPalette(const float* joint_transforms, const float* inverse_bind, size_t count, float* palette){
+    for(size_t j = 0; j < count; j++){
+        float m[16];
+        if(inverse_bind) multiplyMatrix(joint_transforms + 16*j, inverse_bind + 16*j, m);
+        else std::copy(joint_transforms + 16*j, joint_transforms + 16*j + 16, m);
+        for(int col = 0; col < 4; col++){
+            for(int row = 0; row < 3; row++) palette[SKIN_PALETTE_STRIDE*j + 3*col + row] = m[4*col + row];
+        }
+    }
+}
+
+/**
+ * buildSkinPalette with engine matrices that already include the inverse bind pose
+ */
+void buildSkinPalette(const std::vector<Matrixf<4>>& joint_transforms, std::vector<float>& palette){
+    palette.resize(SKIN_PALETTE_STRIDE*joint_transforms.size());
+    for(size_t j = 0; j < joint_transforms.size(); j++){
+        const float* m = joint_transforms[j].data(); //column-major, like the float overload
+        for(int col = 0; col < 4; col++){
+            for(int row = 0; row < 3; row++) palette[SKIN_PALETTE_STRIDE*j + 3*col + row] = m[4*col + row];
+        }
+    }
+}
+
+/**
+ * Skin a range of vertices, 4 at a time: the palette entries of every vertex are
+ * blended 12 components wide, transposed to one register per component across
+ * the 4 vertices, and applied to the SoA positions and normals.
+ * Normals use the blended 3x3 part and are renormalized, so joint scales should be uniform.
+ * @param palette the skinning palette, see buildSkinPalette()
+ * @param skin packed influences of the bind mesh
+ * @param bind the bind pose
+ * @param out receives the skinned vertices, its streams must already hold the bind mesh's vertex count
+ * @param first first vertex to skin
+ * @param count number of vertices to skin
+ */
+void skinVertices(const float* palette, const SkinWeights& skin, const Mesh& bind, Mesh& out,
+                  size_t first, size_t count){
+    PROFILE_ZONE("skinVertices");
+    bool normals = bind.hasNormals() && out.hasNormals();
+    const uint8_t* joints = skin.joints.data();
+    const uint8_t* weights = skin.weights.data();
+    const float unorm = 1.0f/255.0f;
+    size_t end = first + count;
+    for(size_t i = first; i < end; i += 4){
+        size_t lanes = std::min<size_t>(4, end - i);
+        //blended matrix of every lane, 3 registers of 4 components each
+        Float4 m[4][3];
+        for(size_t lane = 0; lane < 4; lane++){
+            size_t v = i + std::min(lane, lanes - 1); //tail lanes repeat the last vertex
+            const uint8_t* j = joints + SKIN_INFLUENCES*v;
+            const uint8_t* w = weights + SKIN_INFLUENCES*v;
+            Float4 wk(w[0]*unorm);
+            const float* p = palette + SKIN_PALETTE_STRIDE*j[0];
+            Float4 a = wk*Float4::load(p), b = wk*Float4::load(p + 4), c = wk*Float4::load(p + 8);
+            for(int k = 1; k < SKIN_INFLUENCES; k++){
+                wk = Float4(w[k]*unorm);
+                p = palette + SKIN_PALETTE_STRIDE*j[k];
+                a = a + wk*Float4::load(p);
+                b = b + wk*Float4::load(p + 4);
+                c = c + wk*Float4::load(p + 8);
+            }
+            m[lane][0] = a; m[lane][1] = b; m[lane][2] = c;
+        }
+        for(int g = 0; g < 3; g++) transpose(m[0][g], m[1][g], m[2][g], m[3][g]);
+        //component 4*g + r of the palette entry is now m[r][g]; entry layout is column-major 3x4
+        Float4 c[12];
+        for(int g = 0; g < 3; g++){
+            for(int r = 0; r < 4; r++) c[4*g + r] = m[r][g];
+        }
+
+        float in[6][4], res[6][4];
+        const float* src[6] = {&bind.px[i], &bind.py[i], &bind.pz[i]};
+        float* dst[6] = {&out.px[i], &out.py[i], &out.pz[i]};
+        if(normals){
+            src[3] = &bind.nx[i]; src[4] = &bind.ny[i]; src[5] = &bind.nz[i];
+            dst[3] = &out.nx[i]; dst[4] = &out.ny[i]; dst[5] = &out.nz[i];
+        }
+        int streams = normals? 6: 3;
+        if(lanes < 4){ //tail, padded to a full batch
+            for(int s = 0; s < streams; s++){
+                for(size_t l = 0; l < 4; l++) in[s][l] = src[s][std::min(l, lanes - 1)];
+                src[s] = in[s];
+                dst[s] = res[s];
+            }
+        }
+        Float4 x = Float4::load(src[0]), y = Float4::load(src[1]), z = Float4::load(src[2]);
+        (c[0]*x + c[3]*y + c[6]*z + c[9]).store(dst[0]);
+        (c[1]*x + c[4]*y + c[7]*z + c[10]).store(dst[1]);
+        (c[2]*x + c[5]*y + c[8]*z + c[11]).store(dst[2]);
+        if(normals){
+            x = Float4::load(src[3]); y = Float4::load(src[4]); z = Float4::load(src[5]);
+            Float4 nx = c[0]*x + c[3]*y + c[6]*z;
+            Float4 ny = c[1]*x + c[4]*y + c[7]*z;
+            Float4 nz = c[2]*x + c[5]*y + c[8]*z;
+            Float4 scale = Float4(1.0f)/sqrt(max(nx*nx + ny*ny + nz*nz, Float4(1e-30f)));
+            (nx*scale).store(dst[3]);
+            (ny*scale).store(dst[4]);
+            (nz*scale).store(dst[5]);
+        }
+        if(lanes < 4){
+            float* target[6] = {&out.px[i], &out.py[i], &out.pz[i]};
+            if(normals){ target[3] = &out.nx[i]; target[4] = &out.ny[i]; target[5] = &out.nz[i];}
+            for(int s = 0; s < streams; s++) std::copy(res[s], res[s] + lanes, target[s]);
+        }
+    }
+}
+
+namespace {
+
+/**
+ * Check that an instance can be skinned and size its output streams
+ */
+bool prepareInstance(size_t joint_count, const SkinWeights& skin, const Mesh& bind, Mesh& out){
+    if(skin.vertexCount() != bind.vertexCount()){
+        std::cout << "Warning: skin weights of " << skin.vertexCount() << " vertices for a mesh of "
+                  << bind.vertexCount() << " vertices\n";
+        return false;
+    }
+    if(skin.max_joint >= (int)joint_count){
+        std::cout << "Warning: skin references joint " << skin.max_joint << " of a palette of "
+                  << joint_count << " joints\n";
+        return false;
+    }
+    out.resizeVertices(bind.vertexCount(), bind.hasNormals());
+    return true;
+}
+
+}
+
+/**
+ * Skin a whole mesh on the calling thread
+ * @param palette the skinning palette, see buildSkinPalette()
+ * @param joint_count number of joints in the palette
+ * @param skin packed influences of the bind mesh
+ * @param bind the bind pose
+ * @param out resized and filled with the skinned vertices
+ * @return whether the skin matches the mesh and the palette
+ */
+bool skinMesh(const float* palette, size_t joint_count, const SkinWeights& skin, const Mesh& bind, Mesh& out){
+    if(!prepareInstance(joint_count, skin, bind, out)) return false;
+    skinVertices(palette, skin, bind, out, 0, bind.vertexCount());
+    return true;
+}
+
+/**
+ * Skin many meshes on a job system. Every mesh is split in chunks of
+ * SKIN_CHUNK_VERTICES vertices, so small meshes are one job each and large
+ * meshes are spread over every thread.
+ * @param jobs the job system to run on
+ * @param instances the meshes to skin, invalid ones are skipped
+ * @return whether every instance was valid
+ */
+bool skinInstances(JobSystem& jobs, const std::vector<SkinInstance>& instances){
+    PROFILE_ZONE("skinInstances");
+    bool valid = true;
+    std::vector<size_t> chunk_base(instances.size() + 1, 0);
+    for(size_t i = 0; i < instances.size(); i++){
+        const SkinInstance& instance = instances[i];
+        size_t chunks = 0;
+        if(prepareInstance(instance.joint_count, *instance.skin, *instance.bind, *instance.out)){
+            chunks = (instance.bind->vertexCount() + SKIN_CHUNK_VERTICES - 1)/SKIN_CHUNK_VERTICES;
+        }
+        else valid = false;
+        chunk_base[i + 1] = chunk_base[i] + chunks;
+    }
+    jobs.parallelFor(0, chunk_base.back(), [&](size_t begin, size_t end){
+        for(size_t chunk = begin; chunk < end; chunk++){
+            size_t i = std::upper_bound(chunk_base.begin(), chunk_base.end(), chunk) - chunk_base.begin() - 1;
+            const SkinInstance& instance = instances[i];
+            size_t first = (chunk - chunk_base[i])*SKIN_CHUNK_VERTICES;
+            size_t count = std::min(SKIN_CHUNK_VERTICES, instance.bind->vertexCount() - first);
+            skinVertices(instance.palette, *instance.skin, *instance.bind, *instance.out, first, count);
+        }
+    }, 1);
+    return valid;
+}
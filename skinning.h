@@ -0,0 +1,48 @@
+#ifndef GRAPHICSENGINE3D_SKINNING_H
+#define GRAPHICSENGINE3D_SKINNING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "jobsystem.h"
+#include "matrix.h"
+#include "mesh.h"
+
+const int SKIN_INFLUENCES = 4; //joints per vertex
+const size_t SKIN_PALETTE_STRIDE = 12; //floats per palette entry
+const size_t SKIN_CHUNK_VERTICES = 4096; //vertices per job of skinInstances()
+
+/**
+ * Packed joint influences of a skinned mesh, 8 bytes per vertex:
+ * SKIN_INFLUENCES joint indices into a palette of at most 256 joints, and as
+ * many 8 bit weights summing to 255. Unused influences have weight 0.
+ */
+struct SkinWeights{
+    std::vector<uint8_t> joints;
+    std::vector<uint8_t> weights;
+    int max_joint; //largest joint index referenced, -1 when empty
+
+    size_t vertexCount() const;
+};
+
+/**
+ * One skinned mesh to update with skinInstances()
+ */
+struct SkinInstance{
+    const Mesh* bind; //bind pose positions and optional normals
+    const SkinWeights* skin;
+    const float* palette; //SKIN_PALETTE_STRIDE floats per joint, see buildSkinPalette()
+    size_t joint_count;
+    Mesh* out; //skinned positions and normals, the index buffer is left alone
+};
+
+bool packSkinWeights(const uint32_t* joints, const float* weights, size_t influences, size_t count,
+                     SkinWeights& skin);
+void buildSkinPalette(const float* joint_transforms, const float* inverse_bind, size_t count, float* palette);
+void buildSkinPalette(const std::vector<Matrixf<4>>& joint_transforms, std::vector<float>& palette);
+void skinVertices(const float* palette, const SkinWeights& skin, const Mesh& bind, Mesh& out,
+                  size_t first, size_t count);
+bool skinMesh(const float* palette, size_t joint_count, const SkinWeights& skin, const Mesh& bind, Mesh& out);
+bool skinInstances(JobSystem& jobs, const std::vector<SkinInstance>& instances);
+
+#endif //GRAPHICSENGINE3D_SKINNING_H
@@ -0,0 +1,183 @@
+#include "../animation.h"
+#include "../skinning.h"
+#include <vector>
+#include <math.h>
+#include "tester.h"
+
+/**
+ * Mesh of count vertices on a unit sphere with normals, and a palette of rotations
+ * about z plus translations, with random 3 joint influences per vertex
+ */
+static void buildSkinnedMesh(size_t count, size_t joint_count, Mesh& mesh, std::vector<float>& palette,
+                             std::vector<uint32_t>& joints, std::vector<float>& weights){
+    uint32_t seed = 7;
+    auto random = [&seed](){ seed = seed*1664525u + 1013904223u; return (seed >> 8)*(1.0f/16777216.0f);};
+    mesh.resizeVertices(count, true);
+    for(size_t v = 0; v < count; v++){
+        float theta = 3.14159265f*random(), phi = 6.28318531f*random();
+        mesh.nx[v] = sinf(theta)*cosf(phi); mesh.ny[v] = sinf(theta)*sinf(phi); mesh.nz[v] = cosf(theta);
+        mesh.px[v] = mesh.nx[v]; mesh.py[v] = mesh.ny[v]; mesh.pz[v] = mesh.nz[v];
+        for(int k = 0; k < 3; k++){
+            joints.push_back((uint32_t)(random()*joint_count));
+            weights.push_back(random());
+        }
+    }
+    std::vector<float> transforms(16*joint_count, 0.0f);
+    for(size_t j = 0; j < joint_count; j++){
+        float* m = &transforms[16*j];
+        float angle = 0.3f*j;
+        m[0] = cosf(angle); m[1] = sinf(angle); m[4] = -sinf(angle); m[5] = cosf(angle);
+        m[10] = 1; m[15] = 1;
+        m[12] = 0.5f*j; m[13] = -0.25f*j; m[14] = 1.0f;
+    }
+    palette.resize(SKIN_PALETTE_STRIDE*joint_count);
+    buildSkinPalette(transforms.data(), nullptr, joint_count, palette.data());
+}
+
+/**
+ * Function that handles unittests for packing and skinning
+ * @return Tester object containing the results of the unittests
+ */
+Tester skinning_tests(){
+    std::string test_name = "Linear blend skinning";
+    std::string pack_fail = "Packed weights should keep the 4 heaviest influences and sum to 255";
+    std::string position_fail = "Skinned positions should match the blend of the joint transforms";
+    std::string normal_fail = "Skinned normals should be unit length";
+    std::string jobs_fail = "Skinning on the job system should match skinning on one thread";
+    std::string invalid_fail = "Skin referencing joints outside the palette should be rejected";
+    std::string matrix_fail = "Palette from Matrixf joints should match the hand built column-major matrices";
+    Tester AT = Tester(test_name);
+
+    uint32_t five_joints[5] = {3, 9, 1, 4, 7};
+    float five_weights[5] = {0.3f, 0.5f, 0.15f, 0.04f, 0.01f};
+    SkinWeights packed;
+    bool ok = packSkinWeights(five_joints, five_weights, 5, 1, packed);
+    int sum = packed.weights[0] + packed.weights[1] + packed.weights[2] + packed.weights[3];
+    AT.add(ok && sum == 255 && packed.joints[0] == 9 && packed.joints[1] == 3 && packed.joints[3] == 4
+           && packed.max_joint == 9, pack_fail);
+
+    size_t count = 103, joint_count = 8;
+    Mesh bind, skinned;
+    std::vector<float> palette, weights;
+    std::vector<uint32_t> joints;
+    buildSkinnedMesh(count, joint_count, bind, palette, joints, weights);
+    SkinWeights skin;
+    packSkinWeights(joints.data(), weights.data(), 3, count, skin);
+    ok = skinMesh(palette.data(), joint_count, skin, bind, skinned);
+    float position_error = 0, normal_error = 0;
+    for(size_t v = 0; v < count; v++){
+        float expected[3] = {0, 0, 0};
+        for(int k = 0; k < SKIN_INFLUENCES; k++){
+            float w = skin.weights[4*v + k]/255.0f;
+            const float* m = &palette[SKIN_PALETTE_STRIDE*skin.joints[4*v + k]];
+            for(int r = 0; r < 3; r++){
+                expected[r] += w*(m[r]*bind.px[v] + m[3 + r]*bind.py[v] + m[6 + r]*bind.pz[v] + m[9 + r]);
+            }
+        }
+        position_error = std::max(position_error, fabsf(expected[0] - skinned.px[v]));
+        position_error = std::max(position_error, fabsf(expected[1] - skinned.py[v]));
+        position_error = std::max(position_error, fabsf(expected[2] - skinned.pz[v]));
+        float len = sqrtf(skinned.nx[v]*skinned.nx[v] + skinned.ny[v]*skinned.ny[v] + skinned.nz[v]*skinned.nz[v]);
+        normal_error = std::max(normal_error, fabsf(len - 1));
+    }
+    AT.add(ok && position_error < 1e-5f, position_fail);
+    AT.add(normal_error < 1e-5f, normal_fail);
+
+    Mesh big_bind, big_single, big_jobs, small_jobs;
+    std::vector<float> big_palette, big_weights;
+    std::vector<uint32_t> big_joints;
+    buildSkinnedMesh(3*SKIN_CHUNK_VERTICES + 5, joint_count, big_bind, big_palette, big_joints, big_weights);
+    SkinWeights big_skin;
+    packSkinWeights(big_joints.data(), big_weights.data(), 3, big_bind.vertexCount(), big_skin);
+    skinMesh(big_palette.data(), joint_count, big_skin, big_bind, big_single);
+    JobSystem jobs(3);
+    std::vector<SkinInstance> instances = {
+        SkinInstance{&bind, &skin, palette.data(), joint_count, &small_jobs},
+        SkinInstance{&big_bind, &big_skin, big_palette.data(), joint_count, &big_jobs}};
+    ok = skinInstances(jobs, instances);
+    AT.add(ok && big_jobs.px == big_single.px && big_jobs.nz == big_single.nz && small_jobs.py == skinned.py,
+           jobs_fail);
+
+    instances[0].joint_count = 4;
+    AT.add(!skinInstances(jobs, instances), invalid_fail);
+
+    //joint 1 rotated by 0.4 rad about x and translated by (1, 2, 3)
+    float c = cosf(0.4f), s = sinf(0.4f);
+    float hand[16] = {1, 0, 0, 0,  0, c, s, 0,  0, -s, c, 0,  1, 2, 3, 1};
+    std::vector<Matrixf<4>> engine = {Matrixf<4>(), Matrixf<4>{{1, 0, 0, 0}, {0, c, s, 0}, {0, -s, c, 0}, {1, 2, 3, 1}}};
+    std::vector<float> from_engine;
+    buildSkinPalette(engine, from_engine);
+    bool same = from_engine.size() == 2*SKIN_PALETTE_STRIDE && from_engine[0] == 1 && from_engine[4] == 1
+                && from_engine[9] == 0;
+    for(int col = 0; col < 4; col++){
+        for(int row = 0; row < 3; row++) same = same && from_engine[SKIN_PALETTE_STRIDE + 3*col + row] == hand[4*col + row];
+    }
+    AT.add(same, matrix_fail);
+    return AT;
+}
+
+/**
+ * Function that handles unittests for animation clips and the clip sampler
+ * @return Tester object containing the results of the unittests
+ */
+Tester keyframe_tests(){
+    std::string test_name = "Keyframe sampling";
+    std::string linear_fail = "Linear translation should be halfway between keys";
+    std::string slerp_fail = "Slerp halfway through a quarter turn should be an eighth turn";
+    std::string cubic_fail = "Cubic track should pass through its keys";
+    std::string cursor_fail = "Sequential and random access sampling should agree";
+    std::string invalid_fail = "Cubic rotation track should be rejected";
+    std::string matrix_fail = "Model matrix should chain the parent transform";
+    Tester AT = Tester(test_name);
+
+    AnimationClip clip;
+    float times[3] = {0.0f, 1.0f, 3.0f};
+    float translations[9] = {0, 0, 0, 2, 4, 6, 2, 4, 10};
+    float s = sinf(0.25f*3.14159265f), c = cosf(0.25f*3.14159265f);
+    float rotations[12] = {0, 0, 0, 1, 0, 0, s, c, 0, 0, 1, 0};
+    float scales[9] = {1, 1, 1, 2, 2, 2, 1, 1, 1};
+    clip.addTrack(1, TRACK_TRANSLATION, INTERP_LINEAR, times, translations, 3);
+    clip.addTrack(1, TRACK_ROTATION, INTERP_SLERP, times, rotations, 3);
+    clip.addTrack(0, TRACK_SCALE, INTERP_CUBIC, times, scales, 3);
+    AT.add(clip.addTrack(0, TRACK_ROTATION, INTERP_CUBIC, times, rotations, 3) == -1, invalid_fail);
+
+    Pose pose;
+    ClipSampler sampler(clip);
+    sampler.sample(0.5f, pose);
+    AT.add(pose.jointCount() == 2 && fabsf(pose.translation[3] - 1) < 1e-6f && fabsf(pose.translation[5] - 3) < 1e-6f,
+           linear_fail);
+    float eighth = sinf(0.125f*3.14159265f);
+    AT.add(fabsf(pose.rotation[6] - eighth) < 1e-5f && fabsf(pose.rotation[4]) < 1e-6f, slerp_fail);
+    sampler.sample(1.0f, pose);
+    AT.add(fabsf(pose.scale[0] - 2) < 1e-6f && pose.scale[1] == pose.scale[0], cubic_fail);
+
+    //forward playback through the cursors against a fresh sampler per time
+    bool same = true;
+    Pose sequential, random_access;
+    for(int frame = 0; frame < 200; frame++){
+        float time = frame*0.037f;
+        sampler.sample(time, sequential, true);
+        ClipSampler fresh(clip);
+        fresh.sample(time, random_access, true);
+        same = same && sequential.translation == random_access.translation
+               && sequential.rotation == random_access.rotation && sequential.scale == random_access.scale;
+    }
+    AT.add(same, cursor_fail);
+
+    float local[32], model[32];
+    int parents[2] = {-1, 0};
+    sampler.sample(1.0f, pose);
+    composeLocalMatrices(pose, local);
+    composeModelMatrices(local, parents, 2, model);
+    //joint 1 at (2, 4, 6) under a root scaled by 2
+    AT.add(fabsf(model[16 + 12] - 4) < 1e-5f && fabsf(model[16 + 13] - 8) < 1e-5f && fabsf(model[16 + 14] - 12) < 1e-5f,
+           matrix_fail);
+    return AT;
+}
+
+std::vector<Tester> animationTests(){
+    std::vector<Tester> tests;
+    tests.push_back(skinning_tests());
+    tests.push_back(keyframe_tests());
+    return tests;
+}
@@ -0,0 +1,193 @@
+#include "../bvh.h"
+#include "../pathtracer.h"
+#include <vector>
+#include <math.h>
+#include "tester.h"
+
+/**
+ * Build an n x n grid of unit quads in the z = 0 plane, two triangles per quad
+ */
+static void buildGrid(int n, std::vector<float> &x, std::vector<float> &y, std::vector<float> &z,
+                      std::vector<uint32_t> &idx){
+    for(int j = 0; j <= n; j++){
+        for(int i = 0; i <= n; i++){
+            x.push_back(i); y.push_back(j); z.push_back(0.0);
+        }
+    }
+    for(int j = 0; j < n; j++){
+        for(int i = 0; i < n; i++){
+            uint32_t v = j*(n+1) + i;
+            idx.push_back(v); idx.push_back(v+1); idx.push_back(v+n+1);
+            idx.push_back(v+1); idx.push_back(v+n+2); idx.push_back(v+n+1);
+        }
+    }
+}
+
+/**
+ * Function that handles BVH unittests for construction and refitting
+ * @return Tester object containing the results of the unittests
+ */
+Tester bvh_build_tests(){
+    std::string test_name = "BVH build/refit";
+    std::string node_fail = "BVH node count error";
+    std::string bounds_fail = "BVH root bounds error";
+    std::string refit_fail = "BVH refit bounds error";
+    Tester BT = Tester(test_name);
+
+    std::vector<float> x, y, z;
+    std::vector<uint32_t> idx;
+    buildGrid(32, x, y, z, idx);
+    BVH bvh;
+    bvh.build(x.data(), y.data(), z.data(), idx.data(), idx.size()/3);
+
+    BT.add(bvh.nodeCount() > 2 && bvh.nodeCount() <= 2*bvh.triangleCount(), node_fail);
+    const BVHNode &root = bvh.getNodes()[0];
+    BT.add(root.bmin[0] == 0.0 && root.bmax[0] == 32.0 && root.bmax[1] == 32.0, bounds_fail);
+
+    for(auto &v: z) v += 2.0;
+    bvh.refit(x.data(), y.data(), z.data());
+    BT.add(bvh.getNodes()[0].bmin[2] == 2.0 && bvh.getNodes()[0].bmax[2] == 2.0, refit_fail);
+    return BT;
+}
+
+/**
+ * Function that handles BVH unittests for closest and any hit queries
+ * @return Tester object containing the results of the unittests
+ */
+Tester bvh_query_tests(){
+    std::string test_name = "BVH ray queries";
+    std::string hit_fail = "Closest hit error";
+    std::string miss_fail = "Ray should miss the mesh";
+    std::string occl_fail = "Any hit error";
+    std::string deep_fail = "Trees deeper than the traversal stack should still visit every node";
+    Tester BT = Tester(test_name);
+
+    std::vector<float> x, y, z;
+    std::vector<uint32_t> idx;
+    buildGrid(32, x, y, z, idx);
+    BVH bvh;
+    bvh.build(x.data(), y.data(), z.data(), idx.data(), idx.size()/3);
+
+    float o1[3]{3.25, 7.5, 10.0};
+    float d1[3]{0.0, 0.0, -1.0};
+    Hit hit;
+    bool h1 = bvh.intersect(Ray{o1, d1, 100.0}, hit);
+    BT.add(h1 && fabs(hit.t - 10.0) < 1e-4 && hit.triangle == (7*32 + 3)*2, hit_fail);
+
+    float o2[3]{40.0, 7.5, 10.0};
+    BT.add(!bvh.intersect(Ray{o2, d1, 100.0}, hit), miss_fail);
+
+    BT.add(bvh.occluded(Ray{o1, d1, 100.0}), occl_fail);
+    BT.add(!bvh.occluded(Ray{o1, d1, 5.0}), occl_fail);
+
+    //degenerate chain far deeper than the fixed traversal stack: every level
+    //pushes its leaf, and only the leaf pushed last holds a triangle on the ray
+    const uint32_t levels = 200;
+    std::vector<BVHNode> chain(2*levels + 2); //node 2k + 1 is a leaf, node 2*levels the last leaf
+    std::vector<float> cx, cy, cz;
+    std::vector<uint32_t> chain_idx, order;
+    for(uint32_t t = 0; t <= levels; t++){
+        float offset = t == levels - 1? 0.0f: 5.0f;
+        float tx[3] = {offset - 1, offset + 1, offset}, ty[3] = {offset - 1, offset - 1, offset + 1};
+        for(int c = 0; c < 3; c++){
+            chain_idx.push_back(cx.size());
+            cx.push_back(tx[c]); cy.push_back(ty[c]); cz.push_back(0.0);
+        }
+        order.push_back(t);
+    }
+    for(uint32_t n = 0; n < chain.size(); n++){
+        BVHNode& node = chain[n];
+        for(int a = 0; a < 3; a++){ node.bmin[a] = -2.0; node.bmax[a] = 7.0;}
+        bool leaf = n%2 == 1 || n == 2*levels;
+        node.count = leaf && n > 1? 1: 0; //node 1 is the unused slot after the root
+        node.leftFirst = n == 1? 0: leaf? (n == 2*levels? levels: (n - 3)/2): (n == 0? 2: n + 2);
+    }
+    BVH deep;
+    deep.attach(chain.data(), chain.size(), order.data(), cx.data(), cy.data(), cz.data(), chain_idx.data(), levels + 1);
+    float o3[3]{0.0, 0.0, 5.0};
+    bool h3 = deep.intersect(Ray{o3, d1, 100.0}, hit);
+    RayPacket4 packet;
+    for(int l = 0; l < 4; l++){
+        for(int a = 0; a < 3; a++){ packet.origin[a][l] = o3[a] + (a == 0? 0.1f*l: 0.0f); packet.dir[a][l] = d1[a];}
+        packet.tMax[l] = 100.0;
+    }
+    int lanes = deep.intersect4(packet);
+    BT.add(h3 && hit.triangle == levels - 1 && deep.occluded(Ray{o3, d1, 100.0})
+           && lanes == 15 && packet.triangle[3] == levels - 1, deep_fail);
+    return BT;
+}
+
+/**
+ * Function that handles path tracer unittests with scenes of known radiance
+ * @return Tester object containing the results of the unittests
+ */
+Tester path_tracer_tests(){
+    std::string test_name = "Path tracer";
+    std::string plane_fail = "Diffuse plane under a uniform sky should reflect albedo times the sky radiance";
+    std::string furnace_fail = "Closed emissive box should converge to emission/(1 - albedo)";
+    std::string thread_fail = "Images should not depend on the thread count";
+    Tester BT = Tester(test_name);
+
+    //diffuse plane z = 0 seen from above: one bounce then the sky, so every sample is exact
+    std::vector<float> x, y, z;
+    std::vector<uint32_t> idx;
+    buildGrid(10, x, y, z, idx);
+    BVH plane;
+    plane.build(x.data(), y.data(), z.data(), idx.data(), idx.size()/3);
+    float sky[3] = {0.8f, 0.6f, 0.4f};
+    std::vector<PathMaterial> gray = {PathMaterial{{0.5f, 0.25f, 1.0f}, {0, 0, 0}}};
+    Camera camera;
+    float eye[3] = {5, 5, 3}, target[3] = {5, 5, 0}, up[3] = {0, 1, 0};
+    camera.lookAt(eye, target, up);
+    camera.setPerspective(0.5f, 1.0f, 0.1f, 10.0f);
+    PathTracer tracer(8, 8);
+    tracer.setScene(&plane, x.data(), y.data(), z.data(), idx.data(), nullptr, gray);
+    tracer.setSky(sky, sky);
+    for(int pass = 0; pass < 4; pass++) tracer.renderPass(camera);
+    std::vector<float> image(3*8*8);
+    tracer.resolve(image.data());
+    bool exact = true;
+    for(size_t p = 0; p < image.size(); p += 3){
+        for(int c = 0; c < 3; c++) exact = exact && fabsf(image[p + c] - gray[0].albedo[c]*sky[c]) < 1e-5f;
+    }
+    BT.add(exact, plane_fail);
+
+    //inside a closed box: L = E + a*L, so L = E/(1 - a) = 1, up to max_depth and russian roulette noise
+    float bx[8], by[8], bz[8];
+    for(int v = 0; v < 8; v++){ bx[v] = v & 1? 1.0f: -1.0f; by[v] = v & 2? 1.0f: -1.0f; bz[v] = v & 4? 1.0f: -1.0f;}
+    uint32_t box_idx[36] = {0, 1, 3, 0, 3, 2,  4, 6, 7, 4, 7, 5,  0, 4, 5, 0, 5, 1,
+                            2, 3, 7, 2, 7, 6,  0, 2, 6, 0, 6, 4,  1, 5, 7, 1, 7, 3};
+    BVH box;
+    box.build(bx, by, bz, box_idx, 12);
+    std::vector<PathMaterial> furnace = {PathMaterial{{0.5f, 0.5f, 0.5f}, {0.5f, 0.5f, 0.5f}}};
+    float origin[3] = {0, 0, 0}, ahead[3] = {0, 0, -1};
+    camera.lookAt(origin, ahead, up);
+    camera.setPerspective(1.5f, 1.0f, 0.01f, 10.0f);
+    PathTracer single(16, 16), threaded(16, 16);
+    for(PathTracer* t: {&single, &threaded}){
+        t->setScene(&box, bx, by, bz, box_idx, nullptr, furnace);
+        t->setMaxDepth(64);
+    }
+    single.setThreadCount(1);
+    threaded.setThreadCount(3);
+    for(int pass = 0; pass < 8; pass++){
+        single.renderPass(camera);
+        threaded.renderPass(camera);
+    }
+    std::vector<float> a(3*16*16), b(3*16*16);
+    single.resolve(a.data());
+    threaded.resolve(b.data());
+    double mean = 0;
+    for(float value: a) mean += value/a.size();
+    BT.add(fabs(mean - 1.0) < 0.02, furnace_fail);
+    BT.add(a == b, thread_fail);
+    return BT;
+}
+
+std::vector<Tester> bvhTests(){
+    std::vector<Tester> tests;
+    tests.push_back(bvh_build_tests());
+    tests.push_back(bvh_query_tests());
+    tests.push_back(path_tracer_tests());
+    return tests;
+}
@@ -0,0 +1,175 @@
+#include "../fixedpoint.h"
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+#include "tester.h"
+
+static Fixed16 fx(double d){
+    return Fixed16::fromFloat(d);
+}
+
+/**
+ * Function that handles unittests for fixed point arithmetic
+ * @return Tester object containing the results of the unittests
+ */
+Tester fixed_arithmetic_tests(){
+    std::string test_name = "Fixed point arithmetic";
+    std::string exact_fail = "Products and quotients of dyadic numbers should be exact";
+    std::string round_fail = "Products should round towards negative infinity and quotients towards zero";
+    std::string sqrt_fail = "Square roots should be rounded down";
+    std::string saturate_fail = "Division by zero should saturate";
+    Tester RT = Tester(test_name);
+
+    RT.add(fx(1.5)*fx(2.25) == fx(3.375) && fx(7)/fx(2) == fx(3.5) && fx(-3)/fx(2) == fx(-1.5)
+           && fx(-0.5)*fx(3) == fx(-1.5) && Fixed16::fromInt(-5) + fx(0.25) == fx(-4.75), exact_fail);
+
+    Fixed16 tiny = Fixed16::fromRaw(1), half = fx(0.5);
+    RT.add((tiny*half).getRaw() == 0 && ((-tiny)*half).getRaw() == -1
+           && (Fixed16::fromRaw(-1)/Fixed16::fromInt(2)).getRaw() == 0, round_fail);
+
+    bool roots = sqrt(fx(2)).getRaw() == (int32_t)floor(sqrt(2.0)*65536) && sqrt(fx(9)) == fx(3)
+                 && sqrt(fx(-1)) == Fixed16() && fixedIsqrt<uint64_t>(UINT64_MAX) == 0xffffffffu;
+#ifdef __SIZEOF_INT128__
+    roots = roots && sqrt(Fixed32::fromInt(2)).getRaw() == (int64_t)6074000999ll
+            && Fixed32::fromFloat(1.5)*Fixed32::fromFloat(-2.25) == Fixed32::fromFloat(-3.375);
+#endif
+    RT.add(roots, sqrt_fail);
+
+    RT.add((fx(1)/Fixed16()).getRaw() == INT32_MAX && (fx(-1)/Fixed16()).getRaw() == INT32_MIN, saturate_fail);
+    return RT;
+}
+
+/**
+ * Function that handles unittests for the table driven sine and cosine
+ * @return Tester object containing the results of the unittests
+ */
+Tester fixed_trig_tests(){
+    std::string test_name = "Fixed point trigonometry";
+    std::string accuracy_fail = "Sine and cosine should be within 2e-5 of the exact values";
+    std::string bits_fail = "Sine and cosine should give the same bits on every machine";
+    Tester RT = Tester(test_name);
+
+    double error = 0;
+    for(int i = -2000; i <= 2000; i++){
+        Fixed16 a = Fixed16::fromRaw(i*113);
+        error = fmax(error, fabs(sin(a).toDouble() - ::sin(a.toDouble())));
+        error = fmax(error, fabs(cos(a).toDouble() - ::cos(a.toDouble())));
+    }
+#ifdef __SIZEOF_INT128__
+    for(int i = 0; i <= 1000; i++){
+        Fixed32 a = Fixed32::fromFloat(i*0.01 - 5);
+        error = fmax(error, fabs(sin(a).toDouble() - ::sin(a.toDouble())));
+    }
+#endif
+    RT.add(error < 2e-5, accuracy_fail);
+
+    //golden values: a change here breaks replays and lockstep peers
+    RT.add(fixedSinTurns(0x12345678u) == 463947241 && sin(fx(1)).getRaw() == 55147
+           && cos(fx(-2.5)).getRaw() == -52504 && sin(fx(100)).getRaw() == -33185, bits_fail);
+    return RT;
+}
+
+/**
+ * Function that handles unittests for Vectorx and Matrixx
+ * @return Tester object containing the results of the unittests
+ */
+Tester fixed_vector_tests(){
+    std::string test_name = "Fixed point vectors";
+    std::string products_fail = "Dot and cross products should be exact for integer vectors";
+    std::string normalize_fail = "Normalized vectors should have unit length";
+    std::string rotate_fail = "Rotations about the z axis should agree with the general rotation";
+    std::string layout_fail = "Matrices should be stored and filled by columns, like Matrixf";
+    std::string invert_fail = "A matrix times its inverse should be the identity";
+    Tester RT = Tester(test_name);
+
+    Vectorx<3> x{fx(1), fx(0), fx(0)}, y{fx(0), fx(1), fx(0)}, z{fx(0), fx(0), fx(1)};
+    Vectorx<3> a{fx(1), fx(-2), fx(3)}, b{fx(4), fx(5), fx(-6)};
+    Vectorx<3> ab = a^b;
+    RT.add((x^y)[2] == fx(1) && (x^y)[0] == Fixed16() && a*b == fx(-24)
+           && ab[0] == fx(-3) && ab[1] == fx(18) && ab[2] == fx(13), products_fail);
+
+    Vectorx<3> n = (Vectorx<3>{fx(3), fx(4), fx(0)}).normalize();
+    Vectorx<3> m = b.normalize();
+    RT.add(abs(n[0] - fx(0.6)) <= Fixed16::fromRaw(1) && abs(n[1] - fx(0.8)) <= Fixed16::fromRaw(1)
+           && abs(m.norm() - fx(1)) <= Fixed16::fromRaw(3), normalize_fail);
+
+    Fixed16 angle = fx(0.7);
+    Vectorx<3> r = a.rotate3("z", angle), g = a.gRotate3(z.get(), angle);
+    Vectorx<3> quarter = x.rotate3("z", fx(1.5707963));
+    bool rotated = abs(quarter[0]) <= Fixed16::fromRaw(2) && abs(quarter[1] - fx(1)) <= Fixed16::fromRaw(2);
+    for(int i = 0; i < 3; i++) rotated = rotated && abs(r[i] - g[i]) <= Fixed16::fromRaw(4);
+    RT.add(rotated && r[2] == a[2] && a.reflect3("y")[1] == fx(2), rotate_fail);
+
+    Matrixx<3> M{{fx(2), fx(1), fx(0)},
+                 {fx(0), fx(3), fx(1)},
+                 {fx(1), fx(0), fx(4)}};
+    Matrixx<3> flat{fx(2), fx(1), fx(0), fx(0), fx(3), fx(1), fx(1), fx(0), fx(4)};
+    Vectorx<3> first = M*Vectorx<3>{fx(1), fx(0), fx(0)};
+    bool columns = M.at(0, 2) == fx(1) && M.at(2, 1) == fx(1) && first[0] == fx(2) && first[1] == fx(1);
+    for(size_t i = 0; i < 3; i++){
+        for(size_t j = 0; j < 3; j++) columns = columns && flat.at(i, j) == M.at(i, j);
+    }
+    RT.add(columns, layout_fail);
+    Matrixx<3> I = M*(M^-1), J;
+    bool identity = M.det() == fx(25);
+    for(size_t i = 0; i < 3; i++){
+        for(size_t j = 0; j < 3; j++) identity = identity && abs(I.at(i, j) - J.at(i, j)) <= Fixed16::fromRaw(4);
+    }
+    RT.add(identity, invert_fail);
+    return RT;
+}
+
+/**
+ * Function that handles unittests for the vectorized Q16.16 batch kernels
+ * @return Tester object containing the results of the unittests
+ */
+Tester fixed_batch_tests(){
+    std::string test_name = "Fixed point batch kernels";
+    std::string batch_fail = "Batch kernels should give the same bits as the Vectorx and Matrixx operators";
+    Tester RT = Tester(test_name);
+
+    const size_t count = 103; //not a multiple of 4, to run the tail
+    uint32_t seed = 7;
+    auto random = [&seed](int32_t range){ seed = seed*1664525u + 1013904223u; return (int32_t)(seed >> 1)%range;};
+    std::vector<int32_t> a[3], b[3], c[3], t[3];
+    for(int k = 0; k < 3; k++){
+        a[k].resize(count); b[k].resize(count); c[k].resize(count); t[k].resize(count);
+        for(size_t i = 0; i < count; i++){
+            a[k][i] = random(1 << 24) - (1 << 23); //+-128
+            b[k][i] = random(1 << 20) - (1 << 19);
+        }
+    }
+    b[0][5] = 0; b[1][5] = 0; b[2][5] = 0; //zero vector
+    a[0][6] = INT32_MIN; a[1][6] = INT32_MAX; b[2][6] = INT32_MAX; //full range products
+    std::vector<int32_t> before[3] = {b[0], b[1], b[2]};
+    Matrixx<3> M{{fx(0.8), fx(0.6), fx(1.5)}, {fx(-0.6), fx(0.8), fx(-2)}, {fx(0), fx(0), fx(3)}};
+    std::vector<int32_t> dots(count);
+    fixedDot3(a[0].data(), a[1].data(), a[2].data(), b[0].data(), b[1].data(), b[2].data(), count, dots.data());
+    fixedCross3(a[0].data(), a[1].data(), a[2].data(), b[0].data(), b[1].data(), b[2].data(), count,
+                c[0].data(), c[1].data(), c[2].data());
+    fixedTransform3(M, a[0].data(), a[1].data(), a[2].data(), count, t[0].data(), t[1].data(), t[2].data());
+    fixedNormalize3(b[0].data(), b[1].data(), b[2].data(), count);
+
+    bool same = true;
+    for(size_t i = 0; i < count; i++){
+        Vectorx<3> u{Fixed16::fromRaw(a[0][i]), Fixed16::fromRaw(a[1][i]), Fixed16::fromRaw(a[2][i])};
+        Vectorx<3> v{Fixed16::fromRaw(before[0][i]), Fixed16::fromRaw(before[1][i]), Fixed16::fromRaw(before[2][i])};
+        Vectorx<3> cross = u^v, moved = M*u, unit = v.normalize();
+        same = same && (u*v).getRaw() == dots[i];
+        for(int k = 0; k < 3; k++){
+            same = same && cross[k].getRaw() == c[k][i] && moved[k].getRaw() == t[k][i]
+                   && unit[k].getRaw() == b[k][i];
+        }
+    }
+    RT.add(same, batch_fail);
+    return RT;
+}
+
+std::vector<Tester> fixedPointTests(){
+    std::vector<Tester> tests;
+    tests.push_back(fixed_arithmetic_tests());
+    tests.push_back(fixed_trig_tests());
+    tests.push_back(fixed_vector_tests());
+    tests.push_back(fixed_batch_tests());
+    return tests;
+}
@@ -0,0 +1,82 @@
+#include "../imagewriter.h"
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "tester.h"
+
+static std::string readFile(const std::string& path){
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+/**
+ * Function that handles unittests for the streaming image writer
+ * @return Tester object containing the results of the unittests
+ */
+Tester image_writer_tests(){
+    std::string test_name = "Image writer";
+    std::string order_fail = "Tiles reported out of order should give the same file as writeImage";
+    std::string reject_fail = "Tiles of another size, reported twice or after the image was finished should be ignored";
+    std::string twice_fail = "A tile reported twice should not complete its band before the other tiles";
+    Tester RT = Tester(test_name);
+
+    //3x2 tiles, the last column and row of tiles partial
+    Framebuffer target(20, 12);
+    float gray[3] = {0.2f, 0.3f, 0.4f};
+    target.clear(gray);
+    for(int y = 0; y < 12; y++){
+        for(int x = 0; x < 20; x++){
+            float rgb[3] = {x/19.0f, y/11.0f, 0.5f};
+            if(target.tileAt(x, y) != 4) target.setPixel(x, y, rgb); //tile 4 keeps the clear color
+        }
+    }
+    std::string streamed = "image_writer_streamed.ppm", reference = "image_writer_reference.ppm";
+    ImageWriter writer;
+    bool ok = writer.open(streamed, IMAGE_PPM, 20, 12);
+    int order[6] = {5, 2, 4, 0, 3, 1};
+    for(int tile: order){
+        writer.tileDone(target, tile);
+        if(tile == 4) writer.tileDone(target, 4);
+    }
+    ok = ok && writer.endFrame(target);
+    ok = ok && ImageWriter::writeImage(reference, target, IMAGE_PPM);
+    std::string bytes = readFile(streamed);
+    RT.add(ok && bytes.size() == 13 + 3*20*12 && bytes == readFile(reference), order_fail);
+
+    float white[3] = {1, 1, 1};
+    target.setPixel(0, 0, white);
+    writer.tileDone(target, 0); //after the image was finished
+    Framebuffer other(16, 16);
+    writer.tileDone(other, 0); //reported as a failure by close()
+    bool closed = writer.close();
+    RT.add(!closed && writer.frameCount() == 1 && readFile(streamed) == bytes, reject_fail);
+
+    //tile 0 reported twice while tile 2 of the same band is still being rendered
+    Framebuffer late(20, 12);
+    late.clear(gray);
+    ok = writer.open(streamed, IMAGE_PPM, 20, 12);
+    writer.tileDone(late, 0);
+    writer.tileDone(late, 0);
+    writer.tileDone(late, 1);
+    for(int y = 0; y < 12; y++){
+        for(int x = 0; x < 20; x++){
+            if(late.tileAt(x, y) == 2) late.setPixel(x, y, white);
+        }
+    }
+    writer.tileDone(late, 2);
+    ok = ok && writer.endFrame(late) && writer.close();
+    ok = ok && ImageWriter::writeImage(reference, late, IMAGE_PPM);
+    RT.add(ok && readFile(streamed) == readFile(reference), twice_fail);
+    remove(streamed.c_str());
+    remove(reference.c_str());
+    return RT;
+}
+
+std::vector<Tester> framebufferTests(){
+    std::vector<Tester> tests;
+    tests.push_back(image_writer_tests());
+    return tests;
+}
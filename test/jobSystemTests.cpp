@@ -0,0 +1,283 @@
+#include "../arena.h"
+#include "../jobsystem.h"
+#include "../profiler.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "tester.h"
+
+/**
+ * Function that handles unittests for JobSystem::parallelFor
+ * @return Tester object containing the results of the unittests
+ */
+Tester parallel_for_tests(){
+    std::string test_name = "Job system parallel for";
+    std::string cover_fail = "Every index should be visited exactly once";
+    std::string nested_fail = "Nested parallel for error";
+    std::string empty_fail = "Empty range should not call the body";
+    Tester JT = Tester(test_name);
+    JT.setBudget(0.5);
+
+    JobSystem jobs(4);
+    std::vector<int> visits(100003, 0);
+    jobs.parallelFor(0, visits.size(), [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; i++) visits[i]++;
+    });
+    bool once = true;
+    for(int v: visits) once = once && v == 1;
+    JT.add(once, cover_fail);
+
+    std::atomic<long> total(0);
+    jobs.parallelFor(0, 16, [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; i++){
+            jobs.parallelFor(0, 100, [&](size_t b, size_t e){ total += (long)(e - b);}, 7);
+        }
+    }, 1);
+    JT.add(total == 1600, nested_fail);
+
+    bool called = false;
+    jobs.parallelFor(5, 5, [&](size_t, size_t){ called = true;});
+    JT.add(!called, empty_fail);
+    return JT;
+}
+
+/**
+ * Function that handles unittests for TaskGraph dependencies
+ * @return Tester object containing the results of the unittests
+ */
+Tester task_graph_tests(){
+    std::string test_name = "Task graph";
+    std::string order_fail = "Tasks ran before their dependencies";
+    std::string relaunch_fail = "Graph should run again once done";
+    std::string cycle_fail = "Graph with a cycle should not launch";
+    Tester JT = Tester(test_name);
+
+    JobSystem jobs(4);
+    TaskGraph graph;
+    std::atomic<int> step(0);
+    int order[4];
+    int cull = graph.addTask("cull", [&](){ order[0] = step++;});
+    int transform = graph.addTask("transform", [&](){ order[1] = step++;});
+    int raster = graph.addTask("raster", [&](){ order[2] = step++;});
+    int post = graph.addTask("post", [&](){ order[3] = step++;});
+    graph.addDependency(cull, transform);
+    graph.addDependency(transform, raster);
+    graph.addDependency(raster, post);
+
+    bool ok = graph.run(jobs);
+    JT.add(ok && order[0] == 0 && order[1] == 1 && order[2] == 2 && order[3] == 3, order_fail);
+    step = 0;
+    ok = graph.run(jobs);
+    JT.add(ok && graph.isDone() && order[3] == 3, relaunch_fail);
+
+    graph.addDependency(post, cull);
+    JT.add(!graph.run(jobs), cycle_fail);
+    return JT;
+}
+
+/**
+ * Function that handles unittests for the FrameArena
+ * @return Tester object containing the results of the unittests
+ */
+Tester frame_arena_tests(){
+    std::string test_name = "Frame arena";
+    std::string align_fail = "Allocations should honour their alignment";
+    std::string reuse_fail = "A reset should hand out the same memory again without growing";
+    std::string growth_fail = "Frames overflowing a block should be merged into one block at reset";
+    std::string threads_fail = "resetAll should reset the arena of every thread";
+    Tester JT = Tester(test_name);
+
+    FrameArena arena(256);
+    bool aligned = true;
+    for(size_t alignment = 1; alignment <= 64; alignment *= 2){
+        arena.allocate(3);
+        aligned = aligned && (uintptr_t)arena.allocate(5, alignment)%alignment == 0;
+    }
+    aligned = aligned && (uintptr_t)arena.allocateArray<double>(3)%alignof(double) == 0;
+    JT.add(aligned, align_fail);
+
+    arena.reset();
+    char* first = (char*)arena.allocate(100);
+    size_t capacity = arena.capacity();
+    arena.reset();
+    JT.add(arena.bytesUsed() == 0 && (char*)arena.allocate(100) == first && arena.capacity() == capacity, reuse_fail);
+
+    arena.reset();
+    for(int i = 0; i < 10; i++) arena.allocate(200, 1); //one block each
+    size_t used = arena.bytesUsed();
+    bool grown = arena.capacity() >= 10*200 && used == 10*200;
+    arena.reset();
+    grown = grown && arena.peakBytes() == used && arena.capacity() >= used;
+    char* block = (char*)arena.allocate(1, 1);
+    for(int i = 0; i < 9; i++) arena.allocate(200, 1);
+    grown = grown && (char*)arena.allocate(199, 1) == block + 1 + 9*200; //still the one merged block
+    JT.add(grown, growth_fail);
+
+    JobSystem jobs(4);
+    std::atomic<size_t> used_by_jobs(0);
+    jobs.parallelFor(0, 64, [&](size_t begin, size_t end){
+        FrameArena& local = FrameArena::forThread();
+        for(size_t i = begin; i < end; i++) local.allocateArray<float>(16);
+        used_by_jobs += local.bytesUsed() > 0;
+    }, 1);
+    FrameArena::forThread().allocate(8);
+    FrameArena::resetAll();
+    std::atomic<size_t> leftover(0);
+    jobs.parallelFor(0, 64, [&](size_t, size_t){
+        leftover += FrameArena::forThread().bytesUsed();
+    }, 1);
+    JT.add(used_by_jobs > 0 && leftover == 0 && FrameArena::forThread().bytesUsed() == 0, threads_fail);
+    return JT;
+}
+
+/**
+ * Check that text[at...] starts with one well-formed JSON value and move past it
+ */
+static bool skipJsonValue(const std::string& text, size_t& at){
+    auto skipSpace = [&](){ while(at < text.size() && strchr(" \t\r\n", text[at])) at++;};
+    skipSpace();
+    if(at >= text.size()) return false;
+    char c = text[at];
+    if(c == '{' || c == '['){
+        char close = c == '{'? '}': ']';
+        at++;
+        skipSpace();
+        if(at < text.size() && text[at] == close){ at++; return true;}
+        while(true){
+            if(c == '{'){
+                skipSpace();
+                if(at >= text.size() || text[at] != '"' || !skipJsonValue(text, at)) return false;
+                skipSpace();
+                if(at >= text.size() || text[at++] != ':') return false;
+            }
+            if(!skipJsonValue(text, at)) return false;
+            skipSpace();
+            if(at >= text.size()) return false;
+            if(text[at] == close){ at++; return true;}
+            if(text[at++] != ',') return false;
+        }
+    }
+    if(c == '"'){
+        for(at++; at < text.size() && text[at] != '"'; at++){
+            if((unsigned char)text[at] < 0x20) return false;
+            if(text[at] == '\\') at++;
+        }
+        return at++ < text.size();
+    }
+    for(const char* word: {"true", "false", "null"}){
+        if(text.compare(at, strlen(word), word) == 0){ at += strlen(word); return true;}
+    }
+    char* end;
+    strtod(text.c_str() + at, &end);
+    if(end == text.c_str() + at) return false;
+    at = end - text.c_str();
+    return true;
+}
+
+static bool isJson(const std::string& text){
+    size_t at = 0;
+    if(!skipJsonValue(text, at)) return false;
+    while(at < text.size() && strchr(" \t\r\n", text[at])) at++;
+    return at == text.size();
+}
+
+/**
+ * Function that handles unittests for the profiler rings and trace export
+ * @return Tester object containing the results of the unittests
+ */
+Tester profiler_tests(){
+    std::string test_name = "Profiler";
+    std::string wrap_fail = "A full ring should keep only the newest events";
+    std::string json_fail = "Exported trace should be well-formed JSON";
+    std::string nesting_fail = "Every zone should end after it begins, nested zones inside their parent";
+    std::string reuse_fail = "Threads that ran one after the other should share a ring and keep their events";
+    std::string nan_fail = "Counters that are not finite should be exported as null";
+    Tester JT = Tester(test_name);
+    std::string path = "profiler_trace.json";
+
+    //one thread overfills its ring: the first 10 zones are overwritten
+    bool was_enabled = Profiler::isEnabled();
+    Profiler::setEnabled(true);
+    Profiler::clear();
+    std::thread([](){
+        for(uint64_t i = 0; i < PROFILER_RING_SIZE + 10; i++) Profiler::zone("wrap", 1000*i, 1000*i + 500);
+    }).join();
+    bool exported = Profiler::exportChromeTrace(path);
+    std::ifstream in(path);
+    std::string line;
+    std::vector<double> starts;
+    while(std::getline(in, line)){
+        size_t ts = line.find("\"ts\":");
+        if(ts != std::string::npos) starts.push_back(atof(line.c_str() + ts + 5));
+    }
+    bool newest = exported && Profiler::eventCount() == PROFILER_RING_SIZE && starts.size() == PROFILER_RING_SIZE;
+    for(size_t i = 0; newest && i < starts.size(); i++) newest = starts[i] == (double)(i + 10);
+    JT.add(newest, wrap_fail);
+
+    //nested zones, a counter, a frame mark and a name that needs escaping
+    Profiler::clear();
+    std::thread([](){
+        ProfileZone outer("outer \"zone\"");
+        { ProfileZone first("first"); Profiler::counter("count", 0.5);}
+        { ProfileZone second("second"); Profiler::frameMark();}
+    }).join();
+    exported = Profiler::exportChromeTrace(path);
+    std::ifstream trace(path);
+    std::stringstream text;
+    text << trace.rdbuf();
+    JT.add(exported && isJson(text.str()), json_fail);
+
+    std::vector<std::pair<double, double>> zones; //[begin, end] in export order: first, second, outer
+    text.seekg(0);
+    while(std::getline(text, line)){
+        size_t ts = line.find("\"ts\":"), dur = line.find("\"dur\":");
+        if(dur == std::string::npos) continue;
+        double begin = atof(line.c_str() + ts + 5);
+        zones.push_back({begin, begin + atof(line.c_str() + dur + 6)});
+    }
+    bool nested = zones.size() == 3;
+    for(size_t z = 0; nested && z < 3; z++) nested = zones[z].first <= zones[z].second;
+    nested = nested && zones[2].first <= zones[0].first && zones[0].second <= zones[1].first
+             && zones[1].second <= zones[2].second;
+    JT.add(nested, nesting_fail);
+
+    //short lived threads hand their ring on, the events stay until exported
+    Profiler::clear();
+    size_t ring_count = Profiler::ringCount();
+    for(int t = 0; t < 100; t++) std::thread([](){ Profiler::zone("short", 1000, 2000);}).join();
+    JT.add(Profiler::ringCount() <= ring_count + 1 && Profiler::eventCount() == 100, reuse_fail);
+
+    Profiler::clear();
+    std::thread([](){
+        Profiler::counter("nan", NAN);
+        Profiler::counter("inf", -INFINITY);
+    }).join();
+    exported = Profiler::exportChromeTrace(path);
+    std::ifstream counters(path);
+    std::stringstream counter_text;
+    counter_text << counters.rdbuf();
+    std::string json = counter_text.str();
+    size_t nulls = 0; //isJson would take nan and inf, strtod reads them
+    for(size_t at = json.find("\"value\":null"); at != std::string::npos; at = json.find("\"value\":null", at + 1)) nulls++;
+    JT.add(exported && isJson(json) && nulls == 2, nan_fail);
+    Profiler::clear();
+    Profiler::setEnabled(was_enabled);
+    remove(path.c_str());
+    return JT;
+}
+
+std::vector<Tester> jobSystemTests(){
+    std::vector<Tester> tests;
+    tests.push_back(parallel_for_tests());
+    tests.push_back(task_graph_tests());
+    tests.push_back(frame_arena_tests());
+    tests.push_back(profiler_tests());
+    return tests;
+}
@@ -0,0 +1,45 @@
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "tester.h"
+
+std::vector<Tester> vectorTests();
+std::vector<Tester> bvhTests();
+std::vector<Tester> meshLoaderTests();
+std::vector<Tester> projectionTests();
+std::vector<Tester> jobSystemTests();
+std::vector<Tester> framebufferTests();
+std::vector<Tester> rasterizerTests();
+std::vector<Tester> animationTests();
+std::vector<Tester> physicsTests();
+std::vector<Tester> fixedPointTests();
+std::vector<Tester> meshOptimizerTests();
+
+/**
+ * Unittest executable
+ * usage: tester [--threads n] [--perf]
+ * --perf enables the perf assertions failing tests that exceed their time budget
+ */
+int main(int argc, char** argv){
+    unsigned threads = 0;
+    bool perf = false;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = (unsigned)atoi(argv[++i]);
+        else if(strcmp(argv[i], "--perf") == 0) perf = true;
+        else std::cout << "Warning: unknown option " << argv[i] << "\n";
+    }
+    TestRunner runner(threads);
+    runner.setPerfAssertions(perf);
+    runner.add("Vector", vectorTests);
+    runner.add("BVH", bvhTests);
+    runner.add("Mesh loader", meshLoaderTests);
+    runner.add("Projection", projectionTests);
+    runner.add("Job system", jobSystemTests);
+    runner.add("Framebuffer", framebufferTests);
+    runner.add("Rasterizer", rasterizerTests);
+    runner.add("Animation", animationTests);
+    runner.add("Physics", physicsTests);
+    runner.add("Fixed point", fixedPointTests);
+    runner.add("Mesh optimizer", meshOptimizerTests);
+    return runner.run()? 0: 1;
+}
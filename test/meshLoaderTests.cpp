@@ -0,0 +1,266 @@
+#include "../meshcache.h"
+#include "../meshloader.h"
+#include <cstdio>
+#include <fstream>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+#include "tester.h"
+
+/**
+ * Function that handles OBJ parser unittests
+ * @return Tester object containing the results of the unittests
+ */
+Tester obj_loader_tests(){
+    std::string test_name = "OBJ loader";
+    std::string parse_fail = "OBJ parse error";
+    std::string tri_fail = "OBJ polygon triangulation error";
+    std::string index_fail = "OBJ out of range index should be rejected";
+    std::string overflow_fail = "OBJ index too large for a long long should be rejected";
+    Tester LT = Tester(test_name);
+
+    std::string obj = "# quad and a triangle with relative indices\n"
+                      "v 0 0 0\nv 1.5 0 0\r\nv 1 1e1 -2.5E-1\nv 0 1 0\n"
+                      "vt 0 0\n"
+                      "f 1/1 2/1 3/1 4/1\nf -1 -2 -3\n";
+    Mesh mesh;
+    bool ok = parseOBJ(obj.data(), obj.size(), mesh, 2);
+    LT.add(ok && mesh.vertexCount() == 4 && !mesh.hasNormals(), parse_fail);
+    LT.add(mesh.px[1] == 1.5f && mesh.py[2] == 10.0f && mesh.pz[2] == -0.25f, parse_fail);
+    std::vector<uint32_t> expected{0, 1, 2, 0, 2, 3, 3, 2, 1};
+    LT.add(mesh.indices == expected, tri_fail);
+
+    std::string bad = "v 0 0 0\nf 1 2 3\n";
+    LT.add(!parseOBJ(bad.data(), bad.size(), mesh, 1) && mesh.vertexCount() == 0, index_fail);
+
+    std::string huge = "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 18446744073709551617\n"; //2^64 + 1 wraps to 1
+    LT.add(!parseOBJ(huge.data(), huge.size(), mesh, 1) && mesh.vertexCount() == 0, overflow_fail);
+    return LT;
+}
+
+/**
+ * Function that handles PLY parser unittests for ascii and binary bodies
+ * @return Tester object containing the results of the unittests
+ */
+Tester ply_loader_tests(){
+    std::string test_name = "PLY loader";
+    std::string ascii_fail = "Ascii PLY parse error";
+    std::string binary_fail = "Binary PLY parse error";
+    std::string truncated_fail = "Truncated binary PLY bodies should be rejected";
+    std::string count_fail = "Element counts and list lengths larger than the data should be rejected";
+    Tester LT = Tester(test_name);
+
+    std::string ply = "ply\nformat ascii 1.0\n"
+                      "element vertex 4\nproperty float x\nproperty float y\nproperty float z\nproperty uchar red\n"
+                      "element face 2\nproperty uchar flags\nproperty list uchar int vertex_indices\n"
+                      "end_header\n"
+                      "0 0 0 1\n1 0 0 2\n1 1 0 3\n0 1 0 4\n"
+                      "7 4 0 1 2 3\n1 3 3 2 1\n";
+    Mesh mesh;
+    bool ok = parsePLY(ply.data(), ply.size(), mesh, 2);
+    std::vector<uint32_t> expected{0, 1, 2, 0, 2, 3, 3, 2, 1};
+    LT.add(ok && mesh.vertexCount() == 4 && mesh.indices == expected && mesh.px[2] == 1.0f, ascii_fail);
+
+    std::string bin = "ply\nformat binary_little_endian 1.0\n"
+                      "element vertex 3\nproperty float x\nproperty float y\nproperty float z\n"
+                      "element face 1\nproperty list uchar uint vertex_indices\nend_header\n";
+    float positions[9]{0, 0, 0, 1, 2, -1, 2, 4, -2};
+    uint32_t face[3]{0, 1, 2};
+    bin.append((const char*)positions, sizeof(positions)); // assumes a little endian host
+    bin.push_back(3);
+    bin.append((const char*)face, sizeof(face));
+    ok = parsePLY(bin.data(), bin.size(), mesh, 2);
+    LT.add(ok && mesh.vertexCount() == 3 && mesh.triangleCount() == 1 && mesh.py[2] == 4.0f, binary_fail);
+
+    //every cut of the body, including inside the list count and the list itself, is rejected
+    std::string wide = bin.substr(0, bin.size() - sizeof(face) - 1);
+    wide.replace(wide.find("list uchar"), 10, "list int");
+    int32_t corners = 3;
+    wide.append((const char*)&corners, sizeof(corners));
+    wide.append((const char*)face, sizeof(face));
+    bool rejected = true;
+    for(const std::string& full: {bin, wide}){
+        size_t body = full.find("end_header\n") + 11;
+        for(size_t cut = body; cut < full.size(); cut++){
+            std::vector<char> truncated(full.begin(), full.begin() + cut); //exact size, so sanitizers catch reads past it
+            rejected = rejected && !parsePLY(truncated.data(), truncated.size(), mesh, 2);
+        }
+    }
+    LT.add(rejected && parsePLY(wide.data(), wide.size(), mesh, 2) && mesh.triangleCount() == 1, truncated_fail);
+
+    //would allocate terabytes before reading the body if the counts were trusted
+    std::string many = bin;
+    many.replace(many.find("vertex 3"), 8, "vertex 100000000000");
+    std::string ascii_many = ply;
+    ascii_many.replace(ascii_many.find("vertex 4"), 8, "vertex 100000000000");
+    std::string long_face = ply;
+    long_face.replace(long_face.find("7 4 0 1 2 3"), 11, "7 1000000000000 0 1 2 3");
+    std::string negative_face = ply;
+    negative_face.replace(negative_face.find("7 4 0 1 2 3"), 11, "7 -4 0 1 2 3");
+    rejected = true;
+    for(const std::string& bad: {many, ascii_many, long_face, negative_face}){
+        rejected = rejected && !parsePLY(bad.data(), bad.size(), mesh, 2) && mesh.vertexCount() == 0;
+    }
+    LT.add(rejected, count_fail);
+    return LT;
+}
+
+/**
+ * Function that handles unittests for files large enough to be split in chunks parsed by several threads
+ * @return Tester object containing the results of the unittests
+ */
+Tester parallel_loader_tests(){
+    std::string test_name = "Parallel mesh loading";
+    std::string obj_fail = "Chunked OBJ parse should match the single threaded parse";
+    std::string ply_fail = "Chunked binary PLY parse should match the single threaded parse";
+    Tester LT = Tester(test_name);
+
+    //a 300x300 grid of quads is over 3 MB of OBJ text
+    const int size = 300;
+    std::string obj;
+    for(int y = 0; y <= size; y++){
+        for(int x = 0; x <= size; x++) obj += "v " + std::to_string(x) + " " + std::to_string(y) + " 0.5\n";
+    }
+    for(int y = 0; y < size; y++){
+        for(int x = 0; x < size; x++){
+            int v = (size + 1)*y + x + 1;
+            obj += "f " + std::to_string(v) + " " + std::to_string(v + 1) + " " + std::to_string(v + size + 2)
+                   + " " + std::to_string(v + size + 1) + "\n";
+        }
+    }
+    Mesh single, chunked;
+    bool ok = obj.size() > (3 << 20) && parseOBJ(obj.data(), obj.size(), single, 1)
+              && parseOBJ(obj.data(), obj.size(), chunked, 4);
+    LT.add(ok && chunked.triangleCount() == 2*size*size && chunked.indices == single.indices
+           && chunked.px == single.px && chunked.py == single.py && chunked.pz == single.pz, obj_fail);
+
+    size_t vertex_count = (size + 1)*(size + 1);
+    std::string ply = "ply\nformat binary_little_endian 1.0\nelement vertex " + std::to_string(vertex_count)
+                      + "\nproperty float x\nproperty float y\nproperty float z\n"
+                        "element face " + std::to_string(size*size)
+                      + "\nproperty list uchar uint vertex_indices\nend_header\n";
+    for(size_t v = 0; v < vertex_count; v++){
+        float position[3] = {single.px[v], single.py[v], single.pz[v]};
+        ply.append((const char*)position, sizeof(position)); // assumes a little endian host
+    }
+    for(size_t t = 0; t < single.indices.size(); t += 6){
+        uint32_t quad[4] = {single.indices[t], single.indices[t + 1], single.indices[t + 2], single.indices[t + 5]};
+        ply.push_back(4);
+        ply.append((const char*)quad, sizeof(quad));
+    }
+    ok = parsePLY(ply.data(), ply.size(), chunked, 4);
+    LT.add(ok && 12*vertex_count > (1 << 20) && chunked.indices == single.indices
+           && chunked.px == single.px && chunked.py == single.py && chunked.pz == single.pz, ply_fail);
+    return LT;
+}
+
+/**
+ * Function that handles mesh cache unittests: round trips, invalidation and corrupt files
+ * @return Tester object containing the results of the unittests
+ */
+Tester mesh_cache_tests(){
+    std::string test_name = "Mesh cache";
+    std::string round_fail = "Cached mesh and BVH should match the source mesh";
+    std::string reuse_fail = "A cache matching the source should be used without reparsing";
+    std::string size_fail = "A source size change should rebuild the cache";
+    std::string mtime_fail = "A source modification time change should rebuild the cache";
+    std::string nanosecond_fail = "A source rewritten within the same second should rebuild the cache";
+    std::string corrupt_fail = "Caches with out of range indices or children in the padding node should be rejected";
+    Tester LT = Tester(test_name);
+
+    std::string source = "mesh_cache_source.obj", cache_path = "mesh_cache_source.ge3dmesh";
+    std::string obj;
+    for(int y = 0; y < 5; y++){ //4x4 quads in the z = 0 plane
+        for(int x = 0; x < 5; x++) obj += "v " + std::to_string(x) + " " + std::to_string(y) + " 0\n";
+    }
+    for(int y = 0; y < 4; y++){
+        for(int x = 0; x < 4; x++){
+            int v = 5*y + x + 1;
+            obj += "f " + std::to_string(v) + " " + std::to_string(v + 1) + " " + std::to_string(v + 6)
+                   + " " + std::to_string(v + 5) + "\n";
+        }
+    }
+    std::ofstream(source, std::ios::binary) << obj;
+    Mesh mesh;
+    parseOBJ(obj.data(), obj.size(), mesh, 1);
+
+    MeshCache cache;
+    bool ok = cache.load(source, cache_path);
+    bool same = ok && cache.vertexCount() == mesh.vertexCount() && cache.triangleCount() == mesh.triangleCount();
+    for(size_t v = 0; same && v < mesh.vertexCount(); v++){
+        same = cache.getStream(CACHE_PX)[v] == mesh.px[v] && cache.getStream(CACHE_PY)[v] == mesh.py[v];
+    }
+    for(size_t i = 0; same && i < mesh.indices.size(); i++) same = cache.getIndices()[i] == mesh.indices[i];
+    float origin[3] = {2.5f, 1.25f, 1}, down[3] = {0, 0, -1};
+    Hit hit;
+    same = same && cache.getBVH().intersect(Ray(origin, down, 10), hit) && hit.t == 1.0f
+           && hit.triangle/2 == 6; //quad (2, 1)
+    LT.add(same, round_fail);
+
+    //swap in a different mesh under the source's stamp: a load that does not reparse keeps it
+    uint64_t source_size;
+    int64_t source_mtime;
+    statFile(source, source_size, source_mtime);
+    Mesh quad;
+    parseOBJ(obj.data(), obj.find("f "), quad, 1);
+    quad.indices = {0, 1, 6, 0, 6, 5};
+    BVH quad_bvh;
+    quad_bvh.build(quad.px.data(), quad.py.data(), quad.pz.data(), quad.indices.data(), quad.triangleCount());
+    cache.close();
+    MeshCache::write(cache_path, quad, quad_bvh, source_size, source_mtime);
+    LT.add(cache.load(source, cache_path) && cache.triangleCount() == 2, reuse_fail);
+
+    MeshCache::write(cache_path, quad, quad_bvh, source_size, source_mtime - 1);
+    LT.add(cache.load(source, cache_path) && cache.triangleCount() == mesh.triangleCount(), mtime_fail);
+
+#ifndef _WIN32
+    //same size, same second, another nanosecond
+    struct timespec stamps[2] = {{1700000000, 100}, {1700000000, 100}};
+    utimensat(AT_FDCWD, source.c_str(), stamps, 0);
+    statFile(source, source_size, source_mtime);
+    MeshCache::write(cache_path, quad, quad_bvh, source_size, source_mtime);
+    stamps[0].tv_nsec = stamps[1].tv_nsec = 200;
+    utimensat(AT_FDCWD, source.c_str(), stamps, 0);
+    LT.add(cache.load(source, cache_path) && cache.triangleCount() == mesh.triangleCount(), nanosecond_fail);
+    statFile(source, source_size, source_mtime);
+#endif
+
+    MeshCache::write(cache_path, quad, quad_bvh, source_size, source_mtime);
+    std::ofstream(source, std::ios::binary | std::ios::app) << "f 1 2 3\n";
+    LT.add(cache.load(source, cache_path) && cache.triangleCount() == mesh.triangleCount() + 1, size_fail);
+
+    //point one index past the vertices, the root's children past the nodes, then at the padding node
+    BVH mesh_bvh;
+    mesh_bvh.build(mesh.px.data(), mesh.py.data(), mesh.pz.data(), mesh.indices.data(), mesh.triangleCount());
+    MeshCache::write(cache_path, mesh, mesh_bvh, 0, 0);
+    cache.open(cache_path);
+    MeshCacheHeader header = cache.getHeader();
+    cache.close();
+    uint64_t root = header.offset[CACHE_BVH_NODES] + 12;
+    uint64_t patches[3] = {header.offset[CACHE_INDICES] + 4, root, root};
+    uint32_t values[3] = {(uint32_t)header.vertex_count, (uint32_t)header.node_count, 1};
+    bool rejected = true;
+    for(int p = 0; p < 3; p++){
+        MeshCache::write(cache_path, mesh, mesh_bvh, 0, 0);
+        std::fstream file(cache_path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(patches[p]);
+        file.write((const char*)&values[p], sizeof(values[p]));
+        file.close();
+        rejected = rejected && !cache.open(cache_path);
+    }
+    LT.add(rejected, corrupt_fail);
+    remove(source.c_str());
+    remove(cache_path.c_str());
+    return LT;
+}
+
+std::vector<Tester> meshLoaderTests(){
+    std::vector<Tester> tests;
+    tests.push_back(obj_loader_tests());
+    tests.push_back(ply_loader_tests());
+    tests.push_back(parallel_loader_tests());
+    tests.push_back(mesh_cache_tests());
+    return tests;
+}
@@ -0,0 +1,153 @@
+#include "../meshoptimizer.h"
+#include "../simplify.h"
+#include <algorithm>
+#include <math.h>
+#include <vector>
+#include "tester.h"
+
+/**
+ * Index buffer of a size x size grid of quads, 2 triangles per quad, in scanline order
+ */
+static std::vector<uint32_t> gridIndices(uint32_t size){
+    std::vector<uint32_t> indices;
+    for(uint32_t y = 0; y < size; y++){
+        for(uint32_t x = 0; x < size; x++){
+            uint32_t v = y*(size + 1) + x;
+            uint32_t quad[6] = {v, v + 1, v + size + 1, v + 1, v + size + 2, v + size + 1};
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+    return indices;
+}
+
+/**
+ * Function that handles unittests for the vertex cache analyzer and optimizer
+ * @return Tester object containing the results of the unittests
+ */
+Tester vertex_cache_tests(){
+    std::string test_name = "Vertex cache";
+    std::string strip_fail = "A strip should transform every vertex once with a cache of 2";
+    std::string optimize_fail = "Optimizing should never raise the ACMR of a shuffled grid";
+    std::string triangles_fail = "Optimizing should keep the same triangles";
+    Tester OT = Tester(test_name);
+
+    //strip of 10 triangles over 12 vertices: each triangle reuses the last 2 vertices
+    std::vector<uint32_t> strip;
+    for(uint32_t t = 0; t < 10; t++){
+        if(t%2 == 0){ strip.push_back(t); strip.push_back(t + 1);}
+        else{ strip.push_back(t + 1); strip.push_back(t);}
+        strip.push_back(t + 2);
+    }
+    VertexCacheStats stats = analyzeVertexCache(strip.data(), strip.size(), 12, 2);
+    OT.add(stats.transforms == 12 && stats.vertices == 12 && stats.acmr == 1.2f && stats.atvr == 1.0f, strip_fail);
+
+    uint32_t size = 24, vertex_count = (size + 1)*(size + 1);
+    std::vector<uint32_t> grid = gridIndices(size);
+    uint32_t seed = 11;
+    for(size_t t = grid.size()/3 - 1; t > 0; t--){ //shuffle the triangles
+        seed = seed*1664525u + 1013904223u;
+        size_t other = (seed >> 8)%(t + 1);
+        for(int c = 0; c < 3; c++) std::swap(grid[3*t + c], grid[3*other + c]);
+    }
+    bool never_worse = true, same_triangles = true;
+    unsigned cache_sizes[4] = {4, 8, 16, 32};
+    for(unsigned cache_size: cache_sizes){
+        std::vector<uint32_t> optimized = grid;
+        optimizeVertexCache(optimized.data(), optimized.size(), vertex_count, cache_size);
+        float before = analyzeVertexCache(grid.data(), grid.size(), vertex_count, cache_size).acmr;
+        float after = analyzeVertexCache(optimized.data(), optimized.size(), vertex_count, cache_size).acmr;
+        never_worse = never_worse && after <= before;
+        std::vector<size_t> uses(vertex_count, 0), optimized_uses(vertex_count, 0);
+        for(uint32_t v: grid) uses[v]++;
+        for(uint32_t v: optimized) optimized_uses[v]++;
+        same_triangles = same_triangles && optimized.size() == grid.size() && uses == optimized_uses;
+    }
+    OT.add(never_worse, optimize_fail);
+    OT.add(same_triangles, triangles_fail);
+    return OT;
+}
+
+/**
+ * Function that handles unittests for quadric simplification and LOD selection
+ * @return Tester object containing the results of the unittests
+ */
+Tester simplify_tests(){
+    std::string test_name = "Simplification";
+    std::string flat_fail = "A flat grid should simplify to 2 triangles with no error";
+    std::string bound_fail = "Every removed vertex should have a survivor within the error of its face planes";
+    std::string chain_fail = "Coarser levels should have fewer triangles and larger errors";
+    std::string select_fail = "LOD selection should get coarser with distance";
+    std::string behind_fail = "Objects behind the camera should get the coarsest level";
+    Tester ST = Tester(test_name);
+
+    uint32_t size = 16, vertex_count = (size + 1)*(size + 1);
+    Mesh flat, bumpy;
+    flat.resizeVertices(vertex_count, false);
+    bumpy.resizeVertices(vertex_count, false);
+    for(uint32_t v = 0; v < vertex_count; v++){
+        float x = (float)(v%(size + 1))/size, y = (float)(v/(size + 1))/size;
+        flat.px[v] = bumpy.px[v] = x;
+        flat.py[v] = bumpy.py[v] = y;
+        flat.pz[v] = 0;
+        bumpy.pz[v] = 0.05f*sinf(3*x)*cosf(2*y);
+    }
+    flat.indices = bumpy.indices = gridIndices(size);
+
+    std::vector<uint32_t> indices;
+    float error = 1;
+    size_t left = simplifyMesh(flat, 2, indices, &error);
+    ST.add(left == 2 && error < 1e-4f, flat_fail);
+
+    simplifyMesh(bumpy, 60, indices, &error);
+    std::vector<bool> survives(vertex_count, false);
+    for(uint32_t v: indices) survives[v] = true;
+    bool bounded = error > 0;
+    for(uint32_t u = 0; u < vertex_count && bounded; u++){
+        if(survives[u]) continue;
+        float closest = 1e9f;
+        for(uint32_t w = 0; w < vertex_count; w++){
+            if(!survives[w]) continue;
+            float farthest = 0; //distance from w to the planes of the source faces around u
+            for(size_t t = 0; t < bumpy.indices.size(); t += 3){
+                const uint32_t* f = &bumpy.indices[t];
+                if(f[0] != u && f[1] != u && f[2] != u) continue;
+                float e1[3] = {bumpy.px[f[1]] - bumpy.px[f[0]], bumpy.py[f[1]] - bumpy.py[f[0]], bumpy.pz[f[1]] - bumpy.pz[f[0]]};
+                float e2[3] = {bumpy.px[f[2]] - bumpy.px[f[0]], bumpy.py[f[2]] - bumpy.py[f[0]], bumpy.pz[f[2]] - bumpy.pz[f[0]]};
+                float n[3] = {e1[1]*e2[2] - e1[2]*e2[1], e1[2]*e2[0] - e1[0]*e2[2], e1[0]*e2[1] - e1[1]*e2[0]};
+                float length = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+                float distance = (n[0]*(bumpy.px[w] - bumpy.px[f[0]]) + n[1]*(bumpy.py[w] - bumpy.py[f[0]])
+                                  + n[2]*(bumpy.pz[w] - bumpy.pz[f[0]]))/length;
+                farthest = std::max(farthest, fabsf(distance));
+            }
+            closest = std::min(closest, farthest);
+        }
+        bounded = closest <= error*1.001f + 1e-5f;
+    }
+    ST.add(bounded, bound_fail);
+
+    LodChain chain = buildLodChain(bumpy, 4, 0.5f, 32);
+    bool ordered = chain.levels.size() == 4 && chain.levels[0].error == 0;
+    for(size_t l = 1; l < chain.levels.size(); l++){
+        ordered = ordered && chain.levels[l].indices.size() < chain.levels[l - 1].indices.size()
+                  && chain.levels[l].error >= chain.levels[l - 1].error;
+    }
+    ST.add(ordered, chain_fail);
+
+    Camera camera;
+    float eye[3] = {0, 0, 0}, target[3] = {0, 0, -1}, up[3] = {0, 1, 0};
+    camera.lookAt(eye, target, up);
+    camera.setPerspective(1.0f, 1.0f, 0.1f, 1000.0f);
+    float near_center[3] = {0, 0, -1.5f}, far_center[3] = {0, 0, -500}, behind[3] = {0, 0, 5};
+    int near_level = selectLod(chain, camera, near_center, 0.75f, 1080);
+    int far_level = selectLod(chain, camera, far_center, 0.75f, 1080);
+    ST.add(near_level < far_level && far_level == 3, select_fail);
+    ST.add(selectLod(chain, camera, behind, 0.75f, 1080) == 3, behind_fail);
+    return ST;
+}
+
+std::vector<Tester> meshOptimizerTests(){
+    std::vector<Tester> tests;
+    tests.push_back(vertex_cache_tests());
+    tests.push_back(simplify_tests());
+    return tests;
+}
@@ -0,0 +1,323 @@
+#include "../broadphase.h"
+#include "../narrowphase.h"
+#include "../physics.h"
+#include <algorithm>
+#include <math.h>
+#include <vector>
+#include "tester.h"
+
+/**
+ * Function that handles unittests for the rigid body integrator
+ * @return Tester object containing the results of the unittests
+ */
+Tester integrator_tests(){
+    std::string test_name = "Rigid body integrator";
+    std::string fall_fail = "Free fall should follow semi-implicit Euler";
+    std::string static_fail = "Static body should not fall";
+    std::string spin_fail = "Half a second at pi rad/s should be a quarter turn";
+    std::string torque_fail = "Torque should accelerate the spin by the inverse inertia";
+    std::string island_fail = "Linked dynamic bodies should share islands, static bodies should not";
+    std::string handle_fail = "Handles should keep their body when islands move the slots";
+    std::string jobs_fail = "Integration on the job system should match one thread";
+    std::string fixed_fail = "Fixed timestep should take whole steps and cap them";
+    Tester PT = Tester(test_name);
+    PT.setBudget(0.5);
+
+    JobSystem jobs(3);
+    PhysicsWorld world(jobs);
+    float origin[3] = {0, 0, 0}, inertia[3] = {2, 2, 2}, none[3] = {0, 0, 0};
+    int falling = world.addBody(origin, 1.0f, inertia);
+    int ground = world.addBody(origin, 0.0f, inertia);
+    int spinning = world.addBody(origin, 1.0f, inertia);
+    float spin[3] = {0, 0, 3.14159265f};
+    world.setVelocity(spinning, none, spin);
+    float dt = 1/600.0f;
+    for(int s = 0; s < 600; s++) world.step(dt);
+    float p[3], q[4], v[3], w[3];
+    world.getPosition(falling, p);
+    world.getVelocity(falling, v, w);
+    //y = -g dt^2 (1 + 2 + ... + n)
+    float expected = -9.81f*dt*dt*600*601/2;
+    PT.add(fabsf(p[1] - expected) < 1e-3f && fabsf(v[1] + 9.81f) < 1e-3f, fall_fail);
+    world.getPosition(ground, p);
+    PT.add(p[0] == 0 && p[1] == 0 && p[2] == 0, static_fail);
+
+    PhysicsWorld turning(jobs);
+    spinning = turning.addBody(origin, 1.0f, inertia);
+    turning.setVelocity(spinning, none, spin);
+    for(int s = 0; s < 300; s++) turning.step(dt);
+    turning.getOrientation(spinning, q);
+    PT.add(fabsf(q[2] - sinf(0.25f*3.14159265f)) < 1e-3f && fabsf(q[3] - cosf(0.25f*3.14159265f)) < 1e-3f,
+           spin_fail);
+    int driven = turning.addBody(origin, 1.0f, inertia);
+    float torque[3] = {0, 4, 0};
+    for(int s = 0; s < 300; s++){
+        turning.applyTorque(driven, torque);
+        turning.step(dt);
+    }
+    turning.getVelocity(driven, v, w);
+    PT.add(fabsf(w[1] - 1) < 1e-4f && fabsf(w[0]) < 1e-6f, torque_fail);
+
+    PhysicsWorld linked(jobs);
+    for(int b = 0; b < 10; b++){
+        float position[3] = {(float)b, 0, 0};
+        linked.addBody(position, b == 9? 0.0f: 1.0f, inertia);
+    }
+    linked.link(0, 3);
+    linked.link(7, 3);
+    linked.link(9, 0);
+    linked.link(9, 5);
+    PT.add(linked.islandCount() == 8 && !linked.link(2, 10), island_fail);
+    bool kept = true;
+    for(int b = 0; b < 10; b++){
+        linked.getPosition(b, p);
+        kept = kept && p[0] == b;
+    }
+    PT.add(kept && linked.slotCount() % 4 == 0, handle_fail);
+
+    JobSystem single(1);
+    PhysicsWorld many(jobs), reference(single);
+    uint32_t seed = 99;
+    auto random = [&seed](){ seed = seed*1664525u + 1013904223u; return (seed >> 8)*(1.0f/16777216.0f) - 0.5f;};
+    for(int b = 0; b < 5000; b++){
+        float position[3] = {random(), random(), random()};
+        float linear[3] = {random(), random(), random()}, angular[3] = {random(), random(), random()};
+        float body_inertia[3] = {1 + random(), 1 + random(), 1 + random()};
+        float mass = 1 + random();
+        int h = many.addBody(position, mass, body_inertia);
+        reference.addBody(position, mass, body_inertia);
+        many.setVelocity(h, linear, angular);
+        reference.setVelocity(h, linear, angular);
+        if(b%3 == 0 && b > 0){
+            many.link(b, b - 1);
+            reference.link(b, b - 1);
+        }
+    }
+    for(int s = 0; s < 10; s++){
+        many.step(1/60.0f);
+        reference.step(1/60.0f);
+    }
+    bool same = true;
+    for(int b = 0; b < 5000; b++){
+        float qa[4], qb[4], pa[3], pb[3];
+        many.getOrientation(b, qa); reference.getOrientation(b, qb);
+        many.getPosition(b, pa); reference.getPosition(b, pb);
+        same = same && qa[0] == qb[0] && qa[3] == qb[3] && pa[1] == pb[1];
+    }
+    PT.add(same, jobs_fail);
+
+    world.setFixedTimestep(0.01f, 8);
+    int first = world.update(0.025f);
+    float alpha = world.getInterpolationAlpha();
+    int capped = world.update(1.0f);
+    PT.add(first == 2 && fabsf(alpha - 0.5f) < 1e-3f && capped == 8 && world.getInterpolationAlpha() < 1, fixed_fail);
+    return PT;
+}
+
+/**
+ * Random boxes of sizes between 0.1 and 1 in a cube of the given side
+ */
+static void randomBounds(size_t count, float side, uint32_t seed, ColliderBounds& bounds){
+    auto random = [&seed](){ seed = seed*1664525u + 1013904223u; return (seed >> 8)*(1.0f/16777216.0f);};
+    bounds.resize(count);
+    for(size_t c = 0; c < count; c++){
+        float bmin[3], bmax[3];
+        for(int k = 0; k < 3; k++){
+            bmin[k] = side*random();
+            bmax[k] = bmin[k] + 0.1f + 0.9f*random();
+        }
+        bounds.set(c, bmin, bmax);
+    }
+}
+
+static std::vector<uint64_t> sortedPairs(const std::vector<ColliderPair>& pairs){
+    std::vector<uint64_t> keys;
+    for(const ColliderPair& p: pairs) keys.push_back((uint64_t)p.a << 32 | p.b);
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+static std::vector<uint64_t> bruteForcePairs(const ColliderBounds& b){
+    std::vector<ColliderPair> pairs;
+    for(uint32_t i = 0; i < b.count(); i++){
+        for(uint32_t j = i + 1; j < b.count(); j++){
+            if(b.minx[i] <= b.maxx[j] && b.minx[j] <= b.maxx[i] && b.miny[i] <= b.maxy[j] && b.miny[j] <= b.maxy[i]
+               && b.minz[i] <= b.maxz[j] && b.minz[j] <= b.maxz[i]) pairs.push_back(ColliderPair{i, j});
+        }
+    }
+    return sortedPairs(pairs);
+}
+
+/**
+ * Function that handles unittests for the sweep and prune and spatial hash broadphases
+ * @return Tester object containing the results of the unittests
+ */
+Tester broadphase_tests(){
+    std::string test_name = "Broadphase";
+    std::string sap_fail = "Sweep and prune should find exactly the overlapping pairs";
+    std::string incremental_fail = "Small motions should only need a few insertion sort moves";
+    std::string resize_fail = "Sweep and prune should follow added and removed colliders";
+    std::string unbounded_fail = "Sweep and prune should pair an unbounded collider with every other one";
+    std::string grid_fail = "Spatial hash should find exactly the overlapping pairs, each once";
+    std::string oversized_fail = "Colliders spanning many cells should still be paired";
+    Tester PT = Tester(test_name);
+    PT.setBudget(0.5);
+
+    ColliderBounds bounds;
+    randomBounds(2000, 20.0f, 3, bounds);
+    std::vector<uint64_t> expected = bruteForcePairs(bounds);
+    std::vector<ColliderPair> pairs;
+    SweepAndPrune sap;
+    sap.findPairs(bounds, pairs);
+    PT.add(!expected.empty() && sortedPairs(pairs) == expected, sap_fail);
+
+    for(size_t c = 0; c < bounds.count(); c += 50){
+        bounds.minx[c] += 0.01f;
+        bounds.maxx[c] += 0.01f;
+    }
+    sap.findPairs(bounds, pairs);
+    PT.add(sap.lastSwaps() < 100 && sortedPairs(pairs) == bruteForcePairs(bounds), incremental_fail);
+
+    ColliderBounds fewer = bounds;
+    fewer.resize(1500);
+    sap.findPairs(fewer, pairs);
+    bool resized = sortedPairs(pairs) == bruteForcePairs(fewer);
+    sap.findPairs(bounds, pairs);
+    PT.add(resized && sortedPairs(pairs) == bruteForcePairs(bounds), resize_fail);
+
+    //the sweep of an infinite collider must stop at the last collider, not in the padding
+    ColliderBounds open;
+    randomBounds(6, 5.0f, 5, open);
+    float everywhere_min[3] = {-INFINITY, -INFINITY, -INFINITY}, everywhere_max[3] = {INFINITY, INFINITY, INFINITY};
+    open.set(0, everywhere_min, everywhere_max);
+    SweepAndPrune open_sap;
+    open_sap.findPairs(open, pairs);
+    std::vector<uint64_t> open_pairs = sortedPairs(pairs);
+    size_t with_open = 0;
+    for(const ColliderPair& p: pairs) with_open += p.a == 0 || p.b == 0;
+    PT.add(open_pairs == bruteForcePairs(open) && with_open == 5, unbounded_fail);
+
+    SpatialHashGrid grid;
+    grid.findPairs(bounds, pairs);
+    std::vector<uint64_t> found = sortedPairs(pairs);
+    bool unique = std::adjacent_find(found.begin(), found.end()) == found.end();
+    grid.setCellSize(0.3f);
+    grid.findPairs(bounds, pairs);
+    PT.add(unique && found == bruteForcePairs(bounds) && sortedPairs(pairs) == found, grid_fail);
+
+    float wall_min[3] = {-1, -1, 5}, wall_max[3] = {30, 30, 5.5f};
+    bounds.resize(2002);
+    bounds.set(2000, wall_min, wall_max);
+    bounds.set(2001, wall_min, wall_max);
+    grid.findPairs(bounds, pairs);
+    PT.add(sortedPairs(pairs) == bruteForcePairs(bounds), oversized_fail);
+    return PT;
+}
+
+static ShapeInstance place(const ConvexShape& shape, float x, float y, float z){
+    return ShapeInstance{&shape, {x, y, z}, {0, 0, 0, 1}};
+}
+
+static bool near(const float* v, float x, float y, float z, float tolerance){
+    return fabsf(v[0] - x) < tolerance && fabsf(v[1] - y) < tolerance && fabsf(v[2] - z) < tolerance;
+}
+
+/**
+ * Function that handles unittests for GJK, EPA and the narrowphase
+ * @return Tester object containing the results of the unittests
+ */
+Tester narrowphase_tests(){
+    std::string test_name = "Narrowphase";
+    std::string sphere_fail = "Sphere contact should be exact";
+    std::string box_fail = "Overlapping boxes should be pushed apart along the shallowest axis";
+    std::string rotated_fail = "Corner of a rotated box should give the corner depth";
+    std::string capsule_fail = "Capsule resting on a box should touch along y";
+    std::string distance_fail = "Distance from a hull to a sphere should be exact";
+    std::string separated_fail = "Separated shapes should not touch";
+    std::string warm_fail = "Warm started GJK should take fewer iterations";
+    std::string batch_fail = "Batched contacts should match the contacts of each pair";
+    Tester PT = Tester(test_name);
+    PT.setBudget(0.5);
+
+    ConvexShape sphere = makeSphere(1.0f);
+    Contact contact;
+    ShapeInstance s0 = place(sphere, 0, 0, 0), s1 = place(sphere, 1.5f, 0, 0);
+    bool hit = collideShapes(s0, s1, contact);
+    PT.add(hit && fabsf(contact.depth - 0.5f) < 1e-5f && near(contact.normal, 1, 0, 0, 1e-5f)
+           && near(contact.point_a, 1, 0, 0, 1e-5f) && near(contact.point_b, 0.5f, 0, 0, 1e-5f), sphere_fail);
+
+    float unit[3] = {1, 1, 1}, slab[3] = {5, 1, 5};
+    ConvexShape box = makeBox(unit), floor = makeBox(slab);
+    hit = collideShapes(place(box, 0, 0, 0), place(box, 1.8f, 0.3f, 0), contact);
+    PT.add(hit && fabsf(contact.depth - 0.2f) < 1e-4f && near(contact.normal, 1, 0, 0, 1e-4f), box_fail);
+
+    ShapeInstance turned = place(box, 0, 0, 0);
+    turned.rotation[2] = sinf(0.125f*3.14159265f);
+    turned.rotation[3] = cosf(0.125f*3.14159265f);
+    hit = collideShapes(turned, place(box, sqrtf(2) + 0.9f, 0, 0), contact);
+    PT.add(hit && fabsf(contact.depth - 0.1f) < 1e-3f && near(contact.normal, 1, 0, 0, 1e-3f)
+           && fabsf(contact.point_a[0] - sqrtf(2)) < 1e-3f && fabsf(contact.point_a[1]) < 1e-3f, rotated_fail);
+
+    ConvexShape capsule = makeCapsule(0.5f, 1.0f);
+    hit = collideShapes(place(floor, 0, 0, 0), place(capsule, 0.3f, 2.4f, -2), contact);
+    PT.add(hit && fabsf(contact.depth - 0.1f) < 1e-4f && near(contact.normal, 0, 1, 0, 1e-4f)
+           && near(contact.point_b, 0.3f, 0.9f, -2, 1e-4f), capsule_fail);
+
+    float cube[24] = {-1, -1, -1, 1, -1, -1, -1, 1, -1, 1, 1, -1, -1, -1, 1, 1, -1, 1, -1, 1, 1, 1, 1, 1};
+    ConvexShape hull = makeHull(cube, 8), ball = makeSphere(0.5f);
+    float pa[3], pb[3];
+    float distance = shapeDistance(place(hull, 0, 0, 0), place(ball, 3, 0.5f, 0), pa, pb);
+    PT.add(fabsf(distance - 1.5f) < 1e-4f && near(pa, 1, 0.5f, 0, 1e-4f) && near(pb, 2.5f, 0.5f, 0, 1e-4f),
+           distance_fail);
+    hit = collideShapes(place(hull, 0, 0, 0), place(capsule, 0, 3, 0), contact);
+    PT.add(!hit && !collideShapes(place(box, 0, 0, 0), place(sphere, 2.5f, 2.5f, 2.5f), contact), separated_fail);
+
+    //a ring of hulls, spheres and capsules with neighbours both touching and apart
+    JobSystem jobs(3);
+    std::vector<ShapeInstance> shapes;
+    std::vector<ColliderPair> pairs;
+    const ConvexShape* kinds[4] = {&hull, &sphere, &capsule, &box};
+    for(uint32_t i = 0; i < 600; i++){
+        float angle = i*0.0104719755f;
+        shapes.push_back(place(*kinds[i%4], 200*cosf(angle), 200*sinf(angle), 0));
+        shapes.back().rotation[0] = sinf(0.05f*i);
+        shapes.back().rotation[3] = cosf(0.05f*i);
+        if(i > 0) pairs.push_back(ColliderPair{i - 1, i});
+    }
+    Narrowphase narrowphase;
+    std::vector<Contact> contacts;
+    size_t cold = 0, warm = 0;
+    for(int frame = 0; frame < 5; frame++){
+        for(ShapeInstance& s: shapes) s.position[2] += 0.01f*frame;
+        narrowphase.clearCache();
+        narrowphase.findContacts(jobs, shapes, pairs, contacts);
+        cold += narrowphase.lastIterations();
+    }
+    narrowphase.findContacts(jobs, shapes, pairs, contacts);
+    for(int frame = 0; frame < 5; frame++){
+        for(ShapeInstance& s: shapes) s.position[2] += 0.01f*frame;
+        narrowphase.findContacts(jobs, shapes, pairs, contacts);
+        warm += narrowphase.lastIterations();
+    }
+    PT.add(warm < cold, warm_fail);
+
+    bool same = !contacts.empty() && contacts.size() < pairs.size();
+    size_t next = 0;
+    for(const ColliderPair& pair: pairs){
+        Contact single;
+        if(!collideShapes(shapes[pair.a], shapes[pair.b], single)) continue;
+        same = same && next < contacts.size() && contacts[next].a == pair.a && contacts[next].b == pair.b
+               && fabsf(contacts[next].depth - single.depth) < 1e-4f;
+        next++;
+    }
+    PT.add(same && next == contacts.size(), batch_fail);
+    return PT;
+}
+
+std::vector<Tester> physicsTests(){
+    std::vector<Tester> tests;
+    tests.push_back(integrator_tests());
+    tests.push_back(broadphase_tests());
+    tests.push_back(narrowphase_tests());
+    return tests;
+}
@@ -0,0 +1,117 @@
+#include "../projection.h"
+#include "../camera.h"
+#include <vector>
+#include <math.h>
+#include "tester.h"
+
+/**
+ * Function that handles unittests for the batched perspective projection
+ * @return Tester object containing the results of the unittests
+ */
+Tester perspective_batch_tests(){
+    std::string test_name = "Perspective projection batch";
+    std::string center_fail = "Point on the view axis should land in the viewport center";
+    std::string depth_fail = "Depths next to the near and far planes should be close to 0 and 1";
+    std::string clip_fail = "Point behind the camera should be clipped";
+    Tester PT = Tester(test_name);
+    PT.setBudget(0.05);
+
+    Camera camera;
+    camera.setPerspective(1.0f, 2.0f, 1.0f, 10.0f);
+    float vp[16];
+    camera.getViewProjectionMatrix(vp);
+    //5 points so the tail of the batch is exercised
+    float x[5] = {0, 0, 0, 0, 0};
+    float y[5] = {0, 0, 0, 0, 0};
+    float z[5] = {-5, -1.01f, -9.99f, 3, -2};
+    float sx[5], sy[5], sz[5], rhw[5];
+    uint8_t clip[5];
+    size_t inside = projectVertices(vp, x, y, z, 5, 200, 100, sx, sy, sz, rhw, clip);
+
+    PT.add(fabs(sx[0] - 100) < 1e-3 && fabs(sy[0] - 50) < 1e-3 && fabs(rhw[0] - 0.2f) < 1e-6, center_fail);
+    PT.add(sz[1] > 0 && sz[1] < 0.02f && sz[2] < 1 && sz[2] > 0.999f, depth_fail);
+    PT.add((clip[3] & CLIP_NEAR) && clip[4] == 0 && inside == 4, clip_fail);
+    return PT;
+}
+
+/**
+ * Function that handles unittests for the orthographic and oblique plane projections
+ * @return Tester object containing the results of the unittests
+ */
+Tester parallel_batch_tests(){
+    std::string test_name = "Parallel projection batch";
+    std::string ortho_fail = "Orthogonal projection onto xz error";
+    std::string oblique_fail = "Oblique projection onto xy error";
+    std::string matrix_fail = "Oblique matrix and batch kernel disagree";
+    std::string parallel_fail = "Direction parallel to the plane should be rejected";
+    std::string box_fail = "Orthographic view box mapping error";
+    Tester PT = Tester(test_name);
+
+    std::vector<float> x, y, z;
+    for(int i = 0; i < 7; i++){
+        x.push_back(i); y.push_back(2*i); z.push_back(-i);
+    }
+    std::vector<float> u(7), v(7);
+    ProjectionPlane plane;
+    parsePlane("y", plane);
+    orthoProject(plane, x.data(), y.data(), z.data(), 7, u.data(), v.data());
+    PT.add(u[6] == 6 && v[6] == -6, ortho_fail);
+
+    float dir[3] = {1, 0, -1};
+    bool ok = obliqueProject(PLANE_XY, dir, x.data(), y.data(), z.data(), 7, u.data(), v.data());
+    PT.add(ok && u[5] == 0 && v[5] == 10, oblique_fail);
+
+    float m[16];
+    obliquePlaneMatrix(PLANE_XY, dir, m);
+    bool same = true;
+    for(int i = 0; i < 7; i++){
+        float mx = m[0]*x[i] + m[4]*y[i] + m[8]*z[i] + m[12];
+        float my = m[1]*x[i] + m[5]*y[i] + m[9]*z[i] + m[13];
+        same = same && mx == u[i] && my == v[i];
+    }
+    PT.add(same, matrix_fail);
+
+    float flat[3] = {1, 1, 0};
+    PT.add(!obliqueProject(PLANE_XY, flat, x.data(), y.data(), z.data(), 7, u.data(), v.data()), parallel_fail);
+
+    float ortho[16];
+    orthographicMatrix(0, 6, 0, 12, 0, 6, ortho);
+    std::vector<float> sx(7), sy(7), sz(7);
+    size_t inside = projectOrthographic(ortho, x.data(), y.data(), z.data(), 7, 60, 120,
+                                        sx.data(), sy.data(), sz.data());
+    PT.add(inside == 7 && sx[6] == 60 && sy[6] == 0 && fabs(sz[3] - 0.5f) < 1e-6, box_fail);
+    return PT;
+}
+
+/**
+ * Function that handles unittests for the conversions between Matrixf and the batch kernel layout
+ * @return Tester object containing the results of the unittests
+ */
+Tester matrix_conversion_tests(){
+    std::string test_name = "Matrix conversion";
+    std::string round_fail = "toArray(toMatrix(m)) should give back m";
+    std::string layout_fail = "The batch layout should be column-major like Matrixf";
+    Tester PT = Tester(test_name);
+
+    float m[16], back[16];
+    for(int i = 0; i < 16; i++) m[i] = (float)(i*i + 1); //not symmetric
+    Matrixf<4> M = toMatrix(m);
+    toArray(M, back);
+    bool same = true;
+    for(int i = 0; i < 16; i++) same = same && back[i] == m[i];
+    PT.add(same, round_fail);
+
+    std::vector<float> row = M.row(1), col = M.col(2);
+    Vectorf<4> moved = M*Vectorf<4>{1, 2, 3, 4};
+    float expected = m[1] + 2*m[5] + 3*m[9] + 4*m[13];
+    PT.add(row[2] == m[9] && col[0] == m[8] && col[3] == m[11] && moved.get()[1] == expected, layout_fail);
+    return PT;
+}
+
+std::vector<Tester> projectionTests(){
+    std::vector<Tester> tests;
+    tests.push_back(perspective_batch_tests());
+    tests.push_back(parallel_batch_tests());
+    tests.push_back(matrix_conversion_tests());
+    return tests;
+}
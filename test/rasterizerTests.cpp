@@ -0,0 +1,586 @@
+#include "../rasterizer.h"
+#include "../arena.h"
+#include "../projection.h"
+#include "../particles.h"
+#include "../texture.h"
+#include <algorithm>
+#include <vector>
+#include <math.h>
+#include "tester.h"
+
+/**
+ * Square of half size s in the plane z, two counter clockwise triangles seen from +z
+ */
+static Mesh buildQuad(float s, float z){
+    Mesh quad;
+    quad.resizeVertices(4, false);
+    float x[4] = {-s, s, s, -s}, y[4] = {-s, -s, s, s};
+    for(int i = 0; i < 4; i++){ quad.px[i] = x[i]; quad.py[i] = y[i]; quad.pz[i] = z;}
+    quad.indices = {0, 1, 2, 0, 2, 3};
+    return quad;
+}
+
+static RenderObject makeObject(const Mesh& mesh, float r, float g, float b){
+    RenderObject object;
+    object.mesh = &mesh;
+    identityMatrix(object.transform);
+    object.albedo[0] = r; object.albedo[1] = g; object.albedo[2] = b;
+    return object;
+}
+
+/**
+ * Function that handles unittests for rasterizer coverage and culling
+ * @return Tester object containing the results of the unittests
+ */
+Tester raster_coverage_tests(){
+    std::string test_name = "Rasterizer coverage";
+    std::string cover_fail = "Quad covering the screen should shade every pixel exactly once";
+    std::string cull_fail = "Clockwise quad should be culled";
+    std::string two_sided_fail = "Clockwise quad should be drawn without back face culling";
+    Tester RT = Tester(test_name);
+
+    JobSystem jobs(2);
+    Rasterizer raster(jobs);
+    Camera camera;
+    camera.setPerspective(1.57079633f, 1.0f, 0.1f, 10.0f);
+    Framebuffer target(16, 16);
+    float black[3] = {0, 0, 0};
+    //the shared diagonal runs through pixel centers
+    Mesh quad = buildQuad(1.5f, -1.0f);
+    std::vector<RenderObject> scene = {makeObject(quad, 1, 1, 1)};
+    target.clear(black);
+    raster.render(camera, scene, target);
+    RT.add(raster.getStats().fragments == 256 && raster.getStats().binned == 2, cover_fail);
+
+    Mesh back = quad;
+    back.indices = {0, 2, 1, 0, 3, 2};
+    scene[0].mesh = &back;
+    target.clear(black);
+    raster.render(camera, scene, target);
+    RT.add(raster.getStats().fragments == 0, cull_fail);
+
+    raster.setBackfaceCulling(false);
+    target.clear(black);
+    raster.render(camera, scene, target);
+    RT.add(raster.getStats().fragments == 256, two_sided_fail);
+    return RT;
+}
+
+/**
+ * Function that handles unittests for depth testing, near plane clipping and determinism
+ * @return Tester object containing the results of the unittests
+ */
+Tester raster_depth_tests(){
+    std::string test_name = "Rasterizer depth";
+    std::string depth_fail = "Nearest quad should be visible whatever the draw order";
+    std::string clip_fail = "Floor crossing the near plane should be clipped and drawn";
+    std::string thread_fail = "Image should not depend on the thread count";
+    std::string arena_fail = "Rendering should leave the frame arenas to the caller";
+    Tester RT = Tester(test_name);
+
+    Camera camera;
+    camera.setPerspective(1.0f, 1.0f, 0.1f, 50.0f);
+    Framebuffer target(40, 40);
+    float black[3] = {0, 0, 0};
+    float ambient[3] = {1, 1, 1};
+    Mesh near_quad = buildQuad(0.5f, -2.0f);
+    Mesh far_quad = buildQuad(2.0f, -4.0f);
+    JobSystem jobs(3);
+    Rasterizer raster(jobs);
+    raster.setAmbient(ambient);
+    std::vector<RenderObject> scene = {makeObject(far_quad, 0, 0, 1), makeObject(near_quad, 1, 0, 0)};
+    target.clear(black);
+    raster.render(camera, scene, target);
+    float first[3], second[3];
+    target.getPixel(20, 20, first);
+    std::swap(scene[0], scene[1]);
+    target.clear(black);
+    raster.render(camera, scene, target);
+    target.getPixel(20, 20, second);
+    RT.add(first[0] == 1 && first[2] == 0 && second[0] == 1 && second[2] == 0, depth_fail);
+
+    //floor from behind the camera to far away, lit by a point light
+    Mesh floor;
+    floor.resizeVertices(4, false);
+    float x[4] = {-10, 10, 10, -10}, z[4] = {5, 5, -40, -40};
+    for(int i = 0; i < 4; i++){ floor.px[i] = x[i]; floor.py[i] = -1; floor.pz[i] = z[i];}
+    floor.indices = {0, 1, 2, 0, 2, 3};
+    float dim[3] = {0.05f, 0.05f, 0.05f};
+    raster.setAmbient(dim);
+    raster.setLights({PointLight{{0, 1, -5}, {2, 2, 2}, 12}});
+    scene = {makeObject(floor, 0.8f, 0.8f, 0.8f), makeObject(near_quad, 0.2f, 0.9f, 0.2f)};
+    target.clear(black);
+    FrameArena::resetAll();
+    void* held = FrameArena::forThread().allocate(64); //a temporary of the caller's frame
+    raster.render(camera, scene, target);
+    float bottom[3];
+    target.getPixel(20, 39, bottom);
+    RT.add(raster.getStats().binned > 3 && bottom[0] > 0, clip_fail);
+    RT.add(held != nullptr && FrameArena::forThread().bytesUsed() >= 64, arena_fail);
+    FrameArena::resetAll();
+
+    std::vector<float> image(3*40*40), single(3*40*40);
+    target.resolve(image.data());
+    JobSystem serial(1);
+    Rasterizer serial_raster(serial);
+    serial_raster.setAmbient(dim);
+    serial_raster.setLights({PointLight{{0, 1, -5}, {2, 2, 2}, 12}});
+    target.clear(black);
+    serial_raster.render(camera, scene, target);
+    target.resolve(single.data());
+    RT.add(image == single, thread_fail);
+    return RT;
+}
+
+/**
+ * Function that handles unittests for the particle update, compaction and point sprites
+ * @return Tester object containing the results of the unittests
+ */
+Tester particle_tests(){
+    std::string test_name = "Particles";
+    std::string motion_fail = "Particle should follow semi-implicit Euler under gravity";
+    std::string capacity_fail = "Emission should stop at the capacity";
+    std::string compact_fail = "Dead particles should be removed, survivors keeping their order";
+    std::string curl_fail = "Curl noise should be divergence free";
+    std::string sprite_fail = "Sprite in front of a quad should light it, behind it should not";
+    std::string fade_fail = "Sprite should fade out over the fade time";
+    std::string thread_fail = "Update should not depend on the thread count";
+    Tester RT = Tester(test_name);
+
+    JobSystem jobs(3);
+    ParticleSystem single(jobs, 10);
+    ParticleEmitter emitter = {{0, 1, 0}, {1, 2, 0}, 0, {5, 5}, 0.1f};
+    single.emit(emitter, 1);
+    single.update(0.1f);
+    single.update(0.1f);
+    float vy = 2 - 2*0.981f, y = 1 + 0.1f*(2 - 0.981f) + 0.1f*vy;
+    RT.add(fabsf(single.stream(PARTICLE_PX)[0] - 0.2f) < 1e-5f && fabsf(single.stream(PARTICLE_VY)[0] - vy) < 1e-5f
+           && fabsf(single.stream(PARTICLE_PY)[0] - y) < 1e-5f && fabsf(single.stream(PARTICLE_LIFE)[0] - 4.8f) < 1e-5f,
+           motion_fail);
+    RT.add(single.emit(emitter, 20) == 9 && single.count() == 10, capacity_fail);
+
+    //bursts of 7 alternating short and long lives, so survivors sit across lanes
+    ParticleSystem bursts(jobs, 100);
+    float zero[3] = {0, 0, 0};
+    bursts.setGravity(zero);
+    for(int b = 0; b < 6; b++){
+        ParticleEmitter e = {{(float)b, 0, 0}, {0, 0, 0}, 0, {b%2? 3.0f: 1.0f, b%2? 3.0f: 1.0f}, 0.1f};
+        bursts.emit(e, 7);
+    }
+    bursts.update(2.0f);
+    bool compacted = bursts.count() == 21;
+    for(size_t i = 0; i < bursts.count(); i++) compacted = compacted && bursts.stream(PARTICLE_PX)[i] == 1 + 2*(i/7);
+    RT.add(compacted, compact_fail);
+
+    float px[6] = {0.3f, -1.2f, 2.5f, 0.0f, 4.1f, -3.3f}, py[6] = {1.1f, 0.4f, -0.7f, 2.2f, -2.6f, 0.9f};
+    float pz[6] = {-0.5f, 3.0f, 1.7f, -2.4f, 0.2f, 1.4f};
+    float h = 1e-2f, divergence = 0;
+    for(int i = 0; i < 6; i++){
+        float x[6] = {px[i] + h, px[i] - h, px[i], px[i], px[i], px[i]};
+        float yy[6] = {py[i], py[i], py[i] + h, py[i] - h, py[i], py[i]};
+        float z[6] = {pz[i], pz[i], pz[i], pz[i], pz[i] + h, pz[i] - h};
+        float cx[6], cy[6], cz[6];
+        curlNoise(x, yy, z, 6, 1.0f, 0.4f, cx, cy, cz);
+        divergence = std::max(divergence, fabsf((cx[0] - cx[1] + cy[2] - cy[3] + cz[4] - cz[5])/(2*h)));
+    }
+    RT.add(divergence < 0.05f, curl_fail);
+
+    //a red quad at z = -4, one sprite in front of it and one behind it
+    Camera camera;
+    camera.setPerspective(1.0f, 1.0f, 0.1f, 50.0f);
+    Framebuffer target(40, 40);
+    float black[3] = {0, 0, 0}, white[3] = {1, 1, 1}, green[3] = {0, 1, 0};
+    Mesh quad = buildQuad(2.0f, -4.0f);
+    Rasterizer raster(jobs);
+    raster.setAmbient(white);
+    std::vector<RenderObject> scene = {makeObject(quad, 1, 0, 0)};
+    ParticleSystem sprites(jobs, 8);
+    sprites.setColor(green, 0.5f);
+    sprites.setGravity(zero);
+    ParticleEmitter front = {{0, 0, -2}, {0, 0, 0}, 0, {2, 2}, 0.3f};
+    ParticleEmitter behind = {{0.8f, 0, -6}, {0, 0, 0}, 0, {2, 2}, 0.3f};
+    sprites.emit(front, 1);
+    sprites.emit(behind, 1);
+    target.clear(black);
+    raster.render(camera, scene, target);
+    raster.renderParticles(camera, sprites, target);
+    float center[3], occluded[3];
+    target.getPixel(20, 20, center);
+    target.getPixel(25, 20, occluded); //the behind sprite is centered about 5 pixels right of the center
+    float lit = center[1];
+    RT.add(center[0] == 1 && lit > 0.9f && lit < 1 && occluded[1] == 0 && raster.getStats().triangles == 2
+           && raster.getStats().binned == 2, sprite_fail);
+
+    sprites.update(1.75f); //0.25 s left, half the fade time
+    target.clear(black);
+    raster.renderParticles(camera, sprites, target);
+    target.getPixel(20, 20, center);
+    RT.add(center[0] == 0 && fabsf(center[1] - 0.5f*lit) < 1e-4f, fade_fail);
+
+    //more than one chunk, curl noise on
+    JobSystem serial(1);
+    ParticleSystem a(serial, 3*PARTICLE_CHUNK), b(jobs, 3*PARTICLE_CHUNK);
+    ParticleEmitter spray = {{0, 0, 0}, {0, 1, 0}, 2, {0.05f, 1}, 0.1f};
+    for(ParticleSystem* s: {&a, &b}){
+        s->setCurlNoise(3, 0.7f);
+        s->setDrag(0.5f);
+        s->emit(spray, 2*PARTICLE_CHUNK + 5);
+        for(int step = 0; step < 4; step++) s->update(0.1f);
+    }
+    bool same = a.count() == b.count() && a.count() > 0 && a.count() < 2*PARTICLE_CHUNK;
+    for(int s = 0; s < PARTICLE_STREAM_COUNT && same; s++){
+        same = std::equal(a.stream((ParticleStream)s), a.stream((ParticleStream)s) + a.count(), b.stream((ParticleStream)s));
+    }
+    RT.add(same, thread_fail);
+    return RT;
+}
+
+/**
+ * Function that handles unittests for texture storage, mipmaps and filtering
+ * @return Tester object containing the results of the unittests
+ */
+Tester texture_tests(){
+    std::string test_name = "Texture";
+    std::string texel_fail = "Texels should read back where they were written, tiles padded";
+    std::string mip_fail = "Mip chain should halve down to 1x1, the last level holding the mean";
+    std::string mip_thread_fail = "Mip chain should not depend on the thread count";
+    std::string odd_mip_fail = "Odd sized levels should fold their last row and column into the level below";
+    std::string bilinear_fail = "Bilinear filter should blend neighbour texels, wrapping or clamping at the edges";
+    std::string trilinear_fail = "Trilinear filter should blend two levels by the fractional level of detail";
+    std::string lod_fail = "Level of detail should be log2 of the texels covered by a pixel";
+    std::string simd_fail = "4 wide sampling should match single sampling exactly";
+    Tester RT = Tester(test_name);
+
+    int width = 13, height = 7;
+    std::vector<float> image(4*width*height);
+    for(size_t i = 0; i < image.size(); i++) image[i] = (float)i;
+    Texture texture;
+    texture.setPixels(image.data(), width, height);
+    bool round_trip = texture.getWidth() == 13 && texture.getHeight() == 7;
+    for(int y = 0; y < height; y++){
+        for(int x = 0; x < width; x++){
+            float rgba[4];
+            texture.getTexel(x, y, rgba);
+            for(int c = 0; c < 4; c++) round_trip = round_trip && rgba[c] == image[4*(y*width + x) + c];
+        }
+    }
+    RT.add(round_trip, texel_fail);
+
+    //16x8 of random values, mean over the texture
+    Texture noise(16, 8), noise_serial(16, 8);
+    double mean = 0;
+    unsigned seed = 7;
+    for(int y = 0; y < 8; y++){
+        for(int x = 0; x < 16; x++){
+            seed = seed*1664525u + 1013904223u;
+            float value = (seed >> 8)*(1.0f/16777216.0f);
+            float rgba[4] = {value, 1 - value, 0.5f, 1};
+            noise.setTexel(x, y, rgba);
+            noise_serial.setTexel(x, y, rgba);
+            mean += value/128;
+        }
+    }
+    JobSystem jobs(3), serial(1);
+    noise.buildMipmaps(jobs);
+    noise_serial.buildMipmaps(serial);
+    float last[4];
+    noise.getTexel(0, 0, last, 4);
+    RT.add(noise.levelCount() == 5 && noise.getWidth(3) == 2 && noise.getHeight(3) == 1 && noise.getWidth(4) == 1
+           && fabs(last[0] - mean) < 1e-5 && fabsf(last[2] - 0.5f) < 1e-6f, mip_fail);
+    bool same_mips = true;
+    for(int l = 0; l < noise.levelCount(); l++){
+        for(int y = 0; y < noise.getHeight(l); y++){
+            for(int x = 0; x < noise.getWidth(l); x++){
+                float p[4], q[4];
+                noise.getTexel(x, y, p, l);
+                noise_serial.getTexel(x, y, q, l);
+                same_mips = same_mips && std::equal(p, p + 4, q);
+            }
+        }
+    }
+    RT.add(same_mips, mip_thread_fail);
+
+    //5x3 lit only in its last column and row: 2x1 then 1x1, the lit texel must not be dropped
+    Texture odd(5, 3);
+    float lit[4] = {1, 1, 1, 1};
+    odd.setTexel(4, 2, lit);
+    odd.buildMipmaps(serial);
+    float left[4], right[4], odd_last[4];
+    odd.getTexel(0, 0, left, 1);
+    odd.getTexel(1, 0, right, 1);
+    odd.getTexel(0, 0, odd_last, 2);
+    RT.add(odd.levelCount() == 3 && odd.getWidth(1) == 2 && odd.getHeight(1) == 1 && left[0] == 0.0f
+           && fabsf(right[0] - 2.0f/15) < 1e-6f && fabsf(odd_last[0] - 1.0f/15) < 1e-6f, odd_mip_fail);
+
+    //black and white texel side by side
+    Texture pair(2, 1);
+    float black[4] = {0, 0, 0, 1}, white[4] = {1, 1, 1, 1};
+    pair.setTexel(0, 0, black);
+    pair.setTexel(1, 0, white);
+    float middle[4], center[4], wrapped[4], clamped[4];
+    pair.sample(0.5f, 0.5f, 0, middle);
+    pair.sample(0.25f, 0.5f, 0, center);
+    pair.sample(0.0f, 0.5f, 0, wrapped);
+    pair.setWrap(TEXTURE_CLAMP);
+    pair.sample(0.0f, 0.5f, 0, clamped);
+    RT.add(middle[0] == 0.5f && center[0] == 0 && wrapped[0] == 0.5f && clamped[0] == 0 && middle[3] == 1,
+           bilinear_fail);
+
+    //4x4 checker: white on its texel centers at level 0, grey at level 1
+    Texture checker(4, 4);
+    for(int y = 0; y < 4; y++){
+        for(int x = 0; x < 4; x++) checker.setTexel(x, y, (x + y)%2? black: white);
+    }
+    checker.buildMipmaps(jobs);
+    checker.setFilter(TEXTURE_TRILINEAR);
+    float level0[4], between[4];
+    checker.sample(0.125f, 0.125f, 0, level0);
+    checker.sample(0.125f, 0.125f, 0.5f, between);
+    RT.add(level0[0] == 1 && fabsf(between[0] - 0.75f) < 1e-6f, trilinear_fail);
+
+    RT.add(checker.computeLod(0.25f, 0, 0, 0.25f) == 0 && checker.computeLod(0, 0.5f, 0.25f, 0) == 1, lod_fail);
+
+    bool same = true;
+    seed = 11;
+    for(int wrap = 0; wrap < 2; wrap++){
+        for(int f = 0; f < 3; f++){
+            noise.setWrap((TextureWrap)wrap);
+            noise.setFilter((TextureFilter)f);
+            for(int batch = 0; batch < 64; batch++){
+                float u[4], v[4], lod[4], r[4], g[4], b[4], a[4];
+                for(int lane = 0; lane < 4; lane++){
+                    seed = seed*1664525u + 1013904223u;
+                    u[lane] = (seed >> 8)*(6.0f/16777216.0f) - 3;
+                    seed = seed*1664525u + 1013904223u;
+                    v[lane] = (seed >> 8)*(6.0f/16777216.0f) - 3;
+                    seed = seed*1664525u + 1013904223u;
+                    lod[lane] = (seed >> 8)*(7.0f/16777216.0f) - 1;
+                }
+                noise.sample4(u, v, lod, r, g, b, a);
+                for(int lane = 0; lane < 4; lane++){
+                    float rgba[4];
+                    noise.sample(u[lane], v[lane], lod[lane], rgba);
+                    same = same && rgba[0] == r[lane] && rgba[1] == g[lane] && rgba[2] == b[lane] && rgba[3] == a[lane];
+                }
+            }
+        }
+    }
+    RT.add(same, simd_fail);
+    return RT;
+}
+
+/**
+ * Function that handles unittests for light types and the clustered light assignment
+ * @return Tester object containing the results of the unittests
+ */
+Tester lighting_tests(){
+    std::string test_name = "Clustered lighting";
+    std::string cluster_fail = "Every light reaching a point should be listed in the point's cluster";
+    std::string cull_fail = "Clusters should list a small part of many small lights";
+    std::string spot_fail = "Spot light should light inside its cone only";
+    std::string directional_fail = "Directional light should light every surface facing it";
+    Tester RT = Tester(test_name);
+
+    JobSystem jobs(3);
+    Camera camera;
+    float eye[3] = {0, 4, 6}, target_point[3] = {0, 0, -12}, world_up[3] = {0, 1, 0};
+    camera.lookAt(eye, target_point, world_up);
+    camera.setPerspective(1.0f, 1.5f, 0.1f, 60.0f);
+    int width = 300, height = 200;
+    unsigned seed = 5;
+    auto random = [&seed](){
+        seed = seed*1664525u + 1013904223u;
+        return (seed >> 8)*(1.0f/16777216.0f);
+    };
+    std::vector<PointLight> points;
+    std::vector<SpotLight> spots;
+    for(int l = 0; l < 400; l++){
+        points.push_back(PointLight{{40*random() - 20, 3*random() - 1, -40*random() + 4}, {1, 1, 1}, 0.5f + 2*random()});
+    }
+    for(int l = 0; l < 100; l++){
+        float cone = 0.3f + 0.6f*random();
+        spots.push_back(SpotLight{{40*random() - 20, 3*random(), -40*random() + 4}, {random() - 0.5f, -1, random() - 0.5f},
+                                  {1, 1, 1}, 1 + 3*random(), cone + 0.05f, cone});
+        float* d = spots.back().direction;
+        float len = sqrtf(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+        for(int c = 0; c < 3; c++) d[c] /= len;
+    }
+    LightClusters clusters;
+    clusters.build(jobs, camera, width, height, 32, points, spots);
+    float view_projection[16];
+    camera.getViewProjectionMatrix(view_projection);
+    bool listed = true;
+    for(int i = 0; i < 4000; i++){
+        float p[3] = {30*random() - 15, 3*random() - 1, -40*random() + 2};
+        float sx, sy, sz, rhw;
+        uint8_t clip;
+        projectVertices(view_projection, p, p + 1, p + 2, 1, width, height, &sx, &sy, &sz, &rhw, &clip);
+        if(clip != 0) continue;
+        uint32_t count;
+        const uint32_t* list = clusters.clusterLights(clusters.cluster((int)sx/32, (int)sy/32, clusters.slice(1/rhw)), count);
+        for(size_t l = 0; l < points.size() + spots.size(); l++){
+            const float* center = l < points.size()? points[l].position: spots[l - points.size()].position;
+            float radius = l < points.size()? points[l].radius: spots[l - points.size()].radius;
+            float d2 = 0;
+            for(int c = 0; c < 3; c++) d2 += (p[c] - center[c])*(p[c] - center[c]);
+            if(l >= points.size()){ //inside the cone too
+                const float* axis = spots[l - points.size()].direction;
+                float along = 0;
+                for(int c = 0; c < 3; c++) along += (p[c] - center[c])*axis[c];
+                if(along <= spots[l - points.size()].outer_cos*sqrtf(d2)) continue;
+            }
+            if(d2 < radius*radius) listed = listed && std::find(list, list + count, (uint32_t)l) != list + count;
+        }
+    }
+    RT.add(listed, cluster_fail);
+    RT.add(clusters.assignmentCount() > 0
+           && clusters.assignmentCount() < clusters.clusterCount()*(points.size() + spots.size())/20, cull_fail);
+
+    //a screen filling wall, the spot light points at its center from the camera side
+    Camera front;
+    front.setPerspective(1.0f, 1.0f, 0.1f, 50.0f);
+    Framebuffer image(40, 40);
+    float black[3] = {0, 0, 0};
+    Mesh wall = buildQuad(4.0f, -4.0f);
+    std::vector<RenderObject> scene = {makeObject(wall, 1, 1, 1)};
+    Rasterizer raster(jobs);
+    raster.setAmbient(black);
+    raster.setSpotLights({SpotLight{{0, 0, -1}, {0, 0, -2}, {1, 1, 1}, 10, 0.99f, 0.98f}});
+    image.clear(black);
+    raster.render(front, scene, image);
+    float center[3], side[3];
+    image.getPixel(20, 20, center);
+    image.getPixel(32, 20, side);
+    RT.add(center[0] > 0.5f && side[0] == 0 && raster.getStats().light_tests > 0, spot_fail);
+
+    raster.setSpotLights({});
+    raster.setDirectionalLights({DirectionalLight{{0, 0, -3}, {0.5f, 0.25f, 1}}});
+    image.clear(black);
+    raster.render(front, scene, image);
+    image.getPixel(5, 35, side);
+    RT.add(fabsf(side[0] - 0.5f) < 1e-5f && fabsf(side[1] - 0.25f) < 1e-5f && fabsf(side[2] - 1) < 1e-5f,
+           directional_fail);
+    return RT;
+}
+
+/**
+ * Function that handles unittests for the cascaded shadow maps
+ * @return Tester object containing the results of the unittests
+ */
+Tester shadow_tests(){
+    std::string test_name = "Shadow maps";
+    std::string shadow_fail = "Surfaces behind an occluder should get no light from the shadowed light";
+    std::string depth_fail = "Depth pass should keep the nearest caster depth";
+    std::string filter_fail = "Filtered lookups should fade smoothly across a shadow edge";
+    std::string cover_fail = "Cascades should cover the view up to the shadow distance";
+    std::string snap_fail = "Moving the camera should move the shadow maps by whole texels";
+    Tester RT = Tester(test_name);
+
+    //a wall facing the camera, lit at a slant, and a small quad in front of it casting a shadow beside itself
+    JobSystem jobs(3);
+    Camera camera;
+    camera.setPerspective(1.0f, 1.0f, 0.1f, 50.0f);
+    Framebuffer image(64, 64);
+    float black[3] = {0, 0, 0};
+    Mesh wall = buildQuad(4.0f, -6.0f), card = buildQuad(0.5f, -3.0f);
+    std::vector<RenderObject> scene = {makeObject(wall, 1, 1, 1), makeObject(card, 1, 1, 1)};
+    scene[1].transform[12] = -1;
+    Rasterizer raster(jobs);
+    raster.setAmbient(black);
+    raster.setDirectionalLights({DirectionalLight{{0.6f, 0, -0.8f}, {1, 1, 1}}});
+    raster.setShadows(3, 512, 20);
+    image.clear(black);
+    raster.render(camera, scene, image);
+    //the shadow is around x = 1.25 on the wall, pixel 44
+    float shadowed[3], lit[3];
+    image.getPixel(44, 32, shadowed);
+    image.getPixel(58, 32, lit);
+    RT.add(shadowed[0] < 1e-5f && fabsf(lit[0] - 0.8f) < 1e-4f && raster.getStats().shadow_triangles > 0, shadow_fail);
+
+    const ShadowCascades& shadows = raster.getShadows();
+    float card_center[3] = {-1, 0, -3};
+    bool nearest = true;
+    for(int c = 0; c < shadows.cascadeCount(); c++){
+        const float* m = shadows.lightMatrix(c);
+        float u = m[0]*card_center[0] + m[4]*card_center[1] + m[8]*card_center[2] + m[12];
+        float v = m[1]*card_center[0] + m[5]*card_center[1] + m[9]*card_center[2] + m[13];
+        float z = m[2]*card_center[0] + m[6]*card_center[1] + m[10]*card_center[2] + m[14];
+        int size = shadows.getResolution();
+        if(u < 0 || v < 0 || u >= size || v >= size) continue;
+        //the card's depth changes by 0.75 texels of depth per texel across the map
+        nearest = nearest && fabsf(shadows.depthMap(c)[(int)v*size + (int)u] - z) < 1.0f/size;
+    }
+    RT.add(nearest, depth_fail);
+
+    float normal[3] = {0, 0, 1}, previous = -1;
+    bool smooth = true, partial = false;
+    for(int i = 0; i <= 100; i++){
+        float p[3] = {1.25f + 0.01f*i, 0, -6};
+        float visible = shadows.visibility(p, normal, 6);
+        smooth = smooth && visible >= previous - 1e-6f;
+        partial = partial || (visible > 0.1f && visible < 0.9f);
+        previous = visible;
+    }
+    RT.add(smooth && partial && previous == 1, filter_fail);
+
+    //every point of the view frustum up to the shadow distance falls inside its cascade
+    float eye[3] = {3, 2, 5}, target_point[3] = {-4, -1, -10}, world_up[3] = {0, 1, 0};
+    camera.lookAt(eye, target_point, world_up);
+    ShadowCascades cascades;
+    cascades.setCascades(4, 256, 30);
+    float light[3] = {0.48f, -0.8f, 0.36f};
+    cascades.fit(camera, light);
+    unsigned seed = 11;
+    auto random = [&seed](){
+        seed = seed*1664525u + 1013904223u;
+        return (seed >> 8)*(1.0f/16777216.0f);
+    };
+    float tan_y = tanf(0.5f), tan_x = tan_y;
+    bool covered = cascades.splitDepth(0) == camera.getNear() && cascades.splitDepth(4) == 30;
+    for(int i = 0; i < 2000; i++){
+        float depth = camera.getNear() + (30 - camera.getNear())*random();
+        float x = (2*random() - 1)*tan_x*depth, y = (2*random() - 1)*tan_y*depth;
+        float p[3];
+        for(int k = 0; k < 3; k++) p[k] = eye[k] + depth*camera.getForward()[k] + x*camera.getRight()[k] + y*camera.getUp()[k];
+        int c = 0;
+        while(c < 3 && depth >= cascades.splitDepth(c + 1)) c++;
+        const float* m = cascades.lightMatrix(c);
+        float u = m[0]*p[0] + m[4]*p[1] + m[8]*p[2] + m[12];
+        float v = m[1]*p[0] + m[5]*p[1] + m[9]*p[2] + m[13];
+        float z = m[2]*p[0] + m[6]*p[1] + m[10]*p[2] + m[14];
+        covered = covered && u >= 0 && v >= 0 && u <= 256 && v <= 256 && z >= 0 && z <= 1;
+    }
+    RT.add(covered, cover_fail);
+
+    float fixed[3] = {-2, 0, -8}, before[SHADOW_MAX_CASCADES][2], texels[SHADOW_MAX_CASCADES];
+    for(int c = 0; c < 4; c++){
+        const float* m = cascades.lightMatrix(c);
+        before[c][0] = m[0]*fixed[0] + m[4]*fixed[1] + m[8]*fixed[2] + m[12];
+        before[c][1] = m[1]*fixed[0] + m[5]*fixed[1] + m[9]*fixed[2] + m[13];
+        texels[c] = cascades.texelSize(c);
+    }
+    float moved_eye[3] = {3.37f, 2.11f, 4.73f}, moved_target[3] = {-3, -1.5f, -10};
+    camera.lookAt(moved_eye, moved_target, world_up);
+    cascades.fit(camera, light);
+    bool snapped = true;
+    for(int c = 0; c < 4; c++){
+        const float* m = cascades.lightMatrix(c);
+        float du = m[0]*fixed[0] + m[4]*fixed[1] + m[8]*fixed[2] + m[12] - before[c][0];
+        float dv = m[1]*fixed[0] + m[5]*fixed[1] + m[9]*fixed[2] + m[13] - before[c][1];
+        snapped = snapped && fabsf(du - roundf(du)) < 0.01f && fabsf(dv - roundf(dv)) < 0.01f
+                  && fabsf(cascades.texelSize(c) - texels[c]) < 1e-6f*texels[c];
+    }
+    RT.add(snapped, snap_fail);
+    return RT;
+}
+
+std::vector<Tester> rasterizerTests(){
+    std::vector<Tester> tests;
+    tests.push_back(raster_coverage_tests());
+    tests.push_back(raster_depth_tests());
+    tests.push_back(particle_tests());
+    tests.push_back(texture_tests());
+    tests.push_back(lighting_tests());
+    tests.push_back(shadow_tests());
+    return tests;
+}
@@ -1,4 +1,7 @@
 #include "tester.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 //Implementations details of Tester class
 
@@ -7,9 +10,13 @@
  * @param identifier the name/identifier of the unittest object
  */
 Tester::Tester(std::string &identifier){
+    name = identifier;
     messages = "";
     num_tests = 0;
     passed = 0;
+    start = std::chrono::steady_clock::now();
+    last = start;
+    budget = 0;
 }
 
 /**
@@ -18,6 +25,7 @@ Tester::Tester(std::string &identifier){
  * @param m the error message to display should the test fail
  */
 void Tester::add(bool s, std::string &m){
+    last = std::chrono::steady_clock::now();
     num_tests++;
     if(s) passed ++;
     else{addFailMessage(m);}
@@ -32,6 +40,7 @@ void Tester::add(bool s, std::string &m){
  * @param g the obtained result message
  */
 void Tester::add(bool s, std::string &m, std::string &e, std::string &g){
+    last = std::chrono::steady_clock::now();
     num_tests++;
     if(s) passed ++;
     else {
@@ -40,6 +49,47 @@ void Tester::add(bool s, std::string &m, std::string &e, std::string &g){
     }
 }
 
+/**
+ * Give the test a wall time budget, only enforced when perf assertions are enabled
+ * @param seconds the longest the test may take
+ */
+void Tester::setBudget(double seconds){
+    budget = seconds;
+}
+
+/**
+ * Perf assertion: record a failed test if the test took longer than its budget
+ * @return whether the test is within its budget, true when it has none
+ */
+bool Tester::checkBudget(){
+    if(budget <= 0) return true;
+    double elapsed = getElapsed();
+    std::string budget_fail = "Exceeded time budget of " + std::to_string(budget*1e3) + " ms, took "
+                              + std::to_string(elapsed*1e3) + " ms";
+    num_tests++;
+    if(elapsed <= budget){
+        passed++;
+        return true;
+    }
+    addFailMessage(budget_fail);
+    return false;
+}
+
+/**
+ * @return wall time in seconds from construction to the last added test result
+ */
+double Tester::getElapsed() const{
+    return std::chrono::duration<double>(last - start).count();
+}
+
+bool Tester::allPassed() const{
+    return passed == num_tests;
+}
+
+int Tester::failedCount() const{
+    return num_tests - passed;
+}
+
 /**
  * helper method for adding failed tests output to Tester Object.
  * @param m the error message to display should a test fail
@@ -56,24 +106,73 @@ void Tester::addFailMessage(std::string &m){
  * @return output stream
  */
 std::ostream& operator<<(std::ostream &os, const Tester &t){
-    os << t.passed << "/" << t.num_tests <<  t.name<<" tests passed. \n" << t.messages;
+    os << t.passed << "/" << t.num_tests << " " << t.name << " tests passed ("
+       << t.getElapsed()*1e3 << " ms). \n" << t.messages;
     return os;
 }
 
+// ====== TestRunner ======
+
 /**
- * Add a test result and error message containing the expected and
- * obtained behaviour from the test
- * @param s the boolean statement representing a unittest
- * @param m the error message to display should the test fail
- * @param e the expected result
- * @param g the obtained result
+ * Create a test runner
+ * @param threads number of threads running test groups, 0 to use the hardware concurrency
  */
-template<typename T, typename U>
-void Tester::add(bool s, std::string &m, T e, U g) {
-    num_tests++;
-    if(s) passed ++;
-    else {
-        std::string new_message = m + "\n" + "Expected :" << e + "\n" + "Got: " << g;
-        addFailMessage(new_message);
+TestRunner::TestRunner(unsigned threads){
+    thread_count = threads? threads: std::max(1u, std::thread::hardware_concurrency());
+    perf_assertions = false;
+}
+
+/**
+ * Register a group of tests, e.g. the vectorTests function
+ * @param group name of the group in the report
+ * @param tests function running the group and returning its Tester objects
+ */
+void TestRunner::add(const std::string &group, std::function<std::vector<Tester>()> tests){
+    groups.push_back(Group{group, std::move(tests), std::vector<Tester>(), 0.0});
+}
+
+/**
+ * Enable failing tests that exceed their time budget, off by default since
+ * timings depend on the machine and its load
+ */
+void TestRunner::setPerfAssertions(bool enabled){
+    perf_assertions = enabled;
+}
+
+/**
+ * Run every registered group, groups in parallel, then print the results with their wall times
+ * @param os the output stream of the report
+ * @return whether every test passed
+ */
+bool TestRunner::run(std::ostream &os){
+    std::atomic<size_t> next(0);
+    auto worker = [&](){
+        for(size_t i = next++; i < groups.size(); i = next++){
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            groups[i].results = groups[i].tests();
+            groups[i].elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        }
+    };
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    size_t extra = std::min<size_t>(thread_count, groups.size());
+    for(size_t t = 1; t < extra; t++) threads.emplace_back(worker);
+    worker();
+    for(std::thread &thread: threads) thread.join();
+    double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    int failed = 0;
+    for(Group &group: groups){
+        os << "========================================\n"
+           << group.name << " (" << group.elapsed*1e3 << " ms)\n";
+        for(Tester &test: group.results){
+            if(perf_assertions) test.checkBudget();
+            failed += test.failedCount();
+            os << test << "\n";
+        }
     }
+    os << "========================================\n"
+       << failed << " failing tests, " << groups.size() << " groups in " << total*1e3 << " ms on "
+       << thread_count << " threads\n";
+    return failed == 0;
 }
@@ -1,7 +1,16 @@
+#ifndef GRAPHICSENGINE3D_TESTER_H
+#define GRAPHICSENGINE3D_TESTER_H
+
 #include <string>
 #include <iostream>
+#include <chrono>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+#include <sstream>
 /**
  * Test object for Unittests
+ * The wall time of a test is measured from construction to its last add call.
  */
 class Tester{
 public:
@@ -10,24 +19,72 @@ public:
     void add(bool s, std::string &m, std::string &e, std::string &g);
     template<typename T, typename U>
     void add(bool s, std::string &m, T e, U g);
+    void setBudget(double seconds);
+    bool checkBudget();
+    double getElapsed() const;
+    bool allPassed() const;
+    int failedCount() const;
     friend std::ostream& operator<<(std::ostream &os, const Tester& t);
 private:
     std::string name;
     std::string messages;
     int num_tests;
     int passed;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point last;
+    double budget; //seconds, 0 when the test has no time budget
 
     void addFailMessage(std::string &m);
 };
 
+/**
+ * Runs groups of tests on a pool of threads and reports them in registration order
+ */
+class TestRunner{
+public:
+    explicit TestRunner(unsigned threads = 0);
+    void add(const std::string &group, std::function<std::vector<Tester>()> tests);
+    void setPerfAssertions(bool enabled);
+    bool run(std::ostream &os = std::cout);
+private:
+    struct Group{
+        std::string name;
+        std::function<std::vector<Tester>()> tests;
+        std::vector<Tester> results;
+        double elapsed;
+    };
+    std::vector<Group> groups;
+    unsigned thread_count;
+    bool perf_assertions;
+};
+
 
 /**
  * Function to print the output of all Tester Objects provided
  * @param tests the Tester Objects provided
  */
-void getAllTestResults(std::initializer_list<Tester> tests){
+inline void getAllTestResults(std::initializer_list<Tester> tests){
     for(auto &test: tests){
         std::cout << "========================================\n"
             << test<< "\n \n" << "========================================\n" ;
     }
-}
\ No newline at end of file
+}
+
+/**
+ * Add a test result and error message containing the expected and
+ * obtained behaviour from the test
+ * @param s the boolean statement representing a unittest
+ * @param m the error message to display should the test fail
+ * @param e the expected result, printable to an output stream
+ * @param g the obtained result, printable to an output stream
+ */
+template<typename T, typename U>
+void Tester::add(bool s, std::string &m, T e, U g) {
+    std::ostringstream expected, got;
+    expected << e;
+    got << g;
+    std::string e_message = expected.str(), g_message = got.str();
+    add(s, m, e_message, g_message);
+}
+
+#endif //GRAPHICSENGINE3D_TESTER_H
@@ -0,0 +1,375 @@
+#include "texture.h"
+#include "profiler.h"
+#include "simd.h"
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+//Implementation details of the Morton tiled Texture
+
+namespace {
+
+/**
+ * Level of a texture as seen by the samplers
+ */
+struct LevelView{
+    const float* base;
+    int width;
+    int height;
+    int tiles_x;
+};
+
+/**
+ * Bits of x moved to the even bit positions, x < 256
+ */
+inline unsigned spreadBits(unsigned x){
+    x = (x | x << 4) & 0x0f0fu;
+    x = (x | x << 2) & 0x3333u;
+    return (x | x << 1) & 0x5555u;
+}
+
+/**
+ * Float offset of a texel: tile row by row, then Morton order inside the tile
+ */
+inline size_t texelOffset(int tiles_x, int x, int y){
+    unsigned ux = (unsigned)x, uy = (unsigned)y;
+    size_t tile = (size_t)(uy/TEXTURE_TILE_SIZE)*tiles_x + ux/TEXTURE_TILE_SIZE;
+    unsigned morton = spreadBits(ux%TEXTURE_TILE_SIZE) | spreadBits(uy%TEXTURE_TILE_SIZE) << 1;
+    return 4*(tile*TEXTURE_TILE_TEXELS + morton);
+}
+
+/**
+ * Parent texels and weights of child texel i along one axis of a mip reduction.
+ * An even parent size gives 2 equal taps. An odd size 2k+1 gives 3 taps over
+ * 2i .. 2i+2, weighted by how much of each the child covers, so the trailing
+ * texel is folded in rather than dropped.
+ */
+inline void reductionTaps(int i, int parent_size, int taps[3], float weights[3]){
+    if(parent_size%2 == 0 || parent_size == 1){
+        taps[0] = 2*i; taps[1] = std::min(2*i + 1, parent_size - 1); taps[2] = taps[1];
+        weights[0] = 0.5f; weights[1] = 0.5f; weights[2] = 0.0f;
+        return;
+    }
+    int k = parent_size/2;
+    float scale = 1.0f/parent_size;
+    taps[0] = 2*i; taps[1] = 2*i + 1; taps[2] = 2*i + 2;
+    weights[0] = (k - i)*scale; weights[1] = k*scale; weights[2] = (i + 1)*scale;
+}
+
+/**
+ * Texel coordinate moved into [0, size), c within one texel of that range
+ * (the samplers wrap or clamp texture coordinates to [0, 1] first)
+ */
+inline int wrapCoord(int c, int size, bool repeat){
+    if(c < 0) return repeat? c + size: 0;
+    if(c >= size) return repeat? c - size: size - 1;
+    return c;
+}
+
+inline Float4 fetch(const LevelView& level, int x, int y, bool repeat){
+    x = wrapCoord(x, level.width, repeat);
+    y = wrapCoord(y, level.height, repeat);
+    return Float4::load(level.base + texelOffset(level.tiles_x, x, y));
+}
+
+/**
+ * Filter one level at (x, y), in texels of that level
+ */
+inline Float4 filterLevel(const LevelView& level, float x, float y, bool bilinear, bool repeat){
+    if(!bilinear) return fetch(level, (int)floorf(x), (int)floorf(y), repeat);
+    x -= 0.5f;
+    y -= 0.5f;
+    float fx = floorf(x), fy = floorf(y);
+    int x0 = (int)fx, y0 = (int)fy;
+    Float4 ax(x - fx), ay(y - fy);
+    Float4 top = fetch(level, x0, y0, repeat), bottom = fetch(level, x0, y0 + 1, repeat);
+    top = top + ax*(fetch(level, x0 + 1, y0, repeat) - top);
+    bottom = bottom + ax*(fetch(level, x0 + 1, y0 + 1, repeat) - bottom);
+    return top + ay*(bottom - top);
+}
+
+}
+
+/**
+ * 1x1 transparent black texture, bilinear and repeating
+ */
+Texture::Texture(){
+    texels = nullptr;
+    filter = TEXTURE_BILINEAR;
+    wrap = TEXTURE_REPEAT;
+    resize(1, 1);
+}
+
+Texture::Texture(int width, int height){
+    texels = nullptr;
+    filter = TEXTURE_BILINEAR;
+    wrap = TEXTURE_REPEAT;
+    resize(width, height);
+}
+
+/**
+ * Reallocate as a single level, transparent black
+ * @param width texels per row, at least 1
+ * @param height rows, at least 1
+ */
+void Texture::resize(int width, int height){
+    levels[0].width = std::max(1, width);
+    levels[0].height = std::max(1, height);
+    allocate(1);
+}
+
+/**
+ * Lay out count levels halving the size of level 0, and zero every texel
+ */
+void Texture::allocate(int count){
+    level_count = count;
+    size_t floats = 0;
+    for(int l = 0; l < count; l++){
+        Level& level = levels[l];
+        if(l > 0){
+            level.width = std::max(1, levels[l - 1].width/2);
+            level.height = std::max(1, levels[l - 1].height/2);
+        }
+        level.tiles_x = (level.width + TEXTURE_TILE_SIZE - 1)/TEXTURE_TILE_SIZE;
+        int tiles_y = (level.height + TEXTURE_TILE_SIZE - 1)/TEXTURE_TILE_SIZE;
+        level.offset = floats;
+        floats += (size_t)level.tiles_x*tiles_y*TEXTURE_TILE_TEXELS*4;
+    }
+    std::vector<char>().swap(storage);
+    storage.assign(floats*sizeof(float) + TEXTURE_ALIGNMENT, 0);
+    uintptr_t base = (uintptr_t)storage.data();
+    texels = (float*)((base + TEXTURE_ALIGNMENT - 1)/TEXTURE_ALIGNMENT*TEXTURE_ALIGNMENT);
+}
+
+/**
+ * Replace the texture by an image, as a single level
+ * @param rgba 4 floats per pixel, rows top to bottom
+ * @param width pixels per row
+ * @param height rows
+ * @return false when the image is empty
+ */
+bool Texture::setPixels(const float* rgba, int width, int height){
+    if(rgba == nullptr || width <= 0 || height <= 0){
+        std::cout << "Warning: texture image of " << width << "x" << height << " texels is empty\n";
+        return false;
+    }
+    resize(width, height);
+    for(int y = 0; y < height; y++){
+        for(int x = 0; x < width; x++) setTexel(x, y, rgba + 4*((size_t)y*width + x));
+    }
+    return true;
+}
+
+/**
+ * Rebuild every level below level 0 down to 1x1, each texel the mean of its
+ * 2x2 parent texels. Odd sizes use 3 taps along that axis so every parent
+ * texel contributes to the level below. Levels are built one after the other,
+ * the tile rows of a level in parallel.
+ */
+void Texture::buildMipmaps(JobSystem& jobs){
+    PROFILE_ZONE("Texture::buildMipmaps");
+    int count = 1;
+    for(int size = std::max(levels[0].width, levels[0].height); size > 1; size /= 2) count++;
+    count = std::min(count, TEXTURE_MAX_LEVELS);
+    Level first = levels[0];
+    size_t first_floats = (size_t)first.tiles_x*((first.height + TEXTURE_TILE_SIZE - 1)/TEXTURE_TILE_SIZE)
+                          *TEXTURE_TILE_TEXELS*4;
+    std::vector<float> base(texels, texels + first_floats);
+    allocate(count);
+    memcpy(texels, base.data(), first_floats*sizeof(float));
+
+    for(int l = 1; l < count; l++){
+        const Level& parent = levels[l - 1];
+        const Level& level = levels[l];
+        int tiles_y = (level.height + TEXTURE_TILE_SIZE - 1)/TEXTURE_TILE_SIZE;
+        jobs.parallelFor(0, tiles_y, [&](size_t begin, size_t end){
+            int y_end = std::min(level.height, (int)end*TEXTURE_TILE_SIZE);
+            const float* p = texels + parent.offset;
+            for(int y = (int)begin*TEXTURE_TILE_SIZE; y < y_end; y++){
+                int rows[3], cols[3];
+                float wy[3], wx[3];
+                reductionTaps(y, parent.height, rows, wy);
+                for(int x = 0; x < level.width; x++){
+                    reductionTaps(x, parent.width, cols, wx);
+                    Float4 sum(0.0f);
+                    for(int j = 0; j < 3; j++){
+                        if(wy[j] == 0.0f) continue;
+                        for(int i = 0; i < 3; i++){
+                            if(wx[i] == 0.0f) continue;
+                            sum = sum + Float4(wx[i]*wy[j])*Float4::load(p + texelOffset(parent.tiles_x, cols[i], rows[j]));
+                        }
+                    }
+                    sum.store(texels + level.offset + texelOffset(level.tiles_x, x, y));
+                }
+            }
+        }, 1);
+    }
+}
+
+float* Texture::texel(int level, int x, int y){
+    return texels + levels[level].offset + texelOffset(levels[level].tiles_x, x, y);
+}
+
+const float* Texture::texel(int level, int x, int y) const{
+    return texels + levels[level].offset + texelOffset(levels[level].tiles_x, x, y);
+}
+
+void Texture::setTexel(int x, int y, const float rgba[4], int level){
+    if(level < 0 || level >= level_count || x < 0 || y < 0 || x >= levels[level].width || y >= levels[level].height){
+        std::cout << "Warning: texel (" << x << ", " << y << ") of level " << level << " is out of the texture\n";
+        return;
+    }
+    float* t = texel(level, x, y);
+    for(int c = 0; c < 4; c++) t[c] = rgba[c];
+}
+
+/**
+ * @param rgba set to transparent black out of the texture
+ */
+void Texture::getTexel(int x, int y, float rgba[4], int level) const{
+    if(level < 0 || level >= level_count || x < 0 || y < 0 || x >= levels[level].width || y >= levels[level].height){
+        for(int c = 0; c < 4; c++) rgba[c] = 0;
+        return;
+    }
+    const float* t = texel(level, x, y);
+    for(int c = 0; c < 4; c++) rgba[c] = t[c];
+}
+
+void Texture::setFilter(TextureFilter f){
+    filter = f;
+}
+
+void Texture::setWrap(TextureWrap w){
+    wrap = w;
+}
+
+/**
+ * Level of detail of a screen space footprint
+ * @param dudx, dvdx change of the texture coordinates one pixel to the right
+ * @param dudy, dvdy change of the texture coordinates one pixel down
+ * @return log2 of the longest footprint axis in level 0 texels, 0 when one pixel covers one texel
+ */
+float Texture::computeLod(float dudx, float dvdx, float dudy, float dvdy) const{
+    float w = (float)levels[0].width, h = (float)levels[0].height;
+    float x = dudx*dudx*w*w + dvdx*dvdx*h*h;
+    float y = dudy*dudy*w*w + dvdy*dvdy*h*h;
+    return 0.5f*log2f(std::max(x, y));
+}
+
+/**
+ * Filtered color at a point of the texture
+ * @param u, v texture coordinates
+ * @param lod level of detail, see computeLod(); 0 or less samples level 0
+ * @param rgba filtered color
+ */
+void Texture::sample(float u, float v, float lod, float rgba[4]) const{
+    bool repeat = wrap == TEXTURE_REPEAT;
+    if(repeat){
+        u -= floorf(u);
+        v -= floorf(v);
+    }
+    else{
+        u = std::min(std::max(u, 0.0f), 1.0f);
+        v = std::min(std::max(v, 0.0f), 1.0f);
+    }
+    float top = (float)(level_count - 1);
+    lod = lod > 0? std::min(lod, top): 0.0f; //NaN goes to level 0
+    int l0 = filter == TEXTURE_TRILINEAR? (int)lod: (int)(lod + 0.5f);
+    float blend = filter == TEXTURE_TRILINEAR? lod - l0: 0.0f;
+    bool bilinear = filter != TEXTURE_NEAREST;
+
+    const Level& a = levels[l0];
+    LevelView view = {texels + a.offset, a.width, a.height, a.tiles_x};
+    Float4 color = filterLevel(view, u*a.width, v*a.height, bilinear, repeat);
+    if(blend > 0){
+        const Level& b = levels[l0 + 1];
+        LevelView next = {texels + b.offset, b.width, b.height, b.tiles_x};
+        color = color + Float4(blend)*(filterLevel(next, u*b.width, v*b.height, bilinear, repeat) - color);
+    }
+    color.store(rgba);
+}
+
+/**
+ * Filtered colors at 4 points, for shading 4 fragments at once. The wrapping,
+ * level selection and texel coordinates are computed 4 lanes wide, the texels
+ * are blended as RGBA vectors and returned as one stream per channel.
+ * Results match sample() exactly.
+ */
+void Texture::sample4(const float u[4], const float v[4], const float lod[4],
+                      float r[4], float g[4], float b[4], float a[4]) const{
+    bool repeat = wrap == TEXTURE_REPEAT;
+    bool bilinear = filter != TEXTURE_NEAREST;
+    bool trilinear = filter == TEXTURE_TRILINEAR;
+    Float4 zero(0.0f), one(1.0f), half(0.5f);
+    Float4 U = Float4::load(u), V = Float4::load(v);
+    if(repeat){
+        U = U - floor(U);
+        V = V - floor(V);
+    }
+    else{
+        U = min(max(U, zero), one);
+        V = min(max(V, zero), one);
+    }
+    Float4 L = min(max(Float4::load(lod), zero), Float4((float)(level_count - 1)));
+    Float4 L0 = trilinear? floor(L): floor(L + half);
+    float level0[4], blend[4];
+    L0.store(level0);
+    (trilinear? L - L0: zero).store(blend);
+
+    Float4 color[4];
+    for(int pass = 0; pass < 2; pass++){
+        if(pass == 1 && !trilinear) break;
+        LevelView views[4];
+        float w[4], h[4];
+        for(int lane = 0; lane < 4; lane++){
+            int l = std::min((int)level0[lane] + pass, level_count - 1);
+            const Level& level = levels[l];
+            views[lane] = LevelView{texels + level.offset, level.width, level.height, level.tiles_x};
+            w[lane] = (float)level.width;
+            h[lane] = (float)level.height;
+        }
+        Float4 X = U*Float4::load(w), Y = V*Float4::load(h);
+        if(bilinear){
+            X = X - half;
+            Y = Y - half;
+        }
+        Float4 FX = floor(X), FY = floor(Y);
+        float fx[4], fy[4], ax[4], ay[4];
+        FX.store(fx); FY.store(fy);
+        (X - FX).store(ax); (Y - FY).store(ay);
+        for(int lane = 0; lane < 4; lane++){
+            Float4 c;
+            const LevelView& view = views[lane];
+            int x0 = (int)fx[lane], y0 = (int)fy[lane];
+            if(!bilinear) c = fetch(view, x0, y0, repeat);
+            else{
+                Float4 wx(ax[lane]), wy(ay[lane]);
+                Float4 top = fetch(view, x0, y0, repeat), bottom = fetch(view, x0, y0 + 1, repeat);
+                top = top + wx*(fetch(view, x0 + 1, y0, repeat) - top);
+                bottom = bottom + wx*(fetch(view, x0 + 1, y0 + 1, repeat) - bottom);
+                c = top + wy*(bottom - top);
+            }
+            if(pass == 0) color[lane] = c;
+            else if(blend[lane] > 0) color[lane] = color[lane] + Float4(blend[lane])*(c - color[lane]);
+        }
+    }
+    transpose(color[0], color[1], color[2], color[3]);
+    color[0].store(r);
+    color[1].store(g);
+    color[2].store(b);
+    color[3].store(a);
+}
+
+int Texture::getWidth(int level) const{
+    return level >= 0 && level < level_count? levels[level].width: 0;
+}
+
+int Texture::getHeight(int level) const{
+    return level >= 0 && level < level_count? levels[level].height: 0;
+}
+
+int Texture::levelCount() const{
+    return level_count;
+}
@@ -0,0 +1,83 @@
+#ifndef GRAPHICSENGINE3D_TEXTURE_H
+#define GRAPHICSENGINE3D_TEXTURE_H
+
+#include <stddef.h>
+#include <vector>
+#include "jobsystem.h"
+
+const int TEXTURE_TILE_SIZE = 8; //texels per side of a tile, a power of 2
+const int TEXTURE_TILE_TEXELS = TEXTURE_TILE_SIZE*TEXTURE_TILE_SIZE;
+const int TEXTURE_MAX_LEVELS = 16; //enough for 32768 texels per side
+const size_t TEXTURE_ALIGNMENT = 64;
+
+/**
+ * TEXTURE_NEAREST nearest texel of the nearest level
+ * TEXTURE_BILINEAR 2x2 texels of the nearest level
+ * TEXTURE_TRILINEAR 2x2 texels of the two nearest levels, blended by the fractional level
+ */
+enum TextureFilter{
+    TEXTURE_NEAREST,
+    TEXTURE_BILINEAR,
+    TEXTURE_TRILINEAR
+};
+
+enum TextureWrap{
+    TEXTURE_REPEAT,
+    TEXTURE_CLAMP
+};
+
+/**
+ * Linear RGBA float texture with a mip chain.
+ * Every level is stored in square tiles of TEXTURE_TILE_SIZE^2 texels, tiles
+ * row by row, and the texels of a tile in Morton (Z) order, 4 floats each.
+ * The 2x2 footprint of a bilinear fetch at even coordinates is one 64 byte
+ * cache line, and neighbours in any direction are close in memory, so sampling
+ * along a rotated or sheared span touches about as many lines as along a row.
+ * Texture coordinates are in [0, 1] over the whole texture, (0, 0) at the top
+ * left corner of the first row, texel centers at half integers times the texel size.
+ */
+class Texture{
+public:
+    Texture();
+    Texture(int width, int height);
+    Texture(const Texture&) = delete; //texels points into this object's own storage
+    Texture& operator=(const Texture&) = delete;
+    Texture(Texture&&) = default;
+    Texture& operator=(Texture&&) = default;
+    void resize(int width, int height);
+    bool setPixels(const float* rgba, int width, int height);
+    void buildMipmaps(JobSystem& jobs);
+
+    void setTexel(int x, int y, const float rgba[4], int level = 0);
+    void getTexel(int x, int y, float rgba[4], int level = 0) const;
+    void setFilter(TextureFilter filter);
+    void setWrap(TextureWrap wrap);
+
+    float computeLod(float dudx, float dvdx, float dudy, float dvdy) const;
+    void sample(float u, float v, float lod, float rgba[4]) const;
+    void sample4(const float u[4], const float v[4], const float lod[4],
+                 float r[4], float g[4], float b[4], float a[4]) const;
+
+    int getWidth(int level = 0) const;
+    int getHeight(int level = 0) const;
+    int levelCount() const;
+private:
+    struct Level{
+        int width;
+        int height;
+        int tiles_x;
+        size_t offset; //first float of the level in texels
+    };
+    Level levels[TEXTURE_MAX_LEVELS];
+    int level_count;
+    std::vector<char> storage;
+    float* texels; //aligned start of storage
+    TextureFilter filter;
+    TextureWrap wrap;
+
+    void allocate(int count);
+    float* texel(int level, int x, int y);
+    const float* texel(int level, int x, int y) const;
+};
+
+#endif //GRAPHICSENGINE3D_TEXTURE_H
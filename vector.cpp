@@ -5,6 +5,21 @@
 
 //Implementation Details of Float Vector 'Vectorf<N>' objects.
 
+namespace {
+
+/**
+ * Index of the coordinate normal to a standard 3d plane "xy"/"z", "xz"/"y" or "yz"/"x"
+ * @return the axis, -1 for an invalid plane
+ */
+int planeAxis(const std::string& plane){
+    if(plane == "xy" || plane == "z") return 2;
+    if(plane == "xz" || plane == "y") return 1;
+    if(plane == "yz" || plane == "x") return 0;
+    return -1;
+}
+
+}
+
 /**
  * Default intialization of N-dimensional Vector of floats.
  * Initalized to zero vector, with default 0 collision.
@@ -12,12 +27,9 @@
  */
 template<size_t N>
 Vectorf<N>::Vectorf() {
-    float new_pos[N];
-    for(int i = 0; i < N; i++){
-        new_pos[i] = 0;
+    for(size_t i = 0; i <= N; i++){
+        pos[i] = 0;
     }
-    pos = new_pos;
-    e = 0;
 }
 
 /**
@@ -29,36 +41,24 @@ Vectorf<N>::Vectorf() {
  */
 template<size_t N>
 Vectorf<N>::Vectorf(std::initializer_list<float> input) {
-    float new_pos[N];
-    int cur_index = 0;
+    size_t cur_index = 0;
     for(auto coord: input){
-        if(cur_index < N)new_pos[cur_index] = coord;
-        else{ e = coord;}
-        cur_index++;
-        if(cur_index == N) break;
-    }
-
-    for(int i = 0; i < N-cur_index; i++){
-        new_pos[i] = 0.0; // if not enough positions are specified set to 0
+        if(cur_index > N) break; //truncate extra coordinates
+        pos[cur_index++] = coord;
     }
-    //if not enough parameters are specified, set collision to 0
-    if(cur_index < N){
-        e = 0;
+    for(; cur_index <= N; cur_index++){
+        pos[cur_index] = 0.0; // if not enough positions are specified set to 0
     }
-    pos = new_pos;
 }
 /**
  * Get the position array of the vector with the collision parameter appended
  * at the end of the array
  * @tparam N dimension of the vector
- * @return float array of position and (last index)collision
+ * @return float array of position and (last index)collision, valid while the vector is
  */
 template<size_t N>
 float *Vectorf<N>::get() {
-    float tup[N+1];
-    tup = pos;
-    tup[N] = e;
-    return tup;
+    return pos;
 }
 
 /**
@@ -69,11 +69,11 @@ float *Vectorf<N>::get() {
  */
 template<size_t N>
 Vectorf<N> Vectorf<N>::operator+(Vectorf<N> V) {
-    float new_pos[N];
-    for(int i = 0; i < N; i++){
-        new_pos[i] = pos[i]+V.pos[i];
+    Vectorf<N> sum;
+    for(size_t i = 0; i < N; i++){
+        sum.pos[i] = pos[i]+V.pos[i];
     }
-    return Vectorf<N>{*new_pos};
+    return sum;
 }
 
 /**
@@ -84,11 +84,11 @@ Vectorf<N> Vectorf<N>::operator+(Vectorf<N> V) {
  */
 template<size_t N>
 Vectorf<N> Vectorf<N>::operator-(Vectorf<N> V) {
-    float new_pos[N];
-    for(int i = 0; i < N; i++){
-        new_pos[i] = pos[i] - V.pos[i];
+    Vectorf<N> difference;
+    for(size_t i = 0; i < N; i++){
+        difference.pos[i] = pos[i] - V.pos[i];
     }
-    return Vectorf<N>{*new_pos};
+    return difference;
 }
 
 /**
@@ -99,10 +99,11 @@ Vectorf<N> Vectorf<N>::operator-(Vectorf<N> V) {
  */
 template<size_t N>
 float Vectorf<N>::operator*(Vectorf<N> V) {
-    int sum = 0;
-    for(int i = 0; i < N; i++){
-        sum+= pos[i]*V.pos[i];
+    float sum = 0;
+    for(size_t i = 0; i < N; i++){
+        sum += pos[i]*V.pos[i];
     }
+    return sum;
 }
 /**
  * Standard n-dimensional cross product of vectors.
@@ -116,20 +117,19 @@ template<size_t N>
 Vectorf<N> Vectorf<N>::operator^(Vectorf<N> V) {
     if(N > 3 || N == 2){
         std::cout << "Warning: cross product called on vector of invalid dimension " << N
-        << " returning original vector.";
-        return this;
+        << " returning original vector.\n";
+        return *this;
     }
-    if(N== 1){
-        return Vectorf<1>{pos[0]*V.pos[1]}; //return dot product
+    Vectorf<N> cross;
+    if(N == 1){
+        cross.pos[0] = pos[0]*V.pos[0]; //return dot product
+        return cross;
     }
-
-    if(N==3){
-        float new_pos[N];
-        new_pos[0] = pos[1]*V.pos[2] - pos[2]*V.pos[1];
-        new_pos[1] = pos[0]*V.pos[2] - pos[2]*V.pos[0];
-        new_pos[2] = pos[0]*V.pos[1] - pos[1]*V.pos[0];
-        return Vectorf<N>{*new_pos};
+    for(size_t i = 0; i < N; i++){
+        size_t j = (i + 1)%N, k = (i + 2)%N;
+        cross.pos[i] = pos[j]*V.pos[k] - pos[k]*V.pos[j];
     }
+    return cross;
 }
 /**
  * Calculate norm of n-dimensional float vector
@@ -138,7 +138,7 @@ Vectorf<N> Vectorf<N>::operator^(Vectorf<N> V) {
  */
 template<size_t N>
 float Vectorf<N>::norm(){
-   return sqrt(norm2());
+   return sqrtf(norm2());
 }
 
 /**
@@ -150,7 +150,7 @@ float Vectorf<N>::norm(){
 template<size_t N>
 float Vectorf<N>::norm2(){
     float val = 0;
-    for(int i = 0; i < N; i++){ val += pow(pos[i],2);}
+    for(size_t i = 0; i < N; i++){ val += pos[i]*pos[i];}
     return val;
 }
 
@@ -163,11 +163,11 @@ float Vectorf<N>::norm2(){
  */
 template<size_t N>
 Vectorf<N> operator*(float c, Vectorf<N> V) {
-    float new_pos[N];
-    for(int i = 0; i < N; i++){
-        new_pos[i] = c* V.pos[i];
+    Vectorf<N> scaled = V;
+    for(size_t i = 0; i < N; i++){
+        scaled.pos[i] = c* V.pos[i];
     }
-    return Vectorf<N>{*new_pos, V.e}; //TODO: depending on future implementation c*e
+    return scaled;
 }
 
 /**
@@ -178,8 +178,8 @@ Vectorf<N> operator*(float c, Vectorf<N> V) {
  */
 template<size_t N>
 bool Vectorf<N>::operator<(Vectorf<N> V){
-    for(int i = 0; i < N; i++){
-        if(!(sgn(pos[i]) == sgn(V.pos[i]) && abs(pos[i]) < abs(V.pos[i]))) return false;
+    for(size_t i = 0; i < N; i++){
+        if(!(sgn(pos[i]) == sgn(V.pos[i]) && fabsf(pos[i]) < fabsf(V.pos[i]))) return false;
     }
     return true;
 }
@@ -192,7 +192,7 @@ bool Vectorf<N>::operator<(Vectorf<N> V){
  */
 template<size_t N>
 bool Vectorf<N>::operator<(float dist){
-    return norm2() < pow(dist,2);
+    return norm2() < dist*dist;
 }
 
 /**
@@ -205,40 +205,29 @@ bool Vectorf<N>::operator<(float dist){
 template<size_t N>
 std::ostream &operator<<(std::ostream &os, Vectorf<N> V) {
     os << "Position : ";
-    for(int i = 0; i < N; i ++){
+    for(size_t i = 0; i < N; i ++){
         os << V.pos[i]<<" , ";
     }
-    os << "Collision : " << V.e;
+    os << "Collision : " << V.pos[N];
+    return os;
 }
 
 /**
  * Return a vector that is the normalized vector of the input
  * @tparam N dimension of the vector
- * @return the normalized vector
+ * @return the normalized vector, the vector itself when it is zero
  */
 template<size_t N>
 Vectorf<N> Vectorf<N>::normalize() {
-    float min_val = 0.0;
-    for(int i = 0; i < N; i++){
-        if(pos[i] < min_val) min_val = pos[i];
-    }
-
-    //now sum
-    float sum = 0.0;
-    for(int i = 0; i < N; i++){
-        sum += min_val+pos[i];
-    }
-
-    float new_pos[N];
-    for(int i = 0; i < N; i++){
-        new_pos = (pos[i]+min_val)/sum;
-    }
-    return Vectorf<N>{*new_pos};
+    float length = norm();
+    if(length == 0) return *this;
+    return (1/length)*(*this);
 }
 
 /**
  * 3d Rotation of a 3d vector about orthonormal planes "xy", "yz" and "xz".
  * Alternatively, you can specify a rotation direction "z", "x and "y".
+ * Rotations are counter clockwise seen from the positive side of the axis.
  * @tparam N dimension of the vector to rotate
  * @param plane the string identifier for which standard orthonormal
  * plane to rotate the vector about
@@ -248,33 +237,25 @@ Vectorf<N> Vectorf<N>::normalize() {
 template<size_t N>
 Vectorf<N> Vectorf<N>::rotate3(std::string&plane, float radians) {
     if(N != 3){
-        std::cout << "Warning: called 3d rotate on non 3d vector. Returning input vector.";
-        return this;
-    }
-    float ccos = std::cos(radians);
-    float csin = std::sin(radians);
-    if(plane == "xy" || plane == "z"){
-        Matrixf<N> I = new Matrixf<N>();
-        Matrixf<N> S{0.0, 0.0, -1.0, 0.0, 0.0, 1.0, 1.0, -1.0, 1.0};
-        return (I+(csin*S)*this + (1-ccos*S^2))*this;
-    }
-    if(plane == "yz" || plane == "x"){
-        Matrixf<N> I = new Matrixf<N>();
-        Matrixf<N> S{1.0 , 1.0, -1.0, -1.0, 0, 0, 1.0, 0.0, 0.0};
-        return (I+(csin*S)*this + (1-ccos*S^2))*this;
-    }
-    if(plane == "xz" || plane == "y"){
-        Matrixf<N> I = new Matrixf<N>();
-        Matrixf<N> S{0.0 , 1.0, -0.0, -1.0, 0.0, 1.0, 0.0, -1.0, 0.0};
-        return (I+(csin*S)*this + (1-ccos*S^2))*this;
-    }
-    std::cout << "Warning: invalid 3d plane or direction provided. Returning input vector.";
-    return this;
-
+        std::cout << "Warning: called 3d rotate on non 3d vector. Returning input vector.\n";
+        return *this;
+    }
+    int axis = planeAxis(plane);
+    if(axis < 0){
+        std::cout << "Warning: invalid 3d plane or direction provided. Returning input vector.\n";
+        return *this;
+    }
+    size_t a = (axis + 1)%3, b = (axis + 2)%3; //rotates a towards b
+    float ccos = cosf(radians);
+    float csin = sinf(radians);
+    Vectorf<N> rotated = *this;
+    rotated.pos[a] = ccos*pos[a] - csin*pos[b];
+    rotated.pos[b] = csin*pos[a] + ccos*pos[b];
+    return rotated;
 }
 
 /**
- * general 3D rotation of 3D vector about provided axis.
+ * general 3D rotation of 3D vector about provided axis, Rodrigues' formula.
  * Should only be used if necessary otherwise rotate3 should be used
  * for rotation about the standard orthonormal axes.
  * @tparam N dimension of the vector
@@ -285,16 +266,17 @@ Vectorf<N> Vectorf<N>::rotate3(std::string&plane, float radians) {
 template<size_t N>
 Vectorf<N> Vectorf<N>::gRotate3(float axis[3], float radians) {
     if(N!= 3){
-        std::cout << "Warning: called 3d rotate on non 3d vector. Returning input vector.";
-        return this;
-    }
-    float ccos = std::cos(radians);
-    float csin = std::sin(radians);
-    float x = axis[0]; float y = axis[1]; float z = axis[2];
-    Matrixf<N> R{ccos + pow(x,2)*(1-ccos), x*y*(1-ccos)+z*csin, z*x*(1-ccos) -y*csin,
-                 x*y*(1-ccos)+z*csin, ccos+pow(y,2)*(1-ccos), y*z*(1-ccos) - x*csin,
-                 x*z*(1-ccos)+y*csin, y*z*(1-ccos) - x*csin, ccos+pow(z,2)*(1-ccos)};
-    return R*this;
+        std::cout << "Warning: called 3d rotate on non 3d vector. Returning input vector.\n";
+        return *this;
+    }
+    float ccos = cosf(radians);
+    float csin = sinf(radians);
+    Vectorf<N> k;
+    for(size_t i = 0; i < N; i++) k.pos[i] = axis[i];
+    float along = (k*(*this))*(1 - ccos);
+    Vectorf<N> rotated = ccos*(*this) + csin*(k^(*this)) + along*k;
+    rotated.pos[N] = pos[N];
+    return rotated;
 }
 
 /**
@@ -302,29 +284,20 @@ Vectorf<N> Vectorf<N>::gRotate3(float axis[3], float radians) {
  * The plane can be "xy"/"z" or "yz"/"x" or "xz"/"y".
  * @tparam N
  * @param plane the string representation of a standard plane.
- * @return
+ * @return the reflected vector
  */
 template<size_t N>
 Vectorf<N> Vectorf<N>::reflect3(std::string& plane) {
     if(N!=3) {
         std::cout << "Warning: 3D reflect method called on non-3D vector"
-        <<"Returning initial vector.";
-        return this;
-    }
-    Vectorf<N> Normal;
-    if(plane == "xy" || plane == "z"){
-        Normal = new Vectorf<N>{0,0,1};
-    }
-    if(plane == "xz" || plane == "y"){
-        Normal = new Vectorf<N>{0,1,0};
-    }
-    if(plane == "yz" || plane == "x"){
-        Normal = new Vectorf<N>{1,0,0};
-    }
-    Matrixf<N> I = new Matrixf<N>();
-    Matrixf<N> T = I.mProduct(N,N);
-    return (I - 2*T)*this;
-
+        <<"Returning initial vector.\n";
+        return *this;
+    }
+    int axis = planeAxis(plane);
+    Vectorf<N> reflected = *this;
+    if(axis < 0) std::cout << "Warning: invalid 3d plane provided. Returning initial vector.\n";
+    else reflected.pos[axis] = -pos[axis];
+    return reflected;
 }
 
 /**
@@ -339,18 +312,20 @@ template<size_t N>
 Vectorf<N> Vectorf<N>::gReflect3(float normal[N]) {
     if(N != 3){
         std::cout << "Warning: general 3D reflect method called on non-3D vector"
-                  <<"Returning initial vector.";
-        return this;
-    }
-    float x = normal[0]; float y = normal[1]; float z = normal[2];
-    Matrixf<N> R = Matrixf<N>{1-std::pow(x,2), -x*y, -x*z,
-                              -x*y, 1-std::pow(y,2), -y*z,
-                              -x*z, -y*z, 1-std::pow(z,2)};
-    return R*this;
+                  <<"Returning initial vector.\n";
+        return *this;
+    }
+    Vectorf<N> n;
+    for(size_t i = 0; i < N; i++) n.pos[i] = normal[i];
+    Vectorf<N> reflected = *this - (2*(n*(*this)))*n;
+    reflected.pos[N] = pos[N];
+    return reflected;
 }
 
 /**
- * Scale a vector in the direction in a direction vector D by an amount vector S
+ * Scale a vector in the direction in a direction vector D by an amount vector S.
+ * The orthonormal frame is built from D then the standard axes (Gram-Schmidt),
+ * and the vector's coordinate along its i-th axis is scaled by S[i].
  * @tparam N dimension of the vectors in input
  * @param D direction vector specifying the direction to scale in
  * @param S scale vector specying the amounts to scale in for each coordinate
@@ -358,25 +333,20 @@ Vectorf<N> Vectorf<N>::gReflect3(float normal[N]) {
  */
 template<size_t N>
 Vectorf<N> Vectorf<N>::scale(Vectorf<N> D, Vectorf<N> S){
-
-    Matrixf<N> sM;
-    Matrixf<N> M;
-    Matrixf<N> Mt;
-    float sElems[N*N];
-    float mElems[N*N];
-    float mtElems[N*N];
-    for(int i = 0; i < N; i++){
-        for(int j = 0; j < N; j++){
-            sElems[i*N+j] = 0.0;
-            mElems[i*N+j] = 0.0;
-            mtElems[i*N+j] = 0.0;
-
-            if(i == j) sElems[i*N+j] = S.pos[i];
-
-        }
-    }
-
-    return ((M*S)*Mt)*this;
+    Vectorf<N> frame[N];
+    size_t count = 0;
+    for(size_t c = 0; c <= N && count < N; c++){
+        Vectorf<N> axis;
+        if(c == 0) axis = D;
+        else axis.pos[c - 1] = 1;
+        for(size_t k = 0; k < count; k++) axis = axis - (frame[k]*axis)*frame[k];
+        if(axis.norm2() < 1e-12f) continue; //D was zero or along a standard axis
+        frame[count++] = axis.normalize();
+    }
+    Vectorf<N> scaled;
+    for(size_t k = 0; k < N; k++) scaled = scaled + (S.pos[k]*(frame[k]*(*this)))*frame[k];
+    scaled.pos[N] = pos[N];
+    return scaled;
 }
 
 /**
@@ -391,23 +361,14 @@ Vectorf<N> Vectorf<N>::orthoProject3(std::string &plane) {
     if(N!=3) {
         std::cout << "Warning: 3D orthogonal plane projection "
                     << "called on non-3D vector"
-                    <<"Returning initial vector.";
-        return this;
-    }
-    Vectorf<N> Normal;
-    Vectorf<N> P = new Vectorf<N>{0,0,0}; //point on the plane
-    if(plane == "xy" || plane == "z"){
-        Normal = new Vectorf<N>{0,0,1};
-    }
-    if(plane == "xz" || plane == "y"){
-        Normal = new Vectorf<N>{0,1,0};
-    }
-    if(plane == "yz" || plane == "x"){
-        Normal = new Vectorf<N>{1,0,0};
-    }
-    Matrixf<N> I = new Matrixf<N>();
-    Matrixf<N> T = I.mProduct(N,N);
-    return (I - T)*this + (T)*P;
+                    <<"Returning initial vector.\n";
+        return *this;
+    }
+    int axis = planeAxis(plane);
+    Vectorf<N> projected = *this;
+    if(axis < 0) std::cout << "Warning: invalid 3d plane provided. Returning initial vector.\n";
+    else projected.pos[axis] = 0;
+    return projected;
 }
 /**
  * 3D oblique projection of a vector onto a plane identified by
@@ -423,22 +384,18 @@ Vectorf<N> Vectorf<N>::oblProject3(std::string &plane, Vectorf<N> D) {
     if(N!=3) {
         std::cout << "Warning: 3D oblique plane projection "
                   << "called on non-3D vector"
-                  <<"Returning initial vector.";
-        return this;
-    }
-    Vectorf<N> Normal;
-    Vectorf<N> P = new Vectorf<N>{0,0,0}; //point on the plane
-    if(plane == "xy" || plane == "z"){
-        Normal = new Vectorf<N>{0,0,1};
-    }
-    if(plane == "xz" || plane == "y"){
-        Normal = new Vectorf<N>{0,1,0};
-    }
-    if(plane == "yz" || plane == "x"){
-        Normal = new Vectorf<N>{1,0,0};
-    }
-    Matrixf<N> I = new Matrixf<N>();
-    return (I - (1/(D*N))*I.mproduct(D,N))*this + ((1/(D*N))*I.mproduct(D,N))*P;
+                  <<"Returning initial vector.\n";
+        return *this;
+    }
+    int axis = planeAxis(plane);
+    if(axis < 0 || D.pos[axis] == 0){
+        std::cout << "Warning: invalid 3d plane or direction parallel to it. Returning initial vector.\n";
+        return *this;
+    }
+    Vectorf<N> projected = *this - (pos[axis]/D.pos[axis])*D;
+    projected.pos[axis] = 0;
+    projected.pos[N] = pos[N];
+    return projected;
 }
 
 
@@ -448,13 +405,20 @@ Vectorf<N> Vectorf<N>::oblProject3(std::string &plane, Vectorf<N> D) {
  * @param E the Eye point E of the projection
  * @param P a known point of the plane
  * @param Normal normal vector to the plane
- * @return the perspective projected vector from the eye point onto the plane
+ * @return the perspective projected vector from the eye point onto the plane,
+ * the vector itself when the line of sight is parallel to the plane
+ * For whole vertex arrays use projectVertices (projection.h) instead.
  */
 template<size_t N>
 Vectorf<N> Vectorf<N>::pProject(Vectorf<N> E, Vectorf<N> P, Vectorf<N> Normal) {
-
-    float t = (N*(E-P))/(N*(this-E));
-    return E+t*(this-E);
+    Vectorf<N> sight = *this - E;
+    float denominator = Normal*sight;
+    if(denominator == 0){
+        std::cout << "Warning: line of sight parallel to the projection plane. Returning initial vector.\n";
+        return *this;
+    }
+    float t = (Normal*(P - E))/denominator;
+    return E + t*sight;
 }
 
 template<size_t N>
@@ -467,11 +431,25 @@ Vectorf<N> Vectorf<N>::AffineDsum(int n, float *d, Vectorf<N> *Q) {
     return Vectorf<N>();
 }
 
+/**
+ * Copy of a vector. The dimension of a Vectorf is fixed at compile time, so
+ * dim must be N: anything else is reported and ignored.
+ */
 template<size_t N>
 Vectorf<N> extend(Vectorf<N> V, size_t dim) {
-    return Vectorf<N + dim-N>{*V.pos};
+    if(dim != N) std::cout << "Warning: cannot extend a " << N << " dimensional vector to " << dim << "\n";
+    return V;
 }
 
-
-
-
+// ====== Instantiations ======
+
+#define GRAPHICSENGINE3D_VECTORF(n) \
+template class Vectorf<n>; \
+template Vectorf<n> operator*(float c, Vectorf<n> V); \
+template std::ostream &operator<<(std::ostream &os, Vectorf<n> V); \
+template Vectorf<n> extend(Vectorf<n> V, size_t dim);
+GRAPHICSENGINE3D_VECTORF(1)
+GRAPHICSENGINE3D_VECTORF(2)
+GRAPHICSENGINE3D_VECTORF(3)
+GRAPHICSENGINE3D_VECTORF(4)
+#undef GRAPHICSENGINE3D_VECTORF
@@ -1,4 +1,8 @@
+#ifndef GRAPHICSENGINE3D_VECTOR_H
+#define GRAPHICSENGINE3D_VECTOR_H
+
 #include <iostream>
+#include <string>
 
 /**
  * General n-dimensional Vector/Point float class.  * Distinctions between the two
@@ -7,6 +11,7 @@
  * Vector type objects follow the convention of being column-vectors;
  * so that matrix transformations are done from the left.
  * 3 dimensional vectors are 16-bit, so compatible with console development.
+ * Definitions live in vector.cpp, instantiated for N = 1 to 4.
  * @tparam N dimension of float vector
  */
 template<size_t N>
@@ -46,8 +51,7 @@ public:
 
 
 private:
-    float pos[N];
-    float e; //default = 0
+    float pos[N + 1]; //coordinates, then the collision parameter (default = 0)
 };
 
 
@@ -62,4 +66,4 @@ template<typename T> int sgn(T val){
     return (T(0) < val) - (val < T(0));
 }
 
-
+#endif //GRAPHICSENGINE3D_VECTOR_H